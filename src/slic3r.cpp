@@ -4,7 +4,9 @@
 #include "Log.hpp"
 #include "SLAPrint.hpp"
 #include "Print.hpp"
+#include "Profiler.hpp"
 #include "SimplePrint.hpp"
+#include "SliceCache.hpp"
 #include "TriangleMesh.hpp"
 #include "libslic3r.h"
 #include <cmath>
@@ -95,6 +97,10 @@ int CLI::run(int argc, char **argv) {
     }
     Slic3r::Log::debug("CLI") << "Config validated" << std::endl;
 
+    const std::string profile_file = this->config.getString("profile", "");
+    if (!profile_file.empty())
+        Profiler::instance().enable();
+
     // read input file(s) if any
     for (auto const &file : input_files) {
         Model model;
@@ -296,8 +302,19 @@ int CLI::run(int argc, char **argv) {
         } else if (opt_key == "export_3mf") {
             this->export_models(IO::TMF);
         } else if (opt_key == "export_sla") {
-            Slic3r::Log::error("CLI") << "--export-sla is not implemented yet" << std::endl;
+            for (auto &model : this->models)
+                model.add_default_instances();
+            for (const Model &model : this->models) {
+                SLAPrint print(&model); // initialize print with model
+                print.config.apply(this->print_config, true); // apply configuration
+                print.slice(); // slice file
+                const std::string outfile = this->output_filepath(model, IO::ZIP);
+                print.write_png_zip(outfile); // write PNG masks
+                boost::nowide::cout << "SLA masks exported to " << outfile << std::endl;
+            }
         } else if (opt_key == "export_sla_svg") {
+            for (auto &model : this->models)
+                model.add_default_instances();
             for (const Model &model : this->models) {
                 SLAPrint print(&model); // initialize print with model
                 print.config.apply(this->print_config, true); // apply configuration
@@ -307,6 +324,9 @@ int CLI::run(int argc, char **argv) {
                 boost::nowide::cout << "SVG file exported to " << outfile << std::endl;
             }
         } else if (opt_key == "export_gcode") {
+            std::shared_ptr<SliceCache> slice_cache;
+            if (!this->config.getString("slice_cache", "").empty())
+                slice_cache = std::make_shared<SliceCache>(this->config.getString("slice_cache"));
             for (const Model &model : this->models) {
                 // If all objects have defined instances, their relative positions will be
                 // honored when printing (they will be only centered, unless --dont-arrange
@@ -318,6 +338,9 @@ int CLI::run(int argc, char **argv) {
                 };
                 print.apply_config(this->print_config);
                 print.arrange = !this->config.getBool("dont_arrange", false);
+                print.stream_infill = this->config.getBool("stream_infill", false);
+                print.parallel_gcode = this->config.getBool("parallel_gcode", false);
+                print.slice_cache = slice_cache;
                 print.center = !this->config.has("center")
                     && !this->config.has("align_xy")
                     && print.arrange;
@@ -348,12 +371,30 @@ int CLI::run(int argc, char **argv) {
                     << "Filament required: " << print.total_used_filament() << "mm"
                     << " (" << print.total_extruded_volume()/1000 << "cm3)" << std::endl;
             }
+            if (slice_cache != nullptr) {
+                const SliceCache::Stats toolpaths = slice_cache->stats(posInfill);
+                const SliceCache::Stats slices = slice_cache->stats(posSlice);
+                boost::nowide::cout << "Slice cache " << slice_cache->directory() << ": "
+                    << toolpaths.hits << " hits, " << toolpaths.misses << " misses for toolpaths; "
+                    << slices.hits << " hits, " << slices.misses << " misses for slices; "
+                    << (toolpaths.stores + slices.stores) << " entries stored." << std::endl;
+            }
         } else {
             Slic3r::Log::error("CLI") <<  "error: option not supported yet: " << opt_key << std::endl;
             exit(EXIT_FAILURE);
         }
     }
     
+    if (!profile_file.empty()) {
+        try {
+            Profiler::instance().write_trace(profile_file);
+            boost::nowide::cout << "Profile written to " << profile_file << std::endl;
+        } catch (std::exception &e) {
+            Slic3r::Log::error("CLI") << e.what() << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+    
     if (actions.empty()) {
 #ifdef USE_WX
         GUI::App *gui = new GUI::App();
@@ -414,7 +455,7 @@ CLI::export_models(IO::ExportFormat format) {
     for (const Model& model : this->models) {
         const std::string outfile = this->output_filepath(model, format);
         
-        IO::write_model.at(format)(model, outfile);
+        IO::write_model.at(format)(model, outfile, this->full_print_config.threads.value);
         std::cout << "File exported to " << outfile << std::endl;
     }
 }
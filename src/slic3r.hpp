@@ -28,7 +28,7 @@ class CLI {
     void export_models(IO::ExportFormat format);
     
     bool has_print_action() const {
-        return this->config.has("export_gcode") || this->config.has("export_sla_svg");
+        return this->config.has("export_gcode") || this->config.has("export_sla") || this->config.has("export_sla_svg");
     };
     
     std::string output_filepath(const Model &model, IO::ExportFormat format) const;
@@ -1,7 +1,9 @@
 #include <catch.hpp>
 #include <test_options.hpp>
+#include "test_data.hpp"
 #include "Model.hpp"
 #include "TMF.hpp"
+#include <boost/filesystem.hpp>
 
 
 using namespace Slic3r;
@@ -17,3 +19,85 @@ SCENARIO("Reading 3mf file") {
         }
     }
 }
+
+SCENARIO("3mf models are inflated straight into the parser") {
+    GIVEN("a 3mf file") {
+        Model model;
+        WHEN("it is read") {
+            boost::filesystem::remove("3dmodel.model");
+            REQUIRE(Slic3r::IO::TMF::read(testfile("test_3mf/Geräte/box.3mf"), &model));
+            THEN("the object is read and no temporary file is left in the working directory") {
+                REQUIRE(model.objects.size() == 1);
+                REQUIRE(model.objects.front()->facets_count() == 12);
+                REQUIRE(!boost::filesystem::exists("3dmodel.model"));
+            }
+        }
+    }
+    GIVEN("a model of several objects written to a 3mf file") {
+        Model model;
+        for (const auto m : { Slic3r::Test::TestMesh::sphere_50mm, Slic3r::Test::TestMesh::ipadstand, Slic3r::Test::TestMesh::cube_20x20x20 }) {
+            ModelObject* object = model.add_object();
+            object->add_volume(Slic3r::Test::mesh(m));
+            object->add_instance();
+        }
+        const std::string file {(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("%%%%-%%%%.3mf")).string()};
+        REQUIRE(Slic3r::IO::TMF::write(model, file));
+        WHEN("it is read back") {
+            Model read;
+            REQUIRE(Slic3r::IO::TMF::read(file, &read));
+            THEN("the objects have the same triangles and volume") {
+                REQUIRE(read.objects.size() == model.objects.size());
+                for (size_t i = 0; i < model.objects.size(); ++i) {
+                    REQUIRE(read.objects[i]->facets_count() == model.objects[i]->facets_count());
+                    REQUIRE(read.objects[i]->raw_mesh().volume() == Approx(model.objects[i]->raw_mesh().volume()));
+                }
+            }
+        }
+        boost::filesystem::remove(file);
+    }
+    GIVEN("a zip archive without a 3D model") {
+        const std::string file {(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("%%%%-%%%%.3mf")).string()};
+        {
+            Slic3r::ZipArchive zip(file, 'W');
+            const std::string content {"<model/>"};
+            REQUIRE(zip.add_entry("3D/other.model", content.data(), content.size()));
+            zip.finalize();
+        }
+        THEN("reading it fails") {
+            Model model;
+            REQUIRE(!Slic3r::IO::TMF::read(file, &model));
+        }
+        boost::filesystem::remove(file);
+    }
+}
+
+SCENARIO("3mf writer leaves the model untouched") {
+    GIVEN("a model whose mesh has no shared vertices") {
+        Model model;
+        ModelObject* object = model.add_object();
+        object->add_volume(Slic3r::Test::mesh(Slic3r::Test::TestMesh::cube_20x20x20));
+        object->add_instance();
+        REQUIRE(object->volumes.front()->mesh.stl.v_shared == nullptr);
+        const std::string file {(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("%%%%-%%%%.3mf")).string()};
+        WHEN("it is written") {
+            REQUIRE(Slic3r::IO::TMF::write(model, file));
+            THEN("the mesh is not indexed and no temporary file is left in the working directory") {
+                REQUIRE(object->volumes.front()->mesh.stl.v_shared == nullptr);
+                REQUIRE(!boost::filesystem::exists(".3dmodel.model"));
+                REQUIRE(!boost::filesystem::exists(".rels"));
+                REQUIRE(!boost::filesystem::exists("[Content_Types].xml"));
+            }
+            THEN("it is read back with its 8 shared vertices") {
+                Model read;
+                REQUIRE(Slic3r::IO::TMF::read(file, &read));
+                REQUIRE(read.objects.size() == 1);
+                REQUIRE(read.objects.front()->facets_count() == 12);
+                TriangleMesh mesh {read.objects.front()->raw_mesh()};
+                mesh.require_shared_vertices();
+                REQUIRE(mesh.stl.stats.shared_vertices == 8);
+                REQUIRE(mesh.volume() == Approx(8000));
+            }
+            boost::filesystem::remove(file);
+        }
+    }
+}
@@ -2,6 +2,9 @@
 #include <test_options.hpp>
 #include "Model.hpp"
 #include "IO.hpp"
+#include "IO/XMLWriter.hpp"
+#include "test_data.hpp"
+#include <boost/filesystem.hpp>
 
 
 using namespace Slic3r;
@@ -83,3 +86,49 @@ SCENARIO("Reading AMF file", "[AMF]") {
         }
     }
 }
+
+SCENARIO("Writing AMF file", "[AMF]") {
+    GIVEN("coordinates to format") {
+        THEN("they are written with 6 significant digits as printf(\"%g\") does") {
+            std::string text;
+            for (const double v : { 0., 20., -3.5, 39.999382, 0.0024674, -0.0000001, 1e15 }) {
+                Slic3r::IO::append_float(text, v);
+                text += ' ';
+            }
+            REQUIRE(text == "0 20 -3.5 39.9994 0.0024674 -1e-07 1e+15 ");
+        }
+        THEN("values next to a rounding tie are rounded as printf(\"%g\") does") {
+            std::string text;
+            for (const double v : { 146.8145, 89.09575, 61.58175, 8610.305 }) {
+                Slic3r::IO::append_float(text, v);
+                text += ' ';
+            }
+            REQUIRE(text == "146.815 89.0957 61.5817 8610.31 ");
+        }
+    }
+    GIVEN("a model of two objects") {
+        Model model;
+        for (const auto m : { Slic3r::Test::TestMesh::sphere_50mm, Slic3r::Test::TestMesh::cube_20x20x20 }) {
+            ModelObject* object = model.add_object();
+            object->add_volume(Slic3r::Test::mesh(m));
+            object->add_instance();
+        }
+        const std::string file {(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("%%%%-%%%%.amf")).string()};
+        WHEN("it is written and read back") {
+            REQUIRE(Slic3r::IO::AMF::write(model, file));
+            Model read;
+            REQUIRE(Slic3r::IO::AMF::read(file, &read));
+            THEN("the objects have the same triangles and volume") {
+                REQUIRE(read.objects.size() == model.objects.size());
+                for (size_t i = 0; i < model.objects.size(); ++i) {
+                    REQUIRE(read.objects[i]->facets_count() == model.objects[i]->facets_count());
+                    REQUIRE(read.objects[i]->raw_mesh().volume() == Approx(model.objects[i]->raw_mesh().volume()));
+                }
+            }
+            THEN("the written meshes are left untouched") {
+                REQUIRE(model.objects.front()->volumes.front()->mesh.stl.v_shared == nullptr);
+            }
+            boost::filesystem::remove(file);
+        }
+    }
+}
@@ -21,6 +21,123 @@ SCENARIO("Cooling buffer speed factor rewrite enforces precision") {
     }
 }
 
+SCENARIO("Cooling buffer slows down short layers") {
+    GIVEN("A layer with an extrusion, a bridge, an external perimeter and a wipe") {
+        PrintConfig config;
+        config.cooling.value                    = true;
+        config.slowdown_below_layer_time.value  = 10;
+        config.fan_below_layer_time.value       = 60;
+        config.max_fan_speed.value              = 100;
+        config.min_fan_speed.value              = 35;
+        config.bridge_fan_speed.value           = 50;
+        config.disable_fan_first_layers.value   = 0;
+        config.min_print_speed.value            = 10;
+        const std::string layer {
+            "G1 X0 Y0 F7800\n"
+            "G1 X10 Y0 E1 F3000 ;_EXTRUDE_SET_SPEED\n"
+            ";_BRIDGE_FAN_START\n"
+            "G1 X20 Y0 E2 F3000 ;_EXTRUDE_SET_SPEED\n"
+            ";_BRIDGE_FAN_END\n"
+            "G1 X20 Y10 E3 F3000 ;_EXTRUDE_SET_SPEED;_EXTERNAL_PERIMETER\n"
+            "G1 X10 Y10 F7800 ;_WIPE\n"};
+        // the fan commands flush() writes, in the order it writes them
+        const auto fan = [&config](unsigned int speed) {
+            GCodeWriter writer;
+            writer.apply_print_config(config);
+            std::vector<std::string> gcode;
+            gcode.push_back(writer.set_fan(speed));
+            gcode.push_back(writer.set_fan(config.bridge_fan_speed, true));
+            gcode.push_back(writer.set_fan(speed, true));
+            return gcode;
+        };
+        // the layer appended in two pieces, the second one for another object
+        // so that it does not flush the first one
+        const auto cool = [&config](const std::vector<std::string> &pieces, float elapsed_time) {
+            GCode gcodegen;
+            gcodegen.apply_print_config(config);
+            CoolingBuffer buffer(gcodegen);
+            gcodegen.elapsed_time = elapsed_time;
+            for (size_t i = 0; i < pieces.size(); ++i)
+                buffer.append(pieces[i], std::to_string(i), 1, 0.5);
+            return buffer.flush();
+        };
+        WHEN("It took half the time to slow down below") {
+            const std::string gcode {cool({layer}, 5)};
+            THEN("The fan runs full and only the extrusion outside of the bridge and the external perimeter is slowed down") {
+                const std::vector<std::string> fans {fan(100)};
+                REQUIRE_THAT(gcode, Catch::Equals(fans[0]
+                    + "G1 X0 Y0 F7800\n"
+                    + "G1 X10 Y0 E1 F1500.000\n"
+                    + fans[1] + "\n"
+                    + "G1 X20 Y0 E2 F3000 \n"
+                    + fans[2] + "\n"
+                    + "G1 X20 Y10 E3 F3000 \n"
+                    + "G1 X10 Y10 F7800 \n"));
+            }
+        }
+        WHEN("It took longer than the time to run the fan below") {
+            const std::string gcode {cool({layer}, 100)};
+            THEN("No extrusion is slowed down and the markers are removed") {
+                const std::vector<std::string> fans {fan(0)};
+                REQUIRE_THAT(gcode, Catch::Equals(fans[0]
+                    + "G1 X0 Y0 F7800\n"
+                    + "G1 X10 Y0 E1 F3000 \n"
+                    + fans[1] + "\n"
+                    + "G1 X20 Y0 E2 F3000 \n"
+                    + fans[2] + "\n"
+                    + "G1 X20 Y10 E3 F3000 \n"
+                    + "G1 X10 Y10 F7800 \n"));
+            }
+        }
+        WHEN("It is appended in two pieces, split anywhere") {
+            const std::string whole {cool({layer}, 5)};
+            THEN("The markers are found across the split") {
+                for (size_t split = 0; split <= layer.size(); ++split)
+                    REQUIRE_THAT(cool({layer.substr(0, split), layer.substr(split)}, 5), Catch::Equals(whole));
+            }
+        }
+    }
+}
+
+SCENARIO("Leaving an external perimeter loop with a short last path") {
+    GIVEN("A 10mm square loop made of one external perimeter path per side") {
+        auto config {Slic3r::Config::new_from_defaults()};
+        config->set("perimeters", 2);
+        config->set("seam_position", "nearest");
+        config->set("gcode_comments", true);
+        Slic3r::Model model;
+        auto print {Slic3r::Test::init_print({TestMesh::cube_20x20x20}, model, config)};
+        print->process();
+
+        GCode gcodegen;
+        gcodegen.apply_print_config(print->config);
+        gcodegen.set_extruders(std::vector<unsigned int> {0});
+        gcodegen.writer.toolchange(0);
+        gcodegen.layer = print->objects.front()->get_layer(0);
+        gcodegen.set_last_pos(Point(0, 0));
+
+        const Points corners {Point::new_scale(0, 0), Point::new_scale(10, 0), Point::new_scale(10, 10), Point::new_scale(0, 10)};
+        ExtrusionLoop loop;
+        for (size_t i = 0; i < corners.size(); ++i) {
+            ExtrusionPath path(erExternalPerimeter, 0.05, 0.5, 0.3);
+            path.polyline.points = { corners[i], corners[(i + 1) % corners.size()] };
+            loop.paths.push_back(path);
+        }
+        WHEN("It is extruded from its first corner") {
+            const std::string gcode {gcodegen.extrude(loop, "perimeter")};
+            THEN("The move inwards turns from the first side into the square") {
+                std::smatch match;
+                REQUIRE(std::regex_search(gcode, match, std::regex("G1 X([-0-9.]+) Y([-0-9.]+) .*; move inwards before travel")));
+                const double x {std::stod(match[1])}, y {std::stod(match[2])};
+                REQUIRE(x > 0);
+                REQUIRE(x < 0.5);
+                REQUIRE(y > 0);
+                REQUIRE(y < x);
+            }
+        }
+    }
+}
+
 SCENARIO( "Test of COG calculation") {
     GIVEN("A default configuration and a print test object") {
         auto config {Slic3r::Config::new_from_defaults()};
@@ -67,3 +184,31 @@ SCENARIO( "Test of COG calculation") {
         gcode.clear();
     }
 }
+
+#include "GCode/SpiralVase.hpp"
+
+SCENARIO("Spiral vase ramps the Z of a layer along its extrusions") {
+    GIVEN("A spiral vase past a first layer at 0.3mm") {
+        PrintConfig config;
+        SpiralVase spiral_vase(config);
+        spiral_vase.process_layer("G1 Z0.300 F7800.000\nG1 X0 Y0 E0\n");
+        spiral_vase.enable = true;
+        WHEN("A layer 0.2mm above it is processed") {
+            const std::string gcode {spiral_vase.process_layer(
+                "G1 Z0.500 F7800.000 ; move to next layer\n"
+                "G1 X10 Y0\n"
+                "G1 X20 Y0 E1\n"
+                "G1 X20 Y10 E2\n"
+                "M107\n"
+                "G1 X10 Y10 E3 ; perimeter")};
+            THEN("The layer starts at the previous Z, drops the travel and climbs with the extrusions") {
+                REQUIRE_THAT(gcode, Catch::Equals(
+                    "G1 Z0.300 F7800.000 ; move to next layer\n"
+                    "G1 Z0.367 X20 Y0 E1\n"
+                    "G1 Z0.433 X20 Y10 E2\n"
+                    "M107\n"
+                    "G1 Z0.500 X10 Y10 E3 ; perimeter\n"));
+            }
+        }
+    }
+}
@@ -0,0 +1,117 @@
+#include <catch.hpp>
+#include <fstream>
+#include <sstream>
+#include <boost/filesystem.hpp>
+
+#include "GCodeReader.hpp"
+
+using namespace Slic3r;
+using namespace std::literals::string_literals;
+
+SCENARIO("GCodeReader tokenizes lines into words") {
+    GIVEN("A G1 line with a comment, a repeated word and an unusual number") {
+        GCodeReader reader;
+        std::string cmd, comment, raw;
+        bool has_x {false}, has_a {false};
+        float x {0}, y {0}, z {0}, f {0};
+        reader.parse("G1 X1.5 X2 Y-.25 Z1e1 F ; move;here"s, [&] (GCodeReader&, const GCodeReader::GCodeLine& line) {
+            cmd = line.cmd;
+            comment = line.comment;
+            raw = line.raw;
+            has_x = line.has('X');
+            has_a = line.has('A');
+            x = line.get_float('X');
+            y = line.new_Y();
+            z = line.new_Z();
+            f = line.new_F();
+        });
+        THEN("The command, comment and raw line are kept") {
+            REQUIRE(cmd == "G1");
+            REQUIRE(comment == " move;here");
+            REQUIRE(raw == "G1 X1.5 X2 Y-.25 Z1e1 F ; move;here");
+        }
+        THEN("The first occurrence of a word wins and empty words are ignored") {
+            REQUIRE(has_x);
+            REQUIRE(x == Approx(1.5));
+            REQUIRE(!has_a);
+            REQUIRE(f == 0);
+        }
+        THEN("Numbers are parsed like atof") {
+            REQUIRE(y == Approx(-0.25));
+            REQUIRE(z == Approx(10.0));
+        }
+        THEN("The reader position follows the move") {
+            REQUIRE(reader.X == Approx(1.5));
+            REQUIRE(reader.Y == Approx(-0.25));
+            REQUIRE(reader.Z == Approx(10.0));
+        }
+    }
+    GIVEN("A reader configured with a different extrusion axis") {
+        GCodeReader reader;
+        GCodeConfig config;
+        config.extrusion_axis.value = "A";
+        reader.apply_config(config);
+        WHEN("A line extrudes on that axis") {
+            float dist_e {0};
+            bool has_a {true};
+            reader.parse("G1 X1 A0.5\nG1 X2 A1.25\n"s, [&] (GCodeReader&, const GCodeReader::GCodeLine& line) {
+                dist_e = line.dist_E();
+                has_a = line.has('A');
+            });
+            THEN("It is reported as E") {
+                REQUIRE(dist_e == Approx(0.75));
+                REQUIRE(!has_a);
+                REQUIRE(reader.E == Approx(1.25));
+            }
+        }
+    }
+    GIVEN("A line rewritten with set()") {
+        GCodeReader reader;
+        std::string raw;
+        float z {0};
+        reader.parse("G1 X1 Z0.2 E3"s, [&] (GCodeReader&, const GCodeReader::GCodeLine& l) {
+            GCodeReader::GCodeLine line = l;
+            line.set('Z', "0.350");
+            raw = line.raw;
+            z = line.new_Z();
+        });
+        THEN("Both the text and the value are updated") {
+            REQUIRE(raw == "G1 X1 Z0.350 E3");
+            REQUIRE(z == Approx(0.35));
+        }
+    }
+}
+
+SCENARIO("GCodeReader reads buffers, streams and files the same way") {
+    GIVEN("Some G-code without a final newline") {
+        const std::string gcode {"G92 E0\nG1 Z0.3 F7800\n\nG1 X10 Y10 E1.5 F1800\nG1 X20 E3 ; last"};
+        auto summary = [] (std::vector<std::string> &lines) {
+            return [&lines] (GCodeReader& self, const GCodeReader::GCodeLine& line) {
+                std::ostringstream ss;
+                ss << line.cmd << ":" << line.dist_XY() << ":" << line.dist_E() << ":" << self.Z;
+                lines.push_back(ss.str());
+            };
+        };
+        std::vector<std::string> from_buffer, from_stream, from_file;
+        GCodeReader().parse(gcode, summary(from_buffer));
+        std::istringstream stream(gcode);
+        GCodeReader().parse_stream(stream, summary(from_stream));
+
+        const auto path {boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("gcodereader-%%%%%%.gcode")};
+        {
+            std::ofstream f(path.string());
+            f << gcode;
+        }
+        GCodeReader().parse_file(path.string(), summary(from_file));
+        boost::filesystem::remove(path);
+
+        THEN("Every line is reported once, including empty ones") {
+            REQUIRE(from_buffer.size() == 5);
+            REQUIRE(from_buffer[2] == ":0:0:0.3");
+        }
+        THEN("All inputs give the same lines") {
+            REQUIRE(from_stream == from_buffer);
+            REQUIRE(from_file == from_buffer);
+        }
+    }
+}
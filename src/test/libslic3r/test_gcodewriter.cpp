@@ -1,5 +1,8 @@
 #include <catch.hpp>
+#include <iomanip>
 #include <memory>
+#include <random>
+#include <sstream>
 
 #include "GCodeWriter.hpp"
 #include "test_options.hpp"
@@ -125,3 +128,59 @@ SCENARIO("set_speed emits values with fixed-point output.") {
         }
     }
 }
+
+SCENARIO("GCodeFormatter writes numbers like a fixed-point stream.") {
+    auto stream_fixed = [](double value, int precision) {
+        std::ostringstream ss;
+        ss << std::fixed << std::setprecision(precision) << value;
+        return ss.str();
+    };
+    auto formatted = [](double value, int precision) {
+        std::string out;
+        GCodeFormatter::append_fixed(out, value, precision);
+        return out;
+    };
+
+    GIVEN("Values at rounding boundaries, signed zeroes and huge magnitudes") {
+        const std::vector<double> values {
+            0.0, -0.0, 0.0005, 0.0015, 0.0025, -0.0005, -0.0004, 1.0005, 2.675, 1.00005, 0.000015,
+            203.200522, 999.9995, 9999.99951, -0.00000001, 1e15, 1.5e17, 9007199254740992.0, -1e300
+        };
+        THEN("Output matches std::fixed for 3 and 5 decimals") {
+            for (double v : values) {
+                REQUIRE(formatted(v, 3) == stream_fixed(v, 3));
+                REQUIRE(formatted(v, 5) == stream_fixed(v, 5));
+            }
+        }
+    }
+    GIVEN("Random coordinates and extrusion values") {
+        std::mt19937 rng(1234);
+        std::uniform_real_distribution<double> coord(-1000.0, 1000.0);
+        std::uniform_int_distribution<int> thousandths(-1000000, 1000000);
+        THEN("Output matches std::fixed for every precision used by GCodeWriter") {
+            for (size_t i = 0; i < 100000; ++i) {
+                const double v = coord(rng);
+                // values sitting right on a half step of the last printed digit
+                const double tie = thousandths(rng) / 1000.0 + 0.0005;
+                REQUIRE(formatted(v, 3) == stream_fixed(v, 3));
+                REQUIRE(formatted(v, 5) == stream_fixed(v, 5));
+                REQUIRE(formatted(tie, 3) == stream_fixed(tie, 3));
+            }
+        }
+    }
+    GIVEN("A GCodeWriter with comments enabled") {
+        GCodeWriter writer;
+        writer.config.gcode_comments.value = true;
+        std::vector<unsigned int> extruder_ids {0};
+        writer.set_extruders(extruder_ids);
+        writer.set_extruder(0);
+        WHEN("Moves are written") {
+            THEN("Lines keep the historical layout") {
+                REQUIRE_THAT(writer.travel_to_xy(Pointf(1.23456, -0.0004), "move"s), Catch::Equals("G1 X1.235 Y-0.000 F7800.000 ; move\n"));
+                REQUIRE_THAT(writer.travel_to_z(0.3), Catch::Equals("G1 Z0.300 F7800.000\n"));
+                REQUIRE_THAT(writer.extrude_to_xy(Pointf(10, 20), 0.123456), Catch::Equals("G1 X10.000 Y20.000 E0.12346\n"));
+                REQUIRE_THAT(writer.set_speed(1800, ""s, ";_COOLING"s), Catch::Equals("G1 F1800.000;_COOLING\n"));
+            }
+        }
+    }
+}
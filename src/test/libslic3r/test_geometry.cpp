@@ -9,6 +9,8 @@
 #include "Geometry.hpp"
 #include "ClipperUtils.hpp"
 
+#include <random>
+
 using namespace Slic3r;
 
 TEST_CASE("Polygon::contains works properly", ""){
@@ -266,6 +268,35 @@ TEST_CASE("Chained path working correctly"){
     }
 }
 
+SCENARIO("Chained path matches a linear nearest-neighbor walk") {
+    GIVEN("Points on a coarse lattice, with duplicates and equidistant neighbors") {
+        std::mt19937 rng(3);
+        std::uniform_int_distribution<int> coord(-30, 30);
+        Points points;
+        for (int i = 0; i < 2000; ++i)
+            points.push_back(Point(coord(rng) * 1000, coord(rng) * 500));
+        WHEN("they are chained") {
+            std::vector<Points::size_type> indices;
+            Geometry::chained_path(points, indices, Point(0, 0));
+            THEN("the order is the one of repeated Point::nearest_point_index() scans") {
+                Points remaining = points;
+                std::vector<Points::size_type> remaining_indices(points.size());
+                for (size_t i = 0; i < points.size(); ++i) remaining_indices[i] = i;
+                std::vector<Points::size_type> expected;
+                Point start_near(0, 0);
+                while (!remaining.empty()) {
+                    const int idx = start_near.nearest_point_index(remaining);
+                    start_near = remaining[idx];
+                    expected.push_back(remaining_indices[idx]);
+                    remaining.erase(remaining.begin() + idx);
+                    remaining_indices.erase(remaining_indices.begin() + idx);
+                }
+                REQUIRE(indices == expected);
+            }
+        }
+    }
+}
+
 SCENARIO("Line distances"){
     GIVEN("A line"){
         auto line = Line(Point(0, 0), Point(20, 0));
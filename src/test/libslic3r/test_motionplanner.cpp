@@ -0,0 +1,115 @@
+#include <catch.hpp>
+
+#include "MotionPlanner.hpp"
+#include "ClipperUtils.hpp"
+#include "Line.hpp"
+#include "Point.hpp"
+#include "Polygon.hpp"
+
+#include <random>
+
+using namespace Slic3r;
+
+// Ported from xs/t/18_motionplanner.t
+
+namespace {
+
+/// 100x100mm square with a 20x20mm hole in its center, translated by dx.
+ExPolygon
+square_with_hole(double dx = 0)
+{
+    ExPolygon expolygon;
+    expolygon.contour = Polygon(Points({
+        Point::new_scale(100 + dx, 100), Point::new_scale(200 + dx, 100),
+        Point::new_scale(200 + dx, 200), Point::new_scale(100 + dx, 200) }));
+    expolygon.holes.push_back(Polygon(Points({
+        Point::new_scale(140 + dx, 140), Point::new_scale(140 + dx, 160),
+        Point::new_scale(160 + dx, 160), Point::new_scale(160 + dx, 140) })));
+    return expolygon;
+}
+
+}
+
+SCENARIO("MotionPlanner: paths avoid the configuration space boundaries.") {
+    GIVEN("A square with a hole") {
+        const ExPolygon expolygon = square_with_hole();
+        MotionPlanner mp(ExPolygons({ expolygon }));
+        WHEN("a path is planned across the hole") {
+            const Point from = Point::new_scale(120, 120), to = Point::new_scale(180, 180);
+            const Polyline path = mp.shortest_path(from, to);
+            THEN("the path goes around the hole") {
+                REQUIRE(path.is_valid());
+                REQUIRE(path.length() > Line(from, to).length());
+                REQUIRE(path.first_point().coincides_with(from));
+                REQUIRE(path.last_point().coincides_with(to));
+                REQUIRE(expolygon.contains(path));
+            }
+            THEN("planning it again returns the same path") {
+                REQUIRE(mp.shortest_path(from, to).points == path.points);
+            }
+        }
+        WHEN("a path is planned between two points outside of it") {
+            const Point from = Point::new_scale(80, 100), to = Point::new_scale(220, 200);
+            const Polyline path = mp.shortest_path(from, to);
+            THEN("the path goes around the island") {
+                REQUIRE(path.is_valid());
+                REQUIRE(path.length() > Line(from, to).length());
+                REQUIRE(path.first_point().coincides_with(from));
+                REQUIRE(path.last_point().coincides_with(to));
+                REQUIRE(intersection_pl(Polylines({ path }), (Polygons)expolygon).empty());
+            }
+        }
+    }
+    GIVEN("Two islands") {
+        MotionPlanner mp(ExPolygons({ square_with_hole(), square_with_hole(300) }));
+        WHEN("a path is planned from one island to the other") {
+            const Point from = Point::new_scale(120, 120), to = Point::new_scale(420, 120);
+            const Polyline path = mp.shortest_path(from, to);
+            THEN("a valid path joining both points is returned") {
+                REQUIRE(mp.islands_count() == 2);
+                REQUIRE(path.is_valid());
+                REQUIRE(path.first_point().coincides_with(from));
+                REQUIRE(path.last_point().coincides_with(to));
+            }
+        }
+    }
+}
+
+SCENARIO("MotionPlannerGraph: node lookup and shortest path.") {
+    GIVEN("A grid graph with duplicate nodes") {
+        MotionPlannerGraph graph;
+        std::mt19937 rng(7);
+        std::uniform_int_distribution<int> coord(0, 20);
+        for (int i = 0; i < 400; ++i)
+            graph.nodes.push_back(Point(coord(rng) * 1000, coord(rng) * 1000));
+        // connect each node to the nodes within a short distance
+        for (size_t i = 0; i < graph.nodes.size(); ++i)
+            for (size_t j = 0; j < graph.nodes.size(); ++j)
+                if (i != j && graph.nodes[i].distance_to(graph.nodes[j]) <= 1500)
+                    graph.add_edge(i, j, graph.nodes[i].distance_to(graph.nodes[j]));
+        WHEN("nodes are looked up") {
+            THEN("the same node as a linear nearest point search is found") {
+                for (int i = 0; i < 500; ++i) {
+                    const Point p(coord(rng) * 1000 + coord(rng) * 50 - 500, coord(rng) * 1000 + coord(rng) * 50 - 500);
+                    REQUIRE(graph.find_node(p) == (size_t)p.nearest_point_index(graph.nodes));
+                }
+                for (const Point &p : graph.nodes)
+                    REQUIRE(graph.find_node(p) == (size_t)p.nearest_point_index(graph.nodes));
+            }
+        }
+        WHEN("shortest paths are searched") {
+            THEN("they join both nodes through graph edges") {
+                for (int i = 0; i < 50; ++i) {
+                    const size_t from = graph.find_node(graph.nodes[i]), to = graph.find_node(graph.nodes[399 - i]);
+                    const Polyline path = graph.shortest_path(from, to);
+                    REQUIRE(path.first_point() == graph.nodes[from]);
+                    REQUIRE(path.last_point() == graph.nodes[to]);
+                    // the path starts with 'from' twice, unless 'to' is unreachable
+                    if (path.points[1] == graph.nodes[from])
+                        for (size_t k = 1; k + 1 < path.points.size(); ++k)
+                            REQUIRE(path.points[k].distance_to(path.points[k+1]) <= 1500);
+                }
+            }
+        }
+    }
+}
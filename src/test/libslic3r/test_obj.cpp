@@ -0,0 +1,111 @@
+#include <catch.hpp>
+#include <fstream>
+#include <boost/filesystem.hpp>
+#include "test_data.hpp"
+#include "IO.hpp"
+
+using namespace Slic3r;
+
+/// Write content to a new temporary OBJ file and return its name.
+static std::string write_obj(const std::string &content) {
+    const std::string file {(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("obj-%%%%%%.obj")).string()};
+    std::ofstream out(file, std::ios::binary);
+    out << content;
+    return file;
+}
+
+/// Vertices of a 10mm cube at x (mm).
+static std::string cube_vertices(double x) {
+    std::string obj;
+    for (int i = 0; i < 8; ++i)
+        obj += "v " + std::to_string(x + (i & 1 ? 10 : 0)) + " " + std::to_string(i & 2 ? 10 : 0) + " " + std::to_string(i & 4 ? 10 : 0) + "\n";
+    return obj;
+}
+
+/// Quads of a cube whose i-th vertex is referenced as first + i, with texture
+/// and normal references on some of them.
+static std::string cube_faces(int first) {
+    const int quads[6][4] = { {0, 2, 3, 1}, {4, 5, 7, 6}, {0, 1, 5, 4}, {2, 6, 7, 3}, {0, 4, 6, 2}, {1, 3, 7, 5} };
+    std::string obj;
+    for (const auto &quad : quads)
+        obj += "f " + std::to_string(first + quad[0]) + "/1/1 " + std::to_string(first + quad[1]) + "//2 "
+            + std::to_string(first + quad[2]) + " " + std::to_string(first + quad[3]) + "\r\n";
+    return obj;
+}
+
+SCENARIO("Memory-mapped OBJ reader", "[OBJ]") {
+    GIVEN("An OBJ file of two cubes in two groups, the second one with relative references") {
+        const std::string obj {"# two parts\nmtllib parts.mtl\ng first\n" + cube_vertices(0) + cube_faces(1) + "vn 0 0 1\ns off\n"
+            + "g second\n" + cube_vertices(20) + cube_faces(-8)};
+        const std::string file {write_obj(obj)};
+        WHEN("It is mapped and parsed in parallel") {
+            std::vector<TriangleMesh> meshes;
+            const bool result {IO::OBJ::read_mapped(file, &meshes)};
+            THEN("Each group is a closed mesh of its triangulated quads") {
+                REQUIRE(result);
+                REQUIRE(meshes.size() == 2);
+                for (size_t i = 0; i < meshes.size(); ++i) {
+                    meshes[i].repair();
+                    REQUIRE(meshes[i].facets_count() == 12);
+                    REQUIRE(meshes[i].volume() == Approx(1000));
+                    REQUIRE(meshes[i].bounding_box().min.x == Approx(20 * i));
+                }
+            }
+        }
+        WHEN("It is read through IO::OBJ::read") {
+            Model model;
+            IO::OBJ::read(file, &model);
+            THEN("The object has a volume per group") {
+                REQUIRE(model.objects.size() == 1);
+                REQUIRE(model.objects.front()->volumes.size() == 2);
+                REQUIRE(model.objects.front()->facets_count() == 24);
+            }
+        }
+        boost::filesystem::remove(file);
+    }
+    GIVEN("An OBJ file with a concave polygon") {
+        const std::string file {write_obj("v 0 0 0\nv 20 0 0\nv 20 10 0\nv 10 10 0\nv 10 20 0\nv 0 20 0\nf 1 2 3 4 5 6\n")};
+        WHEN("It is read") {
+            std::vector<TriangleMesh> meshes;
+            const bool result {IO::OBJ::read_mapped(file, &meshes)};
+            Model model;
+            IO::OBJ::read(file, &model);
+            THEN("Its triangulation is left to tinyobj") {
+                REQUIRE(!result);
+                REQUIRE(model.objects.front()->facets_count() == 4);
+            }
+        }
+        boost::filesystem::remove(file);
+    }
+    GIVEN("An OBJ file with a pentagram, turning the same way at each vertex") {
+        const std::string file {write_obj("v 0 10 0\nv 9.511 3.09 0\nv 5.878 -8.09 0\nv -5.878 -8.09 0\nv -9.511 3.09 0\nf 1 3 5 2 4\n")};
+        WHEN("It is read") {
+            std::vector<TriangleMesh> meshes;
+            const bool result {IO::OBJ::read_mapped(file, &meshes)};
+            Model model;
+            IO::OBJ::read(file, &model);
+            THEN("Its triangulation is left to tinyobj") {
+                REQUIRE(!result);
+                REQUIRE(model.objects.front()->facets_count() == 3);
+            }
+        }
+        boost::filesystem::remove(file);
+    }
+    GIVEN("A mesh written as OBJ") {
+        TriangleMesh mesh {Test::mesh(Test::TestMesh::ipadstand)};
+        const std::string file {(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("obj-%%%%%%.obj")).string()};
+        IO::OBJ::write(mesh, file);
+        WHEN("It is read back") {
+            Model model;
+            IO::OBJ::read(file, &model);
+            THEN("It has the same triangles and volume") {
+                REQUIRE(model.objects.front()->volumes.size() == 1);
+                REQUIRE(model.objects.front()->facets_count() == mesh.facets_count());
+                TriangleMesh read {model.objects.front()->raw_mesh()};
+                read.repair();
+                REQUIRE(read.volume() == Approx(mesh.volume()));
+            }
+        }
+        boost::filesystem::remove(file);
+    }
+}
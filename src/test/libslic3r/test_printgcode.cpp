@@ -4,6 +4,7 @@
 #include "test_data.hpp"
 #include "libslic3r.h"
 #include "GCodeReader.hpp"
+#include "Profiler.hpp"
 
 using namespace Slic3r::Test;
 using namespace Slic3r;
@@ -270,3 +271,169 @@ SCENARIO( "PrintGCode basic functionality") {
         gcode.clear();
     }
 }
+
+namespace {
+
+/// Output that checks, whenever G-code is written to it, that the fills of a
+/// streamed object are only held within a window of layers past the ones
+/// already written, whose perimeters have been released.
+class LayerWindowCheck : public std::streambuf {
+    public:
+    LayerWindowCheck(const PrintObject* object, size_t window) : _object(object), _window(window) {};
+    size_t violations {0};
+    size_t written {0};     ///< most layers seen released
+
+    protected:
+    int_type overflow(int_type c) override { this->check(); return c; };
+    std::streamsize xsputn(const char*, std::streamsize n) override { this->check(); return n; };
+
+    private:
+    const PrintObject* _object;
+    size_t _window;
+
+    void check() {
+        const LayerPtrs &layers = this->_object->layers;
+        size_t released = 0;
+        while (released < layers.size() && layers[released]->regions.front()->perimeters.empty())
+            ++released;
+        this->written = std::max(this->written, released);
+        // layers in the window may be filled in the background right now
+        for (size_t i = 0; i < layers.size(); ++i)
+            if ((i < released || i >= released + this->_window) && !layers[i]->regions.front()->fills.empty())
+                ++this->violations;
+    };
+};
+
+}
+
+SCENARIO( "PrintGCode streaming export") {
+    // drop the first line, which holds the time of the export
+    auto body = [] (const std::string& gcode) { return gcode.substr(gcode.find('\n')); };
+
+    GIVEN("Two objects with a few layers of infill") {
+        auto config {Slic3r::Config::new_from_defaults()};
+        config->set("layer_height", 0.5);
+        config->set("first_layer_height", 0.5);
+        config->set("fill_density", "20%");
+        config->set("threads", 2);
+        std::stringstream gcode, streamed, again;
+
+        WHEN("the G-code is exported with and without streaming the layers") {
+            Slic3r::Model model, streamed_model;
+            auto print {Slic3r::Test::init_print({TestMesh::cube_20x20x20, TestMesh::ipadstand}, model, config)};
+            Slic3r::Test::gcode(gcode, print);
+            auto streamed_print {Slic3r::Test::init_print({TestMesh::cube_20x20x20, TestMesh::ipadstand}, streamed_model, config)};
+            streamed_print->stream_infill = true;
+            Slic3r::Test::gcode(streamed, streamed_print);
+            THEN("The output is the same") {
+                REQUIRE(body(streamed.str()) == body(gcode.str()));
+            }
+            THEN("The toolpaths of the written layers have been released") {
+                bool released = true;
+                for (const auto* layer : streamed_print->objects.front()->layers)
+                    for (const auto* layerm : layer->regions)
+                        released = released && layerm->fills.empty() && layerm->perimeters.empty();
+                REQUIRE(released);
+            }
+            THEN("The print can be exported again") {
+                streamed_print->stream_infill = false;
+                Slic3r::Test::gcode(again, streamed_print);
+                REQUIRE(body(again.str()) == body(gcode.str()));
+            }
+        }
+        WHEN("an object is exported while the output checks which layers hold fills") {
+            Slic3r::Model model;
+            auto print {Slic3r::Test::init_print({TestMesh::cube_20x20x20}, model, config)};
+            print->stream_infill = true;
+            // two batches of 2 * threads layers: the one being written and the one being filled
+            LayerWindowCheck check(print->objects.front(), 2 * 2 * 2);
+            std::ostream output(&check);
+            print->export_gcode(output, true);
+            THEN("The layers outside the window hold no fills") {
+                REQUIRE(print->objects.front()->layers.size() > 2 * 2 * 2);
+                REQUIRE(check.written == print->objects.front()->layers.size());
+                REQUIRE(check.violations == 0);
+            }
+        }
+        WHEN("the objects are printed one after the other") {
+            config->set("complete_objects", true);
+            Slic3r::Model model, streamed_model;
+            auto print {Slic3r::Test::init_print({TestMesh::cube_20x20x20, TestMesh::ipadstand}, model, config)};
+            Slic3r::Test::gcode(gcode, print);
+            auto streamed_print {Slic3r::Test::init_print({TestMesh::cube_20x20x20, TestMesh::ipadstand}, streamed_model, config)};
+            streamed_print->stream_infill = true;
+            Slic3r::Test::gcode(streamed, streamed_print);
+            THEN("The output is the same as without streaming") {
+                REQUIRE(body(streamed.str()) == body(gcode.str()));
+            }
+        }
+    }
+}
+
+SCENARIO( "PrintGCode output doesn't depend on the number of threads") {
+    // drop the time of the export and the config dump, which lists the thread count
+    auto body = [] (const std::string& gcode) {
+        const size_t start { gcode.find('\n') };
+        return gcode.substr(start, gcode.find("; threads = ") - start);
+    };
+
+    GIVEN("Two objects with several perimeters and some infill") {
+        auto config {Slic3r::Config::new_from_defaults()};
+        config->set("layer_height", 0.5);
+        config->set("first_layer_height", 0.5);
+        config->set("fill_density", "20%");
+        config->set("perimeters", 3);
+        std::stringstream serial, parallel;
+
+        WHEN("the G-code is exported with one and with four threads") {
+            std::array<Slic3r::Model, 2> models;
+            auto prints {Slic3r::Test::init_print_threads({TestMesh::cube_20x20x20, TestMesh::ipadstand}, models, config)};
+            Slic3r::Test::gcode(serial, prints[0]);
+            Slic3r::Test::gcode(parallel, prints[1]);
+            THEN("The output is the same") {
+                REQUIRE(body(parallel.str()) == body(serial.str()));
+            }
+        }
+        WHEN("the layers are written as fragments with one and with four threads") {
+            std::array<Slic3r::Model, 2> models;
+            auto prints {Slic3r::Test::init_print_threads({TestMesh::cube_20x20x20, TestMesh::ipadstand}, models, config)};
+            Slic3r::Model model;
+            auto print {Slic3r::Test::init_print({TestMesh::cube_20x20x20, TestMesh::ipadstand}, model, config)};
+            std::stringstream gcode;
+            Slic3r::Test::gcode(gcode, print);
+            prints[0]->parallel_gcode = prints[1]->parallel_gcode = true;
+            Slic3r::Test::gcode(serial, prints[0]);
+            Slic3r::Profiler::instance().enable();
+            Slic3r::Test::gcode(parallel, prints[1]);
+            Slic3r::Profiler::instance().disable();
+            THEN("The output is the same") {
+                REQUIRE(body(parallel.str()) == body(serial.str()));
+            }
+            THEN("The fragments are joined to the layers without being written again") {
+                size_t written {0}, rewritten {0};
+                for (const auto &event : Slic3r::Profiler::instance().events()) {
+                    if (event.name == "PrintGCode::write_fragments") written += event.items;
+                    if (event.name == "PrintGCode::rewrite_fragment") rewritten += event.items;
+                }
+                size_t layers {0};
+                for (const auto* object : prints[1]->objects) layers += object->layers.size();
+                REQUIRE(written == layers);
+                REQUIRE(rewritten == 0);
+            }
+            THEN("The same filament is extruded as when writing the layers in order") {
+                REQUIRE(prints[1]->total_used_filament == Approx(print->total_used_filament));
+            }
+        }
+        WHEN("the objects are printed one after the other as fragments") {
+            config->set("complete_objects", true);
+            std::array<Slic3r::Model, 2> models;
+            auto prints {Slic3r::Test::init_print_threads({TestMesh::cube_20x20x20, TestMesh::ipadstand}, models, config)};
+            prints[0]->parallel_gcode = prints[1]->parallel_gcode = true;
+            Slic3r::Test::gcode(serial, prints[0]);
+            Slic3r::Test::gcode(parallel, prints[1]);
+            THEN("The output is the same") {
+                REQUIRE(body(parallel.str()) == body(serial.str()));
+            }
+        }
+    }
+}
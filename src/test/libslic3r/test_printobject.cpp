@@ -2,6 +2,7 @@
 #include <string>
 #include "test_data.hpp"
 #include "Log.hpp"
+#include "Profiler.hpp"
 #include "libslic3r.h"
 
 using namespace Slic3r::Test;
@@ -176,3 +177,147 @@ SCENARIO("PrintObject: minimum horizontal shells") {
         }
     }
 }
+
+SCENARIO("PrintObject: region config changes only regenerate the fills of that region") {
+    GIVEN("20mm cube with a modifier volume over its upper half") {
+        auto config {Slic3r::Config::new_from_defaults()};
+        config->set("fill_density", "20%");
+        config->set("skirts", 0);
+        Slic3r::Model model;
+        auto* object {model.add_object()};
+        object->add_volume(Slic3r::TriangleMesh::make_cube(20, 20, 20));
+        auto upper_half {Slic3r::TriangleMesh::make_cube(20, 20, 10)};
+        upper_half.translate(0, 0, 10);
+        auto* modifier {object->add_volume(upper_half)};
+        modifier->modifier = true;
+        modifier->config.set_deserialize("fill_density", "40%");
+        auto* inst {object->add_instance()};
+        inst->rotation = 0;
+        inst->scaling_factor = 1.0;
+        model.arrange_objects(5.0);
+        model.center_instances_around_point(Slic3r::Pointf(100,100));
+
+        const auto make_print = [&config, &model] () {
+            auto print {std::make_shared<Slic3r::Print>()};
+            print->apply_config(config);
+            for (auto* mo : model.objects) {
+                print->auto_assign_extruders(mo);
+                print->add_model_object(mo);
+            }
+            print->process();
+            return print;
+        };
+        const auto gcode_of = [] (std::shared_ptr<Slic3r::Print> print) {
+            std::stringstream gcode;
+            print->export_gcode(gcode, true);
+            // skip the header line with the generation date
+            const std::string s {gcode.str()};
+            return s.substr(s.find('\n'));
+        };
+
+        auto print {make_print()};
+        auto* print_object {print->objects[0]};
+        REQUIRE(print->regions.size() == 2);
+
+        std::vector<Slic3r::ExtrusionEntitiesPtr> region0_fills, region1_fills;
+        for (auto* layer : print_object->layers) {
+            region0_fills.push_back(layer->get_region(0)->fills.entities);
+            region1_fills.push_back(layer->get_region(1)->fills.entities);
+        }
+
+        WHEN("the fill angle of the modifier changes") {
+            modifier->config.set_deserialize("fill_angle", "60");
+            print->apply_config(config);
+            THEN("only posInfill is invalidated") {
+                REQUIRE(!print_object->state.is_done(posInfill));
+                REQUIRE(print_object->state.is_done(posPrepareInfill));
+            }
+            Slic3r::Profiler::instance().enable();
+            print->process();
+            Slic3r::Profiler::instance().disable();
+            THEN("the fills of the other region are kept") {
+                for (size_t i = 0; i < print_object->layers.size(); ++i)
+                    REQUIRE(print_object->layers[i]->get_region(0)->fills.entities == region0_fills[i]);
+            }
+            THEN("only the layers within the modifier get new fills") {
+                size_t refilled = 0;
+                for (size_t i = 0; i < print_object->layers.size(); ++i) {
+                    if (print_object->layers[i]->print_z <= 10)
+                        REQUIRE(print_object->layers[i]->get_region(1)->fills.entities == region1_fills[i]);
+                    else
+                        ++refilled;
+                }
+                const auto events {Slic3r::Profiler::instance().events()};
+                const auto infill {std::find_if(events.begin(), events.end(),
+                    [] (const Slic3r::Profiler::Event &e) { return e.name == "PrintObject::infill"; })};
+                REQUIRE(infill != events.end());
+                REQUIRE(infill->items == refilled);
+                REQUIRE(refilled < print_object->layers.size());
+            }
+            THEN("the G-code is the same as for a print made from scratch") {
+                REQUIRE(gcode_of(print) == gcode_of(make_print()));
+            }
+        }
+        WHEN("the fill angle of the whole object changes") {
+            config->set("fill_angle", 60);
+            print->apply_config(config);
+            print->process();
+            THEN("the G-code is the same as for a print made from scratch") {
+                REQUIRE(gcode_of(print) == gcode_of(make_print()));
+            }
+        }
+    }
+}
+
+namespace {
+
+/// Prepare the infill of m with 1 and with 4 threads and check that every
+/// layer gets the same fill surfaces.
+void
+check_prepare_infill_threads(TestMesh m, config_ptr config)
+{
+    std::array<Slic3r::Model, 2> models;
+    auto prints {Slic3r::Test::init_print_threads({m}, models, config)};
+    for (auto print : prints)
+        print->objects[0]->prepare_infill();
+
+    const auto &layers1 = prints[0]->objects[0]->layers, &layers4 = prints[1]->objects[0]->layers;
+    REQUIRE(layers1.size() == layers4.size());
+    for (size_t i = 0; i < layers1.size(); ++i) {
+        const auto &surfaces1 = layers1[i]->regions.front()->fill_surfaces.surfaces;
+        const auto &surfaces4 = layers4[i]->regions.front()->fill_surfaces.surfaces;
+        REQUIRE(surfaces1.size() == surfaces4.size());
+        for (size_t j = 0; j < surfaces1.size(); ++j) {
+            REQUIRE(surfaces1[j].surface_type == surfaces4[j].surface_type);
+            REQUIRE(surfaces1[j].thickness_layers == surfaces4[j].thickness_layers);
+            REQUIRE(surfaces1[j].expolygon.contour.points == surfaces4[j].expolygon.contour.points);
+            REQUIRE(surfaces1[j].expolygon.holes.size() == surfaces4[j].expolygon.holes.size());
+        }
+    }
+}
+
+}
+
+SCENARIO("PrintObject: prepared infill doesn't depend on the number of threads") {
+    GIVEN("Objects with top and bottom surfaces at several heights") {
+        auto config {Slic3r::Config::new_from_defaults()};
+        config->set("top_solid_layers", 4);
+        config->set("bottom_solid_layers", 3);
+        config->set("layer_height", 0.2);
+        WHEN("horizontal shells and periodic solid infill are discovered") {
+            config->set("solid_infill_every_layers", 7);
+            THEN("every layer gets the same fill surfaces") {
+                for (TestMesh m : { TestMesh::step, TestMesh::pyramid, TestMesh::two_hollow_squares, TestMesh::overhang })
+                    check_prepare_infill_threads(m, config);
+            }
+        }
+        WHEN("infill is combined every 3 layers and only where needed") {
+            config->set("infill_every_layers", 3);
+            config->set("infill_only_where_needed", true);
+            THEN("every layer gets the same fill surfaces") {
+                for (TestMesh m : { TestMesh::step, TestMesh::pyramid, TestMesh::overhang, TestMesh::sloping_hole })
+                    check_prepare_infill_threads(m, config);
+            }
+        }
+    }
+}
@@ -0,0 +1,87 @@
+#include <catch.hpp>
+
+#include "test_data.hpp"
+#include "Profiler.hpp"
+#include "libslic3r.h"
+#include <algorithm>
+#include <sstream>
+
+using namespace Slic3r;
+using namespace Slic3r::Test;
+
+namespace {
+
+/// First recorded event with the given name, or nullptr.
+const Profiler::Event*
+find_event(const std::vector<Profiler::Event> &events, const std::string &name)
+{
+    const auto it = std::find_if(events.begin(), events.end(),
+        [&name](const Profiler::Event &e) { return e.name == name; });
+    return it == events.end() ? nullptr : &*it;
+}
+
+}
+
+SCENARIO("Profiler: slicing steps and parallel loops are recorded") {
+    GIVEN("A 20mm cube sliced with 2 threads") {
+        auto config {Config::new_from_defaults()};
+        config->set("threads", 2);
+        config->set("layer_height", 0.5);
+        config->set("first_layer_height", 0.5);
+        Model model;
+        WHEN("the profiler is disabled") {
+            Profiler::instance().enable();
+            Profiler::instance().disable();
+            auto print {init_print({TestMesh::cube_20x20x20}, model, config)};
+            std::stringstream gcode_out;
+            gcode(gcode_out, print);
+            THEN("nothing is recorded") {
+                REQUIRE(Profiler::instance().events().empty());
+            }
+        }
+        WHEN("the profiler is enabled") {
+            Profiler::instance().enable();
+            auto print {init_print({TestMesh::cube_20x20x20}, model, config)};
+            std::stringstream gcode_out;
+            gcode(gcode_out, print);
+            Profiler::instance().disable();
+            const std::vector<Profiler::Event> events {Profiler::instance().events()};
+            const size_t layers {print->objects.front()->layer_count()};
+            THEN("each step is recorded once with the number of layers it handled") {
+                for (const std::string name : { "PrintObject::slice", "PrintObject::make_perimeters",
+                        "PrintObject::prepare_infill", "PrintObject::infill" }) {
+                    REQUIRE(std::count_if(events.begin(), events.end(),
+                        [&name](const Profiler::Event &e) { return e.name == name; }) == 1);
+                    REQUIRE(find_event(events, name)->items == layers);
+                }
+                REQUIRE(find_event(events, "Print::make_skirt") != nullptr);
+                REQUIRE(find_event(events, "Print::export_gcode") != nullptr);
+            }
+            THEN("parallel loops are named after their step") {
+                const Profiler::Event* loop {find_event(events, "PrintObject::infill/parallelize#1")};
+                REQUIRE(loop != nullptr);
+                REQUIRE(loop->category == "parallelize");
+                REQUIRE(loop->items == layers);
+                REQUIRE(loop->threads == 2);
+            }
+            THEN("nested events lie within their parents") {
+                const Profiler::Event* infill {find_event(events, "PrintObject::infill")};
+                const Profiler::Event* prepare {find_event(events, "PrintObject::prepare_infill")};
+                REQUIRE(prepare->thread == infill->thread);
+                REQUIRE(prepare->start_us >= infill->start_us);
+                REQUIRE(prepare->start_us + prepare->wall_us <= infill->start_us + infill->wall_us);
+            }
+            THEN("the trace has one complete event per recorded event") {
+                std::stringstream trace;
+                Profiler::instance().write_trace(trace);
+                const std::string json {trace.str()};
+                REQUIRE(json.find("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[") == 0);
+                size_t complete = 0;
+                for (size_t pos = json.find("\"ph\":\"X\""); pos != std::string::npos; pos = json.find("\"ph\":\"X\"", pos + 1))
+                    ++complete;
+                REQUIRE(complete == events.size());
+                REQUIRE(json.find("\"name\":\"PrintObject::infill/parallelize#1\"") != std::string::npos);
+            }
+        }
+    }
+}
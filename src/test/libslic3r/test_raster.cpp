@@ -0,0 +1,146 @@
+#include <catch.hpp>
+
+#include "test_data.hpp"
+#include "Raster.hpp"
+#include "SLAPrint.hpp"
+#include "libslic3r.h"
+#include <miniz/miniz.h>
+#include <boost/filesystem.hpp>
+
+using namespace Slic3r;
+using namespace Slic3r::Test;
+
+namespace {
+
+/// Square of the given side (mm) with its bottom left corner at (x, y) mm.
+Polygon
+square(double x, double y, double side)
+{
+    return Polygon(Points({
+        Point::new_scale(x, y), Point::new_scale(x + side, y),
+        Point::new_scale(x + side, y + side), Point::new_scale(x, y + side)
+    }));
+}
+
+/// Sum of the pixel values divided by 255, i.e. the number of lit pixels.
+double
+lit_pixels(const Raster &raster)
+{
+    double sum = 0;
+    for (uint8_t v : raster.pixels()) sum += v;
+    return sum / 255;
+}
+
+}
+
+SCENARIO("Raster: even-odd scanline fill") {
+    GIVEN("A 20x20 pixels raster of 1mm pixels whose top left corner is at (0, 20)") {
+        Raster raster(20, 20, 1., Pointf(0, 20));
+        WHEN("a square aligned on the pixels is drawn") {
+            raster.draw(Polygons { square(2, 2, 10) });
+            THEN("exactly the pixels inside are lit") {
+                REQUIRE(lit_pixels(raster) == Approx(100));
+                REQUIRE(raster.pixel(2, 8) == 255);
+                REQUIRE(raster.pixel(11, 17) == 255);
+                REQUIRE(raster.pixel(1, 8) == 0);
+                REQUIRE(raster.pixel(12, 8) == 0);
+                REQUIRE(raster.pixel(5, 7) == 0);
+                REQUIRE(raster.pixel(5, 18) == 0);
+            }
+        }
+        WHEN("a square with a hole is drawn") {
+            ExPolygon expolygon;
+            expolygon.contour = square(2, 2, 10);
+            Polygon hole = square(4, 4, 4);
+            hole.reverse();
+            expolygon.holes.push_back(hole);
+            raster.draw(ExPolygons { expolygon });
+            THEN("the hole stays dark") {
+                REQUIRE(lit_pixels(raster) == Approx(84));
+                REQUIRE(raster.pixel(5, 13) == 0);
+            }
+        }
+        WHEN("two overlapping squares are drawn at once") {
+            raster.draw(Polygons { square(0, 0, 10), square(5, 5, 10) });
+            THEN("their overlap is outside according to the even-odd rule") {
+                REQUIRE(raster.pixel(7, 12) == 0);
+                REQUIRE(raster.pixel(2, 17) == 255);
+                REQUIRE(raster.pixel(12, 7) == 255);
+            }
+        }
+        WHEN("a square whose edges fall in the middle of pixels is drawn") {
+            raster.draw(Polygons { square(2.5, 2.5, 10) });
+            THEN("edge pixels get half the intensity and the area is preserved") {
+                REQUIRE(lit_pixels(raster) == Approx(100).epsilon(0.01));
+                REQUIRE(raster.pixel(5, 7) == 128);
+                REQUIRE(raster.pixel(2, 10) == 128);
+                REQUIRE(raster.pixel(5, 10) == 255);
+                REQUIRE(int(raster.pixel(2, 7)) == Approx(64).margin(1));
+            }
+        }
+        WHEN("shapes are drawn in separate calls") {
+            raster.draw(Polygons { square(0, 0, 10) });
+            raster.draw(Polygons { square(5, 5, 10) });
+            THEN("their coverage adds up") {
+                REQUIRE(raster.pixel(7, 12) == 255);
+                REQUIRE(lit_pixels(raster) == Approx(175));
+            }
+        }
+        WHEN("a shape extends beyond the raster") {
+            raster.draw(Polygons { square(-10, -10, 50) });
+            THEN("the whole raster is lit") {
+                REQUIRE(lit_pixels(raster) == Approx(400));
+            }
+        }
+    }
+    GIVEN("A raster without antialiasing") {
+        Raster raster(20, 20, 1., Pointf(0, 20), 1);
+        raster.draw(Polygons { square(2.3, 2.3, 10) });
+        THEN("pixels are either black or white") {
+            for (uint8_t v : raster.pixels())
+                REQUIRE((v == 0 || v == 255));
+            REQUIRE(lit_pixels(raster) == Approx(100));
+        }
+    }
+}
+
+SCENARIO("SLAPrint: PNG masks export") {
+    GIVEN("A sliced 20mm cube") {
+        Model model {Slic3r::Test::model("cube", TriangleMesh(mesh(TestMesh::cube_20x20x20)))};
+        SLAPrint print(&model);
+        print.config.layer_height.value = 0.5;
+        print.config.first_layer_height.value = 0.5;
+        print.config.sla_display_width.value = 400;
+        print.config.sla_display_height.value = 300;
+        print.config.sla_pixel_size.value = 0.1;
+        print.config.fill_density.value = 100;
+        print.slice();
+        const std::string file {(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("%%%%-%%%%.zip")).string()};
+        WHEN("it is exported") {
+            print.write_png_zip(file);
+            THEN("the zip holds a PNG per layer and the settings") {
+                mz_zip_archive zip;
+                mz_zip_zero_struct(&zip);
+                REQUIRE(mz_zip_reader_init_file(&zip, file.c_str(), 0));
+                REQUIRE(mz_zip_reader_get_num_files(&zip) == print.layers.size() + 1);
+                REQUIRE(mz_zip_reader_locate_file(&zip, "config.ini", nullptr, 0) >= 0);
+                size_t size = 0;
+                void* png = mz_zip_reader_extract_file_to_heap(&zip, "layer00000.png", &size, 0);
+                REQUIRE(png != nullptr);
+                REQUIRE(size > 8);
+                REQUIRE(std::string(static_cast<const char*>(png), 8) == "\x89PNG\r\n\x1a\n");
+                mz_free(png);
+                mz_zip_reader_end(&zip);
+            }
+            boost::filesystem::remove(file);
+        }
+        WHEN("a layer is rasterized") {
+            const BoundingBoxf3 bb {model.bounding_box()};
+            Raster raster(400, 300, 0.1, Pointf(bb.min.x - 5, bb.max.y + 5), 4);
+            print.rasterize_layer(print.layers.size() / 2, &raster);
+            THEN("its lit area matches the area of the cube section") {
+                REQUIRE(lit_pixels(raster) * 0.1 * 0.1 == Approx(400).epsilon(0.05));
+            }
+        }
+    }
+}
@@ -0,0 +1,216 @@
+#include <catch.hpp>
+
+#include "test_data.hpp"
+#include "Serialize.hpp"
+#include "libslic3r.h"
+#include <limits>
+#include <sstream>
+
+using namespace Slic3r;
+using namespace Slic3r::Test;
+
+namespace {
+
+/// Layers of the first object of print, as a layer stream.
+std::string
+layer_stream(const PrintObject &object, LayerContent content)
+{
+    std::ostringstream out;
+    LayerWriter writer(out, content);
+    for (const Layer* layer : object.layers) writer.write(*layer);
+    writer.finish();
+    return out.str();
+}
+
+ExtrusionPath
+make_path(ExtrusionRole role, const Points &points)
+{
+    ExtrusionPath path(role, 0.05, 0.45f, 0.2f);
+    path.polyline.points = points;
+    return path;
+}
+
+}
+
+SCENARIO("Serialize: geometry and extrusion entities round-trip") {
+    GIVEN("Points with large, negative and repeated coordinates") {
+        const coord_t max = std::numeric_limits<coord_t>::max(), min = std::numeric_limits<coord_t>::min();
+        const Points points { Point(0, 0), Point(max, min), Point(min, max), Point(-5, 7), Point(-5, 7), Point(1000000, -2000000) };
+        BinaryWriter writer;
+        writer.write(points);
+        THEN("they are read back unchanged") {
+            BinaryReader reader(writer.data);
+            Points read;
+            reader.read(&read);
+            REQUIRE(read == points);
+            REQUIRE(reader.at_end());
+        }
+    }
+    GIVEN("A polyline made of short segments") {
+        Polyline polyline;
+        for (int i = 0; i < 1000; ++i)
+            polyline.points.push_back(Point(coord_t(scale_(100)) + i * 400, coord_t(scale_(100)) + (i % 7) * 300));
+        BinaryWriter writer;
+        writer.write(polyline);
+        THEN("it takes a fraction of the space of fixed-width coordinates") {
+            REQUIRE(writer.data.size() < polyline.points.size() * 2 * 3 + 16);
+        }
+    }
+    GIVEN("A surface collection") {
+        SurfaceCollection surfaces;
+        ExPolygon square;
+        square.contour = Polygon(Points({ Point(0, 0), Point(100, 0), Point(100, 100), Point(0, 100) }));
+        square.holes.push_back(Polygon(Points({ Point(40, 40), Point(40, 60), Point(60, 60), Point(60, 40) })));
+        Surface surface(stBottom | stBridge, square);
+        surface.thickness = 0.4;
+        surface.thickness_layers = 2;
+        surface.bridge_angle = 1.5;
+        surface.extra_perimeters = 3;
+        surfaces.surfaces.push_back(surface);
+        surfaces.surfaces.push_back(Surface(stInternal | stSolid, ExPolygon()));
+        BinaryWriter writer;
+        writer.write(surfaces);
+        THEN("all the surface attributes are read back") {
+            BinaryReader reader(writer.data);
+            SurfaceCollection read;
+            reader.read(&read);
+            REQUIRE(read.surfaces.size() == 2);
+            const Surface &s = read.surfaces.front();
+            REQUIRE(s.surface_type == (stBottom | stBridge));
+            REQUIRE(s.expolygon.contour.points == square.contour.points);
+            REQUIRE(s.expolygon.holes.size() == 1);
+            REQUIRE(s.expolygon.holes.front().points == square.holes.front().points);
+            REQUIRE(s.thickness == 0.4);
+            REQUIRE(s.thickness_layers == 2);
+            REQUIRE(s.bridge_angle == 1.5);
+            REQUIRE(s.extra_perimeters == 3);
+            REQUIRE(read.surfaces.back().surface_type == (stInternal | stSolid));
+        }
+    }
+    GIVEN("A collection holding a path, a loop and a nested collection") {
+        ExtrusionEntityCollection collection;
+        collection.no_sort = true;
+        collection.append(make_path(erGapFill, Points({ Point(0, 0), Point(10, 10) })));
+        ExtrusionLoop loop(elrContourInternalPerimeter);
+        loop.paths.push_back(make_path(erPerimeter, Points({ Point(0, 0), Point(100, 0), Point(100, 100) })));
+        loop.paths.push_back(make_path(erOverhangPerimeter, Points({ Point(100, 100), Point(0, 100), Point(0, 0) })));
+        collection.append(loop);
+        ExtrusionEntityCollection nested;
+        nested.orig_indices = { 1, 0 };
+        nested.append(make_path(erSolidInfill, Points({ Point(-50, -50), Point(50, 50) })));
+        nested.append(make_path(erTopSolidInfill, Points({ Point(50, -50), Point(-50, 50) })));
+        collection.append(nested);
+
+        BinaryWriter writer;
+        writer.write(collection);
+        THEN("the tree is rebuilt with the same types and attributes") {
+            BinaryReader reader(writer.data);
+            ExtrusionEntityCollection read;
+            reader.read(&read);
+            REQUIRE(reader.at_end());
+            REQUIRE(read.no_sort);
+            REQUIRE(read.entities.size() == 3);
+
+            const ExtrusionPath* path = dynamic_cast<const ExtrusionPath*>(read.entities[0]);
+            REQUIRE(path != nullptr);
+            REQUIRE(path->role == erGapFill);
+            REQUIRE(path->mm3_per_mm == 0.05);
+            REQUIRE(path->width == 0.45f);
+            REQUIRE(path->height == 0.2f);
+            REQUIRE(path->polyline.points == Points({ Point(0, 0), Point(10, 10) }));
+
+            const ExtrusionLoop* read_loop = dynamic_cast<const ExtrusionLoop*>(read.entities[1]);
+            REQUIRE(read_loop != nullptr);
+            REQUIRE(read_loop->role == elrContourInternalPerimeter);
+            REQUIRE(read_loop->paths.size() == 2);
+            REQUIRE(read_loop->paths[1].role == erOverhangPerimeter);
+            REQUIRE(read_loop->polygon().points == loop.polygon().points);
+
+            const ExtrusionEntityCollection* read_nested = dynamic_cast<const ExtrusionEntityCollection*>(read.entities[2]);
+            REQUIRE(read_nested != nullptr);
+            REQUIRE(!read_nested->no_sort);
+            REQUIRE(read_nested->orig_indices == std::vector<size_t>({ 1, 0 }));
+            REQUIRE(read_nested->entities.size() == 2);
+            REQUIRE(dynamic_cast<const ExtrusionPath*>(read_nested->entities[1])->role == erTopSolidInfill);
+        }
+        THEN("truncated data is rejected") {
+            for (size_t size = 0; size < writer.data.size(); size += 7) {
+                BinaryReader reader(writer.data.data(), writer.data.data() + size);
+                ExtrusionEntityCollection read;
+                REQUIRE_THROWS_AS(reader.read(&read), SerializationError);
+            }
+        }
+    }
+}
+
+SCENARIO("Serialize: layer streams") {
+    GIVEN("The layers of a processed 20mm cube") {
+        auto config {Slic3r::Config::new_from_defaults()};
+        Slic3r::Model model, model2;
+        auto print {init_print({TestMesh::cube_20x20x20}, model, config)};
+        print->process();
+        const PrintObject &object = *print->objects.front();
+        const std::string stream {layer_stream(object, lcToolpaths)};
+
+        WHEN("they are read into another object of the same print settings") {
+            auto print2 {init_print({TestMesh::cube_20x20x20}, model2, config)};
+            PrintObject &object2 = *print2->objects.front();
+            std::istringstream in(stream);
+            LayerReader reader(in);
+            size_t count = 0;
+            while (reader.read(&object2) != nullptr) ++count;
+            THEN("the same layers are rebuilt") {
+                REQUIRE(reader.version() == LayerWriter::version);
+                REQUIRE(reader.content() == lcToolpaths);
+                REQUIRE(count == object.layers.size());
+                REQUIRE(object2.layers.size() == object.layers.size());
+                REQUIRE(object2.layers[1]->lower_layer == object2.layers[0]);
+                REQUIRE(object2.layers[0]->upper_layer == object2.layers[1]);
+                REQUIRE(object2.layers.back()->print_z == object.layers.back()->print_z);
+                REQUIRE(layer_stream(object2, lcToolpaths) == stream);
+            }
+        }
+        WHEN("layers are skipped") {
+            auto print2 {init_print({TestMesh::cube_20x20x20}, model2, config)};
+            std::istringstream in(stream);
+            LayerReader reader(in);
+            for (size_t i = 0; i < 10; ++i) REQUIRE(reader.skip());
+            THEN("the next layer read is the following one") {
+                const Layer* layer = reader.read(print2->objects.front());
+                REQUIRE(layer != nullptr);
+                REQUIRE(layer->id() == object.layers[10]->id());
+                REQUIRE(layer->print_z == object.layers[10]->print_z);
+            }
+        }
+        WHEN("the stream is written by a newer version of the format") {
+            std::string newer {stream.substr(0, 8)};
+            std::ostringstream header;
+            BinaryWriter w;
+            w.varint(LayerWriter::version + 1);
+            w.u8(lcSlices);
+            write_record(header, w.data);
+            newer += header.str();
+            std::istringstream in(newer);
+            THEN("it is rejected") {
+                REQUIRE_THROWS_AS(LayerReader{in}, SerializationError);
+            }
+        }
+        WHEN("the stream is truncated") {
+            auto print2 {init_print({TestMesh::cube_20x20x20}, model2, config)};
+            std::istringstream in(stream.substr(0, stream.size() / 2));
+            LayerReader reader(in);
+            THEN("reading fails without leaving a partial layer") {
+                PrintObject* object2 = print2->objects.front();
+                REQUIRE_THROWS_AS([&] () { while (reader.read(object2) != nullptr) ; }(), SerializationError);
+                for (const Layer* layer : object2->layers)
+                    REQUIRE(layer->regions.size() == print2->regions.size());
+            }
+        }
+        WHEN("only the slices are written") {
+            const std::string slices {layer_stream(object, lcSlices)};
+            THEN("the stream is smaller") {
+                REQUIRE(slices.size() < stream.size());
+            }
+        }
+    }
+}
@@ -3,6 +3,7 @@
 #include "GCodeReader.hpp"
 #include "Config.hpp"
 #include "Geometry.hpp"
+#include "Serialize.hpp"
 #include <regex>
 
 using namespace Slic3r::Test;
@@ -271,3 +272,38 @@ SCENARIO("Original Slic3r Skirt/Brim tests", "[!mayfail]") {
         }
     }
 }
+
+SCENARIO("Skirt and brim don't depend on the number of threads") {
+    GIVEN("Several objects, one of them with support, and every kind of brim") {
+        auto config {Slic3r::Config::new_from_defaults()};
+        config->set("skirts", 2);
+        config->set("skirt_height", 3);
+        config->set("brim_width", 4);
+        config->set("brim_connections_width", 1);
+        config->set("interior_brim_width", 2);
+        config->set("support_material", true);
+        WHEN("they are generated with 1 and with 4 threads") {
+            THEN("the same extrusions are generated") {
+                for (bool ears : { false, true }) {
+                    config->set("brim_ears", ears);
+                    std::string skirt[2], brim[2];
+                    std::array<Slic3r::Model, 2> models;
+                    auto prints {Slic3r::Test::init_print_threads({TestMesh::cube_20x20x20, TestMesh::L, TestMesh::overhang, TestMesh::cube_with_hole}, models, config)};
+                    for (int run = 0; run < 2; ++run) {
+                        auto print {prints[run]};
+                        print->make_skirt();
+                        print->make_brim();
+                        BinaryWriter w_skirt, w_brim;
+                        w_skirt.write(print->skirt);
+                        w_brim.write(print->brim);
+                        skirt[run] = w_skirt.data;
+                        brim[run] = w_brim.data;
+                    }
+                    REQUIRE(!brim[0].empty());
+                    REQUIRE(skirt[0] == skirt[1]);
+                    REQUIRE(brim[0] == brim[1]);
+                }
+            }
+        }
+    }
+}
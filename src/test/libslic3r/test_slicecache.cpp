@@ -0,0 +1,107 @@
+#include <catch.hpp>
+
+#include "test_data.hpp"
+#include "SliceCache.hpp"
+#include "libslic3r.h"
+#include <boost/filesystem.hpp>
+#include <boost/nowide/fstream.hpp>
+
+using namespace Slic3r::Test;
+using namespace std::literals;
+
+namespace {
+
+/// G-code of print, without the header line holding the generation date.
+std::string
+gcode_of(shared_Print print)
+{
+    std::stringstream ss;
+    gcode(ss, print);
+    const std::string s {ss.str()};
+    return s.substr(s.find('\n'));
+}
+
+}
+
+SCENARIO("SliceCache: objects sliced again with the same inputs reuse the stored layers") {
+    GIVEN("A cache in an empty directory and a 20mm cube") {
+        const auto dir {boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()};
+        auto cache {std::make_shared<Slic3r::SliceCache>(dir.string())};
+        auto config {Slic3r::Config::new_from_defaults()};
+        config->set("skirts", 0);
+
+        Slic3r::Model model;
+        auto print {init_print({TestMesh::cube_20x20x20}, model, config)};
+        print->slice_cache = cache;
+        const std::string expected {gcode_of(print)};
+
+        THEN("the first print misses and stores its slices and toolpaths") {
+            REQUIRE(cache->stats(posInfill).misses == 1);
+            REQUIRE(cache->stats(posSlice).misses == 1);
+            REQUIRE(cache->stats(posInfill).stores == 1);
+            REQUIRE(cache->stats(posSlice).stores == 1);
+        }
+        WHEN("the same object is printed again") {
+            Slic3r::Model model2;
+            auto print2 {init_print({TestMesh::cube_20x20x20}, model2, config)};
+            print2->slice_cache = cache;
+            const std::string gcode2 {gcode_of(print2)};
+            THEN("its toolpaths are reloaded") {
+                REQUIRE(cache->stats(posInfill).hits == 1);
+                REQUIRE(print2->objects.front()->layers.size() == print->objects.front()->layers.size());
+            }
+            THEN("the G-code is the same") {
+                REQUIRE(gcode2 == expected);
+            }
+        }
+        WHEN("only G-code options change") {
+            config->set("start_gcode", "G28 ; home");
+            Slic3r::Model model2;
+            auto print2 {init_print({TestMesh::cube_20x20x20}, model2, config)};
+            print2->slice_cache = cache;
+            gcode_of(print2);
+            THEN("the toolpaths are reloaded") {
+                REQUIRE(cache->stats(posInfill).hits == 1);
+            }
+        }
+        WHEN("an option affecting the infill changes") {
+            config->set("fill_density", "40%");
+            Slic3r::Model model2;
+            auto print2 {init_print({TestMesh::cube_20x20x20}, model2, config)};
+            print2->slice_cache = cache;
+            const std::string gcode2 {gcode_of(print2)};
+            THEN("the cache misses and the result matches a print without cache") {
+                REQUIRE(cache->stats(posInfill).hits == 0);
+                REQUIRE(cache->stats(posInfill).misses == 2);
+                Slic3r::Model model3;
+                REQUIRE(gcode2 == gcode_of(init_print({TestMesh::cube_20x20x20}, model3, config)));
+            }
+        }
+        WHEN("the stored entries are damaged") {
+            for (boost::filesystem::directory_iterator it(dir), end; it != end; ++it) {
+                boost::filesystem::resize_file(it->path(), boost::filesystem::file_size(it->path()) / 2);
+            }
+            Slic3r::Model model2;
+            auto print2 {init_print({TestMesh::cube_20x20x20}, model2, config)};
+            print2->slice_cache = cache;
+            const std::string gcode2 {gcode_of(print2)};
+            THEN("they are ignored") {
+                REQUIRE(cache->stats(posInfill).hits == 0);
+                REQUIRE(cache->stats(posSlice).hits == 0);
+                REQUIRE(gcode2 == expected);
+            }
+        }
+        WHEN("the stream_infill export slices the object") {
+            Slic3r::Model model2;
+            auto print2 {init_print({TestMesh::cube_20x20x20}, model2, config)};
+            print2->slice_cache = cache;
+            print2->stream_infill = true;
+            const std::string gcode2 {gcode_of(print2)};
+            THEN("the slices are reloaded") {
+                REQUIRE(cache->stats(posSlice).hits == 1);
+                REQUIRE(gcode2 == expected);
+            }
+        }
+        boost::filesystem::remove_all(dir);
+    }
+}
@@ -0,0 +1,90 @@
+#include <catch.hpp>
+#include <cstring>
+#include <fstream>
+#include <boost/filesystem.hpp>
+#include "test_data.hpp"
+#include "IO.hpp"
+
+using namespace Slic3r;
+using namespace std::literals::string_literals;
+
+/// Read file with the stdio based admesh reader, for comparison.
+static void legacy_read(const std::string &file, stl_file* stl) {
+    memset(stl, 0, sizeof(stl_file));
+    stl_open(stl, file.c_str());
+}
+
+static bool same_facets(const stl_file &a, const stl_file &b) {
+    if (a.stats.number_of_facets != b.stats.number_of_facets) return false;
+    for (int i = 0; i < a.stats.number_of_facets; ++i)
+        if (memcmp(a.facet_start[i].vertex, b.facet_start[i].vertex, sizeof(stl_vertex) * 3) != 0
+            || memcmp(&a.facet_start[i].normal, &b.facet_start[i].normal, sizeof(stl_normal)) != 0)
+            return false;
+    return true;
+}
+
+SCENARIO("Memory-mapped STL reader", "[STL]") {
+    GIVEN("A mesh written as binary and ASCII STL") {
+        TriangleMesh mesh {Test::mesh(Test::TestMesh::slopy_cube)};
+        mesh.translate(-5.5, 0, 0.25);
+        const auto dir {boost::filesystem::temp_directory_path()};
+        const std::string binary_file {(dir / boost::filesystem::unique_path("stl-%%%%%%.stl")).string()};
+        const std::string ascii_file {(dir / boost::filesystem::unique_path("stl-%%%%%%.stl")).string()};
+        mesh.write_binary(binary_file);
+        mesh.write_ascii(ascii_file);
+
+        for (const std::string &file : { binary_file, ascii_file }) {
+            WHEN("It is mapped and decoded in parallel") {
+                stl_file mapped, legacy;
+                memset(&mapped, 0, sizeof(stl_file));
+                const bool result {IO::STL::read_mapped(file, &mapped)};
+                legacy_read(file, &legacy);
+                THEN("Facets and bounds are the same as with stl_open") {
+                    REQUIRE(result);
+                    REQUIRE(mapped.error == 0);
+                    REQUIRE(mapped.stats.type == legacy.stats.type);
+                    REQUIRE(mapped.stats.number_of_facets == mesh.stl.stats.number_of_facets);
+                    REQUIRE(same_facets(mapped, legacy));
+                    REQUIRE(memcmp(&mapped.stats.min, &legacy.stats.min, sizeof(stl_vertex)) == 0);
+                    REQUIRE(memcmp(&mapped.stats.max, &legacy.stats.max, sizeof(stl_vertex)) == 0);
+                    REQUIRE(mapped.stats.shortest_edge == legacy.stats.shortest_edge);
+                    REQUIRE(mapped.stats.bounding_diameter == legacy.stats.bounding_diameter);
+                    REQUIRE(std::string(mapped.stats.header) == std::string(legacy.stats.header));
+                }
+                stl_close(&mapped);
+                stl_close(&legacy);
+            }
+            WHEN("It is read through IO::STL::read") {
+                TriangleMesh read;
+                IO::STL::read(file, &read);
+                THEN("The mesh is the one that was written") {
+                    REQUIRE(read.facets_count() == mesh.facets_count());
+                    REQUIRE(read.volume() == Approx(mesh.volume()));
+                    REQUIRE(read.bounding_box().min.x == Approx(mesh.bounding_box().min.x));
+                    REQUIRE(read.bounding_box().max.z == Approx(mesh.bounding_box().max.z));
+                }
+            }
+        }
+        boost::filesystem::remove(binary_file);
+        boost::filesystem::remove(ascii_file);
+    }
+    GIVEN("An ASCII STL the parallel reader doesn't understand") {
+        const std::string file {(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("stl-%%%%%%.stl")).string()};
+        {
+            std::ofstream f(file);
+            f << "solid broken\n";
+            for (int i = 0; i < 20; ++i)
+                f << "  facet normal 0 0 1\n    outer loop\n      vertex 0 0 0\n      vertex 1 0 0\n      vertex 0 x 0\n"
+                  << "    endloop\n  endfacet\n";
+            f << "endsolid broken\n";
+        }
+        WHEN("It is read") {
+            stl_file mapped;
+            memset(&mapped, 0, sizeof(stl_file));
+            THEN("It is left to stl_open") {
+                REQUIRE(!IO::STL::read_mapped(file, &mapped));
+            }
+        }
+        boost::filesystem::remove(file);
+    }
+}
@@ -0,0 +1,99 @@
+#include <catch.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <queue>
+#include <stdexcept>
+#include "libslic3r.h"
+#include "ThreadPool.hpp"
+
+using namespace Slic3r;
+
+SCENARIO("parallelize() visits every item exactly once") {
+    GIVEN("A range of 10000 integers") {
+        std::vector<std::atomic<int>> visits(10000);
+        for (auto &v : visits) v = 0;
+        WHEN("parallelize is called over the closed range with 4 threads") {
+            parallelize<size_t>(0, visits.size() - 1, [&visits](size_t i) { visits[i]++; }, 4);
+            THEN("Each item has been visited once") {
+                bool once = true;
+                for (auto &v : visits) once = once && (v == 1);
+                REQUIRE(once);
+            }
+        }
+        WHEN("parallelize is called with a single thread") {
+            parallelize<size_t>(0, visits.size() - 1, [&visits](size_t i) { visits[i]++; }, 1);
+            THEN("Each item has been visited once") {
+                bool once = true;
+                for (auto &v : visits) once = once && (v == 1);
+                REQUIRE(once);
+            }
+        }
+    }
+    GIVEN("A vector of pointers") {
+        std::vector<int> values(1000, 1);
+        std::vector<int*> items;
+        for (auto &v : values) items.push_back(&v);
+        WHEN("parallelize is called on the vector") {
+            parallelize<int*>(items, [](int* v) { *v += 1; }, 8);
+            THEN("Every pointee has been updated") {
+                REQUIRE(std::count(values.begin(), values.end(), 2) == 1000);
+            }
+        }
+        WHEN("parallelize is called on a queue built from the vector") {
+            parallelize<int*>(std::queue<int*>(std::deque<int*>(items.begin(), items.end())), [](int* v) { *v += 1; }, 8);
+            THEN("Every pointee has been updated") {
+                REQUIRE(std::count(values.begin(), values.end(), 2) == 1000);
+            }
+        }
+    }
+    GIVEN("An empty range expressed as size() - 1") {
+        std::vector<int> empty;
+        std::atomic<int> calls(0);
+        WHEN("parallelize is called") {
+            parallelize<size_t>(0, empty.size() - 1, [&calls](size_t) { calls++; }, 4);
+            parallelize<int>(0, -1, [&calls](int) { calls++; }, 4);
+            THEN("The function is never called") {
+                REQUIRE(calls == 0);
+            }
+        }
+    }
+}
+
+SCENARIO("ThreadPool behaviour") {
+    GIVEN("A task that calls parallelize itself") {
+        std::atomic<int> calls(0);
+        WHEN("The outer loop runs on the pool") {
+            parallelize<int>(0, 15, [&calls](int) {
+                parallelize<int>(0, 9, [&calls](int) { calls++; }, 4);
+            }, 4);
+            THEN("The nested calls complete without deadlocking") {
+                REQUIRE(calls == 160);
+            }
+        }
+    }
+    GIVEN("A task that throws") {
+        THEN("The exception is rethrown in the calling thread") {
+            REQUIRE_THROWS_AS(
+                parallelize<int>(0, 999, [](int i) { if (i == 500) throw std::runtime_error("fail"); }, 4),
+                std::runtime_error
+            );
+        }
+        AND_THEN("The pool is still usable afterwards") {
+            std::atomic<int> calls(0);
+            parallelize<int>(0, 99, [&calls](int) { calls++; }, 4);
+            REQUIRE(calls == 100);
+        }
+    }
+    GIVEN("Repeated jobs with a growing thread count") {
+        std::atomic<int> calls(0);
+        for (int threads = 1; threads <= 8; ++threads)
+            parallelize<int>(0, 99, [&calls](int) { calls++; }, threads);
+        THEN("All jobs ran to completion") {
+            REQUIRE(calls == 800);
+        }
+        THEN("Workers are kept around for the next job") {
+            REQUIRE(ThreadPool::instance().size() >= 7);
+        }
+    }
+}
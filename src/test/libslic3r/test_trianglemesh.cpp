@@ -11,8 +11,12 @@
 #include "Log.hpp"
 
 #include <algorithm>
+#include <atomic>
 #include <future>
 #include <chrono>
+#include <cstring>
+#include <map>
+#include <random>
 
 using namespace Slic3r;
 using namespace std;
@@ -225,6 +229,262 @@ SCENARIO( "TriangleMesh: slice behavior.") {
     }
 }
 
+SCENARIO( "TriangleMeshSlicer: intersection lines.") {
+    GIVEN( "A finely tessellated sphere and a list of slicing planes") {
+        auto sphere {TriangleMesh::make_sphere(10, 2*PI/90)};
+        TriangleMeshSlicer<Z> slicer(&sphere);
+        std::vector<float> z;
+        for (float h = -9.9f; h < 10.0f; h += 0.3f) z.push_back(h);
+
+        WHEN("The intersection lines are computed") {
+            std::vector<IntersectionLines> lines;
+            slicer.slice_lines(z, &lines);
+
+            THEN("They match a serial pass over the facets, in the same order") {
+                std::vector<IntersectionLines> expected(z.size());
+                for (int facet_idx = 0; facet_idx < sphere.stl.stats.number_of_facets; ++facet_idx) {
+                    const stl_facet &facet = sphere.stl.facet_start[facet_idx];
+                    const float min_z = std::min({facet.vertex[0].z, facet.vertex[1].z, facet.vertex[2].z});
+                    const float max_z = std::max({facet.vertex[0].z, facet.vertex[1].z, facet.vertex[2].z});
+                    for (size_t i = 0; i < z.size(); ++i)
+                        if (z[i] >= min_z && z[i] <= max_z)
+                            slicer.slice_facet(z[i] / SCALING_FACTOR, facet, facet_idx, min_z, max_z, &expected[i]);
+                }
+                REQUIRE(lines.size() == expected.size());
+                bool same = true;
+                for (size_t i = 0; i < z.size(); ++i) {
+                    same = same && lines[i].size() == expected[i].size();
+                    for (size_t j = 0; same && j < lines[i].size(); ++j) {
+                        const IntersectionLine &l = lines[i][j], &e = expected[i][j];
+                        same = l.a == e.a && l.b == e.b && l.a_id == e.a_id && l.b_id == e.b_id
+                            && l.edge_a_id == e.edge_a_id && l.edge_b_id == e.edge_b_id && l.edge_type == e.edge_type;
+                    }
+                }
+                REQUIRE(same);
+            }
+            THEN("Every plane crossing the sphere has lines") {
+                for (const IntersectionLines &layer : lines)
+                    REQUIRE(layer.size() > 0);
+            }
+        }
+        WHEN("The planes are sliced all at once and one at a time") {
+            std::vector<ExPolygons> layers;
+            slicer.slice(z, &layers);
+            THEN("The resulting slices are identical") {
+                for (size_t i = 0; i < z.size(); ++i) {
+                    ExPolygons single;
+                    slicer.slice(z[i], &single);
+                    REQUIRE(single.size() == layers[i].size());
+                    for (size_t j = 0; j < single.size(); ++j)
+                        REQUIRE(single[j].contour.points == layers[i][j].contour.points);
+                }
+            }
+        }
+    }
+}
+
+SCENARIO( "TriangleMesh: facet span index.") {
+    GIVEN( "A sphere") {
+        auto sphere {TriangleMesh::make_sphere(10, 2*PI/60)};
+        auto brute_force = [&sphere] (float min, float max) {
+            std::vector<int> facets;
+            for (int facet_idx = 0; facet_idx < sphere.stl.stats.number_of_facets; ++facet_idx) {
+                const stl_facet &facet = sphere.stl.facet_start[facet_idx];
+                if (std::min({facet.vertex[0].z, facet.vertex[1].z, facet.vertex[2].z}) <= max
+                    && std::max({facet.vertex[0].z, facet.vertex[1].z, facet.vertex[2].z}) >= min)
+                    facets.push_back(facet_idx);
+            }
+            return facets;
+        };
+        WHEN("The index is queried with single heights and ranges") {
+            const std::shared_ptr<const FacetSpanIndex> index {sphere.span_index(Z)};
+            THEN("It returns the same facets as a pass over the whole mesh") {
+                REQUIRE(index->size() == (size_t)sphere.stl.stats.number_of_facets);
+                for (float z = -11.f; z < 11.f; z += 0.7f) {
+                    REQUIRE(index->query(z, z) == brute_force(z, z));
+                    REQUIRE(index->query(z, z + 1.5f) == brute_force(z, z + 1.5f));
+                }
+                REQUIRE(index->query(-20.f, 20.f).size() == (size_t)sphere.stl.stats.number_of_facets);
+                REQUIRE(index->query(10.5f, 20.f).empty());
+            }
+            THEN("Facets are sorted by their lower end") {
+                REQUIRE(std::is_sorted(index->min_z.begin(), index->min_z.end()));
+                REQUIRE(index->lower_bound(-20.f) == 0);
+                REQUIRE(index->upper_bound(20.f) == index->size());
+            }
+        }
+        WHEN("The mesh is moved after the index has been built") {
+            sphere.span_index(Z);
+            sphere.translate(0, 0, 10);
+            THEN("The index is rebuilt for the new position") {
+                REQUIRE(sphere.span_index(Z)->query(-1.f, -1.f).empty());
+                REQUIRE(sphere.span_index(Z)->query(1.f, 1.f) == brute_force(1.f, 1.f));
+            }
+        }
+        WHEN("An index is held while the mesh is moved") {
+            const std::shared_ptr<const FacetSpanIndex> index {sphere.span_index(Z)};
+            const std::vector<int> facets {brute_force(1.f, 1.f)};
+            sphere.translate(0, 0, 10);
+            sphere.span_index(Z);
+            THEN("The holder can still query it") {
+                REQUIRE(index->query(1.f, 1.f) == facets);
+            }
+        }
+    }
+}
+
+SCENARIO( "TriangleMesh: slicing from several threads.") {
+    GIVEN( "A sphere") {
+        auto sphere {TriangleMesh::make_sphere(10, 2*PI/60)};
+        std::vector<double> z;
+        for (double h = -9.75; h < 10; h += 0.5) z.push_back(h);
+        // number of polygons and area of each layer
+        auto summary = [] (const std::vector<ExPolygons> &layers) {
+            std::vector<std::pair<size_t, double>> retval;
+            for (const ExPolygons &layer : layers) {
+                double area = 0;
+                for (const ExPolygon &expolygon : layer) area += expolygon.area();
+                retval.push_back(std::make_pair(layer.size(), area));
+            }
+            return retval;
+        };
+        WHEN( "It is modified between rounds of slicing on several threads, while its indices are dropped") {
+            bool same = true;
+            for (int round = 0; round < 4; ++round) {
+                if (round > 0) {
+                    sphere.scale(1.1f);
+                    sphere.translate(0, 0, 0.3f);
+                    sphere.check_topology();
+                }
+                sphere.require_shared_vertices();
+                const auto expected {summary(sphere.slice(z))};
+                std::atomic<bool> done(false);
+                std::future<void> invalidator {std::async(std::launch::async, [&sphere, &done] () {
+                    while (!done) sphere.invalidate_indices();
+                })};
+                std::vector<std::future<std::vector<std::pair<size_t, double>>>> slices;
+                for (int thread = 0; thread < 4; ++thread)
+                    slices.push_back(std::async(std::launch::async, [&sphere, &z, &summary] () {
+                        std::vector<ExPolygons> layers;
+                        TriangleMeshSlicer<Z>(&sphere).slice(std::vector<float>(z.begin(), z.end()), &layers);
+                        return summary(layers);
+                    }));
+                for (auto &slice : slices)
+                    same = same && slice.get() == expected;
+                done = true;
+                invalidator.get();
+            }
+            THEN( "Every thread gets the slices of the current mesh") {
+                REQUIRE(same);
+            }
+        }
+    }
+}
+
+SCENARIO( "TriangleMesh: exact facet connectivity.") {
+    auto same_connectivity = [] (const TriangleMesh &mesh) {
+        TriangleMesh expected(mesh), actual(mesh);
+        stl_check_facets_exact(&expected.stl);
+        stl_check_facets_exact_parallel(&actual.stl);
+        const stl_stats &a = expected.stl.stats, &b = actual.stl.stats;
+        if (a.number_of_facets != b.number_of_facets || a.connected_edges != b.connected_edges
+            || a.connected_facets_1_edge != b.connected_facets_1_edge || a.connected_facets_2_edge != b.connected_facets_2_edge
+            || a.connected_facets_3_edge != b.connected_facets_3_edge || a.degenerate_facets != b.degenerate_facets
+            || a.facets_removed != b.facets_removed || a.shortest_edge != b.shortest_edge)
+            return false;
+        for (int i = 0; i < a.number_of_facets; ++i) {
+            if (memcmp(&expected.stl.facet_start[i], &actual.stl.facet_start[i], sizeof(stl_facet)) != 0) return false;
+            for (int j = 0; j < 3; ++j) {
+                if (expected.stl.neighbors_start[i].neighbor[j] != actual.stl.neighbors_start[i].neighbor[j]) return false;
+                if (expected.stl.neighbors_start[i].neighbor[j] != -1
+                    && expected.stl.neighbors_start[i].which_vertex_not[j] != actual.stl.neighbors_start[i].which_vertex_not[j])
+                    return false;
+            }
+        }
+        return true;
+    };
+    GIVEN( "A sphere") {
+        auto sphere {TriangleMesh::make_sphere(10, 2*PI/200)};
+        THEN( "The neighbors list is the same as the one built by admesh") {
+            REQUIRE(same_connectivity(sphere));
+        }
+        WHEN( "Its facets are shuffled, duplicated, flipped and made degenerate") {
+            std::mt19937 rng(42);
+            std::vector<stl_facet> facets(sphere.stl.facet_start, sphere.stl.facet_start + sphere.stl.stats.number_of_facets);
+            std::shuffle(facets.begin(), facets.end(), rng);
+            const size_t n = facets.size();
+            for (size_t i = 0; i < n / 50; ++i)
+                facets.push_back(facets[rng() % n]);
+            for (size_t i = 0; i < n / 100; ++i) {
+                stl_facet degenerate = facets[rng() % n];
+                degenerate.vertex[1] = degenerate.vertex[rng() % 2 ? 0 : 2];
+                facets.insert(facets.begin() + rng() % facets.size(), degenerate);
+            }
+            for (size_t i = 0; i < n / 100; ++i)
+                std::swap(facets[rng() % n].vertex[0], facets[rng() % n].vertex[1]);
+            // an edge shared through +0 and -0 coordinates
+            stl_facet zero = facets.front();
+            zero.vertex[0].x = -0.f; zero.vertex[1].x = 0.f; zero.vertex[2].x = 1.f;
+            facets.push_back(zero);
+            zero.vertex[0].x = 0.f; zero.vertex[1].x = -0.f; std::swap(zero.vertex[1], zero.vertex[2]);
+            facets.push_back(zero);
+            
+            TriangleMesh messy;
+            messy.stl.stats.type = inmemory;
+            messy.stl.stats.number_of_facets = messy.stl.stats.original_num_facets = facets.size();
+            stl_allocate(&messy.stl);
+            std::copy(facets.begin(), facets.end(), messy.stl.facet_start);
+            stl_get_size(&messy.stl);
+            THEN( "The neighbors list is still the same as the one built by admesh") {
+                REQUIRE(same_connectivity(messy));
+            }
+        }
+    }
+}
+
+SCENARIO( "TriangleMesh: edge index.") {
+    GIVEN( "A repaired sphere with shuffled facets") {
+        auto sphere {TriangleMesh::make_sphere(10, 2*PI/200)};
+        std::mt19937 rng(7);
+        std::shuffle(sphere.stl.facet_start, sphere.stl.facet_start + sphere.stl.stats.number_of_facets, rng);
+        sphere.repaired = false;
+        sphere.invalidate_indices();
+        std::shared_ptr<const FacetEdgeIndex> index = sphere.edge_index();
+        THEN( "Edges are numbered in the order they first appear, whatever their direction") {
+            std::map<std::pair<int,int>, int> edges;
+            bool same = index->facets_edges.size() == (size_t)sphere.stl.stats.number_of_facets;
+            for (int facet_idx = 0; same && facet_idx < sphere.stl.stats.number_of_facets; ++facet_idx) {
+                for (int i = 0; i < 3; ++i) {
+                    int a = sphere.stl.v_indices[facet_idx].vertex[i], b = sphere.stl.v_indices[facet_idx].vertex[(i+1) % 3];
+                    auto edge = edges.insert(std::make_pair(std::make_pair(std::min(a, b), std::max(a, b)), (int)edges.size()));
+                    same = same && index->facets_edges[facet_idx][i] == edge.first->second;
+                }
+            }
+            REQUIRE(same);
+            REQUIRE(index->edges_count == edges.size());
+            REQUIRE(index->edges_count == (size_t)sphere.stl.stats.number_of_facets * 3 / 2);
+        }
+        THEN( "Shared vertices are scaled") {
+            REQUIRE(index->scaled_vertices.size() == (size_t)sphere.stl.stats.shared_vertices);
+            REQUIRE(index->scaled_vertices[5].x == float(sphere.stl.v_shared[5].x / SCALING_FACTOR));
+        }
+        WHEN( "Slicers are built again for the same mesh") {
+            TriangleMeshSlicer<X> x_slicer(&sphere);
+            TriangleMeshSlicer<Z> z_slicer(&sphere);
+            THEN( "They reuse the index") {
+                REQUIRE(sphere.edge_index() == index);
+            }
+        }
+        WHEN( "The mesh is moved") {
+            sphere.translate(1, 0, 0);
+            THEN( "The index is rebuilt") {
+                REQUIRE(sphere.edge_index() != index);
+                REQUIRE(sphere.edge_index()->facets_edges == index->facets_edges);
+            }
+        }
+    }
+}
+
 SCENARIO( "make_xxx functions produce meshes.") {
     GIVEN("make_cube() function") {
         WHEN("make_cube() is called with arguments 20,20,20") {
@@ -375,6 +635,26 @@ SCENARIO( "TriangleMeshSlicer: Cut behavior.") {
             }
         }
     }
+    GIVEN( "A sphere of radius 10 centered on the origin") {
+        auto sphere {TriangleMesh::make_sphere(10, PI / 36)};
+        sphere.repair();
+        WHEN( "It is cut above its center") {
+            TriangleMesh upper {};
+            TriangleMesh lower {};
+            sphere.cut(Z, 3, &upper, &lower);
+            upper.repair();
+            lower.repair();
+            THEN("Each part stays on its side of the plane.") {
+                REQUIRE(upper.bounding_box().min.z == Approx(3));
+                REQUIRE(upper.bounding_box().max.z == Approx(10));
+                REQUIRE(lower.bounding_box().min.z == Approx(-10));
+                REQUIRE(lower.bounding_box().max.z == Approx(3));
+            }
+            THEN("The two parts add up to the sphere.") {
+                REQUIRE(upper.volume() + lower.volume() == Approx(sphere.volume()));
+            }
+        }
+    }
 }
 #ifdef TEST_PERFORMANCE
 TEST_CASE("Regression test for issue #4486 - files take forever to slice") {
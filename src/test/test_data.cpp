@@ -268,6 +268,15 @@ shared_Print init_print(std::initializer_list<TriangleMesh> meshes, Slic3r::Mode
     return print;
 }
 
+std::array<shared_Print, 2> init_print_threads(std::initializer_list<TestMesh> meshes, std::array<Slic3r::Model, 2>& models, config_ptr _config) {
+    std::array<shared_Print, 2> prints;
+    for (size_t i = 0; i < prints.size(); ++i) {
+        _config->set("threads", i == 0 ? 1 : 4);
+        prints[i] = init_print(meshes, models[i], _config);
+    }
+    return prints;
+}
+
 void gcode(std::stringstream& gcode, shared_Print _print) {
     _print->export_gcode(gcode, true);
 }
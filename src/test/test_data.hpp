@@ -7,6 +7,7 @@
 #include "Print.hpp"
 #include "Config.hpp"
 
+#include <array>
 #include <unordered_map>
 
 namespace Slic3r { namespace Test {
@@ -68,6 +69,10 @@ Slic3r::Model model(const std::string& model_name, TriangleMesh&& _mesh);
 shared_Print init_print(std::initializer_list<TestMesh> meshes, Slic3r::Model& model, config_ptr _config = Slic3r::Config::new_from_defaults(), bool comments = false);
 shared_Print init_print(std::initializer_list<TriangleMesh> meshes, Slic3r::Model& model, config_ptr _config = Slic3r::Config::new_from_defaults(), bool comments = false);
 
+/// Set up the same print with 1 and with 4 threads, each in its own model, to
+/// check that the output doesn't depend on the number of threads.
+std::array<shared_Print, 2> init_print_threads(std::initializer_list<TestMesh> meshes, std::array<Slic3r::Model, 2>& models, config_ptr _config);
+
 void gcode(std::stringstream& gcode, shared_Print print);
 
 } } // namespace Slic3r::Test
@@ -0,0 +1,257 @@
+// Microbenchmark for nearest-neighbor chaining: compares Geometry::chained_path(),
+// ExtrusionEntityCollection::chained_path_from() and PolylineCollection::chained_path()
+// against the previous linear scans over the remaining endpoints, on synthetic
+// clouds of short segments. Orders and reversals of the two versions are also
+// compared, so a run doubles as an output check.
+//
+// Usage: bench-chaining [segments] [seed]
+
+#include "ExtrusionEntityCollection.hpp"
+#include "Geometry.hpp"
+#include "Line.hpp"
+#include "PolylineCollection.hpp"
+#include <boost/nowide/iostream.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <limits>
+#include <map>
+#include <random>
+
+using namespace Slic3r;
+
+namespace {
+
+/// Geometry::chained_path() before ChainingIndex.
+std::vector<size_t>
+legacy_chained_path(const Points &points, Point start_near)
+{
+    PointConstPtrs my_points;
+    std::map<const Point*,size_t> indices;
+    for (Points::const_iterator it = points.begin(); it != points.end(); ++it) {
+        my_points.push_back(&*it);
+        indices[&*it] = it - points.begin();
+    }
+    std::vector<size_t> retval;
+    while (!my_points.empty()) {
+        size_t idx = start_near.nearest_point_index(my_points);
+        start_near = *my_points[idx];
+        retval.push_back(indices[ my_points[idx] ]);
+        my_points.erase(my_points.begin() + idx);
+    }
+    return retval;
+}
+
+/// ExtrusionEntityCollection::chained_path_from() before ChainingIndex,
+/// returning the original indices, negated and offset by one when reversed.
+std::vector<long>
+legacy_chained_path_from(const Polylines &paths, Point start_near, bool no_reverse)
+{
+    std::vector<size_t> my_paths;
+    Points endpoints;
+    for (size_t i = 0; i < paths.size(); ++i) {
+        my_paths.push_back(i);
+        endpoints.push_back(paths[i].first_point());
+        endpoints.push_back(no_reverse ? paths[i].first_point() : paths[i].last_point());
+    }
+    std::vector<long> retval;
+    while (!my_paths.empty()) {
+        int start_index = start_near.nearest_point_index(endpoints);
+        int path_index = start_index/2;
+        const size_t i = my_paths[path_index];
+        const bool reversed = start_index % 2 && !no_reverse;
+        retval.push_back(reversed ? -long(i) - 1 : long(i));
+        my_paths.erase(my_paths.begin() + path_index);
+        endpoints.erase(endpoints.begin() + 2*path_index, endpoints.begin() + 2*path_index + 2);
+        start_near = reversed ? paths[i].first_point() : paths[i].last_point();
+    }
+    return retval;
+}
+
+/// PolylineCollection::chained_path() before ChainingIndex, in the same encoding.
+std::vector<long>
+legacy_polyline_chained_path(const Polylines &src, bool no_reverse)
+{
+    struct Chaining { Point first, last; size_t idx; };
+    std::vector<Chaining> endpoints;
+    for (size_t i = 0; i < src.size(); ++i)
+        endpoints.push_back(Chaining { src[i].first_point(), src[i].last_point(), i });
+    Point start_near = src.front().first_point();
+    std::vector<long> retval;
+    while (!endpoints.empty()) {
+        double dmin = std::numeric_limits<double>::max();
+        size_t idx = 0;
+        for (size_t k = 0; k < endpoints.size() && dmin >= EPSILON; ++k) {
+            for (int end = 0; end < (no_reverse ? 1 : 2); ++end) {
+                const Point &p = end ? endpoints[k].last : endpoints[k].first;
+                const double dx = double(start_near.x - p.x), dy = double(start_near.y - p.y);
+                const double d = dx * dx + dy * dy;
+                if (d < dmin) {
+                    idx = k * 2 + end;
+                    dmin = d;
+                    if (dmin < EPSILON) break;
+                }
+            }
+        }
+        const size_t i = endpoints[idx/2].idx;
+        retval.push_back(idx & 1 ? -long(i) - 1 : long(i));
+        start_near = idx & 1 ? src[i].first_point() : src[i].last_point();
+        endpoints.erase(endpoints.begin() + idx/2);
+    }
+    return retval;
+}
+
+/// Paths in the order and orientation of a legacy chain.
+Polylines
+apply_chain(const Polylines &paths, const std::vector<long> &chain)
+{
+    Polylines retval;
+    for (long c : chain) {
+        retval.push_back(paths[c < 0 ? -c - 1 : c]);
+        if (c < 0) retval.back().reverse();
+    }
+    return retval;
+}
+
+/// Same polylines, in the same order and orientation.
+bool
+same_polylines(const Polylines &a, const Polylines &b)
+{
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i)
+        if (a[i].points != b[i].points) return false;
+    return true;
+}
+
+struct Cloud {
+    const char* name;
+    Polylines segments;
+};
+
+/// Short segments spread over a 200x200mm bed, like gap fill.
+Cloud
+scattered(size_t n, std::mt19937 &rng)
+{
+    std::uniform_real_distribution<double> pos(0, 200), len(-1, 1);
+    Cloud cloud { "scattered", Polylines() };
+    for (size_t i = 0; i < n; ++i) {
+        const double x = pos(rng), y = pos(rng);
+        cloud.segments.push_back(Line(Point::new_scale(x, y), Point::new_scale(x + len(rng), y + len(rng))));
+    }
+    return cloud;
+}
+
+/// Segments between nodes of a 1mm lattice, with many equidistant and shared endpoints.
+Cloud
+lattice(size_t n, std::mt19937 &rng)
+{
+    std::uniform_int_distribution<int> pos(0, 150), step(-2, 2);
+    Cloud cloud { "lattice", Polylines() };
+    for (size_t i = 0; i < n; ++i) {
+        const int x = pos(rng), y = pos(rng);
+        cloud.segments.push_back(Line(Point::new_scale(x, y), Point::new_scale(x + step(rng), y + step(rng))));
+    }
+    return cloud;
+}
+
+/// Segments gathered around a few small islands, like support contacts.
+Cloud
+clustered(size_t n, std::mt19937 &rng)
+{
+    std::uniform_real_distribution<double> center(0, 200);
+    std::normal_distribution<double> spread(0, 3);
+    std::vector<Pointf> centers;
+    for (int k = 0; k < 12; ++k) centers.push_back(Pointf(center(rng), center(rng)));
+    Cloud cloud { "clustered", Polylines() };
+    for (size_t i = 0; i < n; ++i) {
+        const Pointf &c = centers[i % centers.size()];
+        const double x = c.x + spread(rng), y = c.y + spread(rng);
+        cloud.segments.push_back(Line(Point::new_scale(x, y), Point::new_scale(x + spread(rng) / 5, y + spread(rng) / 5)));
+    }
+    return cloud;
+}
+
+template <class F> double
+time_ms(F f)
+{
+    const auto t0 = std::chrono::steady_clock::now();
+    f();
+    const auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(t1 - t0).count();
+}
+
+void
+report(const char* cloud, const char* function, double legacy, double current, bool same)
+{
+    boost::nowide::cout << std::setw(10) << cloud << std::setw(34) << function
+        << std::fixed << std::setprecision(1)
+        << std::setw(14) << legacy << std::setw(14) << current
+        << std::setw(10) << legacy / current << "x"
+        << std::setw(10) << (same ? "same" : "DIFFERENT") << std::endl;
+}
+
+}
+
+int
+main(int argc, char **argv)
+{
+    const size_t n = argc > 1 ? std::atoll(argv[1]) : 20000;
+    std::mt19937 rng(argc > 2 ? std::atoi(argv[2]) : 1);
+
+    std::vector<Cloud> clouds;
+    clouds.push_back(scattered(n, rng));
+    clouds.push_back(lattice(n, rng));
+    clouds.push_back(clustered(n, rng));
+
+    boost::nowide::cout << std::setw(10) << "cloud" << std::setw(34) << "function"
+        << std::setw(14) << "legacy [ms]" << std::setw(14) << "current [ms]"
+        << std::setw(11) << "speedup" << std::setw(10) << "order" << std::endl;
+    bool all_same = true;
+    for (const Cloud &cloud : clouds) {
+        const Polylines &segments = cloud.segments;
+
+        // Geometry::chained_path() over the first points
+        Points points;
+        for (const Polyline &segment : segments) points.push_back(segment.first_point());
+        std::vector<size_t> legacy_order, order;
+        const double legacy_points = time_ms([&]() { legacy_order = legacy_chained_path(points, points.front()); });
+        const double points_ms = time_ms([&]() { Geometry::chained_path(points, order); });
+        report(cloud.name, "Geometry::chained_path", legacy_points, points_ms, order == legacy_order);
+        all_same &= order == legacy_order;
+
+        // ExtrusionEntityCollection::chained_path_from(), with and without reversals
+        ExtrusionEntityCollection coll;
+        for (const Polyline &segment : segments) {
+            ExtrusionPath path(erGapFill);
+            path.polyline = segment;
+            coll.append(path);
+        }
+        for (int no_reverse = 0; no_reverse < 2; ++no_reverse) {
+            std::vector<long> legacy_chain;
+            ExtrusionEntityCollection chained;
+            std::vector<size_t> orig_indices;
+            const Point start = Point::new_scale(100, 100);
+            const double legacy = time_ms([&]() { legacy_chain = legacy_chained_path_from(segments, start, no_reverse); });
+            const double current = time_ms([&]() { coll.chained_path_from(start, &chained, no_reverse, &orig_indices); });
+            Polylines current_paths;
+            for (const ExtrusionEntity* entity : chained.entities)
+                current_paths.push_back(dynamic_cast<const ExtrusionPath*>(entity)->polyline);
+            std::vector<long> legacy_indices;
+            for (long c : legacy_chain) legacy_indices.push_back(c < 0 ? -c - 1 : c);
+            const bool same = same_polylines(current_paths, apply_chain(segments, legacy_chain))
+                && std::vector<long>(orig_indices.begin(), orig_indices.end()) == legacy_indices;
+            report(cloud.name, no_reverse ? "EEC::chained_path_from nr" : "EEC::chained_path_from", legacy, current, same);
+            all_same &= same;
+        }
+
+        // PolylineCollection::chained_path()
+        std::vector<long> legacy_chain;
+        Polylines chained;
+        const double legacy = time_ms([&]() { legacy_chain = legacy_polyline_chained_path(segments, false); });
+        const double current = time_ms([&]() { chained = PolylineCollection::chained_path(segments, false); });
+        const bool same = same_polylines(chained, apply_chain(segments, legacy_chain));
+        report(cloud.name, "PolylineCollection::chained_path", legacy, current, same);
+        all_same &= same;
+    }
+    return all_same ? 0 : 1;
+}
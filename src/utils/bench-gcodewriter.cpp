@@ -0,0 +1,130 @@
+// Microbenchmark for GCodeWriter move formatting: compares the current writer,
+// which appends fixed-point numbers with GCodeFormatter, against the previous
+// std::ostringstream based formatting of the same G1 lines. Every line of the
+// two versions is also compared, so a run doubles as an output check.
+//
+// Usage: bench-gcodewriter [moves] [travel_every]
+
+#include "GCodeWriter.hpp"
+#include <boost/nowide/iostream.hpp>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <sstream>
+
+using namespace Slic3r;
+
+namespace {
+
+#define PRECISION(val, precision) std::fixed << std::setprecision(precision) << val
+#define XYZF_NUM(val) PRECISION(val, 3)
+#define E_NUM(val) PRECISION(val, 5)
+
+/// Line layout of GCodeWriter::extrude_to_xy() before GCodeFormatter.
+std::string
+legacy_extrude_to_xy(const Pointf &point, double E, const std::string &axis)
+{
+    std::ostringstream gcode;
+    gcode << "G1 X" << XYZF_NUM(point.x)
+          <<   " Y" << XYZF_NUM(point.y)
+          <<    " " << axis << E_NUM(E);
+    gcode << "\n";
+    return gcode.str();
+}
+
+/// Line layout of GCodeWriter::travel_to_xy() before GCodeFormatter.
+std::string
+legacy_travel_to_xy(const Pointf &point, double F)
+{
+    std::ostringstream gcode;
+    gcode << "G1 X" << XYZF_NUM(point.x)
+          <<   " Y" << XYZF_NUM(point.y)
+          <<   " F" << XYZF_NUM(F);
+    gcode << "\n";
+    return gcode.str();
+}
+
+// a spiral toolpath over a 200mm bed
+Pointf
+move_target(size_t i)
+{
+    const double angle = i * 0.01;
+    const double radius = 5 + std::fmod(i * 0.0001, 95.0);
+    return Pointf(100 + radius * std::cos(angle), 100 + radius * std::sin(angle));
+}
+
+template <class F> double
+time_ms(F f)
+{
+    const auto t0 = std::chrono::steady_clock::now();
+    f();
+    const auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(t1 - t0).count();
+}
+
+}
+
+int
+main(int argc, char **argv)
+{
+    const size_t moves = argc > 1 ? std::atoll(argv[1]) : 50000000;
+    const size_t travel_every = argc > 2 ? std::max(1, std::atoi(argv[2])) : 10;
+    const double dE = 0.0123456;
+
+    GCodeWriter writer;
+    writer.config.set_defaults();
+    writer.set_extruders(std::vector<unsigned int> {0});
+    writer.set_extruder(0);
+    const double travel_F = writer.config.travel_speed.value * 60.0;
+    const std::string axis = writer.extrusion_axis();
+
+    size_t legacy_bytes = 0, bytes = 0;
+    double E = 0;
+    const double legacy = time_ms([&]() {
+        for (size_t i = 0; i < moves; ++i) {
+            if (i % travel_every == 0) {
+                legacy_bytes += legacy_travel_to_xy(move_target(i), travel_F).size();
+            } else {
+                E += dE;
+                legacy_bytes += legacy_extrude_to_xy(move_target(i), E, axis).size();
+            }
+        }
+    });
+    const double current = time_ms([&]() {
+        for (size_t i = 0; i < moves; ++i) {
+            if (i % travel_every == 0)
+                bytes += writer.travel_to_xy(move_target(i)).size();
+            else
+                bytes += writer.extrude_to_xy(move_target(i), dE).size();
+        }
+    });
+
+    // line by line comparison, restarting from E = 0
+    size_t mismatches = 0;
+    writer.extruder()->E = 0;
+    E = 0;
+    for (size_t i = 0; i < moves; ++i) {
+        const Pointf p = move_target(i);
+        if (i % travel_every == 0) {
+            mismatches += writer.travel_to_xy(p) != legacy_travel_to_xy(p, travel_F);
+        } else {
+            E += dE;
+            mismatches += writer.extrude_to_xy(p, dE) != legacy_extrude_to_xy(p, E, axis);
+        }
+    }
+
+    boost::nowide::cout << std::setw(10) << "writer" << std::setw(12) << "moves"
+        << std::setw(14) << "time [ms]" << std::setw(12) << "ns/move" << std::setw(12) << "MB/s" << std::endl;
+    for (int k = 0; k < 2; ++k) {
+        const double ms = k == 0 ? legacy : current;
+        const size_t b  = k == 0 ? legacy_bytes : bytes;
+        boost::nowide::cout << std::setw(10) << (k == 0 ? "legacy" : "current") << std::setw(12) << moves
+            << std::fixed << std::setprecision(2)
+            << std::setw(14) << ms << std::setw(12) << ms * 1e6 / moves
+            << std::setw(12) << b / 1e3 / ms << std::endl;
+    }
+    boost::nowide::cout << "speedup: " << std::setprecision(2) << legacy / current << "x, "
+        << mismatches << " mismatching lines" << std::endl;
+    return mismatches == 0 && bytes == legacy_bytes ? 0 : 1;
+}
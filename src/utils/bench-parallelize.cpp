@@ -0,0 +1,125 @@
+// Microbenchmark for parallelize(): compares the shared ThreadPool against the
+// previous implementation, which spawned a thread_group per call and handed out
+// one item at a time from a mutex-protected std::queue.
+//
+// Usage: bench-parallelize [max_threads] [repetitions]
+
+#include "libslic3r.h"
+#include <boost/nowide/iostream.hpp>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <queue>
+
+using namespace Slic3r;
+
+namespace {
+
+template <class T> void
+legacy_parallelize_do(std::queue<T>* queue, boost::mutex* queue_mutex, boost::function<void(T)> func)
+{
+    while (true) {
+        T i;
+        {
+            boost::lock_guard<boost::mutex> l(*queue_mutex);
+            if (queue->empty()) return;
+            i = queue->front();
+            queue->pop();
+        }
+        func(i);
+        boost::this_thread::interruption_point();
+    }
+}
+
+template <class T> void
+legacy_parallelize(T start, T end, boost::function<void(T)> func, int threads_count)
+{
+    std::queue<T> queue;
+    for (T i = start; i <= end; ++i) queue.push(i);
+    boost::mutex queue_mutex;
+    boost::thread_group workers;
+    for (int i = 0; i < std::min(threads_count, (int)queue.size()); i++)
+        workers.add_thread(new boost::thread(&legacy_parallelize_do<T>, &queue, &queue_mutex, func));
+    workers.join_all();
+}
+
+// some floating point work that the compiler can't throw away
+double
+work(size_t item, size_t iterations)
+{
+    double acc = item;
+    for (size_t k = 0; k < iterations; ++k)
+        acc = std::sqrt(acc * 1.0000001 + k);
+    return acc;
+}
+
+struct Workload {
+    const char* name;
+    size_t items;
+    size_t iterations;      ///< cost of a single item
+    size_t calls;           ///< parallelize() calls per repetition
+};
+
+template <class F> double
+time_ms(F f)
+{
+    const auto t0 = std::chrono::steady_clock::now();
+    f();
+    const auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(t1 - t0).count();
+}
+
+}
+
+int
+main(int argc, char **argv)
+{
+    const int max_threads = argc > 1 ? std::atoi(argv[1]) : std::max(1u, boost::thread::hardware_concurrency());
+    const int repetitions = argc > 2 ? std::atoi(argv[2]) : 3;
+
+    const Workload workloads[] = {
+        // many cheap items, e.g. per-facet work in TriangleMeshSlicer::slice
+        { "cheap",      1000000,    10,     1 },
+        // few expensive items, e.g. per-layer perimeters or infill
+        { "expensive",  2000,       20000,  1 },
+        // many short parallel sections, e.g. per-step calls on a tall object
+        { "many-calls", 64,         2000,   200 },
+    };
+
+    std::vector<double> sink(1);
+    boost::nowide::cout << std::setw(12) << "workload" << std::setw(9) << "threads"
+        << std::setw(14) << "legacy [ms]" << std::setw(14) << "pool [ms]" << std::setw(10) << "speedup"
+        << std::setw(14) << "pool scaling" << std::endl;
+
+    for (const Workload &w : workloads) {
+        std::vector<double> out(w.items);
+        const boost::function<void(size_t)> task = [&out, &w](size_t i) { out[i] = work(i, w.iterations); };
+
+        double pool_single = 0;
+        for (int threads = 1; threads <= max_threads; threads *= 2) {
+            double legacy = 0, pool = 0;
+            for (int r = 0; r < repetitions; ++r) {
+                legacy += time_ms([&]() {
+                    for (size_t c = 0; c < w.calls; ++c)
+                        legacy_parallelize<size_t>(0, w.items - 1, task, threads);
+                });
+                pool += time_ms([&]() {
+                    for (size_t c = 0; c < w.calls; ++c)
+                        parallelize<size_t>(0, w.items - 1, task, threads);
+                });
+            }
+            legacy /= repetitions;
+            pool   /= repetitions;
+            if (threads == 1) pool_single = pool;
+            sink[0] += out[w.items / 2];
+
+            boost::nowide::cout << std::setw(12) << w.name << std::setw(9) << threads
+                << std::fixed << std::setprecision(2)
+                << std::setw(14) << legacy << std::setw(14) << pool
+                << std::setw(9) << legacy / pool << "x"
+                << std::setw(13) << pool_single / pool << "x" << std::endl;
+        }
+    }
+    return sink[0] == 0 ? 1 : 0;
+}
@@ -0,0 +1,110 @@
+// Benchmark for the intersection pass of TriangleMeshSlicer::slice(): compares
+// slice_lines() against the previous implementation, in which every facet was
+// handled by its own task and pushed its lines in the shared per-layer vectors
+// under a single mutex.
+//
+// Usage: bench-slice [facets] [layer_height] [threads]
+// The mesh is a sphere tessellated finely enough to reach the requested
+// number of facets (5M by default).
+
+#include "libslic3r.h"
+#include "TriangleMesh.hpp"
+#include <boost/nowide/iostream.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+
+using namespace Slic3r;
+
+namespace {
+
+template <class F> double
+time_ms(F f)
+{
+    const auto t0 = std::chrono::steady_clock::now();
+    f();
+    const auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(t1 - t0).count();
+}
+
+void
+legacy_slice_do(const TriangleMeshSlicer<Z>* slicer, const TriangleMesh* mesh, size_t facet_idx,
+    std::vector<IntersectionLines>* lines, boost::mutex* lines_mutex, const std::vector<float>* z)
+{
+    const stl_facet &facet = mesh->stl.facet_start[facet_idx];
+    const float min_z = fminf(facet.vertex[0].z, fminf(facet.vertex[1].z, facet.vertex[2].z));
+    const float max_z = fmaxf(facet.vertex[0].z, fmaxf(facet.vertex[1].z, facet.vertex[2].z));
+    std::vector<float>::const_iterator min_layer = std::lower_bound(z->begin(), z->end(), min_z);
+    std::vector<float>::const_iterator max_layer = std::upper_bound(min_layer, z->end(), max_z);
+    for (std::vector<float>::const_iterator it = min_layer; it != max_layer; ++it)
+        slicer->slice_facet(*it / SCALING_FACTOR, facet, facet_idx, min_z, max_z, &(*lines)[it - z->begin()], lines_mutex);
+}
+
+bool
+same_lines(const IntersectionLine &l, const IntersectionLine &e)
+{
+    return l.a == e.a && l.b == e.b && l.a_id == e.a_id && l.b_id == e.b_id;
+}
+
+}
+
+int
+main(int argc, char **argv)
+{
+    const size_t facets       = argc > 1 ? std::atol(argv[1]) : 5000000;
+    const double layer_height = argc > 2 ? std::atof(argv[2]) : 0.1;
+    const int threads         = argc > 3 ? std::atoi(argv[3]) : boost::thread::hardware_concurrency();
+
+    // a sphere made of n rings of n points has about 2*n^2 facets
+    const double radius = 50;
+    const double n      = std::sqrt(facets / 2.0);
+    boost::nowide::cout << "Building sphere..." << std::endl;
+    TriangleMesh mesh = TriangleMesh::make_sphere(radius, 2*PI / n);
+
+    std::vector<float> z;
+    for (double h = -radius + layer_height/2; h < radius; h += layer_height) z.push_back(h);
+
+    TriangleMeshSlicer<Z>* slicer = nullptr;
+    const double setup = time_ms([&]() { slicer = new TriangleMeshSlicer<Z>(&mesh); });
+    boost::nowide::cout << mesh.stl.stats.number_of_facets << " facets, " << z.size() << " layers, "
+        << threads << " threads (slicer setup " << std::fixed << std::setprecision(0) << setup << " ms)" << std::endl;
+
+    std::vector<IntersectionLines> legacy(z.size());
+    const double legacy_ms = time_ms([&]() {
+        boost::mutex lines_mutex;
+        parallelize<size_t>(
+            0,
+            mesh.stl.stats.number_of_facets - 1,
+            [&](size_t facet_idx) { legacy_slice_do(slicer, &mesh, facet_idx, &legacy, &lines_mutex, &z); },
+            threads
+        );
+    });
+
+    std::vector<IntersectionLines> lines;
+    const double lines_ms = time_ms([&]() { slicer->slice_lines(z, &lines); });
+
+    // the legacy lines come out in scheduling order, so only compare counts
+    size_t legacy_count = 0, count = 0;
+    for (size_t i = 0; i < z.size(); ++i) {
+        legacy_count += legacy[i].size();
+        count += lines[i].size();
+    }
+    // while slice_lines() must be stable across runs
+    std::vector<IntersectionLines> again;
+    slicer->slice_lines(z, &again);
+    bool stable = true;
+    for (size_t i = 0; stable && i < z.size(); ++i) {
+        stable = again[i].size() == lines[i].size();
+        for (size_t j = 0; stable && j < lines[i].size(); ++j)
+            stable = same_lines(again[i][j], lines[i][j]);
+    }
+
+    boost::nowide::cout << std::setprecision(1)
+        << "legacy mutex pass:    " << std::setw(10) << legacy_ms << " ms (" << legacy_count << " lines)" << std::endl
+        << "slice_lines():        " << std::setw(10) << lines_ms  << " ms (" << count << " lines, "
+            << (stable ? "deterministic" : "NOT deterministic") << ")" << std::endl
+        << "intersection speedup: " << std::setw(10) << legacy_ms / lines_ms << "x" << std::endl;
+
+    delete slicer;
+    return (stable && count == legacy_count) ? 0 : 1;
+}
@@ -1,8 +1,80 @@
 #include "miniz/miniz.h"
 #include "Zip/ZipArchive.hpp"
+#include <cstdlib>
+#include <streambuf>
+#include <vector>
 
 namespace Slic3r {
 
+namespace {
+
+/// Stream buffer deflating whatever is written to it into a string, and
+/// computing the size and the CRC-32 of the uncompressed data on the way.
+class DeflateBuffer : public std::streambuf
+{
+public:
+    DeflateBuffer(mz_uint level) : buffer(1 << 16), crc(MZ_CRC32_INIT), size(0), ok(true),
+        compressor(static_cast<tdefl_compressor*>(malloc(sizeof(tdefl_compressor))))
+    {
+        this->setp(this->buffer.data(), this->buffer.data() + this->buffer.size());
+        this->ok = compressor != nullptr && tdefl_init(compressor, DeflateBuffer::put,
+            &this->compressed, tdefl_create_comp_flags_from_zip_params(level, -MZ_DEFAULT_WINDOW_BITS, MZ_DEFAULT_STRATEGY)) == TDEFL_STATUS_OKAY;
+    }
+
+    ~DeflateBuffer() { free(this->compressor); }
+
+    /// Deflate what is left and end the deflate stream.
+    bool finish()
+    {
+        this->sync();
+        this->ok = this->ok && tdefl_compress_buffer(this->compressor, nullptr, 0, TDEFL_FINISH) == TDEFL_STATUS_DONE;
+        return this->ok;
+    }
+
+    std::string compressed; ///< The deflated data.
+    std::vector<char> buffer; ///< Data not deflated yet.
+    mz_uint32 crc; ///< CRC-32 of the uncompressed data.
+    mz_uint64 size; ///< Size of the uncompressed data.
+
+protected:
+    int overflow(int c) override
+    {
+        if (!this->deflate()) return traits_type::eof();
+        if (c != traits_type::eof()) {
+            *this->pptr() = char(c);
+            this->pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    int sync() override { return this->deflate() ? 0 : -1; }
+
+private:
+    bool ok; ///< Whether deflating succeeded so far.
+    tdefl_compressor* compressor; ///< Miniz deflate state, too big for the stack.
+
+    /// Deflate the buffered data.
+    bool deflate()
+    {
+        const size_t n = this->pptr() - this->pbase();
+        if (n > 0 && this->ok) {
+            this->crc = mz_crc32(this->crc, reinterpret_cast<const mz_uint8*>(this->pbase()), n);
+            this->size += n;
+            this->ok = tdefl_compress_buffer(this->compressor, this->pbase(), n, TDEFL_NO_FLUSH) == TDEFL_STATUS_OKAY;
+        }
+        this->setp(this->buffer.data(), this->buffer.data() + this->buffer.size());
+        return this->ok;
+    }
+
+    static mz_bool put(const void* data, int len, void* user)
+    {
+        static_cast<std::string*>(user)->append(static_cast<const char*>(data), size_t(len));
+        return MZ_TRUE;
+    }
+};
+
+}
+
 ZipArchive::ZipArchive (std::string zip_archive_name, char zip_mode) : archive(mz_zip_archive()), zip_name(zip_archive_name), mode(zip_mode), stats(0), finalized(false)
 {
     // Initialize the miniz zip archive struct.
@@ -34,6 +106,33 @@ ZipArchive::add_entry (std::string entry_path, std::string file_path)
     return stats;
 }
 
+mz_bool
+ZipArchive::add_entry (std::string entry_path, const void* data, size_t size, mz_uint level)
+{
+    stats = 0;
+    // Check if it's in the write mode.
+    if(mode != 'W')
+        return stats;
+    stats = mz_zip_writer_add_mem(&archive, entry_path.c_str(), data, size, level);
+    return stats;
+}
+
+mz_bool
+ZipArchive::add_entry (std::string entry_path, const std::function<bool(std::ostream&)> &writer)
+{
+    stats = 0;
+    // Check if it's in the write mode.
+    if(mode != 'W')
+        return stats;
+    DeflateBuffer buffer(ZIP_DEFLATE_COMPRESSION);
+    std::ostream out(&buffer);
+    if (!writer(out) || !out.flush() || !buffer.finish())
+        return stats;
+    stats = mz_zip_writer_add_mem_ex_v2(&archive, entry_path.c_str(), buffer.compressed.data(), buffer.compressed.size(),
+        nullptr, 0, ZIP_DEFLATE_COMPRESSION | MZ_ZIP_FLAG_COMPRESSED_DATA, buffer.size, buffer.crc, nullptr, nullptr, 0, nullptr, 0);
+    return stats;
+}
+
 mz_bool
 ZipArchive::extract_entry (std::string entry_path, std::string file_path)
 {
@@ -45,6 +144,35 @@ ZipArchive::extract_entry (std::string entry_path, std::string file_path)
     return stats;
 }
 
+mz_bool
+ZipArchive::extract_entry (std::string entry_path, const std::function<bool(const char*, size_t)> &consumer)
+{
+    stats = 0;
+    // Check if it's in the read mode.
+    if (mode != 'R')
+        return stats;
+    // Miniz hands over the inflated data one dictionary-sized chunk at a time.
+    const mz_file_write_func callback = [](void *opaque, mz_uint64 file_ofs, const void *buf, size_t n) -> size_t {
+        const auto &consumer = *static_cast<const std::function<bool(const char*, size_t)>*>(opaque);
+        return consumer(static_cast<const char*>(buf), n) ? n : 0;
+    };
+    stats = mz_zip_reader_extract_file_to_callback(&archive, entry_path.c_str(), callback,
+        const_cast<std::function<bool(const char*, size_t)>*>(&consumer), 0);
+    return stats;
+}
+
+size_t
+ZipArchive::entry_size (std::string entry_path)
+{
+    if (mode != 'R')
+        return 0;
+    const int index = mz_zip_reader_locate_file(&archive, entry_path.c_str(), nullptr, 0);
+    mz_zip_archive_file_stat stat;
+    if (index < 0 || !mz_zip_reader_file_stat(&archive, mz_uint(index), &stat))
+        return 0;
+    return size_t(stat.m_uncomp_size);
+}
+
 mz_bool
 ZipArchive::finalize()
 {
@@ -4,8 +4,10 @@
 #define MINIZ_HEADER_FILE_ONLY
 #define ZIP_DEFLATE_COMPRESSION 8
 
+#include <functional>
 #include <string>
 #include <iostream>
+#include <ostream>
 #include "miniz/miniz.h"
 
 namespace Slic3r {
@@ -30,12 +32,38 @@ public:
     /// \return mz_bool 0: failure 1: success.
     mz_bool add_entry (std::string entry_path, std::string file_path);
 
+    /// Add a file to the current zip archive from memory.
+    /// \param entry_path string the path of the entry in the zip archive.
+    /// \param data const void* the content of the file.
+    /// \param size size_t the size of the content.
+    /// \param level mz_uint the compression level, MZ_NO_COMPRESSION for already compressed data.
+    /// \return mz_bool 0: failure 1: success.
+    mz_bool add_entry (std::string entry_path, const void* data, size_t size, mz_uint level = ZIP_DEFLATE_COMPRESSION);
+
+    /// Add an entry whose content is written to a stream and deflated as it comes, without
+    /// writing it to the disk first. Only the compressed content is kept in memory.
+    /// \param entry_path string the path of the entry in the zip archive.
+    /// \param writer function writing the content to the stream, returning false to abort.
+    /// \return mz_bool 0: failure (or aborted by the writer) 1: success.
+    mz_bool add_entry (std::string entry_path, const std::function<bool(std::ostream&)> &writer);
+
     /// Extract a zip entry to a file on the disk.
     /// \param entry_path string the path of the entry in the zip archive.
     /// \param file_path string the path of the file in the disk.
     /// \return mz_bool 0: failure 1: success.
     mz_bool extract_entry (std::string entry_path, std::string file_path);
 
+    /// Inflate a zip entry chunk by chunk into a consumer, without writing it to the disk.
+    /// \param entry_path string the path of the entry in the zip archive.
+    /// \param consumer function called with each decompressed chunk, returning false to abort the extraction.
+    /// \return mz_bool 0: failure (or aborted by the consumer) 1: success.
+    mz_bool extract_entry (std::string entry_path, const std::function<bool(const char*, size_t)> &consumer);
+
+    /// Get the uncompressed size of a zip entry.
+    /// \param entry_path string the path of the entry in the zip archive.
+    /// \return size_t the size in bytes, 0 if there is no such entry.
+    size_t entry_size (std::string entry_path);
+
     /// Finalize the archive and free any allocated memory.
     /// \return mz_bool 0: failure 1: success.
     mz_bool finalize();
@@ -20,6 +20,8 @@ class Extruder
     double retract_speed_mm_min;
     
     Extruder(unsigned int id, GCodeConfig *config);
+    /// Copy of other reading its settings from config.
+    Extruder(const Extruder &other, GCodeConfig *config) : Extruder(other) { this->config = config; }
     virtual ~Extruder() {}
     void reset();
     /// Calculate the amount extruded for relative or absolute moves.
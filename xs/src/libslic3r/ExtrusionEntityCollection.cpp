@@ -1,4 +1,5 @@
 #include "ExtrusionEntityCollection.hpp"
+#include "Geometry.hpp"
 #include <algorithm>
 #include <cmath>
 #include <map>
@@ -158,40 +159,35 @@ ExtrusionEntityCollection::chained_path_from(Point start_near, ExtrusionEntityCo
     retval->entities.reserve(this->entities.size());
     retval->orig_indices.reserve(this->entities.size());
     
-    // if we're asked to return the original indices, build a map
-    std::map<ExtrusionEntity*,size_t> indices_map;
-    
     ExtrusionEntitiesPtr my_paths;
-    for (ExtrusionEntitiesPtr::const_iterator it = this->entities.begin(); it != this->entities.end(); ++it) {
-        ExtrusionEntity* entity = (*it)->clone();
-        my_paths.push_back(entity);
-        if (orig_indices != NULL) indices_map[entity] = it - this->entities.begin();
-    }
+    for (ExtrusionEntitiesPtr::const_iterator it = this->entities.begin(); it != this->entities.end(); ++it)
+        my_paths.push_back((*it)->clone());
     
-    Points endpoints;
-    for (ExtrusionEntitiesPtr::iterator it = my_paths.begin(); it != my_paths.end(); ++it) {
-        endpoints.push_back((*it)->first_point());
-        if (no_reverse || !(*it)->can_reverse()) {
-            endpoints.push_back((*it)->first_point());
-        } else {
-            endpoints.push_back((*it)->last_point());
+    // index both endpoints of the paths we may reverse, only the first point of the others
+    Geometry::ChainingIndex endpoints;
+    std::vector<bool> last_endpoint;
+    for (size_t i = 0; i < my_paths.size(); ++i) {
+        endpoints.add(my_paths[i]->first_point(), i);
+        last_endpoint.push_back(false);
+        if (!no_reverse && my_paths[i]->can_reverse()) {
+            endpoints.add(my_paths[i]->last_point(), i);
+            last_endpoint.push_back(true);
         }
     }
     
-    while (!my_paths.empty()) {
+    for (size_t n = 0; n < my_paths.size(); ++n) {
         // find nearest point
-        int start_index = start_near.nearest_point_index(endpoints);
-        int path_index = start_index/2;
-        ExtrusionEntity* entity = my_paths.at(path_index);
+        int start_index = endpoints.nearest(start_near);
+        size_t path_index = endpoints.item(start_index);
+        ExtrusionEntity* entity = my_paths[path_index];
         // never reverse loops, since it's pointless for chained path and callers might depend on orientation
-        if (start_index % 2 && !no_reverse && entity->can_reverse()) {
+        if (last_endpoint[start_index]) {
             entity->reverse();
         }
-        retval->entities.push_back(my_paths.at(path_index));
-        if (orig_indices != NULL) orig_indices->push_back(indices_map[entity]);
-        my_paths.erase(my_paths.begin() + path_index);
-        endpoints.erase(endpoints.begin() + 2*path_index, endpoints.begin() + 2*path_index + 2);
-        start_near = retval->entities.back()->last_point();
+        retval->entities.push_back(entity);
+        if (orig_indices != NULL) orig_indices->push_back(path_index);
+        endpoints.remove(path_index);
+        start_near = entity->last_point();
     }
 }
 
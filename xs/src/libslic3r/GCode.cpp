@@ -9,32 +9,20 @@
 namespace Slic3r {
 
 AvoidCrossingPerimeters::AvoidCrossingPerimeters()
-    : use_external_mp(false), use_external_mp_once(false), disable_once(true),
-        _external_mp(NULL), _layer_mp(NULL)
+    : use_external_mp(false), use_external_mp_once(false), disable_once(true)
 {
 }
 
-AvoidCrossingPerimeters::~AvoidCrossingPerimeters()
-{
-    delete this->_external_mp;
-    
-    delete this->_layer_mp;
-}
-
 void
 AvoidCrossingPerimeters::init_external_mp(const ExPolygons &islands)
 {
-    delete this->_external_mp;
-    
-    this->_external_mp = new MotionPlanner(islands);
+    this->_external_mp = std::make_shared<MotionPlanner>(islands);
 }
 
 void
 AvoidCrossingPerimeters::init_layer_mp(const ExPolygons &islands)
 {
-    delete this->_layer_mp;
-    
-    this->_layer_mp = new MotionPlanner(islands);
+    this->_layer_mp = std::make_shared<MotionPlanner>(islands);
 }
 
 Polyline
@@ -199,7 +187,7 @@ GCode::GCode()
     : placeholder_parser(NULL), enable_loop_clipping(true), enable_cooling_markers(false), layer_count(0),
         layer_index(-1), layer(NULL), first_layer(false), elapsed_time(0.0),
         elapsed_time_bridges(0.0), elapsed_time_external(0.0), volumetric_speed(0),
-        _last_pos_defined(false)
+        _cog(0, 0, 0), _extrusion_length(0), _last_pos_defined(false), _defer_travel(false)
 {
 }
 
@@ -423,11 +411,19 @@ GCode::extrude(ExtrusionLoop loop, std::string description, double speed)
         this->wipe.path = paths.front().polyline;  // TODO: don't limit wipe to last path
     
     // make a little move inwards before leaving loop
-    if (paths.back().role == erExternalPerimeter && this->layer != NULL && this->config.perimeters > 1) {
+    // (the last path may be too short to hold the points we look at, so take
+    // them from the whole clipped loop)
+    Points loop_points;
+    for (const ExtrusionPath &path : paths)
+        for (const Point &p : path.polyline.points)
+            if (loop_points.empty() || !loop_points.back().coincides_with(p))
+                loop_points.push_back(p);
+    if (paths.back().role == erExternalPerimeter && this->layer != NULL && this->config.perimeters > 1
+        && loop_points.size() >= 3 && paths.front().polyline.points.size() >= 2) {
         // detect angle between last and first segment
         // the side depends on the original winding order of the polygon (left for contours, right for holes)
         Point a = paths.front().polyline.points[1];  // second point
-        Point b = *(paths.back().polyline.points.end()-3);       // second to last point
+        Point b = *(loop_points.end()-3);            // second to last point
         if (was_clockwise) {
             // swap points
             Point c = a; a = b; b = c;
@@ -491,7 +487,13 @@ GCode::_extrude(ExtrusionPath path, std::string description, double speed)
     description = path.is_bridge() ? description + " (bridge)" : description;
     
     // go to first point of extrusion path
-    if (!this->_last_pos_defined || !this->_last_pos.coincides_with(path.first_point())) {
+    if (this->_defer_travel) {
+        this->fragment_travel.pending = true;
+        this->fragment_travel.point = path.first_point();
+        this->fragment_travel.role = path.role;
+        this->fragment_travel.comment = "move to first " + description + " point";
+        this->_defer_travel = false;
+    } else if (!this->_last_pos_defined || !this->_last_pos.coincides_with(path.first_point())) {
         gcode += this->travel_to(
             path.first_point(),
             path.role,
@@ -765,6 +767,60 @@ GCode::set_extruder(unsigned int extruder_id)
     return gcode;
 }
 
+void
+GCode::begin_fragment(const Layer &layer, const Point &hint)
+{
+    this->layer = &layer;
+    this->first_layer = (layer.id() == 0);
+    if (this->config.avoid_crossing_perimeters)
+        this->avoid_crossing_perimeters.init_layer_mp(union_ex(layer.slices, true));
+    this->avoid_crossing_perimeters.use_external_mp = false;
+    this->avoid_crossing_perimeters.use_external_mp_once = false;
+    this->avoid_crossing_perimeters.disable_once = false;
+    
+    this->writer.begin_fragment();
+    this->wipe.reset_path();
+    this->_seam_position.erase(layer.object());
+    this->_last_pos = hint;
+    this->_last_pos_defined = false;
+    this->_defer_travel = true;
+    this->fragment_travel = Travel();
+    
+    this->elapsed_time = this->elapsed_time_bridges = this->elapsed_time_external = 0;
+    this->_cog = Pointf3(0, 0, 0);
+    this->_extrusion_length = 0;
+}
+
+std::string
+GCode::travel_to_fragment(const GCode &fragment)
+{
+    const Travel &travel { fragment.fragment_travel };
+    if (!travel.pending || (this->_last_pos_defined && this->_last_pos.coincides_with(travel.point)))
+        return "";
+    return this->travel_to(travel.point, travel.role, travel.comment);
+}
+
+void
+GCode::end_fragment(const GCode &fragment)
+{
+    this->writer.end_fragment(fragment.writer);
+    if (this->writer.extruder() != NULL)
+        this->placeholder_parser->set("current_extruder", this->writer.extruder()->id);
+    this->wipe.path = fragment.wipe.path;
+    if (fragment.layer != NULL && fragment._seam_position.count(fragment.layer->object()) > 0)
+        this->_seam_position[fragment.layer->object()] = fragment._seam_position.at(fragment.layer->object());
+    if (fragment._last_pos_defined)
+        this->set_last_pos(fragment._last_pos);
+    
+    this->elapsed_time += fragment.elapsed_time;
+    this->elapsed_time_bridges += fragment.elapsed_time_bridges;
+    this->elapsed_time_external += fragment.elapsed_time_external;
+    this->_cog.x += fragment._cog.x;
+    this->_cog.y += fragment._cog.y;
+    this->_cog.z += fragment._cog.z;
+    this->_extrusion_length += fragment._extrusion_length;
+}
+
 // convert a model-space scaled point into G-code coordinates
 Pointf
 GCode::point_to_gcode(const Point &point)
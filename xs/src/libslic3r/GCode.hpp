@@ -11,6 +11,7 @@
 #include "Print.hpp"
 #include "PrintConfig.hpp"
 #include "ConditionalGCode.hpp"
+#include <memory>
 #include <string>
 #include <vector>
 #include <set>
@@ -31,14 +32,14 @@ class AvoidCrossingPerimeters {
     bool disable_once;
     
     AvoidCrossingPerimeters();
-    ~AvoidCrossingPerimeters();
     void init_external_mp(const ExPolygons &islands);
     void init_layer_mp(const ExPolygons &islands);
     Polyline travel_to(GCode &gcodegen, Point point);
     
     private:
-    MotionPlanner* _external_mp;
-    MotionPlanner* _layer_mp;
+    // shared by copies, which only read them until they init their own
+    std::shared_ptr<MotionPlanner> _external_mp;
+    std::shared_ptr<MotionPlanner> _layer_mp;
 };
 
 class OozePrevention {
@@ -139,12 +140,36 @@ class GCode {
     Pointf point_to_gcode(const Point &point);
     Pointf3 get_cog();
     std::string cog_stats();
+
+    /// Travel move to the first extrusion of a fragment, left to the G-code
+    /// written before it (see begin_fragment()).
+    struct Travel {
+        bool pending {false};
+        Point point;
+        ExtrusionRole role {erNone};
+        std::string comment;
+    };
+    Travel fragment_travel;
+
+    /// Start writing the extrusions of a layer on a copy of this generator,
+    /// before the G-code leading to them is known: the travel to the first
+    /// extrusion is kept in fragment_travel instead of being written, seams
+    /// and path ordering start from hint (in print coordinates, see
+    /// set_origin()) and the time, filament and center of gravity counters
+    /// start from zero.
+    void begin_fragment(const Layer &layer, const Point &hint);
+    /// Write the travel to the first extrusion of fragment.
+    std::string travel_to_fragment(const GCode &fragment);
+    /// Take over the state of fragment, a copy that continued from the state
+    /// of this generator, adding up its counters.
+    void end_fragment(const GCode &fragment);
     
     private:
     Point _last_pos;
     Pointf3 _cog;
     float _extrusion_length;
     bool _last_pos_defined;
+    bool _defer_travel;
     std::string _extrude(ExtrusionPath path, std::string description = "", double speed = -1);
 };
 
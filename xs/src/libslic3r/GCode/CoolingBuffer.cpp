@@ -1,6 +1,10 @@
 #include "CoolingBuffer.hpp"
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/algorithm/string/replace.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 
 namespace Slic3r {
@@ -16,7 +20,9 @@ CoolingBuffer::append(const std::string &gcode, std::string obj_id, size_t layer
     
     this->_layer_id = layer_id;
     this->_last_z[obj_id] = print_z;
+    const size_t from = this->_gcode.size();
     this->_gcode += gcode;
+    this->_index_markers(from);
     // This is a very rough estimate of the print time, 
     // not taking into account the acceleration curves generated by the printer firmware.
     this->_elapsed_time          += this->_gcodegen->elapsed_time;
@@ -29,38 +35,68 @@ CoolingBuffer::append(const std::string &gcode, std::string obj_id, size_t layer
     return out;
 }
 
+void
+CoolingBuffer::_index_markers(size_t from)
+{
+    const std::string &gcode = this->_gcode;
+    // a marked line left unterminated by the previous call goes on
+    if (!this->_marked_lines.empty() && this->_marked_lines.back().end == from) {
+        from = this->_marked_lines.back().start;
+        this->_marked_lines.pop_back();
+    }
+    // all the markers start with ";_", whose ';' may have ended the previous call
+    for (size_t pos = gcode.find(";_", from ? from - 1 : 0); pos != std::string::npos; pos = gcode.find(";_", pos)) {
+        MarkedLine line;
+        const size_t eol = gcode.rfind('\n', pos);
+        line.start = (eol == std::string::npos) ? 0 : eol + 1;
+        line.end   = std::min(gcode.find('\n', pos), gcode.size());
+        
+        const char* begin = gcode.data() + line.start;
+        const char* end   = gcode.data() + line.end;
+        const auto contains = [begin, end](const char* marker, size_t len) {
+            return std::search(begin, end, marker, marker + len) != end;
+        };
+        const auto starts_with = [begin, end](const char* text, size_t len) {
+            return size_t(end - begin) >= len && memcmp(begin, text, len) == 0;
+        };
+        line.markers = 0;
+        if (starts_with("G1", 2))                            line.markers |= mkG1;
+        if (contains(";_EXTRUDE_SET_SPEED", 19))             line.markers |= mkExtrudeSetSpeed;
+        if (contains(";_WIPE", 6))                           line.markers |= mkWipe;
+        if (contains(";_EXTERNAL_PERIMETER", 20))            line.markers |= mkExternalPerimeter;
+        if (contains(";_BRIDGE_FAN_START", 18))              line.markers |= mkBridgeFanStart;
+        if (contains(";_BRIDGE_FAN_END", 16))                line.markers |= mkBridgeFanEnd;
+        if (starts_with(";_BRIDGE_FAN_START", 18))           line.markers |= mkStartsBridge;
+        this->_marked_lines.push_back(line);
+        pos = line.end;
+    }
+}
+
 void
 apply_speed_factor(std::string &line, float speed_factor, float min_print_speed)
 {
     // find pos of F
     size_t pos = line.find_first_of('F');
+    if (pos == std::string::npos) return;
     size_t last_pos = line.find_first_of(' ', pos+1);
     
     // extract current speed
-    float speed;
-    {
-        std::istringstream iss(line.substr(pos+1, last_pos));
-        iss >> speed;
-    }
+    float speed = strtof(line.c_str() + pos + 1, nullptr);
     
     // change speed
     speed *= speed_factor;
     speed = std::max(speed, min_print_speed);
     
     // replace speed in string
-    {
-        std::ostringstream oss;
-        oss.precision(3);
-        oss << std::fixed << speed;
-        line.replace(pos+1, (last_pos-pos), oss.str());
-    }
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.3f", speed);
+    line.replace(pos+1, (last_pos-pos), buf);
 }
 
 std::string
 CoolingBuffer::flush()
 {
     GCode &gg = *this->_gcodegen;
-    std::string gcode = this->_gcode;
     
     int fan_speed           = gg.config.fan_always_on ? gg.config.min_fan_speed.value : 0;
     float speed_factor      = 1.0;
@@ -100,52 +136,62 @@ CoolingBuffer::flush()
         #ifdef SLIC3R_DEBUG
         printf("  fan = %d%%, speed = %f%%\n", fan_speed, speed_factor * 100);
         #endif
-        
-        if (speed_factor < 1.0) {
-            // Adjust feed rate of G1 commands marked with an _EXTRUDE_SET_SPEED
-            // as long as they are not _WIPE moves (they cannot if they are _EXTRUDE_SET_SPEED)
-            // and they are not preceded directly by _BRIDGE_FAN_START (do not adjust bridging speed).
-            std::string new_gcode;
-            std::istringstream ss(gcode);
-            std::string line;
-            bool bridge_fan_start = false;
-            while (std::getline(ss, line)) {
-                if (boost::starts_with(line, "G1")
-                    && boost::contains(line, ";_EXTRUDE_SET_SPEED")
-                    && !boost::contains(line, ";_WIPE")
-                    && !bridge_fan_start
-                    && (slowdown_external || !boost::contains(line, ";_EXTERNAL_PERIMETER"))) {
-                    apply_speed_factor(line, speed_factor, this->_min_print_speed);
-                    boost::replace_first(line, ";_EXTRUDE_SET_SPEED", "");
-                }
-                bridge_fan_start = boost::starts_with(line, ";_BRIDGE_FAN_START");
-                new_gcode += line + '\n';
-            }
-            gcode = new_gcode;
-        }
     }
-    if (this->_layer_id < gg.config.disable_fan_first_layers)
+    const bool fan_disabled = this->_layer_id < size_t(std::max(0, gg.config.disable_fan_first_layers.value));
+    if (fan_disabled)
         fan_speed = 0;
     
-    gcode = gg.writer.set_fan(fan_speed) + gcode;
+    std::string gcode = gg.writer.set_fan(fan_speed);
     
     // bridge fan speed
-    if (!gg.config.cooling || gg.config.bridge_fan_speed == 0 || this->_layer_id < gg.config.disable_fan_first_layers) {
-        boost::replace_all(gcode, ";_BRIDGE_FAN_START", "");
-        boost::replace_all(gcode, ";_BRIDGE_FAN_END", "");
-    } else {
-        boost::replace_all(gcode, ";_BRIDGE_FAN_START", gg.writer.set_fan(gg.config.bridge_fan_speed, true));
-        boost::replace_all(gcode, ";_BRIDGE_FAN_END",   gg.writer.set_fan(fan_speed, true));
+    std::string bridge_fan_start, bridge_fan_end;
+    if (gg.config.cooling && gg.config.bridge_fan_speed != 0 && !fan_disabled) {
+        bridge_fan_start = gg.writer.set_fan(gg.config.bridge_fan_speed, true);
+        bridge_fan_end   = gg.writer.set_fan(fan_speed, true);
+    }
+    
+    // Copy the G-code, rewriting the marked lines.
+    // Adjust feed rate of G1 commands marked with an _EXTRUDE_SET_SPEED
+    // as long as they are not _WIPE moves (they cannot if they are _EXTRUDE_SET_SPEED)
+    // and they are not preceded directly by _BRIDGE_FAN_START (do not adjust bridging speed).
+    gcode.reserve(gcode.size() + this->_gcode.size() + 1);
+    size_t copied = 0;
+    std::string line;
+    for (size_t i = 0; i < this->_marked_lines.size(); ++i) {
+        const MarkedLine &marked = this->_marked_lines[i];
+        const bool after_bridge_fan_start = i > 0
+            && (this->_marked_lines[i-1].markers & mkStartsBridge)
+            && this->_marked_lines[i-1].end + 1 == marked.start;
+        gcode.append(this->_gcode, copied, marked.start - copied);
+        line.assign(this->_gcode, marked.start, marked.end - marked.start);
+        if (speed_factor < 1.0
+            && (marked.markers & mkG1)
+            && (marked.markers & mkExtrudeSetSpeed)
+            && !(marked.markers & mkWipe)
+            && !after_bridge_fan_start
+            && (slowdown_external || !(marked.markers & mkExternalPerimeter))) {
+            apply_speed_factor(line, speed_factor, this->_min_print_speed);
+            boost::replace_first(line, ";_EXTRUDE_SET_SPEED", "");
+        }
+        if (marked.markers & mkBridgeFanStart)    boost::replace_all(line, ";_BRIDGE_FAN_START", bridge_fan_start);
+        if (marked.markers & mkBridgeFanEnd)      boost::replace_all(line, ";_BRIDGE_FAN_END", bridge_fan_end);
+        if (marked.markers & mkWipe)              boost::replace_all(line, ";_WIPE", "");
+        if (marked.markers & mkExtrudeSetSpeed)   boost::replace_all(line, ";_EXTRUDE_SET_SPEED", "");
+        if (marked.markers & mkExternalPerimeter) boost::replace_all(line, ";_EXTERNAL_PERIMETER", "");
+        gcode += line;
+        copied = marked.end;
     }
-    boost::replace_all(gcode, ";_WIPE", "");
-    boost::replace_all(gcode, ";_EXTRUDE_SET_SPEED", "");
-    boost::replace_all(gcode, ";_EXTERNAL_PERIMETER", "");
+    gcode.append(this->_gcode, copied, std::string::npos);
+    // slowing down used to rewrite the G-code line by line, terminating the last one
+    if (speed_factor < 1.0 && !this->_gcode.empty() && this->_gcode.back() != '\n')
+        gcode += '\n';
     
     // Reset the buffer.
     this->_elapsed_time          = 0;
     this->_elapsed_time_bridges  = 0;
     this->_elapsed_time_external = 0;
-    this->_gcode = "";
+    this->_gcode.clear();
+    this->_marked_lines.clear();
     this->_last_z.clear(); // reset the whole table otherwise we would compute overlapping times
     
     return gcode;
@@ -5,6 +5,7 @@
 #include "GCode.hpp"
 #include <map>
 #include <string>
+#include <vector>
 
 namespace Slic3r {
 
@@ -12,6 +13,8 @@ namespace Slic3r {
 A standalone G-code filter, to control cooling of the print.
 The G-code is processed per layer. Once a layer is collected, fan start / stop commands are edited
 and the print is modified to stretch over a minimum layer time.
+The lines holding cooling markers are indexed as the G-code is appended, so that the layer is
+rewritten in a single pass by flush(), only the slowed down moves getting a new feedrate.
 */
 
 class CoolingBuffer {
@@ -27,14 +30,35 @@ class CoolingBuffer {
     GCode* gcodegen() { return this->_gcodegen; };
     
     private:
+    /// Cooling markers (and the line starts) found in a line.
+    enum Marker {
+        mkG1                = 1 << 0,   ///< the line is a G1 move
+        mkExtrudeSetSpeed   = 1 << 1,   ///< ;_EXTRUDE_SET_SPEED
+        mkWipe              = 1 << 2,   ///< ;_WIPE
+        mkExternalPerimeter = 1 << 3,   ///< ;_EXTERNAL_PERIMETER
+        mkBridgeFanStart    = 1 << 4,   ///< ;_BRIDGE_FAN_START
+        mkBridgeFanEnd      = 1 << 5,   ///< ;_BRIDGE_FAN_END
+        mkStartsBridge      = 1 << 6,   ///< the line starts with ;_BRIDGE_FAN_START
+    };
+    /// A line of _gcode holding cooling markers.
+    struct MarkedLine {
+        size_t start;       ///< offset of the line in _gcode
+        size_t end;         ///< offset of its '\n' (or the end of _gcode)
+        unsigned int markers;
+    };
+
     GCode*                      _gcodegen;
     std::string                 _gcode;
+    std::vector<MarkedLine>     _marked_lines;
     float                       _elapsed_time;
     float                       _elapsed_time_bridges;
     float                       _elapsed_time_external;
     size_t                      _layer_id;
     std::map<std::string,float> _last_z;
     float                       _min_print_speed;
+
+    /// Index the lines of _gcode holding markers, from offset from on.
+    void _index_markers(size_t from);
 };
 
 #ifdef SLIC3R_TEST
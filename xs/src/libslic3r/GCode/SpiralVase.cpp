@@ -1,15 +1,30 @@
 #include "SpiralVase.hpp"
-#include <sstream>
+#include <algorithm>
+#include <cstdio>
 
 namespace Slic3r {
 
-std::string
-_format_z(float z)
+/// Append the line [begin, end) to out, with its Z word (if any,
+/// otherwise a new one after the command) set to z.
+static void
+_append_with_z(std::string &out, const char* begin, const char* end, bool has_z, float z)
 {
-    std::ostringstream ss;
-    ss << std::fixed << std::setprecision(3)
-       << z;
-    return ss.str();
+    char value[32];
+    const int len = snprintf(value, sizeof(value), "%.3f", z);
+    if (has_z) {
+        static const char word[] = " Z";
+        const char* pos = std::search(begin, end, word, word + 2) + 2;
+        const char* value_end = (pos + 1 < end) ? std::find(pos + 1, end, ' ') : end;
+        out.append(begin, pos);
+        out.append(value, len);
+        out.append(value_end, end);
+    } else {
+        const char* pos = std::find(begin, end, ' ');
+        out.append(begin, pos);
+        out += " Z";
+        out.append(value, len);
+        out.append(pos, end);
+    }
 }
 
 std::string
@@ -30,64 +45,72 @@ SpiralVase::process_layer(const std::string &gcode)
         return gcode;
     }
     
-    // Get total XY length for this layer by summing all extrusion moves.
+    // Get total XY length for this layer by summing all extrusion moves,
+    // and collect the moves to rewrite.
     float total_layer_length = 0;
     float layer_height = 0;
-    float z;
+    float z = this->_reader.Z;
     bool set_z = false;
     
-    {
-        GCodeReader r = this->_reader;  // clone
-        r.parse(gcode, [&total_layer_length, &layer_height, &z, &set_z]
-            (GCodeReader &, const GCodeReader::GCodeLine &line) {
-            if (line.cmd == "G1") {
-                if (line.extruding()) {
-                    total_layer_length += line.dist_XY();
-                } else if (line.has('Z')) {
-                    layer_height += line.dist_Z();
-                    if (!set_z) {
-                        z = line.new_Z();
-                        set_z = true;
-                    }
-                }
+    this->_moves.clear();
+    size_t offset = 0;
+    this->_reader.parse(gcode, [this, &offset, &total_layer_length, &layer_height, &z, &set_z]
+        (GCodeReader &, const GCodeReader::GCodeLine &line) {
+        Move move;
+        move.start = offset;
+        move.end = offset + line.raw.size();
+        offset = move.end + 1;
+        if (line.cmd != "G1") return;
+        
+        if (line.extruding()) {
+            total_layer_length += line.dist_XY();
+        } else if (line.has('Z')) {
+            layer_height += line.dist_Z();
+            if (!set_z) {
+                z = line.new_Z();
+                set_z = true;
             }
-        });
-    }
+        }
+        
+        if (line.has('Z')) {
+            move.type = Move::mtLayerZ;
+        } else {
+            move.dist_XY = line.dist_XY();
+            if (move.dist_XY <= 0) return;
+            move.type = line.extruding() ? Move::mtExtrusion : Move::mtTravel;
+        }
+        this->_moves.push_back(move);
+    });
     
-    // Remove layer height from initial Z.
+    // Remove layer height from initial Z.
     z -= layer_height;
     
     std::string new_gcode;
-    this->_reader.parse(gcode, [&new_gcode, &z, &layer_height, &total_layer_length]
-        (GCodeReader &, GCodeReader::GCodeLine line) {
-        if (line.cmd == "G1") {
-            if (line.has('Z')) {
-                // If this is the initial Z move of the layer, replace it with a
-                // (redundant) move to the last Z of previous layer.
-                line.set('Z', _format_z(z));
-                new_gcode += line.raw + '\n';
-                return;
-            } else {
-                float dist_XY = line.dist_XY();
-                if (dist_XY > 0) {
-                    // horizontal move
-                    if (line.extruding()) {
-                        z += dist_XY * layer_height / total_layer_length;
-                        line.set('Z', _format_z(z));
-                        new_gcode += line.raw + '\n';
-                    }
-                    return;
-                
-                    /*  Skip travel moves: the move to first perimeter point will
-                        cause a visible seam when loops are not aligned in XY; by skipping
-                        it we blend the first loop move in the XY plane (although the smoothness
-                        of such blend depend on how long the first segment is; maybe we should
-                        enforce some minimum length?).  */
-                }
-            }
+    new_gcode.reserve(gcode.size() + this->_moves.size() * 8 + 1);
+    size_t copied = 0;
+    for (const Move &move : this->_moves) {
+        new_gcode.append(gcode, copied, move.start - copied);
+        copied = std::min(move.end + 1, gcode.size());
+        if (move.type == Move::mtTravel) {
+            /*  Skip travel moves: the move to first perimeter point will
+                cause a visible seam when loops are not aligned in XY; by skipping
+                it we blend the first loop move in the XY plane (although the smoothness
+                of such blend depend on how long the first segment is; maybe we should
+                enforce some minimum length?).  */
+            continue;
         }
-        new_gcode += line.raw + '\n';
-    });
+        // If this is the initial Z move of the layer, replace it with a
+        // (redundant) move to the last Z of previous layer.
+        if (move.type == Move::mtExtrusion)
+            z += move.dist_XY * layer_height / total_layer_length;
+        _append_with_z(new_gcode, gcode.data() + move.start, gcode.data() + move.end,
+            move.type == Move::mtLayerZ, z);
+        new_gcode += '\n';
+    }
+    new_gcode.append(gcode, copied, std::string::npos);
+    // every line is terminated, the last one included
+    if (!new_gcode.empty() && new_gcode.back() != '\n')
+        new_gcode += '\n';
     
     return new_gcode;
 }
@@ -4,9 +4,14 @@
 #include "libslic3r.h"
 #include "GCode.hpp"
 #include "GCodeReader.hpp"
+#include <vector>
 
 namespace Slic3r {
 
+/// Turns the loop of each layer into a ramp climbing to the next layer.
+/// A layer is parsed once: the reader collects the moves to rewrite along with
+/// the length of the extrusions, and their Z is then ramped while copying the
+/// layer, without parsing it again.
 class SpiralVase {
     public:
     bool enable;
@@ -20,8 +25,17 @@ class SpiralVase {
     std::string process_layer(const std::string &gcode);
     
     private:
+    /// A G1 move of the layer that gets rewritten or dropped.
+    struct Move {
+        enum Type { mtLayerZ, mtExtrusion, mtTravel } type;
+        size_t start;       ///< offset of the line in the layer
+        size_t end;         ///< offset of the end of the line
+        float dist_XY;      ///< XY length of the extrusions
+    };
+    
     const PrintConfig* _config;
     GCodeReader _reader;
+    std::vector<Move> _moves;
 };
 
 }
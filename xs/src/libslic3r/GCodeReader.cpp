@@ -1,11 +1,57 @@
 #include "GCodeReader.hpp"
-#include <boost/algorithm/string/classification.hpp>
-#include <boost/algorithm/string/split.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <sstream>
 
 namespace Slic3r {
 
+/// Parse the value of a G-code word, with the result atof() gives.
+/// Plain decimals of up to 15 digits are converted exactly with a single
+/// division; anything else (exponents, long mantissas, junk) goes to atof().
+static double
+parse_word_value(const char* begin, const char* end)
+{
+    static const double pow10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15 };
+    
+    const char* p = begin;
+    const bool negative = p != end && *p == '-';
+    if (p != end && (*p == '-' || *p == '+')) ++p;
+    
+    uint64_t mantissa = 0;
+    int digits = 0, decimals = 0;
+    bool point = false;
+    for (; p != end; ++p) {
+        if (*p >= '0' && *p <= '9') {
+            mantissa = mantissa * 10 + (*p - '0');
+            if (point) ++decimals;
+            if (++digits > 15) break;
+        } else if (*p == '.' && !point) {
+            point = true;
+        } else {
+            break;
+        }
+    }
+    if (p == end && digits > 0) {
+        const double value = double(mantissa) / pow10[decimals];
+        return negative ? -value : value;
+    }
+    
+    // atof() needs a terminated string
+    char buf[64];
+    const size_t len = end - begin;
+    if (len < sizeof(buf)) {
+        memcpy(buf, begin, len);
+        buf[len] = '\0';
+        return atof(buf);
+    }
+    return atof(std::string(begin, end).c_str());
+}
+
 void
 GCodeReader::apply_config(const PrintConfigBase &config)
 {
@@ -16,55 +62,109 @@ GCodeReader::apply_config(const PrintConfigBase &config)
 void
 GCodeReader::parse(const std::string &gcode, callback_t callback)
 {
-    std::istringstream ss(gcode);
-    this->parse_stream(ss, callback);
+    this->parse_buffer(gcode.data(), gcode.size(), callback);
+}
+
+void
+GCodeReader::parse_buffer(const char* data, size_t size, callback_t callback)
+{
+    GCodeLine gline(this);
+    const char* end = data + size;
+    for (const char* p = data; p != end; ) {
+        const char* eol = static_cast<const char*>(memchr(p, '\n', end - p));
+        if (eol == nullptr) {
+            this->_parse_line(p, end, gline, callback);
+            break;
+        }
+        this->_parse_line(p, eol, gline, callback);
+        p = eol + 1;
+    }
 }
 
 void GCodeReader::parse_stream(std::istream &gcode, callback_t callback)
 {
+    GCodeLine gline(this);
     std::string line;
     while (std::getline(gcode, line))
-        this->parse_line(line, callback);
+        this->_parse_line(line.data(), line.data() + line.size(), gline, callback);
 }
 
 void
 GCodeReader::parse_line(std::string line, callback_t callback)
 {
     GCodeLine gline(this);
-    gline.raw = line;
+    this->_parse_line(line.data(), line.data() + line.size(), gline, callback);
+}
+
+void
+GCodeReader::parse_file(const std::string &file, callback_t callback)
+{
+    namespace bip = boost::interprocess;
+    
+    boost::system::error_code ec;
+    const boost::uintmax_t size = boost::filesystem::file_size(file, ec);
+    if (ec || size == 0) return;
+    
+    bip::mapped_region region;
+    try {
+        bip::file_mapping mapping(file.c_str(), bip::read_only);
+        bip::mapped_region(mapping, bip::read_only).swap(region);
+    } catch (const bip::interprocess_exception &) {
+        // not mappable (e.g. a pipe): read it as a stream instead
+        std::ifstream f(file);
+        this->parse_stream(f, callback);
+        return;
+    }
+    region.advise(bip::mapped_region::advice_sequential);
+    this->parse_buffer(static_cast<const char*>(region.get_address()), region.get_size(), callback);
+}
+
+void
+GCodeReader::_parse_line(const char* begin, const char* end, GCodeLine &gline, const callback_t &callback)
+{
+    gline.raw.assign(begin, end);
+    gline.cmd.clear();
+    gline.comment.clear();
+    gline._mask = 0;
     if (this->verbose)
-        std::cout << line << std::endl;
+        std::cout << gline.raw << std::endl;
     
     // strip comment
     {
-        size_t pos = line.find(';');
-        if (pos != std::string::npos) {
-            gline.comment = line.substr(pos+1);
-            line.erase(pos);
+        const char* semicolon = static_cast<const char*>(memchr(begin, ';', end - begin));
+        if (semicolon != nullptr) {
+            gline.comment.assign(semicolon + 1, end);
+            end = semicolon;
         }
     }
     
-    // command and args
+    // command and args, separated by single spaces
     {
-        std::vector<std::string> args;
-        boost::split(args, line, boost::is_any_of(" "));
-        
-        // first one is cmd
-        gline.cmd = args.front();
-        args.erase(args.begin());
+        const char* p = begin;
+        const char* token_end = static_cast<const char*>(memchr(p, ' ', end - p));
+        if (token_end == nullptr) token_end = end;
+        gline.cmd.assign(p, token_end);
         
-        for (std::string &arg : args) {
-            if (arg.size() < 2) continue;
-            gline.args.insert(std::make_pair(arg[0], arg.substr(1)));
+        while (token_end != end) {
+            p = token_end + 1;
+            token_end = static_cast<const char*>(memchr(p, ' ', end - p));
+            if (token_end == nullptr) token_end = end;
+            if (token_end - p < 2) continue;
+            
+            // the first occurrence of a word wins
+            const uint32_t bit = GCodeLine::word_bit(*p);
+            if (bit == 0 || (gline._mask & bit) != 0) continue;
+            gline._mask |= bit;
+            gline._values[*p - 'A'] = parse_word_value(p + 1, token_end);
         }
     }
     
     // convert extrusion axis
     if (this->_extrusion_axis != 'E') {
-        const auto it = gline.args.find(this->_extrusion_axis);
-        if (it != gline.args.end()) {
-            std::swap(gline.args['E'], it->second);
-            gline.args.erase(it);
+        const uint32_t bit = GCodeLine::word_bit(this->_extrusion_axis);
+        if ((gline._mask & bit) != 0) {
+            gline._values['E' - 'A'] = gline._values[this->_extrusion_axis - 'A'];
+            gline._mask = (gline._mask & ~bit) | GCodeLine::word_bit('E');
         }
     }
     
@@ -83,15 +183,6 @@ GCodeReader::parse_line(std::string line, callback_t callback)
     }
 }
 
-void
-GCodeReader::parse_file(const std::string &file, callback_t callback)
-{
-    std::ifstream f(file);
-    std::string line;
-    while (std::getline(f, line))
-        this->parse_line(line, callback);
-}
-
 void
 GCodeReader::GCodeLine::set(char arg, std::string value)
 {
@@ -108,7 +199,11 @@ GCodeReader::GCodeLine::set(char arg, std::string value)
             this->raw = this->raw.replace(pos, 0, space + arg + value);
         }
     }
-    this->args[arg] = value;
+    const uint32_t bit = word_bit(arg);
+    if (bit != 0) {
+        this->_mask |= bit;
+        this->_values[arg - 'A'] = parse_word_value(value.data(), value.data() + value.size());
+    }
 }
 
 }
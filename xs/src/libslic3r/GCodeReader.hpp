@@ -3,6 +3,7 @@
 
 #include "libslic3r.h"
 #include <cmath>
+#include <cstdint>
 #include <cstdlib>
 #include <functional>
 #include <string>
@@ -11,6 +12,12 @@
 namespace Slic3r {
 
 class GCodeReader;
+
+/// Reads G-code one line at a time and hands every line to a callback.
+/// Lines are tokenized in place: the words of each line are parsed straight
+/// from the input buffer into a fixed array of values indexed by their letter,
+/// and a single GCodeLine is reused for the whole input so that parsing does
+/// not allocate per line.
 class GCodeReader {
     public:
     
@@ -20,17 +27,18 @@ class GCodeReader {
         std::string raw;
         std::string cmd;
         std::string comment;
-        std::map<char,std::string> args;
         
-        GCodeLine(GCodeReader* _reader) : reader(_reader) {};
+        GCodeLine(GCodeReader* _reader) : reader(_reader), _mask(0), _values() {};
         
-        bool has(char arg) const { return this->args.count(arg) > 0; };
-        float get_float(char arg) const { return atof(this->args.at(arg).c_str()); };
-        float new_X() const { return this->has('X') ? atof(this->args.at('X').c_str()) : this->reader->X; };
-        float new_Y() const { return this->has('Y') ? atof(this->args.at('Y').c_str()) : this->reader->Y; };
-        float new_Z() const { return this->has('Z') ? atof(this->args.at('Z').c_str()) : this->reader->Z; };
-        float new_E() const { return this->has('E') ? atof(this->args.at('E').c_str()) : this->reader->E; };
-        float new_F() const { return this->has('F') ? atof(this->args.at('F').c_str()) : this->reader->F; };
+        /// Whether the line carries the word arg (an uppercase letter).
+        bool has(char arg) const { return (this->_mask & word_bit(arg)) != 0; };
+        /// Value of word arg, 0 if the line doesn't have it.
+        float get_float(char arg) const { return this->has(arg) ? this->_values[arg - 'A'] : 0; };
+        float new_X() const { return this->has('X') ? this->_values['X' - 'A'] : this->reader->X; };
+        float new_Y() const { return this->has('Y') ? this->_values['Y' - 'A'] : this->reader->Y; };
+        float new_Z() const { return this->has('Z') ? this->_values['Z' - 'A'] : this->reader->Z; };
+        float new_E() const { return this->has('E') ? this->_values['E' - 'A'] : this->reader->E; };
+        float new_F() const { return this->has('F') ? this->_values['F' - 'A'] : this->reader->F; };
         float dist_X() const { return this->new_X() - this->reader->X; };
         float dist_Y() const { return this->new_Y() - this->reader->Y; };
         float dist_Z() const { return this->new_Z() - this->reader->Z; };
@@ -43,7 +51,15 @@ class GCodeReader {
         bool extruding() const { return this->cmd == "G1" && this->dist_E() > 0; };
         bool retracting() const { return this->cmd == "G1" && this->dist_E() < 0; };
         bool travel() const { return this->cmd == "G1" && !this->has('E'); };
+        /// Replace (or add) word arg in raw and in the parsed values.
         void set(char arg, std::string value);
+        
+        private:
+        uint32_t _mask;         ///< one bit per letter present on the line
+        double _values[26];     ///< parsed word values, indexed by letter - 'A'
+        
+        static uint32_t word_bit(char arg) { return (arg >= 'A' && arg <= 'Z') ? (uint32_t(1) << (arg - 'A')) : 0; };
+        friend class GCodeReader;
     };
     typedef std::function<void(GCodeReader&, const GCodeLine&)> callback_t;
     
@@ -54,13 +70,18 @@ class GCodeReader {
     GCodeReader() : X(0), Y(0), Z(0), E(0), F(0), verbose(false), _extrusion_axis('E') {};
     void apply_config(const PrintConfigBase &config);
     void parse(const std::string &gcode, callback_t callback);
+    /// Parse size bytes of G-code at data; the buffer needs no terminator.
+    void parse_buffer(const char* data, size_t size, callback_t callback);
     void parse_stream(std::istream &gcode, callback_t callback);
     void parse_line(std::string line, callback_t callback);
+    /// Parse a file through a read-only memory mapping of it.
     void parse_file(const std::string &file, callback_t callback);
     
     private:
     GCodeConfig _config;
     char _extrusion_axis;
+    
+    void _parse_line(const char* begin, const char* end, GCodeLine &gline, const callback_t &callback);
 };
 
 } /* namespace Slic3r */
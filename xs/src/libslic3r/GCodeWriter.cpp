@@ -1,9 +1,12 @@
 #include "GCodeWriter.hpp"
 #include "utils.hpp"
 #include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <iomanip>
 #include <iostream>
 #include <map>
+#include <sstream>
 
 #define FLAVOR_IS(val) this->config.gcode_flavor == val
 #define FLAVOR_IS_NOT(val) this->config.gcode_flavor != val
@@ -11,9 +14,76 @@
 #define PRECISION(val, precision) std::fixed << std::setprecision(precision) << val
 #define XYZF_NUM(val) PRECISION(val, 3)
 #define E_NUM(val) PRECISION(val, 5)
+#define LINE_COMMENT(comment) if (this->config.gcode_comments && !comment.empty()) line << " ; " << comment;
+#define XYZF_FIXED(val) GCodeFormatter::Fixed{val, 3}
+#define E_FIXED(val) GCodeFormatter::Fixed{val, 5}
 
 namespace Slic3r {
 
+void
+GCodeFormatter::append_fixed(std::string &out, double value, int precision)
+{
+    static const double scale[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9 };
+
+    if (precision >= 0 && precision <= 9 && std::isfinite(value)) {
+        const double scaled = std::fabs(value) * scale[precision];
+        if (scaled < 1e15) {
+            double integral;
+            const double frac = std::modf(scaled, &integral);
+            // The product above is within a few ulps of the exact decimal shift;
+            // only when the fraction is that close to one half could it round
+            // differently from printf, and those rare cases are left to the stream.
+            if (std::fabs(frac - 0.5) > scaled * 1e-15) {
+                uint64_t n = static_cast<uint64_t>(integral) + (frac > 0.5 ? 1 : 0);
+                char buf[32];
+                char* end = buf + sizeof(buf);
+                char* p = end;
+                for (int i = 0; i < precision; ++i) {
+                    *--p = '0' + (n % 10);
+                    n /= 10;
+                }
+                if (precision > 0) *--p = '.';
+                do {
+                    *--p = '0' + (n % 10);
+                    n /= 10;
+                } while (n > 0);
+                if (std::signbit(value)) *--p = '-';
+                out.append(p, end - p);
+                return;
+            }
+        }
+    }
+
+    std::ostringstream ss;
+    ss << PRECISION(value, precision);
+    out += ss.str();
+}
+
+GCodeWriter::GCodeWriter(const GCodeWriter &other)
+{
+    *this = other;
+}
+
+GCodeWriter&
+GCodeWriter::operator=(const GCodeWriter &other)
+{
+    if (this == &other) return *this;
+    this->config                = other.config;
+    this->multiple_extruders    = other.multiple_extruders;
+    this->_extrusion_axis       = other._extrusion_axis;
+    this->_last_acceleration    = other._last_acceleration;
+    this->_last_fan_speed       = other._last_fan_speed;
+    this->_lifted               = other._lifted;
+    this->_pos                  = other._pos;
+    
+    // the extruders read their settings from the config of their writer
+    this->extruders.clear();
+    for (const auto &extruder : other.extruders)
+        this->extruders.insert(std::make_pair(extruder.first, Extruder(extruder.second, &this->config)));
+    this->_extruder = other._extruder == NULL ? NULL : &this->extruders.find(other._extruder->id)->second;
+    return *this;
+}
+
 void
 GCodeWriter::apply_print_config(const PrintConfig &print_config)
 {
@@ -309,13 +379,13 @@ std::string
 GCodeWriter::set_speed(double F, const std::string &comment,
                        const std::string &cooling_marker) const
 {
-    std::ostringstream gcode;
-    gcode.precision(3);
-    gcode << "G1 F" << std::fixed << F;
-    COMMENT(comment);
-    gcode << cooling_marker;
-    gcode << "\n";
-    return gcode.str();
+    std::string gcode;
+    gcode.reserve(32 + comment.size() + cooling_marker.size());
+    GCodeFormatter line(gcode);
+    line << "G1 F" << XYZF_FIXED(F);
+    LINE_COMMENT(comment);
+    line << cooling_marker << '\n';
+    return gcode;
 }
 
 std::string
@@ -324,13 +394,15 @@ GCodeWriter::travel_to_xy(const Pointf &point, const std::string &comment)
     this->_pos.x = point.x;
     this->_pos.y = point.y;
     
-    std::ostringstream gcode;
-    gcode << "G1 X" << XYZF_NUM(point.x)
-          <<   " Y" << XYZF_NUM(point.y)
-          <<   " F" << XYZF_NUM(this->config.travel_speed.value * 60.0);
-    COMMENT(comment);
-    gcode << "\n";
-    return gcode.str();
+    std::string gcode;
+    gcode.reserve(64 + comment.size());
+    GCodeFormatter line(gcode);
+    line << "G1 X" << XYZF_FIXED(point.x)
+         <<   " Y" << XYZF_FIXED(point.y)
+         <<   " F" << XYZF_FIXED(this->config.travel_speed.value * 60.0);
+    LINE_COMMENT(comment);
+    line << '\n';
+    return gcode;
 }
 
 std::string
@@ -351,14 +423,16 @@ GCodeWriter::travel_to_xyz(const Pointf3 &point, const std::string &comment)
     this->_lifted = 0;
     this->_pos = point;
     
-    std::ostringstream gcode;
-    gcode << "G1 X" << XYZF_NUM(point.x)
-          <<   " Y" << XYZF_NUM(point.y)
-          <<   " Z" << XYZF_NUM(point.z)
-          <<   " F" << XYZF_NUM(this->config.travel_speed.value * 60.0);
-    COMMENT(comment);
-    gcode << "\n";
-    return gcode.str();
+    std::string gcode;
+    gcode.reserve(64 + comment.size());
+    GCodeFormatter line(gcode);
+    line << "G1 X" << XYZF_FIXED(point.x)
+         <<   " Y" << XYZF_FIXED(point.y)
+         <<   " Z" << XYZF_FIXED(point.z)
+         <<   " F" << XYZF_FIXED(this->config.travel_speed.value * 60.0);
+    LINE_COMMENT(comment);
+    line << '\n';
+    return gcode;
 }
 
 std::string
@@ -384,12 +458,14 @@ GCodeWriter::_travel_to_z(double z, const std::string &comment)
 {
     this->_pos.z = z;
     
-    std::ostringstream gcode;
-    gcode << "G1 Z" << XYZF_NUM(z)
-          <<   " F" << XYZF_NUM(this->config.travel_speed.value * 60.0);
-    COMMENT(comment);
-    gcode << "\n";
-    return gcode.str();
+    std::string gcode;
+    gcode.reserve(48 + comment.size());
+    GCodeFormatter line(gcode);
+    line << "G1 Z" << XYZF_FIXED(z)
+         <<   " F" << XYZF_FIXED(this->config.travel_speed.value * 60.0);
+    LINE_COMMENT(comment);
+    line << '\n';
+    return gcode;
 }
 
 bool
@@ -412,13 +488,15 @@ GCodeWriter::extrude_to_xy(const Pointf &point, double dE, const std::string &co
     this->_pos.y = point.y;
     this->_extruder->extrude(dE);
     
-    std::ostringstream gcode;
-    gcode << "G1 X" << XYZF_NUM(point.x)
-          <<   " Y" << XYZF_NUM(point.y)
-          <<    " " << this->_extrusion_axis << E_NUM(this->_extruder->E);
-    COMMENT(comment);
-    gcode << "\n";
-    return gcode.str();
+    std::string gcode;
+    gcode.reserve(64 + comment.size());
+    GCodeFormatter line(gcode);
+    line << "G1 X" << XYZF_FIXED(point.x)
+         <<   " Y" << XYZF_FIXED(point.y)
+         <<    ' ' << this->_extrusion_axis << E_FIXED(this->_extruder->E);
+    LINE_COMMENT(comment);
+    line << '\n';
+    return gcode;
 }
 
 std::string
@@ -428,14 +506,16 @@ GCodeWriter::extrude_to_xyz(const Pointf3 &point, double dE, const std::string &
     this->_lifted = 0;
     this->_extruder->extrude(dE);
     
-    std::ostringstream gcode;
-    gcode << "G1 X" << XYZF_NUM(point.x)
-          <<   " Y" << XYZF_NUM(point.y)
-          <<   " Z" << XYZF_NUM(point.z)
-          <<    " " << this->_extrusion_axis << E_NUM(this->_extruder->E);
-    COMMENT(comment);
-    gcode << "\n";
-    return gcode.str();
+    std::string gcode;
+    gcode.reserve(80 + comment.size());
+    GCodeFormatter line(gcode);
+    line << "G1 X" << XYZF_FIXED(point.x)
+         <<   " Y" << XYZF_FIXED(point.y)
+         <<   " Z" << XYZF_FIXED(point.z)
+         <<    ' ' << this->_extrusion_axis << E_FIXED(this->_extruder->E);
+    LINE_COMMENT(comment);
+    line << '\n';
+    return gcode;
 }
 
 std::string
@@ -571,4 +651,48 @@ GCodeWriter::unlift()
     return gcode;
 }
 
+bool
+GCodeWriter::same_state(const GCodeWriter &other) const
+{
+    if ((this->_extruder == NULL) != (other._extruder == NULL)
+        || (this->_extruder != NULL && this->_extruder->id != other._extruder->id)
+        || this->_lifted != other._lifted
+        || this->_pos.z != other._pos.z
+        || this->extruders.size() != other.extruders.size())
+        return false;
+    for (const auto &extruder : this->extruders) {
+        const auto found = other.extruders.find(extruder.first);
+        if (found == other.extruders.end()
+            || extruder.second.E != found->second.E
+            || extruder.second.retracted != found->second.retracted
+            || extruder.second.restart_extra != found->second.restart_extra)
+            return false;
+    }
+    return true;
+}
+
+void
+GCodeWriter::begin_fragment()
+{
+    this->_last_acceleration = 0;
+    for (auto &extruder : this->extruders)
+        extruder.second.absolute_E = 0;
+}
+
+void
+GCodeWriter::end_fragment(const GCodeWriter &fragment)
+{
+    for (auto &extruder : this->extruders) {
+        const Extruder &other { fragment.extruders.at(extruder.first) };
+        extruder.second.E               = other.E;
+        extruder.second.absolute_E     += other.absolute_E;
+        extruder.second.retracted       = other.retracted;
+        extruder.second.restart_extra   = other.restart_extra;
+    }
+    this->_extruder = fragment._extruder == NULL ? NULL : &this->extruders.find(fragment._extruder->id)->second;
+    this->_last_acceleration = fragment._last_acceleration;
+    this->_lifted = fragment._lifted;
+    this->_pos = fragment._pos;
+}
+
 }
@@ -9,6 +9,32 @@
 
 namespace Slic3r {
 
+/// Appends G-code words to a string without going through iostreams.
+/// Numbers are written in fixed notation with exactly the digits that
+/// std::fixed << std::setprecision(n) would produce, so output stays identical
+/// to the stream based writer while avoiding its locale and allocation cost.
+class GCodeFormatter {
+public:
+    explicit GCodeFormatter(std::string &out) : _out(out) {};
+
+    GCodeFormatter& operator<<(const char* s) { this->_out += s; return *this; }
+    GCodeFormatter& operator<<(const std::string &s) { this->_out += s; return *this; }
+    GCodeFormatter& operator<<(char c) { this->_out += c; return *this; }
+
+    /// A number to be written with a fixed count of decimals.
+    struct Fixed {
+        double value;
+        int precision;
+    };
+    GCodeFormatter& operator<<(const Fixed &num) { append_fixed(this->_out, num.value, num.precision); return *this; }
+
+    /// Append value formatted as std::fixed << std::setprecision(precision) would.
+    static void append_fixed(std::string &out, double value, int precision);
+
+private:
+    std::string &_out;
+};
+
 class GCodeWriter {
 public:
     GCodeConfig config;
@@ -19,6 +45,9 @@ public:
         : multiple_extruders(false), _extrusion_axis("E"), _extruder(NULL),
             _last_acceleration(0), _last_fan_speed(0), _lifted(0)
         {};
+    /// Copies have their own extruders, reading the settings of the copy.
+    GCodeWriter(const GCodeWriter &other);
+    GCodeWriter& operator=(const GCodeWriter &other);
     Extruder* extruder() const { return this->_extruder; }
     std::string extrusion_axis() const { return this->_extrusion_axis; }
     void apply_print_config(const PrintConfig &print_config);
@@ -68,6 +97,16 @@ public:
     std::string lift();
     std::string unlift();
     Pointf3 get_position() const { return this->_pos; }
+
+    /// Whether G-code written from here continues the same way as from other:
+    /// same current extruder, Z, lift and state of each extruder.
+    bool same_state(const GCodeWriter &other) const;
+    /// Start writing a fragment on a copy of this writer (see GCode::begin_fragment()):
+    /// the next acceleration is always written and the filament used counts from zero.
+    void begin_fragment();
+    /// Take over the state of fragment, a copy that continued from the state
+    /// of this writer. The fan speed is kept and the filament used adds up.
+    void end_fragment(const GCodeWriter &fragment);
 private:
     std::string _extrusion_axis;
     Extruder* _extruder;
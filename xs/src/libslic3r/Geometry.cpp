@@ -250,20 +250,16 @@ convex_hull(const Polygons &polygons)
 void
 chained_path(const Points &points, std::vector<Points::size_type> &retval, Point start_near)
 {
-    PointConstPtrs my_points;
-    std::map<const Point*,Points::size_type> indices;
-    my_points.reserve(points.size());
-    for (Points::const_iterator it = points.begin(); it != points.end(); ++it) {
-        my_points.push_back(&*it);
-        indices[&*it] = it - points.begin();
-    }
+    ChainingIndex index;
+    for (Points::const_iterator it = points.begin(); it != points.end(); ++it)
+        index.add(*it, it - points.begin());
     
     retval.reserve(points.size());
-    while (!my_points.empty()) {
-        Points::size_type idx = start_near.nearest_point_index(my_points);
-        start_near = *my_points[idx];
-        retval.push_back(indices[ my_points[idx] ]);
-        my_points.erase(my_points.begin() + idx);
+    for (size_t i = 0; i < points.size(); ++i) {
+        Points::size_type idx = index.nearest(start_near);
+        start_near = points[idx];
+        retval.push_back(idx);
+        index.remove(idx);
     }
 }
 
@@ -274,6 +270,155 @@ chained_path(const Points &points, std::vector<Points::size_type> &retval)
     chained_path(points, retval, points.front());
 }
 
+size_t
+ChainingIndex::add(const Point &point, size_t item)
+{
+    const size_t endpoint = this->_points.size();
+    this->_points.push_back(point);
+    this->_items.push_back(item);
+    if (item >= this->_item_first.size()) {
+        this->_item_first.resize(item + 1, -1);
+        this->_removed.resize(item + 1, false);
+    }
+    this->_next_of_item.push_back(this->_item_first[item]);
+    this->_item_first[item] = endpoint;
+    if (!this->_removed[item]) ++this->_alive;
+    
+    // the grid is built again on the next query
+    this->_cell_start.clear();
+    return endpoint;
+}
+
+void
+ChainingIndex::remove(size_t item)
+{
+    if (item >= this->_removed.size() || this->_removed[item]) return;
+    this->_removed[item] = true;
+    for (int e = this->_item_first[item]; e != -1; e = this->_next_of_item[e]) {
+        --this->_alive;
+        if (!this->_cell_start.empty() && this->_endpoint_cell[e] != size_t(-1))
+            --this->_cell_alive[this->_endpoint_cell[e]];
+    }
+}
+
+size_t
+ChainingIndex::_col(coord_t x) const
+{
+    if (x <= this->_origin.x) return 0;
+    return std::min<size_t>((x - this->_origin.x) / this->_cell_size, this->_cols - 1);
+}
+
+size_t
+ChainingIndex::_row(coord_t y) const
+{
+    if (y <= this->_origin.y) return 0;
+    return std::min<size_t>((y - this->_origin.y) / this->_cell_size, this->_rows - 1);
+}
+
+void
+ChainingIndex::_build()
+{
+    std::vector<size_t> endpoints;
+    endpoints.reserve(this->_alive);
+    for (size_t e = 0; e < this->_points.size(); ++e)
+        if (!this->_removed[this->_items[e]]) endpoints.push_back(e);
+    
+    BoundingBox bb;
+    for (size_t e : endpoints) bb.merge(this->_points[e]);
+    
+    // aim at two endpoints per cell, without letting a flat cloud make
+    // the grid larger than that
+    const double w = double(bb.max.x - bb.min.x) + 1, h = double(bb.max.y - bb.min.y) + 1;
+    const double target = std::max<size_t>(1, endpoints.size() / 2);
+    const double cell_size = std::max(sqrt(w * h / target), std::max(w, h) / target);
+    this->_origin    = bb.min;
+    this->_cell_size = std::max<coord_t>(1, coord_t(ceil(cell_size)));
+    this->_cols      = (bb.max.x - bb.min.x) / this->_cell_size + 1;
+    this->_rows      = (bb.max.y - bb.min.y) / this->_cell_size + 1;
+    
+    // bucket the endpoints by cell, keeping them in scan order within each cell
+    const size_t cells = this->_cols * this->_rows;
+    this->_cell_start.assign(cells + 1, 0);
+    this->_endpoint_cell.assign(this->_points.size(), size_t(-1));
+    for (size_t e : endpoints) {
+        const size_t c = this->_row(this->_points[e].y) * this->_cols + this->_col(this->_points[e].x);
+        this->_endpoint_cell[e] = c;
+        ++this->_cell_start[c + 1];
+    }
+    for (size_t c = 0; c < cells; ++c)
+        this->_cell_start[c + 1] += this->_cell_start[c];
+    this->_cell_alive.resize(cells);
+    for (size_t c = 0; c < cells; ++c)
+        this->_cell_alive[c] = this->_cell_start[c + 1] - this->_cell_start[c];
+    this->_cell_endpoints.resize(endpoints.size());
+    std::vector<size_t> fill(this->_cell_start.begin(), this->_cell_start.end() - 1);
+    for (size_t e : endpoints)
+        this->_cell_endpoints[fill[this->_endpoint_cell[e]]++] = e;
+    
+    this->_indexed = endpoints.size();
+}
+
+int
+ChainingIndex::nearest(const Point &point)
+{
+    if (this->_alive == 0) return -1;
+    
+    // rebuild when most indexed endpoints are gone, so that queries don't
+    // wander through empty cells
+    if (this->_cell_start.empty() || this->_alive * 4 < this->_indexed)
+        this->_build();
+    
+    int best = -1;
+    double best_distance = -1;
+    const auto consider = [&](size_t e) {
+        const Point &p = this->_points[e];
+        double d;
+        if (this->_ties == tiesLast) {
+            // same arithmetic as Point::nearest_point_index()
+            d = pow(point.x - p.x, 2) + pow(point.y - p.y, 2);
+        } else {
+            const double dx = double(point.x - p.x), dy = double(point.y - p.y);
+            d = dx * dx + dy * dy;
+        }
+        if (best == -1 || d < best_distance
+            || (d == best_distance && (this->_ties == tiesLast && d >= EPSILON ? (int)e > best : (int)e < best))) {
+            best = e;
+            best_distance = d;
+        }
+    };
+    const auto scan_cell = [&](size_t col, size_t row) {
+        const size_t c = row * this->_cols + col;
+        if (this->_cell_alive[c] == 0) return;
+        for (size_t i = this->_cell_start[c]; i < this->_cell_start[c + 1]; ++i) {
+            const size_t e = this->_cell_endpoints[i];
+            if (!this->_removed[this->_items[e]]) consider(e);
+        }
+    };
+    
+    /*  Scan rings of cells around the cell of point. Endpoints beyond ring r
+        are at least r * cell_size away along X or Y, so the search stops once
+        the best distance is below that: nothing further away can tie. */
+    const long cx = this->_col(point.x), cy = this->_row(point.y);
+    const long cols = this->_cols, rows = this->_rows;
+    const long max_r = std::max(std::max(cx, cols - 1 - cx), std::max(cy, rows - 1 - cy));
+    for (long r = 0; r <= max_r; ++r) {
+        for (long y = std::max(0L, cy - r); y <= std::min(rows - 1, cy + r); ++y) {
+            if (y == cy - r || y == cy + r) {
+                for (long x = std::max(0L, cx - r); x <= std::min(cols - 1, cx + r); ++x)
+                    scan_cell(x, y);
+            } else {
+                if (cx - r >= 0)   scan_cell(cx - r, y);
+                if (cx + r < cols) scan_cell(cx + r, y);
+            }
+        }
+        if (best != -1) {
+            const double reach = double(r) * this->_cell_size;
+            if (best_distance < reach * reach) break;
+        }
+    }
+    return best;
+}
+
 /* retval and items must be different containers */
 template<class T>
 void
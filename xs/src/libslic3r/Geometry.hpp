@@ -18,6 +18,62 @@ Polygon convex_hull(const Polygons &polygons);
 void chained_path(const Points &points, std::vector<Points::size_type> &retval, Point start_near);
 void chained_path(const Points &points, std::vector<Points::size_type> &retval);
 template<class T> void chained_path_items(Points &points, T &items, T &retval);
+
+/// Spatial index over the endpoints of the items left in a nearest-neighbor
+/// walk. It answers the same nearest endpoint as a linear scan over the
+/// remaining endpoints in the order they were added, but only looks at the
+/// grid cells around the query point.
+class ChainingIndex {
+    public:
+    /// How ties between equally near endpoints are resolved, matching the
+    /// linear scans this index replaces.
+    enum Ties {
+        /// As Point::nearest_point_index(): the last of the nearest endpoints,
+        /// or the first one coinciding with the query point.
+        tiesLast,
+        /// The first of the nearest endpoints.
+        tiesFirst,
+    };
+    
+    ChainingIndex(Ties ties = tiesLast) : _ties(ties), _alive(0), _indexed(0), _cell_size(1), _cols(0), _rows(0) {};
+    
+    /// Add an endpoint of item and return its id. Ids count up from 0
+    /// and give the scan order used to break ties.
+    size_t add(const Point &point, size_t item);
+    
+    /// Id of the endpoint nearest to point among the items not removed yet,
+    /// or -1 if there is none left.
+    int nearest(const Point &point);
+    
+    /// Remove all endpoints of item.
+    void remove(size_t item);
+    
+    size_t item(size_t endpoint) const { return this->_items[endpoint]; }
+    const Point& point(size_t endpoint) const { return this->_points[endpoint]; }
+    
+    private:
+    Ties _ties;
+    Points _points;
+    std::vector<size_t> _items;
+    std::vector<bool> _removed;          // per item
+    std::vector<int> _item_first;        // first endpoint of each item, -1 if none
+    std::vector<int> _next_of_item;      // next endpoint of the same item, -1 if none
+    size_t _alive, _indexed;
+    
+    // grid, with the endpoints of each cell in _cell_endpoints[_cell_start[c] .. _cell_start[c+1]-1]
+    Point _origin;
+    coord_t _cell_size;
+    size_t _cols, _rows;
+    std::vector<size_t> _cell_start;
+    std::vector<size_t> _cell_endpoints;
+    std::vector<size_t> _cell_alive;
+    std::vector<size_t> _endpoint_cell;
+    
+    void _build();
+    size_t _col(coord_t x) const;
+    size_t _row(coord_t y) const;
+};
+
 bool directions_parallel(double angle1, double angle2, double max_diff = 0);
 template<class T> bool contains(const std::vector<T> &vector, const Point &point);
 template<class T> double area(const std::vector<T> &vector);
@@ -19,12 +19,13 @@ const std::map<ExportFormat,std::string> extensions{
     {TMF, "3mf"},
     {SVG, "svg"},
     {Gcode, "gcode"},
+    {ZIP, "zip"},
 };
 
-const std::map<ExportFormat,bool(*)(const Model&,std::string)> write_model{
-    {STL, &STL::write},
-    {OBJ, &OBJ::write},
-    {POV, &POV::write},
+const std::map<ExportFormat,bool(*)(const Model&,std::string,int)> write_model{
+    {STL, [](const Model &model, std::string output_file, int) { return STL::write(model, output_file); }},
+    {OBJ, [](const Model &model, std::string output_file, int) { return OBJ::write(model, output_file); }},
+    {POV, [](const Model &model, std::string output_file, int) { return POV::write(model, output_file); }},
     {AMF, &AMF::write},
     {TMF, &TMF::write},
 };
@@ -96,33 +97,26 @@ OBJ::read(std::string input_file, Model* model)
     // TODO: encode file name
     // TODO: check that file exists
     
-    tinyobj::attrib_t attrib;
-    std::vector<tinyobj::shape_t> shapes;
-    std::vector<tinyobj::material_t> materials;
-    std::string err;
-	boost::nowide::ifstream ifs(input_file);
-    bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &err, &ifs);
-    
-    if (!err.empty()) { // `err` may contain warning message.
-        std::cerr << err << std::endl;
-    }
-    
-    if (!ret)
-        throw std::runtime_error("Error while reading OBJ file");
-    
-    ModelObject* object = model->add_object();
-    object->name        = boost::filesystem::path(input_file).filename().string();
-    object->input_file  = input_file;
-    
-    // Loop over shapes and add a volume for each one.
-    for (std::vector<tinyobj::shape_t>::const_iterator shape = shapes.begin();
-        shape != shapes.end(); ++shape) {
+    std::vector<TriangleMesh> meshes;
+    if (!OBJ::read_mapped(input_file, &meshes)) {
+        tinyobj::attrib_t attrib;
+        std::vector<tinyobj::shape_t> shapes;
+        std::vector<tinyobj::material_t> materials;
+        std::string err;
+        boost::nowide::ifstream ifs(input_file);
+        bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &err, &ifs);
         
-        Pointf3s points;
-        std::vector<Point3> facets;
+        if (!err.empty()) { // `err` may contain warning message.
+            std::cerr << err << std::endl;
+        }
+        
+        if (!ret)
+            throw std::runtime_error("Error while reading OBJ file");
         
-        // Read vertices.
+        // Read vertices, shared by all the shapes.
         assert((attrib.vertices.size() % 3) == 0);
+        Pointf3s points;
+        points.reserve(attrib.vertices.size() / 3);
         for (size_t v = 0; v < attrib.vertices.size(); v += 3) {
             points.push_back(Pointf3(
                 attrib.vertices[v],
@@ -131,20 +125,37 @@ OBJ::read(std::string input_file, Model* model)
             ));
         }
         
-        // Loop over facets of the current shape.
-        for (size_t f = 0; f < shape->mesh.num_face_vertices.size(); ++f) {
-            // tiny_obj_loader should triangulate any facet with more than 3 vertices
-            assert((shape->mesh.num_face_vertices[f] % 3) == 0);
+        // Loop over shapes and make a mesh for each one.
+        for (std::vector<tinyobj::shape_t>::const_iterator shape = shapes.begin();
+            shape != shapes.end(); ++shape) {
             
-            facets.push_back(Point3(
-                shape->mesh.indices[f*3+0].vertex_index,
-                shape->mesh.indices[f*3+1].vertex_index,
-                shape->mesh.indices[f*3+2].vertex_index
-            ));
+            std::vector<Point3> facets;
+            facets.reserve(shape->mesh.num_face_vertices.size());
+            
+            // Loop over facets of the current shape.
+            for (size_t f = 0; f < shape->mesh.num_face_vertices.size(); ++f) {
+                // tiny_obj_loader should triangulate any facet with more than 3 vertices
+                assert((shape->mesh.num_face_vertices[f] % 3) == 0);
+                
+                facets.push_back(Point3(
+                    shape->mesh.indices[f*3+0].vertex_index,
+                    shape->mesh.indices[f*3+1].vertex_index,
+                    shape->mesh.indices[f*3+2].vertex_index
+                ));
+            }
+            
+            meshes.push_back(TriangleMesh(points, facets));
         }
-        
-        TriangleMesh mesh(points, facets);
-        mesh.check_topology();
+    }
+    
+    ModelObject* object = model->add_object();
+    object->name        = boost::filesystem::path(input_file).filename().string();
+    object->input_file  = input_file;
+    
+    // Add a volume for each shape.
+    if (!meshes.empty())
+        parallelize<size_t>(0, meshes.size() - 1, [&meshes](size_t i) { meshes[i].check_topology(); });
+    for (const TriangleMesh &mesh : meshes) {
         ModelVolume* volume = object->add_volume(mesh);
         volume->name        = object->name;
     }
@@ -9,16 +9,22 @@
 
 namespace Slic3r { namespace IO {
 
-enum ExportFormat { AMF, OBJ, POV, STL, SVG, TMF, Gcode };
+enum ExportFormat { AMF, OBJ, POV, STL, SVG, TMF, Gcode, ZIP };
 
 extern const std::map<ExportFormat,std::string> extensions;
-extern const std::map<ExportFormat,bool(*)(const Model&,std::string)> write_model;
+/// Writers of the model formats, taking the number of threads to use.
+extern const std::map<ExportFormat,bool(*)(const Model&,std::string,int)> write_model;
 
 class STL
 {
     public:
     static bool read(std::string input_file, TriangleMesh* mesh);
     static bool read(std::string input_file, Model* model);
+    /// Load a binary or ASCII STL into stl by memory-mapping the file and
+    /// decoding its facets in parallel. Returns false when the file can't be
+    /// mapped or is something stl_open() has to deal with (odd sizes, header
+    /// mismatches, malformed ASCII), so that it can be read that way instead.
+    static bool read_mapped(const std::string &input_file, stl_file* stl);
     static bool write(const Model &model, std::string output_file) {
         return STL::write(model, output_file, true);
     };
@@ -31,6 +37,13 @@ class OBJ
     public:
     static bool read(std::string input_file, TriangleMesh* mesh);
     static bool read(std::string input_file, Model* model);
+    /// Load the shapes of an OBJ file into meshes, one per group or object as
+    /// tinyobj splits them, by memory-mapping the file and parsing its lines
+    /// in parallel. All the shapes index a single pool of vertices. Returns
+    /// false when the file can't be mapped or holds something left to tinyobj
+    /// (malformed lines, indices out of range, non convex polygons to
+    /// triangulate), so that it can be read that way instead.
+    static bool read_mapped(const std::string &input_file, std::vector<TriangleMesh>* meshes);
     static bool write(const Model& model, std::string output_file);
     static bool write(const TriangleMesh& mesh, std::string output_file);
 };
@@ -39,7 +52,11 @@ class AMF
 {
     public:
     static bool read(std::string input_file, Model* model);
-    static bool write(const Model& model, std::string output_file);
+    static bool write(const Model& model, std::string output_file) {
+        return AMF::write(model, output_file, boost::thread::hardware_concurrency());
+    };
+    /// Write the model, formatting its meshes on the given number of threads.
+    static bool write(const Model& model, std::string output_file, int threads);
 };
 
 class POV
@@ -53,7 +70,11 @@ class TMF
 {
     public:
     static bool read(std::string input_file, Model* model);
-    static bool write(const Model& model, std::string output_file);
+    static bool write(const Model& model, std::string output_file) {
+        return TMF::write(model, output_file, boost::thread::hardware_concurrency());
+    };
+    /// Write the model, formatting its meshes on the given number of threads.
+    static bool write(const Model& model, std::string output_file, int threads);
 };
 
 } }
@@ -1,4 +1,5 @@
 #include "../IO.hpp"
+#include "XMLWriter.hpp"
 #include <iostream>
 #include <fstream>
 #include <cstring>
@@ -521,7 +522,7 @@ AMF::read(std::string input_file, Model* model)
 }
 
 bool
-AMF::write(const Model& model, std::string output_file)
+AMF::write(const Model& model, std::string output_file, int threads)
 {
     using namespace std;
     
@@ -566,24 +567,36 @@ AMF::write(const Model& model, std::string output_file)
 
         Pointf3 origin_translation = object->origin_translation();
         
-        for (ModelVolume *volume : object->volumes) {
-            volume->mesh.require_shared_vertices();
+        // Get the shared vertices of the volumes, without altering the model.
+        std::vector<std::unique_ptr<TriangleMesh>> holders(object->volumes.size());
+        std::vector<const TriangleMesh*> meshes(object->volumes.size());
+        if (!object->volumes.empty())
+            parallelize<size_t>(0, object->volumes.size() - 1, [&](size_t i) {
+                meshes[i] = &indexed_mesh(object->volumes[i]->mesh, holders[i]);
+            }, threads);
+
+        for (const TriangleMesh *mesh : meshes) {
             vertices_offsets.push_back(num_vertices);
-            const auto &stl = volume->mesh.stl;
-            for (size_t i = 0; i < static_cast<size_t>(stl.stats.shared_vertices); ++i)
-                // Subtract origin_translation in order to restore the coordinates of the parts
-                // before they were imported. Otherwise, when this AMF file is reimported parts
-                // will be placed in the plater correctly, but we will have lost origin_translation
-                // thus any additional part added will not align with the others.
-                // In order to do this we compensate for this translation in the instance placement
-                // below.
-                file << "         <vertex>" << endl
-                     << "           <coordinates>" << endl
-                     << "             <x>" << (stl.v_shared[i].x - origin_translation.x) << "</x>" << endl
-                     << "             <y>" << (stl.v_shared[i].y - origin_translation.y) << "</y>" << endl
-                     << "             <z>" << (stl.v_shared[i].z - origin_translation.z) << "</z>" << endl
-                     << "           </coordinates>" << endl
-                     << "         </vertex>" << endl;
+            const auto &stl = mesh->stl;
+            // Subtract origin_translation in order to restore the coordinates of the parts
+            // before they were imported. Otherwise, when this AMF file is reimported parts
+            // will be placed in the plater correctly, but we will have lost origin_translation
+            // thus any additional part added will not align with the others.
+            // In order to do this we compensate for this translation in the instance placement
+            // below.
+            write_in_chunks(file, stl.stats.shared_vertices, [&stl, &origin_translation](size_t i, std::string &text) {
+                text += "         <vertex>\n"
+                        "           <coordinates>\n"
+                        "             <x>";
+                append_float(text, stl.v_shared[i].x - origin_translation.x);
+                text += "</x>\n             <y>";
+                append_float(text, stl.v_shared[i].y - origin_translation.y);
+                text += "</y>\n             <z>";
+                append_float(text, stl.v_shared[i].z - origin_translation.z);
+                text += "</z>\n"
+                        "           </coordinates>\n"
+                        "         </vertex>\n";
+            }, threads);
             
             num_vertices += stl.stats.shared_vertices;
         }
@@ -591,7 +604,8 @@ AMF::write(const Model& model, std::string output_file)
         
         for (size_t i_volume = 0; i_volume < object->volumes.size(); ++i_volume) {
             ModelVolume *volume = object->volumes[i_volume];
-            int vertices_offset = vertices_offsets[i_volume];
+            const auto &stl = meshes[i_volume]->stl;
+            const size_t vertices_offset = vertices_offsets[i_volume];
             
             if (volume->material_id().empty())
                 file << "      <volume>" << endl;
@@ -608,14 +622,19 @@ AMF::write(const Model& model, std::string output_file)
             if (volume->modifier)
                 file << "        <metadata type=\"slic3r.modifier\">1</metadata>" << endl;
             
-            for (int i = 0; i < volume->mesh.stl.stats.number_of_facets; ++i) {
-                file << "        <triangle>" << endl;
-                for (int j = 0; j < 3; ++ j)
-                    file << "          <v" << (j+1) << ">"
-                         << (volume->mesh.stl.v_indices[i].vertex[j] + vertices_offset)
-                         << "</v" << (j+1) << ">" << endl;
-                file << "        </triangle>" << endl;
-            }
+            write_in_chunks(file, stl.stats.number_of_facets, [&stl, vertices_offset](size_t i, std::string &text) {
+                text += "        <triangle>\n";
+                for (int j = 0; j < 3; ++ j) {
+                    text += "          <v";
+                    text += char('1' + j);
+                    text += '>';
+                    append_int(text, stl.v_indices[i].vertex[j] + vertices_offset);
+                    text += "</v";
+                    text += char('1' + j);
+                    text += ">\n";
+                }
+                text += "        </triangle>\n";
+            }, threads);
             file << "      </volume>" << endl;
         }
         file << "    </mesh>" << endl;
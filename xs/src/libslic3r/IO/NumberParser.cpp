@@ -0,0 +1,79 @@
+#include "NumberParser.hpp"
+#include <cfloat>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+namespace Slic3r { namespace IO {
+
+bool
+parse_float(const char* &p, const char* end, float* out)
+{
+    static const double pow10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+    const char* q = p;
+    const bool negative = q != end && *q == '-';
+    if (q != end && (*q == '-' || *q == '+')) ++q;
+
+    uint64_t mantissa = 0;
+    int exponent = 0;
+    bool digits = false, exact = true;
+    for (; q != end && is_digit(*q); ++q) {
+        digits = true;
+        if (mantissa < 10000000000000000ull) mantissa = mantissa * 10 + (*q - '0');
+        else { ++exponent; exact = exact && *q == '0'; }
+    }
+    if (q != end && *q == '.') {
+        for (++q; q != end && is_digit(*q); ++q) {
+            digits = true;
+            if (mantissa < 10000000000000000ull) { mantissa = mantissa * 10 + (*q - '0'); --exponent; }
+            else exact = exact && *q == '0';
+        }
+    }
+    if (digits && q != end && (*q == 'e' || *q == 'E')) {
+        ++q;
+        const bool negative_exp = q != end && *q == '-';
+        if (q != end && (*q == '-' || *q == '+')) ++q;
+        int e = 0;
+        bool exp_digits = false;
+        for (; q != end && is_digit(*q); ++q) {
+            exp_digits = true;
+            if (e < 10000) e = e * 10 + (*q - '0');
+        }
+        if (!exp_digits) exact = false;
+        exponent += negative_exp ? -e : e;
+    }
+
+    if (digits && exact && (q == end || is_space(*q))
+        && mantissa <= (uint64_t(1) << 53) && exponent >= -22 && exponent <= 22) {
+        double d = exponent < 0 ? double(mantissa) / pow10[-exponent] : double(mantissa) * pow10[exponent];
+        // a double halfway between two normal floats has exactly the top bit
+        // set in the 29 mantissa bits that float drops
+        uint64_t bits;
+        memcpy(&bits, &d, sizeof(bits));
+        const bool tie = (bits & 0x1FFFFFFF) == 0x10000000;
+        if (!tie && (d == 0 || (d >= FLT_MIN && d <= FLT_MAX))) {
+            const float f = float(d);
+            *out = negative ? -f : f;
+            p = q;
+            return true;
+        }
+    }
+
+    // strtof() needs a terminated string
+    const char* token_end = p;
+    while (token_end != end && !is_space(*token_end)) ++token_end;
+    char buf[128];
+    const size_t len = token_end - p;
+    if (len == 0 || len >= sizeof(buf)) return false;
+    memcpy(buf, p, len);
+    buf[len] = '\0';
+    char* parsed_end;
+    *out = strtof(buf, &parsed_end);
+    if (parsed_end != buf + len) return false;
+    p = token_end;
+    return true;
+}
+
+} }
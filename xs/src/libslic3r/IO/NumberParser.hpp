@@ -0,0 +1,32 @@
+#ifndef slic3r_IO_NumberParser_hpp_
+#define slic3r_IO_NumberParser_hpp_
+
+namespace Slic3r { namespace IO {
+
+/// Helpers shared by the text readers (ASCII STL, OBJ) parsing memory-mapped files.
+
+inline bool
+is_space(char c)
+{
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\f' || c == '\v';
+}
+
+inline bool
+is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+/// Parse the number at p like strtof() does (and so fscanf("%f") in stl_read),
+/// leaving p after it. The number has to be followed by whitespace or the end
+/// of the buffer.
+/// Decimals with up to 17 significant digits and a small exponent are exact in
+/// a double and the division/multiplication by a power of ten is correctly
+/// rounded; the only way the conversion to float could then differ from
+/// strtof() is a double sitting exactly between two floats, and that case, as
+/// well as anything unusual (nan, inf, hex, huge exponents), goes to strtof().
+bool parse_float(const char* &p, const char* end, float* out);
+
+} }
+
+#endif
@@ -0,0 +1,255 @@
+#include "../IO.hpp"
+#include "NumberParser.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+namespace Slic3r { namespace IO {
+
+namespace {
+
+/// Bytes parsed by a single task.
+const size_t chunk_bytes = 1 << 22;
+
+/// What a task collects from its run of lines.
+struct ObjRun {
+    std::vector<float> vertices;    ///< x, y, z of the vertices defined in the run
+    std::vector<int> indices;       ///< vertices of the faces, 0-based
+    std::vector<size_t> faces;      ///< position in indices of the first vertex of each face
+    std::vector<size_t> relative;   ///< positions in indices of the negative (relative) references,
+                                    ///< counted from the first vertex of the run
+    std::vector<size_t> groups;     ///< number of faces of the run before each "g" or "o" line
+};
+
+inline bool
+is_blank(char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+/// Parse a vertex reference of a face ("v", "v/vt", "v//vn" or "v/vt/vn"),
+/// keeping the vertex index and leaving p after the reference.
+bool
+parse_reference(const char* &p, const char* end, long* out)
+{
+    const bool negative = p != end && *p == '-';
+    if (negative) ++p;
+    if (p == end || !is_digit(*p)) return false;
+    long value = 0;
+    for (; p != end && is_digit(*p); ++p) {
+        if (value > std::numeric_limits<int>::max()) return false;
+        value = value * 10 + (*p - '0');
+    }
+    *out = negative ? -value : value;
+    // texture and normal indices aren't used
+    for (; p != end && !is_blank(*p); ++p)
+        if (*p != '/' && *p != '-' && !is_digit(*p)) return false;
+    return true;
+}
+
+/// Parse the line [p, end) into run, with tinyobj's interpretation of the
+/// lines we care about; anything else is ignored like tinyobj does.
+bool
+parse_line(const char* p, const char* end, ObjRun &run)
+{
+    while (p != end && is_blank(*p)) ++p;
+    if (end - p < 2 || !is_blank(p[1])) return true;
+    if (p[0] == 'v') {
+        float coords[3];
+        p += 2;
+        for (int i = 0; i < 3; ++i) {
+            while (p != end && is_blank(*p)) ++p;
+            if (!parse_float(p, end, coords + i)) return false;
+        }
+        // a w coordinate or a color may follow
+        run.vertices.insert(run.vertices.end(), coords, coords + 3);
+    } else if (p[0] == 'f') {
+        const long vertices = long(run.vertices.size() / 3);
+        run.faces.push_back(run.indices.size());
+        for (p += 2; ; ) {
+            while (p != end && is_blank(*p)) ++p;
+            if (p == end) break;
+            long index;
+            if (!parse_reference(p, end, &index) || index == 0) return false;
+            if (index < 0) {
+                run.relative.push_back(run.indices.size());
+                index += vertices;
+            } else {
+                --index;
+            }
+            run.indices.push_back(int(index));
+        }
+    } else if (p[0] == 'g' || p[0] == 'o') {
+        run.groups.push_back(run.faces.size());
+    }
+    return true;
+}
+
+/// Whether the polygon turns the same way at each of its vertices and goes
+/// around once, i.e. whether the ear clipping of tinyobj would give the fan
+/// around its first vertex. A pentagram turns the same way everywhere but
+/// winds twice, so the turning angles have to add up to a single turn.
+bool
+is_convex(const Pointf3s &vertices, const int* polygon, size_t n)
+{
+    // normal of the polygon, by Newell's method
+    double nx = 0, ny = 0, nz = 0;
+    for (size_t k = 0; k < n; ++k) {
+        const Pointf3 &a = vertices[polygon[k]];
+        const Pointf3 &b = vertices[polygon[(k + 1) % n]];
+        nx += (a.y - b.y) * (a.z + b.z);
+        ny += (a.z - b.z) * (a.x + b.x);
+        nz += (a.x - b.x) * (a.y + b.y);
+    }
+    const double norm = std::sqrt(nx * nx + ny * ny + nz * nz);
+    if (norm == 0) return false;
+    double total = 0;
+    for (size_t k = 0; k < n; ++k) {
+        const Pointf3 &a = vertices[polygon[k]];
+        const Pointf3 &b = vertices[polygon[(k + 1) % n]];
+        const Pointf3 &c = vertices[polygon[(k + 2) % n]];
+        const double e0x = b.x - a.x, e0y = b.y - a.y, e0z = b.z - a.z;
+        const double e1x = c.x - b.x, e1y = c.y - b.y, e1z = c.z - b.z;
+        const double turn = (e0y * e1z - e0z * e1y) * nx + (e0z * e1x - e0x * e1z) * ny + (e0x * e1y - e0y * e1x) * nz;
+        if (turn < 0) return false;
+        total += std::atan2(turn / norm, e0x * e1x + e0y * e1y + e0z * e1z);
+    }
+    // a simple polygon turns by 2*PI, a star by a multiple of it
+    return total > PI && total < 3 * PI;
+}
+
+}
+
+bool
+OBJ::read_mapped(const std::string &input_file, std::vector<TriangleMesh>* meshes)
+{
+    namespace bip = boost::interprocess;
+
+    bip::mapped_region region;
+    try {
+        bip::file_mapping mapping(input_file.c_str(), bip::read_only);
+        bip::mapped_region(mapping, bip::read_only).swap(region);
+    } catch (const bip::interprocess_exception &) {
+        return false;
+    }
+    const char* data = static_cast<const char*>(region.get_address());
+    const char* end = data + region.get_size();
+
+    // runs of whole lines
+    std::vector<const char*> run_starts { data };
+    for (size_t offset = chunk_bytes; offset < region.get_size(); offset += chunk_bytes) {
+        if (data + offset <= run_starts.back()) continue;
+        const char* eol = static_cast<const char*>(memchr(data + offset, '\n', end - data - offset));
+        if (eol == nullptr) break;
+        run_starts.push_back(eol + 1);
+    }
+    run_starts.push_back(end);
+
+    std::vector<ObjRun> runs(run_starts.size() - 1);
+    std::atomic<bool> failed(false);
+    parallelize<size_t>(
+        0,
+        runs.size() - 1,
+        [&runs, &run_starts, &failed](size_t r) {
+            const char* p = run_starts[r];
+            const char* run_end = run_starts[r+1];
+            while (p < run_end && !failed) {
+                const char* eol = static_cast<const char*>(memchr(p, '\n', run_end - p));
+                if (eol == nullptr) eol = run_end;
+                const char* line_end = eol;
+                if (line_end != p && line_end[-1] == '\r') --line_end;
+                if (!parse_line(p, line_end, runs[r])) {
+                    failed = true;
+                    return;
+                }
+                p = eol + 1;
+            }
+        }
+    );
+    if (failed) return false;
+
+    // where the vertices, indices and faces of each run go
+    std::vector<size_t> vertex_offsets(runs.size() + 1, 0), index_offsets(runs.size() + 1, 0), face_offsets(runs.size() + 1, 0);
+    for (size_t r = 0; r < runs.size(); ++r) {
+        vertex_offsets[r+1] = vertex_offsets[r] + runs[r].vertices.size() / 3;
+        index_offsets[r+1]  = index_offsets[r]  + runs[r].indices.size();
+        face_offsets[r+1]   = face_offsets[r]   + runs[r].faces.size();
+    }
+    const size_t vertices_count = vertex_offsets.back();
+    if (vertices_count > (size_t)std::numeric_limits<int>::max()) return false;
+
+    // a single pool of vertices and indices for all the shapes
+    Pointf3s vertices(vertices_count);
+    std::vector<int> indices(index_offsets.back());
+    std::vector<size_t> faces(face_offsets.back() + 1, indices.size());
+    parallelize<size_t>(
+        0,
+        runs.size() - 1,
+        [&](size_t r) {
+            ObjRun &run = runs[r];
+            for (size_t i = 0; i < run.vertices.size() / 3; ++i)
+                vertices[vertex_offsets[r] + i] = Pointf3(run.vertices[3*i], run.vertices[3*i+1], run.vertices[3*i+2]);
+            for (size_t pos : run.relative)
+                run.indices[pos] += int(vertex_offsets[r]);
+            for (size_t i = 0; i < run.indices.size(); ++i) {
+                // tinyobj and the TriangleMesh constructor deal with what is out of range their own way
+                if (run.indices[i] < 0 || size_t(run.indices[i]) >= vertices_count) failed = true;
+                indices[index_offsets[r] + i] = run.indices[i];
+            }
+            for (size_t i = 0; i < run.faces.size(); ++i)
+                faces[face_offsets[r] + i] = index_offsets[r] + run.faces[i];
+            // only the groups are still needed
+            std::vector<float>().swap(run.vertices);
+            std::vector<int>().swap(run.indices);
+            std::vector<size_t>().swap(run.faces);
+        }
+    );
+    if (failed) return false;
+    if (faces.size() == 1) return true;
+
+    // the shapes start at the beginning and at each group (or object) line
+    // preceded by faces, and each shape ends where the next one starts
+    std::vector<size_t> shape_starts { 0 };
+    for (size_t r = 0; r < runs.size(); ++r)
+        for (size_t group : runs[r].groups)
+            if (face_offsets[r] + group > shape_starts.back())
+                shape_starts.push_back(face_offsets[r] + group);
+    if (shape_starts.back() < face_offsets.back())
+        shape_starts.push_back(face_offsets.back());
+
+    meshes->assign(shape_starts.size() - 1, TriangleMesh());
+    parallelize<size_t>(
+        0,
+        meshes->size() - 1,
+        [&](size_t s) {
+            std::vector<Point3> facets;
+            facets.reserve(shape_starts[s+1] - shape_starts[s]);
+            for (size_t f = shape_starts[s]; f < shape_starts[s+1] && !failed; ++f) {
+                const int* polygon = indices.data() + faces[f];
+                const size_t n = faces[f+1] - faces[f];
+                // like tinyobj, skip faces with less than 3 vertices
+                if (n < 3) continue;
+                if (n > 3 && !is_convex(vertices, polygon, n)) {
+                    failed = true;
+                    return;
+                }
+                for (size_t k = 2; k < n; ++k)
+                    facets.push_back(Point3(polygon[0], polygon[k-1], polygon[k]));
+            }
+            (*meshes)[s] = TriangleMesh(vertices, facets);
+        }
+    );
+    if (failed) {
+        meshes->clear();
+        return false;
+    }
+    return true;
+}
+
+} }
@@ -0,0 +1,281 @@
+#include "../IO.hpp"
+#include "NumberParser.hpp"
+#include <admesh/portable_endian.h>
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+namespace Slic3r { namespace IO {
+
+namespace {
+
+/// Facets decoded by a single task when reading a binary file.
+const size_t binary_chunk_facets = 1 << 16;
+/// Bytes parsed by a single task when reading an ASCII file.
+const size_t ascii_chunk_bytes = 1 << 22;
+
+/// Skip whitespace and match keyword, as the " keyword" directives of
+/// fscanf() in stl_read do.
+bool
+match(const char* &p, const char* end, const char* keyword)
+{
+    while (p != end && is_space(*p)) ++p;
+    for (; *keyword != '\0'; ++keyword, ++p)
+        if (p == end || *p != *keyword) return false;
+    return true;
+}
+
+/// Position of the next "facet" keyword at or after p, or end.
+const char*
+next_facet(const char* p, const char* begin, const char* end)
+{
+    static const char keyword[] = "facet";
+    const size_t len = sizeof(keyword) - 1;
+    while (end - p >= (ptrdiff_t)len) {
+        p = static_cast<const char*>(memchr(p, 'f', end - p - len + 1));
+        if (p == nullptr) return end;
+        if (memcmp(p, keyword, len) == 0
+            && (p == begin || is_space(p[-1]))
+            && (p + len == end || is_space(p[len])))
+            return p;
+        ++p;
+    }
+    return end;
+}
+
+/// Parse one facet starting at its "facet" keyword.
+bool
+parse_ascii_facet(const char* &p, const char* end, stl_facet* facet)
+{
+    if (!match(p, end, "facet") || !match(p, end, "normal")) return false;
+    float* coords = &facet->normal.x;
+    for (int i = 0; i < 3; ++i) {
+        while (p != end && is_space(*p)) ++p;
+        if (!parse_float(p, end, coords + i)) return false;
+    }
+    if (!match(p, end, "outer") || !match(p, end, "loop")) return false;
+    for (int v = 0; v < 3; ++v) {
+        if (!match(p, end, "vertex")) return false;
+        coords = &facet->vertex[v].x;
+        for (int i = 0; i < 3; ++i) {
+            while (p != end && is_space(*p)) ++p;
+            if (!parse_float(p, end, coords + i)) return false;
+        }
+    }
+    return match(p, end, "endloop") && match(p, end, "endfacet");
+}
+
+/// Bounds of a run of facets, computed like stl_facet_stats() does.
+struct FacetStats {
+    stl_vertex min, max;
+
+    void init(const stl_facet &facet) { this->min = this->max = facet.vertex[0]; }
+    void add(const stl_facet &facet) {
+        for (int v = 0; v < 3; ++v) {
+            this->max.x = STL_MAX(this->max.x, facet.vertex[v].x);
+            this->min.x = STL_MIN(this->min.x, facet.vertex[v].x);
+            this->max.y = STL_MAX(this->max.y, facet.vertex[v].y);
+            this->min.y = STL_MIN(this->min.y, facet.vertex[v].y);
+            this->max.z = STL_MAX(this->max.z, facet.vertex[v].z);
+            this->min.z = STL_MIN(this->min.z, facet.vertex[v].z);
+        }
+    }
+};
+
+/// Turn negative zeros into positive ones (as stl_read does, so that
+/// equal vertices compare equal with memcmp) and collect the bounds of
+/// facets [first, last).
+FacetStats
+finish_facets(stl_facet* facets, size_t first, size_t last)
+{
+    FacetStats stats;
+    for (size_t i = first; i < last; ++i) {
+        uint32_t* f = reinterpret_cast<uint32_t*>(facets + i);
+        for (int j = 0; j < 12; ++j, ++f)
+            if (*f == 0x80000000) *f = 0;
+        if (i == first) stats.init(facets[i]);
+        stats.add(facets[i]);
+    }
+    return stats;
+}
+
+}
+
+bool
+STL::read_mapped(const std::string &input_file, stl_file* stl)
+{
+    namespace bip = boost::interprocess;
+
+    bip::mapped_region region;
+    try {
+        bip::file_mapping mapping(input_file.c_str(), bip::read_only);
+        bip::mapped_region(mapping, bip::read_only).swap(region);
+    } catch (const bip::interprocess_exception &) {
+        return false;
+    }
+    const char* data = static_cast<const char*>(region.get_address());
+    const size_t size = region.get_size();
+
+    // same binary/ASCII test as stl_count_facets(); files too short for it
+    // are left to stl_open() to report
+    const size_t probe = 128;
+    if (size < HEADER_SIZE + probe) return false;
+    stl_type type = ascii;
+    for (size_t i = HEADER_SIZE; i < HEADER_SIZE + probe; ++i)
+        if ((unsigned char)data[i] > 127) { type = binary; break; }
+
+    // number of facets and, for ASCII files, where the runs parsed in parallel start
+    size_t facets_count = 0;
+    std::vector<const char*> run_starts;
+    std::vector<size_t> run_offsets;
+    if (type == binary) {
+        if ((size - HEADER_SIZE) % SIZEOF_STL_FACET != 0 || size < STL_MIN_FILE_SIZE) return false;
+        facets_count = (size - HEADER_SIZE) / SIZEOF_STL_FACET;
+        uint32_t header_num_facets;
+        memcpy(&header_num_facets, data + LABEL_SIZE, sizeof(header_num_facets));
+        // let stl_open() warn about (or reject) a mismatching header
+        if (le32toh(header_num_facets) != facets_count) return false;
+    } else {
+        const char* end = data + size;
+        for (size_t offset = 0; offset < size; offset += ascii_chunk_bytes) {
+            const char* start = next_facet(std::max(data + offset, run_starts.empty() ? data : run_starts.back() + 1), data, end);
+            if (start == end) break;
+            if (run_starts.empty() || start != run_starts.back()) run_starts.push_back(start);
+        }
+        if (run_starts.empty()) return false;
+        run_starts.push_back(end);
+        run_offsets.assign(run_starts.size(), 0);
+        parallelize<size_t>(
+            0,
+            run_starts.size() - 2,
+            [&run_starts, &run_offsets, data, end](size_t run) {
+                size_t count = 0;
+                for (const char* p = run_starts[run]; (p = next_facet(p, data, end)) < run_starts[run+1]; ++p)
+                    ++count;
+                run_offsets[run+1] = count;
+            }
+        );
+        for (size_t run = 1; run < run_offsets.size(); ++run)
+            run_offsets[run] += run_offsets[run-1];
+        facets_count = run_offsets.back();
+    }
+    if (facets_count == 0 || facets_count > (size_t)std::numeric_limits<int>::max()) return false;
+
+    stl_initialize(stl);
+    stl->stats.type = type;
+    stl->stats.number_of_facets = (int)facets_count;
+    stl->stats.original_num_facets = stl->stats.number_of_facets;
+    stl_allocate(stl);
+    if (stl->facet_start == NULL || stl->neighbors_start == NULL) {
+        stl->error = 1;
+        return true;
+    }
+    stl_facet* facets = stl->facet_start;
+
+    std::vector<FacetStats> run_stats;
+    std::atomic<bool> failed(false);
+    if (type == binary) {
+        memcpy(stl->stats.header, data, LABEL_SIZE);
+        stl->stats.header[LABEL_SIZE] = '\0';
+
+        const size_t runs = (facets_count + binary_chunk_facets - 1) / binary_chunk_facets;
+        run_stats.resize(runs);
+        parallelize<size_t>(
+            0,
+            runs - 1,
+            [facets, facets_count, data, &run_stats](size_t run) {
+                const size_t first = run * binary_chunk_facets;
+                const size_t last  = std::min(facets_count, first + binary_chunk_facets);
+                const char* src = data + HEADER_SIZE + first * SIZEOF_STL_FACET;
+                for (size_t i = first; i < last; ++i, src += SIZEOF_STL_FACET) {
+                    uint32_t* dst = reinterpret_cast<uint32_t*>(facets + i);
+                    for (int j = 0; j < 12; ++j) {
+                        uint32_t word;
+                        memcpy(&word, src + j * sizeof(float), sizeof(word));
+                        dst[j] = le32toh(word);
+                    }
+                    memcpy(facets[i].extra, src + 12 * sizeof(float), sizeof(stl_extra));
+                }
+                run_stats[run] = finish_facets(facets, first, last);
+            }
+        );
+    } else {
+        // the header is the first line, as stl_count_facets() reads it
+        size_t i = 0;
+        for (; i < LABEL_SIZE && i < size && data[i] != '\n'; ++i)
+            stl->stats.header[i] = data[i];
+        stl->stats.header[i] = '\0';
+        stl->stats.header[LABEL_SIZE] = '\0';
+
+        const char* end = data + size;
+        run_stats.resize(run_starts.size() - 1);
+        parallelize<size_t>(
+            0,
+            run_stats.size() - 1,
+            [facets, &run_starts, &run_offsets, &run_stats, &failed, data, end](size_t run) {
+                size_t idx = run_offsets[run];
+                const char* p = run_starts[run];
+                for (; idx < run_offsets[run+1]; ++idx) {
+                    p = next_facet(p, data, end);
+                    if (failed || !parse_ascii_facet(p, end, facets + idx)) {
+                        failed = true;
+                        return;
+                    }
+                }
+                if (run_offsets[run+1] > run_offsets[run])
+                    run_stats[run] = finish_facets(facets, run_offsets[run], run_offsets[run+1]);
+            }
+        );
+        if (failed) {
+            // leave malformed files to stl_open() and its error reporting
+            stl_close(stl);
+            return false;
+        }
+        // drop the runs that contain no facet
+        std::vector<FacetStats> stats;
+        for (size_t run = 0; run < run_stats.size(); ++run)
+            if (run_offsets[run+1] > run_offsets[run]) stats.push_back(run_stats[run]);
+        run_stats.swap(stats);
+    }
+
+    // merge the bounds in facet order, like the serial pass of stl_read()
+    stl_stats &st = stl->stats;
+    st.min = run_stats.front().min;
+    st.max = run_stats.front().max;
+    for (const FacetStats &rs : run_stats) {
+        st.max.x = STL_MAX(st.max.x, rs.max.x);
+        st.min.x = STL_MIN(st.min.x, rs.min.x);
+        st.max.y = STL_MAX(st.max.y, rs.max.y);
+        st.min.y = STL_MIN(st.min.y, rs.min.y);
+        st.max.z = STL_MAX(st.max.z, rs.max.z);
+        st.min.z = STL_MIN(st.min.z, rs.min.z);
+    }
+    {
+        const stl_facet &facet = facets[0];
+        float diff_x = ABS(facet.vertex[0].x - facet.vertex[1].x);
+        float diff_y = ABS(facet.vertex[0].y - facet.vertex[1].y);
+        float diff_z = ABS(facet.vertex[0].z - facet.vertex[1].z);
+        st.shortest_edge = STL_MAX(diff_z, STL_MAX(diff_x, diff_y));
+    }
+    st.size.x = st.max.x - st.min.x;
+    st.size.y = st.max.y - st.min.y;
+    st.size.z = st.max.z - st.min.z;
+    st.bounding_diameter = ::sqrt(
+        st.size.x * st.size.x +
+        st.size.y * st.size.y +
+        st.size.z * st.size.z
+    );
+    stl->fp = NULL;
+    return true;
+}
+
+} }
@@ -1,112 +1,77 @@
 #include "TMF.hpp"
+#include "XMLWriter.hpp"
 
 namespace Slic3r { namespace IO {
 
 bool
 TMFEditor::write_types()
 {
-    // Create a new .[Content_Types].xml file to add to the zip file later.
-    boost::nowide::ofstream fout(".[Content_Types].xml", std::ios::out | std::ios::trunc);
-    if(!fout.is_open())
-        return false;
-
-    // Write 3MF Types.
-    fout << "<?xml version=\"1.0\" encoding=\"UTF-8\"?> \n";
-    fout << "<Types xmlns=\"" << namespaces.at("content_types") << "\">\n";
-    fout << "<Default Extension=\"rels\" ContentType=\"application/vnd.openxmlformats-package.relationships+xml\"/>\n";
-    fout << "<Default Extension=\"model\" ContentType=\"application/vnd.ms-package.3dmanufacturing-3dmodel+xml\"/>\n";
-    fout << "</Types>\n";
-    fout.close();
-
     // Create [Content_Types].xml in the zip archive.
-    if(!zip_archive->add_entry("[Content_Types].xml", ".[Content_Types].xml"))
-        return false;
-
-    // Remove the created .[Content_Types].xml file.
-    if (remove(".[Content_Types].xml") != 0)
-        return false;
-
-    return true;
+    return zip_archive->add_entry("[Content_Types].xml", [this](std::ostream& fout) {
+        // Write 3MF Types.
+        fout << "<?xml version=\"1.0\" encoding=\"UTF-8\"?> \n";
+        fout << "<Types xmlns=\"" << namespaces.at("content_types") << "\">\n";
+        fout << "<Default Extension=\"rels\" ContentType=\"application/vnd.openxmlformats-package.relationships+xml\"/>\n";
+        fout << "<Default Extension=\"model\" ContentType=\"application/vnd.ms-package.3dmanufacturing-3dmodel+xml\"/>\n";
+        fout << "</Types>\n";
+        return true;
+    });
 }
 
 bool
 TMFEditor::write_relationships()
 {
-    // Create a new .rels file to add to the zip file later.
-    boost::nowide::ofstream fout(".rels", std::ios::out | std::ios::trunc);
-    if(!fout.is_open())
-        return false;
-
-    // Write the primary 3dmodel relationship.
-    fout << "<?xml version=\"1.0\" encoding=\"UTF-8\"?> \n"
-                          << "<Relationships xmlns=\"" << namespaces.at("relationships") <<
-                  "\">\n<Relationship Id=\"rel0\" Target=\"/3D/3dmodel.model\" Type=\"http://schemas.microsoft.com/3dmanufacturing/2013/01/3dmodel\" /></Relationships>\n";
-    fout.close();
-
     // Create .rels in "_rels" folder in the zip archive.
-    if(!zip_archive->add_entry("_rels/.rels", ".rels"))
-        return false;
-
-    // Remove the created .rels file.
-    if (remove(".rels") != 0)
-        return false;
-
-    return true;
+    return zip_archive->add_entry("_rels/.rels", [this](std::ostream& fout) {
+        // Write the primary 3dmodel relationship.
+        fout << "<?xml version=\"1.0\" encoding=\"UTF-8\"?> \n"
+                              << "<Relationships xmlns=\"" << namespaces.at("relationships") <<
+                      "\">\n<Relationship Id=\"rel0\" Target=\"/3D/3dmodel.model\" Type=\"http://schemas.microsoft.com/3dmanufacturing/2013/01/3dmodel\" /></Relationships>\n";
+        return true;
+    });
 }
 
 bool
 TMFEditor::write_model()
 {
-    // Create a new .3dmodel.model file to add to the zip file later.
-    boost::nowide::ofstream fout(".3dmodel.model", std::ios::out | std::ios::trunc);
-    if(!fout.is_open())
-        return false;
-
-    // Add the XML document header.
-    fout << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
+    // Create 3dmodel.model in "3D" folder in the zip archive, deflating it while it's written.
+    return zip_archive->add_entry("3D/3dmodel.model", [this](std::ostream& fout) {
+        // Add the XML document header.
+        fout << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
 
-    // Write the model element. Append any necessary namespaces.
-    fout << "<model unit=\"millimeter\" xml:lang=\"en-US\"";
-    fout << " xmlns=\"" << namespaces.at("3mf") << "\"";
-    fout << " xmlns:slic3r=\"" << namespaces.at("slic3r") << "\"> \n";
+        // Write the model element. Append any necessary namespaces.
+        fout << "<model unit=\"millimeter\" xml:lang=\"en-US\"";
+        fout << " xmlns=\"" << namespaces.at("3mf") << "\"";
+        fout << " xmlns:slic3r=\"" << namespaces.at("slic3r") << "\"> \n";
 
-    // Write metadata.
-    write_metadata(fout);
+        // Write metadata.
+        write_metadata(fout);
 
-    // Write resources.
-    fout << "    <resources> \n";
+        // Write resources.
+        fout << "    <resources> \n";
 
-    // Write Object
-    int object_index = 0;
-    for(const auto object : model->objects)
-        write_object(fout, object, object_index++);
+        // Write Object
+        int object_index = 0;
+        for(const auto object : output_model->objects)
+            write_object(fout, object, object_index++);
 
-    // Close resources
-    fout << "    </resources> \n";
+        // Close resources
+        fout << "    </resources> \n";
 
-    // Write build element.
-    write_build(fout);
+        // Write build element.
+        write_build(fout);
 
-    // Close the model element.
-    fout << "</model>\n";
-    fout.close();
-
-    // Create .3dmodel.model in "3D" folder in the zip archive.
-    if(!zip_archive->add_entry("3D/3dmodel.model", ".3dmodel.model"))
-        return false;
-
-    // Remove the created .rels file.
-    if (remove(".3dmodel.model") != 0)
-        return false;
-
-    return true;
+        // Close the model element.
+        fout << "</model>\n";
+        return true;
+    });
 }
 
 bool
-TMFEditor::write_metadata(boost::nowide::ofstream& fout)
+TMFEditor::write_metadata(std::ostream& fout)
 {
     // Write the model metadata.
-    for (const auto metadata : model->metadata){
+    for (const auto &metadata : output_model->metadata){
         fout << "    <metadata name=\"" << metadata.first << "\">" << metadata.second << "</metadata>\n";
     }
 
@@ -117,7 +82,7 @@ TMFEditor::write_metadata(boost::nowide::ofstream& fout)
 }
 
 bool
-TMFEditor::write_object(boost::nowide::ofstream& fout, const ModelObject* object, int index)
+TMFEditor::write_object(std::ostream& fout, const ModelObject* object, int index)
 {
     // Create the new object element.
     fout << "        <object id=\"" << (index + object_id) << "\" type=\"model\"";
@@ -146,26 +111,33 @@ TMFEditor::write_object(boost::nowide::ofstream& fout, const ModelObject* object
 
     Pointf3 origin_translation = object->origin_translation();
 
-    for (const auto volume : object->volumes){
-        // Require mesh vertices.
-        volume->mesh.require_shared_vertices();
+    // Get the shared vertices of the volumes, without altering the model.
+    std::vector<std::unique_ptr<TriangleMesh>> holders(object->volumes.size());
+    std::vector<const TriangleMesh*> meshes(object->volumes.size());
+    if (!object->volumes.empty())
+        parallelize<size_t>(0, object->volumes.size() - 1, [&](size_t i) {
+            meshes[i] = &indexed_mesh(object->volumes[i]->mesh, holders[i]);
+        }, this->threads);
 
+    for (const auto mesh : meshes){
         vertices_offsets.push_back(num_vertices);
-        const auto &stl = volume->mesh.stl;
-        for (int i = 0; i < stl.stats.shared_vertices; ++i)
-        {
-
-            // Subtract origin_translation in order to restore the coordinates of the parts
-            // before they were imported. Otherwise, when this 3MF file is reimported parts
-            // will be placed in the platter correctly, but we will have lost origin_translation
-            // thus any additional part added will not align with the others.
-            // In order to do this we compensate for this translation in the instance placement
-            // below.
-            fout << "                    <vertex";
-            fout << " x=\"" << (stl.v_shared[i].x - origin_translation.x) << "\"";
-            fout << " y=\"" << (stl.v_shared[i].y - origin_translation.y) << "\"";
-            fout << " z=\"" << (stl.v_shared[i].z - origin_translation.z) << "\"/>\n";
-        }
+        const auto &stl = mesh->stl;
+
+        // Subtract origin_translation in order to restore the coordinates of the parts
+        // before they were imported. Otherwise, when this 3MF file is reimported parts
+        // will be placed in the platter correctly, but we will have lost origin_translation
+        // thus any additional part added will not align with the others.
+        // In order to do this we compensate for this translation in the instance placement
+        // below.
+        write_in_chunks(fout, stl.stats.shared_vertices, [&stl, &origin_translation](size_t i, std::string& text) {
+            text += "                    <vertex x=\"";
+            append_float(text, stl.v_shared[i].x - origin_translation.x);
+            text += "\" y=\"";
+            append_float(text, stl.v_shared[i].y - origin_translation.y);
+            text += "\" z=\"";
+            append_float(text, stl.v_shared[i].z - origin_translation.z);
+            text += "\"/>\n";
+        }, this->threads);
         num_vertices += stl.stats.shared_vertices;
     }
 
@@ -180,19 +152,21 @@ TMFEditor::write_object(boost::nowide::ofstream& fout, const ModelObject* object
     int num_triangles = 0;
     int i_volume = 0;
 
-    for (const auto volume : object->volumes) {
-        int vertices_offset = vertices_offsets[i_volume];
+    for (const auto mesh : meshes) {
+        const int vertices_offset = vertices_offsets[i_volume];
+        const auto &stl = mesh->stl;
         triangles_offsets.push_back(num_triangles);
 
         // Add the volume triangles to the triangles list.
-        for (int i = 0; i < volume->mesh.stl.stats.number_of_facets; ++i){
-            fout << "                    <triangle";
+        write_in_chunks(fout, stl.stats.number_of_facets, [&stl, vertices_offset](size_t i, std::string& text) {
+            text += "                    <triangle";
             for (int j = 0; j < 3; j++){
-                fout << " v" << (j+1) << "=\"" << (volume->mesh.stl.v_indices[i].vertex[j] + vertices_offset) << "\"";
+                text += j == 0 ? " v1=\"" : (j == 1 ? "\" v2=\"" : "\" v3=\"");
+                append_int(text, stl.v_indices[i].vertex[j] + vertices_offset);
             }
-            fout << "/>\n";
-            num_triangles++;
-        }
+            text += "\"/>\n";
+        }, this->threads);
+        num_triangles += stl.stats.number_of_facets;
         i_volume++;
     }
     triangles_offsets.push_back(num_triangles);
@@ -236,14 +210,14 @@ TMFEditor::write_object(boost::nowide::ofstream& fout, const ModelObject* object
 }
 
 bool
-TMFEditor::write_build(boost::nowide::ofstream& fout)
+TMFEditor::write_build(std::ostream& fout)
 {
     // Create build element.
     fout << "    <build> \n";
 
     // Write ModelInstances for each ModelObject.
     int object_id = 0;
-    for(const auto object : model->objects){
+    for(const auto object : output_model->objects){
         for (const auto instance : object->instances){
             fout << "        <item objectid=\"" << (object_id + 1) << "\"";
 
@@ -276,56 +250,38 @@ TMFEditor::write_build(boost::nowide::ofstream& fout)
 bool
 TMFEditor::read_model()
 {
-    // Extract 3dmodel.model entry.
-    if(!zip_archive->extract_entry("3D/3dmodel.model", "3dmodel.model"))
-        return false;
-
-    // Read 3D/3dmodel.model file.
     XML_Parser parser = XML_ParserCreate(NULL);
     if (! parser) {
         std::cout << ("Couldn't allocate memory for parser\n");
         return false;
     }
 
-    boost::nowide::ifstream fin("3dmodel.model", std::ios::in);
-    if (!fin.is_open()) {
-        boost::nowide::cerr << "Cannot open file: " << "3dmodel.model" << std::endl;
-        return false;
-    }
-
     // Create model parser.
-    TMFParserContext ctx(parser, model);
+    TMFParserContext ctx(parser, model, zip_archive->entry_size("3D/3dmodel.model"));
     XML_SetUserData(parser, (void*)&ctx);
     XML_SetElementHandler(parser, TMFParserContext::startElement, TMFParserContext::endElement);
     XML_SetCharacterDataHandler(parser, TMFParserContext::characters);
 
-    char buff[8192];
-    bool result = false;
-    while (!fin.eof()) {
-        fin.read(buff, sizeof(buff));
-        if (fin.bad()) {
-            printf("3MF model parser: Read error\n");
-            break;
-        }
-        if (XML_Parse(parser, buff, fin.gcount(), fin.eof()) == XML_STATUS_ERROR) {
-            printf("3MF model parser: Parse error at line %lu:\n%s\n",
-                   XML_GetCurrentLineNumber(parser),
-                   XML_ErrorString(XML_GetErrorCode(parser)));
-            break;
-        }
-        if (fin.eof()) {
-            result = true;
-            break;
+    // Inflate the 3D/3dmodel.model entry straight into the parser.
+    bool parse_error = false;
+    bool result = zip_archive->extract_entry("3D/3dmodel.model", [parser, &parse_error](const char* data, size_t size) {
+        if (XML_Parse(parser, data, int(size), 0) == XML_STATUS_ERROR) {
+            parse_error = true;
+            return false;
         }
+        return true;
+    });
+    if (result && XML_Parse(parser, nullptr, 0, 1) == XML_STATUS_ERROR)
+        parse_error = true;
+    if (parse_error) {
+        printf("3MF model parser: Parse error at line %lu:\n%s\n",
+               XML_GetCurrentLineNumber(parser),
+               XML_ErrorString(XML_GetErrorCode(parser)));
+        result = false;
     }
 
-    // Free the parser and close the file.
+    // Free the parser.
     XML_ParserFree(parser);
-    fin.close();
-
-    // Remove the extracted 3dmodel.model file.
-    if (remove("3dmodel.model") != 0)
-        return false;
 
     if (result)
         ctx.endDocument();
@@ -380,10 +336,9 @@ TMFEditor::~TMFEditor(){
 }
 
 bool
-TMF::write(const Model& model, std::string output_file)
+TMF::write(const Model& model, std::string output_file, int threads)
 {
-    Model m2{model};
-    TMFEditor tmf_writer(std::move(output_file), &m2);
+    TMFEditor tmf_writer(std::move(output_file), &model, threads);
     return tmf_writer.produce_TMF();
 }
 
@@ -395,7 +350,7 @@ TMF::read(std::string input_file, Model* model)
     return tmf_reader.consume_TMF();
 }
 
-TMFParserContext::TMFParserContext(XML_Parser parser, Model *model):
+TMFParserContext::TMFParserContext(XML_Parser parser, Model *model, size_t document_size):
         m_parser(parser),
         m_path(std::vector<TMFNodeType>()),
         m_model(*model),
@@ -404,7 +359,8 @@ TMFParserContext::TMFParserContext(XML_Parser parser, Model *model):
         m_output_objects(std::vector<bool>()),
         m_object_vertices(std::vector<float>()),
         m_volume(nullptr),
-        m_volume_facets(std::vector<int>())
+        m_volume_facets(std::vector<int>()),
+        m_document_size(document_size)
 {
     m_path.reserve(9);
     m_value[0] = m_value[1] = m_value[2] = "";
@@ -545,8 +501,12 @@ TMFParserContext::startElement(const char *name, const char **atts)
             break;
         case 4:
             if (strcmp(name, "vertices") == 0) {
+                // A closed mesh has about twice as many triangles as vertices, and they
+                // follow the vertices: about a third of the rest of the document is vertices.
+                m_object_vertices.reserve(3 * this->remaining_elements(3 * 64));
                 node_type_new = NODE_TYPE_VERTICES;
             } else if (strcmp(name, "triangles") == 0) {
+                m_volume_facets.reserve(m_volume_facets.size() + 3 * this->remaining_elements(56));
                 node_type_new = NODE_TYPE_TRIANGLES;
             } else if (strcmp(name, "component") == 0) {
                 // Read the object id.
@@ -574,25 +534,37 @@ TMFParserContext::startElement(const char *name, const char **atts)
             break;
         case 5:
             if (strcmp(name, "vertex") == 0) {
-                const char* x = get_attribute(atts, "x");
-                const char* y = get_attribute(atts, "y");
-                const char* z = get_attribute(atts, "z");
-                if ( !x || !y || !z)
+                // Read x, y and z in a single pass over the attributes.
+                float xyz[3];
+                int found = 0;
+                for (const char **att = atts; *att != NULL; att += 2) {
+                    const char *key = att[0];
+                    if (key[0] >= 'x' && key[0] <= 'z' && key[1] == '\0') {
+                        xyz[key[0] - 'x'] = strtof(att[1], nullptr);
+                        found |= 1 << (key[0] - 'x');
+                    }
+                }
+                if (found != 7)
                     this->stop();
-                m_object_vertices.push_back(atof(x));
-                m_object_vertices.push_back(atof(y));
-                m_object_vertices.push_back(atof(z));
+                else
+                    m_object_vertices.insert(m_object_vertices.end(), xyz, xyz + 3);
                 node_type_new = NODE_TYPE_VERTEX;
             } else if (strcmp(name, "triangle") == 0) {
-                const char* v1 = get_attribute(atts, "v1");
-                const char* v2 = get_attribute(atts, "v2");
-                const char* v3 = get_attribute(atts, "v3");
-                if (!v1 || !v2 || !v3)
-                    this->stop();
+                // Read v1, v2 and v3 in a single pass over the attributes.
+                int v[3];
+                int found = 0;
+                for (const char **att = atts; *att != NULL; att += 2) {
+                    const char *key = att[0];
+                    if (key[0] == 'v' && key[1] >= '1' && key[1] <= '3' && key[2] == '\0') {
+                        v[key[1] - '1'] = int(strtol(att[1], nullptr, 10));
+                        found |= 1 << (key[1] - '1');
+                    }
+                }
                 // Add it to the volume facets.
-                m_volume_facets.push_back(atoi(v1));
-                m_volume_facets.push_back(atoi(v2));
-                m_volume_facets.push_back(atoi(v3));
+                if (found != 7)
+                    this->stop();
+                else
+                    m_volume_facets.insert(m_volume_facets.end(), v, v + 3);
                 node_type_new = NODE_TYPE_TRIANGLE;
             } else if (strcmp(name, "slic3r:volume") == 0) {
                 // Read start offset of the triangles.
@@ -746,6 +718,15 @@ TMFParserContext::extract_trafo(std::string matrix, TransformationMatrix &trafo)
     return true;
 }
 
+size_t
+TMFParserContext::remaining_elements(size_t element_size) const
+{
+    const XML_Index position = XML_GetCurrentByteIndex(m_parser);
+    if (position < 0 || size_t(position) >= m_document_size)
+        return 0;
+    return (m_document_size - size_t(position)) / element_size;
+}
+
 ModelVolume*
 TMFParserContext::add_volume(int start_offset, int end_offset, bool modifier)
 {
@@ -33,7 +33,12 @@ public:
     };
     ///< Namespaces in the 3MF document.
 
-    TMFEditor(std::string input_file, Model* _model): zip_archive(nullptr), zip_name(input_file), model(_model), object_id(1)
+    TMFEditor(std::string input_file, Model* _model): zip_archive(nullptr), zip_name(input_file), model(_model), output_model(_model), object_id(1), threads(1)
+    {}
+
+    /// Writer of a model that is left untouched: the meshes lacking shared vertices are indexed in copies,
+    /// and formatted on the given number of threads.
+    TMFEditor(std::string output_file, const Model* _model, int _threads): zip_archive(nullptr), zip_name(output_file), model(nullptr), output_model(_model), object_id(1), threads(_threads)
     {}
 
     /// Write TMF function called by TMF::write() function.
@@ -46,8 +51,10 @@ public:
 private:
     ZipArchive* zip_archive; ///< The zip archive object for reading/writing zip files.
     std::string zip_name; ///< The zip archive file name.
-    Model* model; ///< The model to be read or written.
+    Model* model; ///< The model to be read.
+    const Model* output_model; ///< The model to be written.
     int object_id; ///< The id available for the next object to be written.
+    int threads; ///< The number of threads formatting the meshes.
 
     /// Write the necessary types in the 3MF package. This function is called by produceTMF() function.
     bool write_types();
@@ -59,17 +66,17 @@ private:
     bool write_model();
 
     /// Write the metadata of the model. This function is called by writeModel() function.
-    bool write_metadata(boost::nowide::ofstream& fout);
+    bool write_metadata(std::ostream& fout);
 
     /// Write object of the current model. This function is called by writeModel() function.
-    /// \param fout boost::nowide::ofstream& fout output stream.
+    /// \param fout std::ostream& fout output stream.
     /// \param object ModelObject* a pointer to the object to be written.
     /// \param index int the index of the object to be read
     /// \return bool 1: write operation is successful , otherwise not.
-    bool write_object(boost::nowide::ofstream& fout, const ModelObject* object, int index);
+    bool write_object(std::ostream& fout, const ModelObject* object, int index);
 
     /// Write the build element.
-    bool write_build(boost::nowide::ofstream& fout);
+    bool write_build(std::ostream& fout);
 
     /// Read the Model.
     bool read_model();
@@ -132,12 +139,15 @@ struct TMFParserContext{
     std::string m_value[3];
     ///< Generic string buffer for metadata, etc.
 
+    size_t m_document_size;
+    ///< Size in bytes of the XML document, 0 if unknown. Used to reserve the vertices and facets arrays.
+
     static void XMLCALL startElement(void *userData, const char *name, const char **atts);
     static void XMLCALL endElement(void *userData, const char *name);
     static void XMLCALL characters(void *userData, const XML_Char *s, int len); /* s is not 0 terminated. */
     static const char* get_attribute(const char **atts, const char *id);
 
-    TMFParserContext(XML_Parser parser, Model *model);
+    TMFParserContext(XML_Parser parser, Model *model, size_t document_size = 0);
     void startElement(const char *name, const char **atts);
     void endElement();
     void endDocument();
@@ -149,6 +159,11 @@ struct TMFParserContext{
     /// \return TransformationMatrix a matrix that contains the complete defined transformation.
     bool extract_trafo(std::string matrix, TransformationMatrix& trafo);
 
+    /// Estimate the number of elements left in the document.
+    /// \param element_size size_t the typical size in bytes of one element.
+    /// \return size_t the estimated count, 0 if the document size is unknown.
+    size_t remaining_elements(size_t element_size) const;
+
     /// Add a new volume to the current object.
     /// \param start_offset size_t the start index in the m_volume_facets vector.
     /// \param end_offset size_t the end index in the m_volume_facets vector.
@@ -0,0 +1,104 @@
+#include "XMLWriter.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+namespace Slic3r { namespace IO {
+
+void
+append_float(std::string &out, double v)
+{
+    static const double powers[] = { 1e-4, 1e-3, 1e-2, 1e-1, 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9 };
+    const double* const one = powers + 4;
+    const double abs_v = std::abs(v);
+    // %g switches to the scientific notation out of [1e-4, 1e6), including
+    // when the rounding reaches 1e6 (the test also catches a NaN)
+    bool fast = abs_v >= 1e-4 && abs_v < 999999.5;
+    // keep 6 significant digits: 5 - floor(log10(abs_v)) decimals
+    int exponent = 5;
+    double integral = 0, frac = 0;
+    if (fast) {
+        while (abs_v < one[exponent]) --exponent;
+        const double shifted = abs_v * one[5 - exponent];
+        frac = std::modf(shifted, &integral);
+        // The product is within a few ulps of the exact decimal shift; only when
+        // the fraction is that close to one half could it round differently from
+        // printf, and those rare cases are left to it, like GCodeFormatter::append_fixed() does.
+        fast = std::abs(frac - 0.5) > shifted * 1e-15;
+    }
+    if (!fast) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%g", v);
+        out += buf;
+        return;
+    }
+    const int decimals = 5 - exponent;
+    const long long unit = (long long)one[decimals];
+    const long long scaled = (long long)integral + (frac > 0.5 ? 1 : 0);
+    if (v < 0) out += '-';
+    append_int(out, scaled / unit);
+    long long fraction = scaled % unit;
+    if (fraction == 0) return;
+    char buf[16];
+    int n = decimals;
+    while (fraction % 10 == 0) {
+        fraction /= 10;
+        --n;
+    }
+    buf[0] = '.';
+    for (int i = n; i > 0; --i) {
+        buf[i] = char('0' + fraction % 10);
+        fraction /= 10;
+    }
+    out.append(buf, n + 1);
+}
+
+void
+append_int(std::string &out, long long v)
+{
+    char buf[24];
+    char* end = buf + sizeof(buf);
+    char* p = end;
+    unsigned long long u = v < 0 ? 0ULL - (unsigned long long)v : (unsigned long long)v;
+    do {
+        *--p = char('0' + u % 10);
+        u /= 10;
+    } while (u != 0);
+    if (v < 0) *--p = '-';
+    out.append(p, end - p);
+}
+
+const TriangleMesh&
+indexed_mesh(const TriangleMesh &mesh, std::unique_ptr<TriangleMesh> &holder)
+{
+    if (mesh.repaired && mesh.stl.v_shared != nullptr)
+        return mesh;
+    holder.reset(new TriangleMesh(mesh));
+    holder->require_shared_vertices();
+    return *holder;
+}
+
+void
+write_in_chunks(std::ostream &out, size_t count, const std::function<void(size_t, std::string&)> &format, int threads_count)
+{
+    // big enough to keep the threads busy, small enough to keep the memory low
+    const size_t chunk_size = 1 << 14;
+    const size_t chunks = (count + chunk_size - 1) / chunk_size;
+    const size_t threads = size_t(std::max(1, threads_count));
+    std::vector<std::string> texts;
+    for (size_t first = 0; first < chunks; first += threads) {
+        const size_t last = std::min(chunks, first + threads) - 1;
+        texts.assign(last - first + 1, std::string());
+        parallelize<size_t>(first, last, [&texts, &format, first, count](size_t chunk) {
+            std::string &text = texts[chunk - first];
+            const size_t end = std::min(count, (chunk + 1) * chunk_size);
+            for (size_t i = chunk * chunk_size; i < end; ++i)
+                format(i, text);
+        }, int(threads));
+        for (const std::string &text : texts)
+            out.write(text.data(), text.size());
+    }
+}
+
+} }
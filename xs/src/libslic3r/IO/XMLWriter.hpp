@@ -0,0 +1,34 @@
+#ifndef slic3r_IO_XMLWriter_hpp_
+#define slic3r_IO_XMLWriter_hpp_
+
+#include "../libslic3r.h"
+#include "../TriangleMesh.hpp"
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <string>
+
+namespace Slic3r { namespace IO {
+
+/// Helpers shared by the XML based writers (AMF, 3MF) to format meshes quickly.
+
+/// Append v with 6 significant digits, as printf("%g") and the default
+/// formatting of the streams do, without their overhead.
+void append_float(std::string &out, double v);
+
+/// Append v in decimal notation.
+void append_int(std::string &out, long long v);
+
+/// The mesh with its shared vertices: mesh itself if it already has them,
+/// otherwise a repaired copy kept in holder, so that the model being written
+/// is left untouched.
+const TriangleMesh& indexed_mesh(const TriangleMesh &mesh, std::unique_ptr<TriangleMesh> &holder);
+
+/// Write count items to out, format(i, text) appending item i to text.
+/// Chunks of items are formatted on the given number of threads and written
+/// in order, so that only a few chunks per thread are held in memory at a time.
+void write_in_chunks(std::ostream &out, size_t count, const std::function<void(size_t, std::string&)> &format, int threads);
+
+} }
+
+#endif
@@ -1,6 +1,9 @@
 #include "BoundingBox.hpp"
 #include "MotionPlanner.hpp"
+#include <algorithm>
+#include <functional>
 #include <limits> // for numeric_limits
+#include <queue>
 #include <assert.h>
 
 #include "boost/polygon/voronoi.hpp"
@@ -63,9 +66,15 @@ MotionPlanner::initialize()
     ExPolygons outer = diff_ex(contour, outer_holes);
     assert(outer.size() == 1);
     this->outer.island = outer.front();
+    this->outer._island_region = MotionPlannerRegion(this->outer.island);
     
     this->outer.env = ExPolygonCollection(diff_ex(contour, offset(outer_holes, +MP_OUTER_MARGIN)));
     
+    // grow our environment slightly in order for simplify_by_visibility()
+    // to work best by considering moves on boundaries valid as well
+    this->outer._grown_env = ExPolygonCollection(offset_ex((Polygons)this->outer.env, +SCALED_EPSILON));
+    this->outer._grown_region = MotionPlannerRegion(this->outer._grown_env);
+    
     this->graphs.resize(this->islands.size() + 1, NULL);
     this->initialized = true;
 }
@@ -105,7 +114,7 @@ MotionPlanner::shortest_path(const Point &from, const Point &to)
     this->initialize();
     
     // get environment
-    MotionPlannerEnv env = this->get_env(island_idx);
+    const MotionPlannerEnv &env = this->get_env(island_idx);
     if (env.env.expolygons.empty()) {
         // if this environment is empty (probably because it's too small), perform straight move
         // and avoid running the algorithms on empty dataset
@@ -140,11 +149,9 @@ MotionPlanner::shortest_path(const Point &from, const Point &to)
     polyline.points.push_back(to);
     
     {
-        // grow our environment slightly in order for simplify_by_visibility()
-        // to work best by considering moves on boundaries valid as well
-        ExPolygonCollection grown_env(offset_ex((Polygons)env.env, +SCALED_EPSILON));
-        
         if (island_idx == -1) {
+            const ExPolygonCollection &grown_env = env._grown_env;
+            
             /*  If 'from' or 'to' are not inside our env, they were connected using the 
                 nearest_env_point() search which maybe produce ugly paths since it does not
                 include the endpoint in the Dijkstra search; the simplify_by_visibility() 
@@ -155,12 +162,12 @@ MotionPlanner::shortest_path(const Point &from, const Point &to)
             if (!grown_env.contains(from)) {
                 // delete second point while the line connecting first to third crosses the
                 // boundaries as many times as the current first to second
-                while (polyline.points.size() > 2 && intersection_ln(Line(from, polyline.points[2]), grown_env).size() == 1) {
+                while (polyline.points.size() > 2 && env._grown_region.intersection(Line(from, polyline.points[2])).size() == 1) {
                     polyline.points.erase(polyline.points.begin() + 1);
                 }
             }
             if (!grown_env.contains(to)) {
-                while (polyline.points.size() > 2 && intersection_ln(Line(*(polyline.points.end() - 3), to), grown_env).size() == 1) {
+                while (polyline.points.size() > 2 && env._grown_region.intersection(Line(*(polyline.points.end() - 3), to)).size() == 1) {
                     polyline.points.erase(polyline.points.end() - 2);
                 }
             }
@@ -218,7 +225,7 @@ MotionPlanner::init_graph(int island_idx)
         t_vd_vertices vd_vertices;
         
         // get boundaries as lines
-        MotionPlannerEnv env = this->get_env(island_idx);
+        const MotionPlannerEnv &env = this->get_env(island_idx);
         Lines lines = env.env.lines();
         boost::polygon::construct_voronoi(lines.begin(), lines.end(), &vd);
         
@@ -298,7 +305,7 @@ MotionPlannerEnv::nearest_env_point(const Point &from, const Point &to) const
         size_t result = from.nearest_waypoint_index(pp, to);
         
         // as we assume 'from' is outside env, any node will require at least one crossing
-        if (intersection_ln(Line(from, pp[result]), this->island).size() > 1) {
+        if (this->_island_region.intersection(Line(from, pp[result])).size() > 1) {
             // discard result
             pp.erase(pp.begin() + result);
         } else {
@@ -316,6 +323,30 @@ MotionPlannerEnv::nearest_env_point(const Point &from, const Point &to) const
     return from;
 }
 
+MotionPlannerRegion::MotionPlannerRegion(const Polygons &polygons)
+    : _polygons(polygons)
+{
+    this->_bboxes.reserve(polygons.size());
+    for (const Polygon &polygon : polygons)
+        this->_bboxes.push_back(polygon.bounding_box());
+}
+
+Lines
+MotionPlannerRegion::intersection(const Line &line) const
+{
+    const Point min(std::min(line.a.x, line.b.x), std::min(line.a.y, line.b.y));
+    const Point max(std::max(line.a.x, line.b.x), std::max(line.a.y, line.b.y));
+    
+    // a polygon can only cut the line if its bounding box touches the line's one
+    Polygons clip;
+    for (size_t i = 0; i < this->_polygons.size(); ++i) {
+        const BoundingBox &bb = this->_bboxes[i];
+        if (bb.min.x <= max.x && bb.max.x >= min.x && bb.min.y <= max.y && bb.max.y >= min.y)
+            clip.push_back(this->_polygons[i]);
+    }
+    return intersection_ln(line, clip);
+}
+
 void
 MotionPlannerGraph::add_edge(node_t from, node_t to, double weight)
 {
@@ -324,17 +355,64 @@ MotionPlannerGraph::add_edge(node_t from, node_t to, double weight)
         this->adjacency_list.resize(from+1);
     
     this->adjacency_list[from].push_back(neighbor(to, weight));
+    this->_compacted = false;
 }
 
-size_t
-MotionPlannerGraph::find_node(const Point &point) const
+void
+MotionPlannerGraph::_compact()
 {
-    /*
-    for (Points::const_iterator p = this->nodes.begin(); p != this->nodes.end(); ++p) {
-        if (p->coincides_with(point)) return p - this->nodes.begin();
+    const size_t n = this->nodes.size();
+    
+    this->_offsets.assign(n + 1, 0);
+    this->_edges.clear();
+    for (size_t i = 0; i < n; ++i) {
+        if (i < this->adjacency_list.size())
+            this->_edges.insert(this->_edges.end(), this->adjacency_list[i].begin(), this->adjacency_list[i].end());
+        this->_offsets[i+1] = this->_edges.size();
     }
-    */
-    return point.nearest_point_index(this->nodes);
+    
+    this->_nodes_by_x.resize(n);
+    for (size_t i = 0; i < n; ++i) this->_nodes_by_x[i] = i;
+    const Points &nodes = this->nodes;
+    std::stable_sort(this->_nodes_by_x.begin(), this->_nodes_by_x.end(),
+        [&nodes](node_t a, node_t b) { return nodes[a].x < nodes[b].x; });
+    
+    this->_compacted = true;
+}
+
+size_t
+MotionPlannerGraph::find_node(const Point &point)
+{
+    if (!this->_compacted) this->_compact();
+    
+    /*  Walk outwards from point.x through the nodes sorted by x, and stop in each
+        direction once the X distance alone exceeds the best distance found.
+        Distances are computed as in Point::nearest_point_index(), which keeps
+        the last of several nearest nodes, or the first one coinciding with point. */
+    int idx = -1;
+    double distance = -1;
+    const auto consider = [&](node_t i) {
+        const double d = pow(point.x - this->nodes[i].x, 2) + pow(point.y - this->nodes[i].y, 2);
+        if (distance == -1 || d < distance
+            || (d == distance && (d < EPSILON ? i < idx : i > idx))) {
+            idx = i;
+            distance = d;
+        }
+    };
+    const auto beyond = [&](node_t i) {
+        return distance != -1 && pow(point.x - this->nodes[i].x, 2) > distance;
+    };
+    
+    const std::vector<node_t> &by_x = this->_nodes_by_x;
+    const Points &nodes = this->nodes;
+    const size_t start = std::lower_bound(by_x.begin(), by_x.end(), point.x,
+        [&nodes](node_t a, coord_t x) { return nodes[a].x < x; }) - by_x.begin();
+    for (size_t k = start; k < by_x.size() && !beyond(by_x[k]); ++k)
+        consider(by_x[k]);
+    for (size_t k = start; k > 0 && !beyond(by_x[k-1]); --k)
+        consider(by_x[k-1]);
+    
+    return idx;
 }
 
 Polyline
@@ -343,65 +421,61 @@ MotionPlannerGraph::shortest_path(node_t from, node_t to)
     // this prevents a crash in case for some reason we got here with an empty adjacency list
     if (this->adjacency_list.empty()) return Polyline();
     
+    if (!this->_compacted) this->_compact();
+    
     const weight_t max_weight = std::numeric_limits<weight_t>::infinity();
     
-    std::vector<weight_t> dist;
-    std::vector<node_t> previous;
+    std::vector<weight_t> &dist     = this->_dist;
+    std::vector<node_t>   &previous = this->_previous;
     {
         // number of nodes
-        const int n = this->adjacency_list.size();
+        const size_t n = this->nodes.size();
         
         // initialize dist and previous
-        dist.clear();
-        dist.resize(n, max_weight);
+        dist.assign(n, max_weight);
         dist[from] = 0;  // distance from 'from' to itself
-        previous.clear();
-        previous.resize(n, -1);
+        previous.assign(n, -1);
+        this->_visited.assign(n, false);
         
-        // initialize the Q with all nodes
-        std::set<node_t> Q;
-        for (node_t i = 0; i < n; ++i) Q.insert(i);
+        /*  Q holds (dist, node) pairs and pops the lowest node among those at the
+            minimum distance, like a scan of all unvisited nodes would. Instead of
+            decreasing keys, nodes are pushed again when their distance improves
+            and outdated entries are skipped. Unreached nodes are never queued,
+            since visiting them cannot improve any distance. */
+        typedef std::pair<weight_t,node_t> queued_t;
+        std::priority_queue<queued_t, std::vector<queued_t>, std::greater<queued_t> > Q;
+        Q.push(queued_t(0, from));
         
         while (!Q.empty()) 
         {
             // get node in Q having the minimum dist ('from' in the first loop)
-            node_t u;
-            {
-                double min_dist = -1;
-                for (std::set<node_t>::const_iterator n = Q.begin(); n != Q.end(); ++n) {
-                    if (dist[*n] < min_dist || min_dist == -1) {
-                        u = *n;
-                        min_dist = dist[*n];
-                    }
-                }
-            }
-            Q.erase(u);
+            const node_t u = Q.top().second;
+            const weight_t u_dist = Q.top().first;
+            Q.pop();
+            if (this->_visited[u] || u_dist != dist[u]) continue;
+            this->_visited[u] = true;
             
             // stop searching if we reached our destination
             if (u == to) break;
             
             // Visit each edge starting from node u
-            const std::vector<neighbor> &neighbors = this->adjacency_list[u];
-            for (std::vector<neighbor>::const_iterator neighbor_iter = neighbors.begin();
-                 neighbor_iter != neighbors.end();
-                 ++neighbor_iter)
-            {
+            for (size_t e = this->_offsets[u]; e < this->_offsets[u+1]; ++e) {
                 // neighbor node is v
-                node_t v = neighbor_iter->target;
+                const node_t v = this->_edges[e].target;
                 
                 // skip if we already visited this
-                if (Q.find(v) == Q.end()) continue;
+                if (this->_visited[v]) continue;
                 
                 // calculate total distance
-                weight_t alt = dist[u] + neighbor_iter->weight;
+                const weight_t alt = dist[u] + this->_edges[e].weight;
                 
                 // if total distance through u is shorter than the previous
                 // distance (if any) between 'from' and 'v', replace it
                 if (alt < dist[v]) {
                     dist[v]     = alt;
                     previous[v] = u;
+                    Q.push(queued_t(alt, v));
                 }
-
             }
         }
     }
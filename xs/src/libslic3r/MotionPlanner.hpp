@@ -2,6 +2,7 @@
 #define slic3r_MotionPlanner_hpp_
 
 #include "libslic3r.h"
+#include "BoundingBox.hpp"
 #include "ClipperUtils.hpp"
 #include "ExPolygonCollection.hpp"
 #include "Polyline.hpp"
@@ -16,6 +17,23 @@ constexpr coord_t MP_OUTER_MARGIN = scale_(2.0);
 
 class MotionPlanner;
 
+/// Polygons kept together with their bounding boxes, so that short lines can be
+/// clipped against a large environment without handing every polygon to Clipper.
+class MotionPlannerRegion
+{
+    public:
+    MotionPlannerRegion() {};
+    MotionPlannerRegion(const Polygons &polygons);
+    
+    /// Same result as intersection_ln(line, polygons), skipping the polygons
+    /// whose bounding box the line does not touch.
+    Lines intersection(const Line &line) const;
+    
+    private:
+    Polygons _polygons;
+    std::vector<BoundingBox> _bboxes;
+};
+
 class MotionPlannerEnv
 {
     friend class MotionPlanner;
@@ -24,8 +42,15 @@ class MotionPlannerEnv
     ExPolygon island;
     ExPolygonCollection env;
     MotionPlannerEnv() {};
-    MotionPlannerEnv(const ExPolygon &island) : island(island) {};
+    MotionPlannerEnv(const ExPolygon &island) : island(island), _island_region(island) {};
     Point nearest_env_point(const Point &from, const Point &to) const;
+    
+    private:
+    MotionPlannerRegion _island_region;
+    
+    /// env grown by SCALED_EPSILON, only built for the outer environment.
+    ExPolygonCollection _grown_env;
+    MotionPlannerRegion _grown_region;
 };
 
 class MotionPlannerGraph
@@ -44,11 +69,33 @@ class MotionPlannerGraph
     typedef std::vector< std::vector<neighbor> > adjacency_list_t;
     adjacency_list_t adjacency_list;
     
+    bool _compacted;
+    
+    /// Compressed copy of adjacency_list: the neighbors of node i are
+    /// _edges[_offsets[i]] .. _edges[_offsets[i+1]-1].
+    std::vector<size_t> _offsets;
+    std::vector<neighbor> _edges;
+    
+    /// Node indices sorted by x coordinate, for find_node().
+    std::vector<node_t> _nodes_by_x;
+    
+    /// Search state reused by consecutive shortest_path() calls.
+    std::vector<weight_t> _dist;
+    std::vector<node_t> _previous;
+    std::vector<bool> _visited;
+    
+    /// Build the compressed adjacency and the node lookup once edges are in.
+    void _compact();
+    
     public:
     Points nodes;
     //std::map<std::pair<size_t,size_t>, double> edges;
+    MotionPlannerGraph() : _compacted(false) {};
     void add_edge(node_t from, node_t to, double weight);
-    size_t find_node(const Point &point) const;
+    
+    /// Index of the node nearest to point, with the same choice among
+    /// equidistant nodes as Point::nearest_point_index().
+    size_t find_node(const Point &point);
     Polyline shortest_path(node_t from, node_t to);
 };
 
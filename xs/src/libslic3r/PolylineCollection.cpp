@@ -1,50 +1,8 @@
 #include "PolylineCollection.hpp"
+#include "Geometry.hpp"
 
 namespace Slic3r {
 
-struct Chaining
-{
-    Point first;
-    Point last;
-    size_t idx;
-};
-
-#ifndef sqr
-    #define sqr(x) (x * x);
-#endif
-
-template<typename T>
-inline int nearest_point_index(const std::vector<Chaining> &pairs, const Point &start_near, bool no_reverse)
-{
-    T dmin = std::numeric_limits<T>::max();
-    int idx = 0;
-    for (std::vector<Chaining>::const_iterator it = pairs.begin(); it != pairs.end(); ++it) {
-        T d = sqr(T(start_near.x - it->first.x));
-        if (d <= dmin) {
-            d += sqr(T(start_near.y - it->first.y));
-            if (d < dmin) {
-                idx = (it - pairs.begin()) * 2;
-                dmin = d;
-                if (dmin < EPSILON)
-                    break;
-            }
-        }
-        if (! no_reverse) {
-            d = sqr(T(start_near.x - it->last.x));
-            if (d <= dmin) {
-                d += sqr(T(start_near.y - it->last.y));
-                if (d < dmin) {
-                    idx = (it - pairs.begin()) * 2 + 1;
-                    dmin = d;
-                    if (dmin < EPSILON)
-                        break;
-                }
-            }
-        }
-    }
-    return idx;
-}
-
 Polylines PolylineCollection::_chained_path_from(
     const Polylines &src,
     Point start_near,
@@ -54,33 +12,34 @@ Polylines PolylineCollection::_chained_path_from(
 #endif
     )
 {
-    std::vector<Chaining> endpoints;
-    endpoints.reserve(src.size());
+    Geometry::ChainingIndex endpoints(Geometry::ChainingIndex::tiesFirst);
+    std::vector<bool> last_endpoint;
     for (size_t i = 0; i < src.size(); ++ i) {
-        Chaining c;
-        c.first = src[i].first_point();
-        if (! no_reverse)
-            c.last = src[i].last_point();
-        c.idx = i;
-        endpoints.push_back(c);
+        endpoints.add(src[i].first_point(), i);
+        last_endpoint.push_back(false);
+        if (! no_reverse) {
+            endpoints.add(src[i].last_point(), i);
+            last_endpoint.push_back(true);
+        }
     }
     Polylines retval;
-    while (! endpoints.empty()) {
+    for (size_t n = 0; n < src.size(); ++ n) {
         // find nearest point
-        int endpoint_index = nearest_point_index<double>(endpoints, start_near, no_reverse);
-        assert(endpoint_index >= 0 && endpoint_index < (int)endpoints.size() * 2);
+        int endpoint_index = endpoints.nearest(start_near);
+        assert(endpoint_index >= 0);
+        const size_t idx = endpoints.item(endpoint_index);
 #if SLIC3R_CPPVER > 11
         if (move_from_src) {
-            retval.push_back(std::move(src[endpoints[endpoint_index/2].idx]));
+            retval.push_back(std::move(src[idx]));
         } else {
-            retval.push_back(src[endpoints[endpoint_index/2].idx]);
+            retval.push_back(src[idx]);
         }
 #else
-        retval.push_back(src[endpoints[endpoint_index/2].idx]);
+        retval.push_back(src[idx]);
 #endif
-        if (endpoint_index & 1)
+        if (last_endpoint[endpoint_index])
             retval.back().reverse();
-        endpoints.erase(endpoints.begin() + endpoint_index/2);
+        endpoints.remove(idx);
         start_near = retval.back().last_point();
     }
     return retval;
@@ -5,6 +5,7 @@
 #include "Fill/Fill.hpp"
 #include "Flow.hpp"
 #include "Geometry.hpp"
+#include "Profiler.hpp"
 #include "SupportMaterial.hpp"
 #include <algorithm>
 #include <boost/filesystem.hpp>
@@ -106,6 +107,7 @@ Print::delete_object(size_t idx)
 void
 Print::process() 
 {
+    Profiler::Scope profile("Print::process", "Print", this->objects.size());
     /// No need to call this as we call it as part of prepare_infill()
     /// until we fix the idempotency issue.
 //    if (this->status_cb != nullptr)
@@ -113,13 +115,24 @@ Print::process()
   //  for(auto& obj : this->objects) { obj->make_perimeters(); }
     if (this->status_cb != nullptr)
         this->status_cb(70, "Infilling layers");
-    for(auto& obj : this->objects) { obj->infill(); }
+    for(auto& obj : this->objects) { this->_infill(obj); }
     for(auto& obj : this->objects) { obj->generate_support_material(); }
 
     this->make_skirt();
     this->make_brim(); // must follow make_skirt
 }
 
+void
+Print::_infill(PrintObject* object)
+{
+    // when streaming, PrintGCode makes the fills of each layer right before writing it
+    if (this->stream_infill) {
+        object->prepare_infill();
+    } else {
+        object->infill();
+    }
+}
+
 void
 Print::make_brim() 
 {
@@ -127,13 +140,19 @@ Print::make_brim()
     // prereqs
     for(auto& obj: this->objects) {
         obj->make_perimeters();
-        obj->infill();
+        this->_infill(obj);
         obj->generate_support_material();
     }
+    // the interior brim looks at the infill of the first layer
+    if (this->stream_infill && this->config.interior_brim_width > 0)
+        for (auto* obj : this->objects)
+            if (!obj->layers.empty()) obj->layers.front()->make_fills();
     this->state.set_started(psBrim);
     if (this->status_cb != nullptr)
         this->status_cb(88, "Generating brim");
+    Profiler::Scope profile("Print::make_brim", "Print");
     this->_make_brim();
+    profile.items(this->brim.entities.size());
     this->state.set_done(psBrim);
 }
 
@@ -146,7 +165,7 @@ Print::make_skirt()
     // prereqs
     for (auto* obj: this->objects) {
         obj->make_perimeters();
-        obj->infill();
+        this->_infill(obj);
         obj->generate_support_material();
     }
 
@@ -161,6 +180,7 @@ Print::make_skirt()
 
     if (this->status_cb != nullptr)
         this->status_cb(88, "Generating skirt");
+    Profiler::Scope profile("Print::make_skirt", "Print");
 
     // First off we need to decide how tall the skirt must be.
     // The skirt_height option from config is expressed in layers, but our
@@ -184,29 +204,46 @@ Print::make_skirt()
     }
 
     // collect points from all layers contained in skirt height
+    // Objects are gathered in parallel. Layers of an object usually repeat the
+    // same points, so each object keeps its points sorted and without
+    // duplicates, which doesn't change the convex hull but makes the final one
+    // much cheaper with many copies.
+    std::vector<Points> objects_points(this->objects.size());
+    parallelize<size_t>(
+        0,
+        this->objects.size() - 1,
+        [this, &objects_points] (size_t object_idx) {
+            const PrintObject* object = this->objects[object_idx];
+            Points &object_points = objects_points[object_idx];
+            
+            // get object layers up to this->skirt_height_z
+            for (const auto* layer : object->layers) {
+                if (layer->print_z > this->skirt_height_z) break;
+                for (const ExPolygon &ex : layer->slices)
+                    append_to(object_points, static_cast<Points>(ex));
+            }
+            
+            // get support layers up to this->skirt_height_z
+            for (const auto* layer : object->support_layers) {
+                if (layer->print_z > this->skirt_height_z) break;
+                for (auto* ee : layer->support_fills)
+                    append_to(object_points, ee->as_polyline().points);
+                for (auto* ee : layer->support_interface_fills)
+                    append_to(object_points, ee->as_polyline().points);
+            }
+            
+            std::sort(object_points.begin(), object_points.end(),
+                [] (const Point &a, const Point &b) { return a.x < b.x || (a.x == b.x && a.y < b.y); });
+            object_points.erase(std::unique(object_points.begin(), object_points.end()), object_points.end());
+        },
+        this->config.threads.value
+    );
+    
+    // repeat points for each object copy
     Points points;
-    for (auto* object : this->objects) {
-        Points object_points;
-        
-        // get object layers up to this->skirt_height_z
-        for (const auto* layer : object->layers) {
-            if (layer->print_z > this->skirt_height_z) break;
-            for (const ExPolygon ex : layer->slices)
-                append_to(object_points, static_cast<Points>(ex));
-        }
-        
-        // get support layers up to this->skirt_height_z
-        for (const auto* layer : object->support_layers) {
-            if (layer->print_z > this->skirt_height_z) break;
-            for (auto* ee : layer->support_fills)
-                append_to(object_points, ee->as_polyline().points);
-            for (auto* ee : layer->support_interface_fills)
-                append_to(object_points, ee->as_polyline().points);
-        }
-        
-        // repeat points for each object copy
-        for (const auto& copy : object->_shifted_copies) {
-            for (Point p : object_points) {
+    for (size_t object_idx = 0; object_idx < this->objects.size(); ++object_idx) {
+        for (const auto& copy : this->objects[object_idx]->_shifted_copies) {
+            for (Point p : objects_points[object_idx]) {
                 p.translate(copy);
                 points.push_back(p);
             }
@@ -266,6 +303,7 @@ Print::make_skirt()
     }
 
     this->skirt.reverse();
+    profile.items(this->skirt.entities.size());
     this->state.set_done(psSkirt);
 }
 
@@ -326,6 +364,81 @@ Print::delete_region(size_t idx)
     this->regions.erase(i);
 }
 
+/// PrintConfig options that only affect the G-code export.
+static const std::set<t_config_option_key> gcode_only_options {
+    "avoid_crossing_perimeters",
+    "bed_shape",
+    "bed_temperature",
+    "between_objects_gcode",
+    "bridge_acceleration",
+    "bridge_fan_speed",
+    "complete_objects",
+    "cooling",
+    "default_acceleration",
+    "disable_fan_first_layers",
+    "duplicate_distance",
+    "end_gcode",
+    "extruder_clearance_height",
+    "extruder_clearance_radius",
+    "extruder_offset",
+    "extrusion_axis",
+    "extrusion_multiplier",
+    "fan_always_on",
+    "fan_below_layer_time",
+    "filament_colour",
+    "filament_diameter",
+    "filament_notes",
+    "first_layer_acceleration",
+    "first_layer_bed_temperature",
+    "first_layer_speed",
+    "first_layer_temperature",
+    "gcode_arcs",
+    "gcode_comments",
+    "gcode_flavor",
+    "infill_acceleration",
+    "infill_first",
+    "layer_gcode",
+    "min_fan_speed",
+    "max_fan_speed",
+    "min_print_speed",
+    "notes",
+    "only_retract_when_crossing_perimeters",
+    "output_filename_format",
+    "perimeter_acceleration",
+    "post_process",
+    "pressure_advance",
+    "printer_notes",
+    "retract_before_travel",
+    "retract_layer_change",
+    "retract_length",
+    "retract_length_toolchange",
+    "retract_lift",
+    "retract_lift_above",
+    "retract_lift_below",
+    "retract_restart_extra",
+    "retract_restart_extra_toolchange",
+    "retract_speed",
+    "slowdown_below_layer_time",
+    "spiral_vase",
+    "standby_temperature_delta",
+    "start_gcode",
+    "temperature",
+    "threads",
+    "toolchange_gcode",
+    "travel_speed",
+    "use_firmware_retraction",
+    "use_relative_e_distances",
+    "vibration_limit",
+    "wipe",
+    "z_offset",
+};
+
+bool
+Print::gcode_only_option(const t_config_option_key &opt_key)
+{
+    return gcode_only_options.count(opt_key) > 0;
+}
+
 bool
 Print::invalidate_state_by_config(const PrintConfigBase &config)
 {
@@ -359,71 +472,7 @@ Print::invalidate_state_by_config(const PrintConfigBase &config)
         } else if (opt_key == "resolution"
             || opt_key == "z_steps_per_mm") {
             osteps.insert(posSlice);
-        } else if (opt_key == "avoid_crossing_perimeters"
-            || opt_key == "bed_shape"
-            || opt_key == "bed_temperature"
-            || opt_key == "between_objects_gcode"
-            || opt_key == "bridge_acceleration"
-            || opt_key == "bridge_fan_speed"
-            || opt_key == "complete_objects"
-            || opt_key == "cooling"
-            || opt_key == "default_acceleration"
-            || opt_key == "disable_fan_first_layers"
-            || opt_key == "duplicate_distance"
-            || opt_key == "end_gcode"
-            || opt_key == "extruder_clearance_height"
-            || opt_key == "extruder_clearance_radius"
-            || opt_key == "extruder_offset"
-            || opt_key == "extrusion_axis"
-            || opt_key == "extrusion_multiplier"
-            || opt_key == "fan_always_on"
-            || opt_key == "fan_below_layer_time"
-            || opt_key == "filament_colour"
-            || opt_key == "filament_diameter"
-            || opt_key == "filament_notes"
-            || opt_key == "first_layer_acceleration"
-            || opt_key == "first_layer_bed_temperature"
-            || opt_key == "first_layer_speed"
-            || opt_key == "first_layer_temperature"
-            || opt_key == "gcode_arcs"
-            || opt_key == "gcode_comments"
-            || opt_key == "gcode_flavor"
-            || opt_key == "infill_acceleration"
-            || opt_key == "infill_first"
-            || opt_key == "layer_gcode"
-            || opt_key == "min_fan_speed"
-            || opt_key == "max_fan_speed"
-            || opt_key == "min_print_speed"
-            || opt_key == "notes"
-            || opt_key == "only_retract_when_crossing_perimeters"
-            || opt_key == "output_filename_format"
-            || opt_key == "perimeter_acceleration"
-            || opt_key == "post_process"
-            || opt_key == "pressure_advance"
-            || opt_key == "printer_notes"
-            || opt_key == "retract_before_travel"
-            || opt_key == "retract_layer_change"
-            || opt_key == "retract_length"
-            || opt_key == "retract_length_toolchange"
-            || opt_key == "retract_lift"
-            || opt_key == "retract_lift_above"
-            || opt_key == "retract_lift_below"
-            || opt_key == "retract_restart_extra"
-            || opt_key == "retract_restart_extra_toolchange"
-            || opt_key == "retract_speed"
-            || opt_key == "slowdown_below_layer_time"
-            || opt_key == "spiral_vase"
-            || opt_key == "standby_temperature_delta"
-            || opt_key == "start_gcode"
-            || opt_key == "temperature"
-            || opt_key == "threads"
-            || opt_key == "toolchange_gcode"
-            || opt_key == "travel_speed"
-            || opt_key == "use_firmware_retraction"
-            || opt_key == "use_relative_e_distances"
-            || opt_key == "vibration_limit"
-            || opt_key == "wipe"
-            || opt_key == "z_offset") {
+        } else if (Print::gcode_only_option(opt_key)) {
             // these options only affect G-code export, so nothing to invalidate
         } else if (opt_key == "first_layer_extrusion_width") {
             osteps.insert(posPerimeters);
@@ -683,6 +732,7 @@ Print::add_model_object(ModelObject* model_object, int idx)
 void
 Print::export_gcode(std::ostream& output, bool quiet)
 {
+    Profiler::Scope profile("Print::export_gcode", "Print", this->objects.size());
     // prerequisites
     this->process();
     
@@ -690,6 +740,14 @@ Print::export_gcode(std::ostream& output, bool quiet)
         this->status_cb(90, "Exporting G-Code...");
     
     Slic3r::PrintGCode(*this, output).output();
+    
+    // the toolpaths written by a streaming export are gone
+    if (this->stream_infill) {
+        for (auto* obj : this->objects) {
+            obj->invalidate_step(posPerimeters);
+            obj->invalidate_step(posSupportMaterial);
+        }
+    }
 }
 
 void
@@ -1087,50 +1145,87 @@ Print::_make_brim()
     const double mm3_per_mm = flow.mm3_per_mm();
     
     const coord_t grow_distance = flow.scaled_width()/2;
-    Polygons islands;
-    Points pt_ears;
     
-    for (PrintObject* object : this->objects) {
-        const Layer* layer0 = object->get_layer(0);
-        
-        Polygons object_islands = layer0->slices.contours();
-        
-        if (!object->support_layers.empty()) {
-            const SupportLayer* support_layer0 = object->get_support_layer(0);
+    // Gather the first layer islands of each object in parallel, then place
+    // them (and find the corners needing ears) for each copy in parallel too.
+    // Results are merged in object and copy order, as they used to be built.
+    std::vector<Polygons> objects_islands(this->objects.size());
+    parallelize<size_t>(
+        0,
+        this->objects.size() - 1,
+        [this, &objects_islands, grow_distance] (size_t object_idx) {
+            PrintObject* object = this->objects[object_idx];
+            const Layer* layer0 = object->get_layer(0);
             
-            for (const ExtrusionEntity* e : support_layer0->support_fills.entities)
-                append_to(object_islands, offset(e->as_polyline(), grow_distance));
+            Polygons &object_islands = objects_islands[object_idx];
+            object_islands = layer0->slices.contours();
             
-            for (const ExtrusionEntity* e : support_layer0->support_interface_fills.entities)
-                append_to(object_islands, offset(e->as_polyline(), grow_distance));
-        }
-        for (const Point &copy : object->_shifted_copies) {
-            for (Polygon p : object_islands) {
-                p.translate(copy);
-                islands.push_back(p);
+            if (!object->support_layers.empty()) {
+                const SupportLayer* support_layer0 = object->get_support_layer(0);
+                
+                for (const ExtrusionEntity* e : support_layer0->support_fills.entities)
+                    append_to(object_islands, offset(e->as_polyline(), grow_distance));
+                
+                for (const ExtrusionEntity* e : support_layer0->support_interface_fills.entities)
+                    append_to(object_islands, offset(e->as_polyline(), grow_distance));
+            }
+        },
+        this->config.threads.value
+    );
+    
+    std::vector<std::pair<size_t, Point>> copies;
+    for (size_t object_idx = 0; object_idx < this->objects.size(); ++object_idx)
+        for (const Point &copy : this->objects[object_idx]->_shifted_copies)
+            copies.emplace_back(object_idx, copy);
+    std::vector<Polygons> copies_islands(copies.size());
+    std::vector<Points> copies_ears(copies.size());
+    parallelize<size_t>(
+        0,
+        copies.size() - 1,
+        [this, &copies, &objects_islands, &copies_islands, &copies_ears] (size_t copy_idx) {
+            Polygons &copy_islands = copies_islands[copy_idx];
+            copy_islands = objects_islands[copies[copy_idx].first];
+            for (Polygon &p : copy_islands) {
+                p.translate(copies[copy_idx].second);
                 if(this->config.brim_ears)
-                    for (const Point &p_corner : p.convex_points(this->config.brim_ears_max_angle.value * PI / 180.0)) {
-                        pt_ears.push_back(p_corner);
-                    }
+                    append_to(copies_ears[copy_idx], p.convex_points(this->config.brim_ears_max_angle.value * PI / 180.0));
             }
-        }
+        },
+        this->config.threads.value
+    );
+    
+    Polygons islands;
+    Points pt_ears;
+    for (size_t copy_idx = 0; copy_idx < copies.size(); ++copy_idx) {
+        append_to(islands, copies_islands[copy_idx]);
+        append_to(pt_ears, copies_ears[copy_idx]);
     }
     
-    Polygons loops;
+    // each loop is offset from all the islands at once, so that loops of
+    // nearby islands merge like before; distinct loops are offset in parallel
     const int num_loops = floor(this->config.brim_width / flow.width + 0.5);
-    for (int i = num_loops; i >= 1; --i) {
-        // JT_SQUARE ensures no vertex is outside the given offset distance
-        // -0.5 because islands are not represented by their centerlines
-        // (first offset more, then step back - reverse order than the one used for 
-        // perimeters because here we're offsetting outwards)
-        append_to(loops, offset2(
-            islands,
-            flow.scaled_width() + flow.scaled_spacing() * (i - 1.5 + 0.5),
-            flow.scaled_spacing() * -0.525, // WORKAROUND for brim placement, original 0.5 leaves too much of a gap.
-            100000,
-            ClipperLib::jtSquare
-        ));
-    }
+    std::vector<Polygons> loops_by_index(std::max(num_loops, 0));
+    parallelize<int>(
+        1,
+        num_loops,
+        [&islands, &flow, &loops_by_index] (int i) {
+            // JT_SQUARE ensures no vertex is outside the given offset distance
+            // -0.5 because islands are not represented by their centerlines
+            // (first offset more, then step back - reverse order than the one used for 
+            // perimeters because here we're offsetting outwards)
+            loops_by_index[i - 1] = offset2(
+                islands,
+                flow.scaled_width() + flow.scaled_spacing() * (i - 1.5 + 0.5),
+                flow.scaled_spacing() * -0.525, // WORKAROUND for brim placement, original 0.5 leaves too much of a gap.
+                100000,
+                ClipperLib::jtSquare
+            );
+        },
+        this->config.threads.value
+    );
+    Polygons loops;
+    for (int i = num_loops; i >= 1; --i)
+        append_to(loops, loops_by_index[i - 1]);
     
     if(this->config.brim_ears){
         
@@ -1261,8 +1356,12 @@ Print::_make_brim()
     
     if (this->config.brim_connections_width > 0) {
         // get islands to connect
-        for (Polygon &p : islands)
-            p = Geometry::convex_hull(p.points);
+        parallelize<size_t>(
+            0,
+            islands.size() - 1,
+            [&islands] (size_t i) { islands[i] = Geometry::convex_hull(islands[i].points); },
+            this->config.threads.value
+        );
         
         islands = offset(islands, flow.scaled_spacing() * (num_loops-0.2), 10000, jtSquare);
         
@@ -1278,15 +1377,23 @@ Print::_make_brim()
         const Polygons grown = offset(islands, +scaled_width/2);
         
         // find pairs of islands having direct visibility
+        std::vector<Lines> lines_from(islands.size());
+        parallelize<size_t>(
+            0,
+            islands.size() - 1,
+            [&islands, &centroids, &grown, &lines_from] (size_t i) {
+                for (size_t j = (i+1); j < islands.size(); ++j) {
+                    // check visibility
+                    Line line(centroids[i], centroids[j]);
+                    if (diff_pl((Polyline)line, grown).size() != 1) continue;
+                    lines_from[i].push_back(line);
+                }
+            },
+            this->config.threads.value
+        );
         Lines lines;
-        for (size_t i = 0; i < islands.size(); ++i) {
-            for (size_t j = (i+1); j < islands.size(); ++j) {
-                // check visibility
-                Line line(centroids[i], centroids[j]);
-                if (diff_pl((Polyline)line, grown).size() != 1) continue;
-                lines.push_back(line);
-            }
-        }
+        for (const Lines &l : lines_from)
+            append_to(lines, l);
         
         std::unique_ptr<Fill> filler(Fill::new_from_type(ipRectilinear));
         filler->min_spacing  = flow.spacing();
@@ -1340,15 +1447,23 @@ Print::_make_brim()
             }
         }
         
-        Polygons loops;
         const int num_loops = floor(this->config.interior_brim_width / flow.width + 0.5);
-        for (int i = 1; i <= num_loops; ++i) {
-            append_to(loops, offset2(
-                holes,
-                -flow.scaled_spacing() * (i + 0.5),
-                flow.scaled_spacing()
-            ));
-        }
+        std::vector<Polygons> loops_by_index(std::max(num_loops, 0));
+        parallelize<int>(
+            1,
+            num_loops,
+            [&holes, &flow, &loops_by_index] (int i) {
+                loops_by_index[i - 1] = offset2(
+                    holes,
+                    -flow.scaled_spacing() * (i + 0.5),
+                    flow.scaled_spacing()
+                );
+            },
+            this->config.threads.value
+        );
+        Polygons loops;
+        for (const Polygons &l : loops_by_index)
+            append_to(loops, l);
         
         loops = union_pt_chained(loops);
         for (const Polygon &p : loops) {
@@ -2,6 +2,7 @@
 #define slic3r_Print_hpp_
 
 #include "libslic3r.h"
+#include <map>
 #include <set>
 #include <string>
 #include <vector>
@@ -30,6 +31,7 @@ class InvalidPrintException : public std::runtime_error {
 class Print;
 class PrintObject;
 class ModelObject;
+class SliceCache;
 class SupportMaterial;
 
 // Print step IDs for keeping track of the print state.
@@ -114,6 +116,7 @@ class PrintObject
     PrintState<PrintObjectStep> state;
     
     Print* print() { return this->_print; };
+    const Print* print() const { return this->_print; };
     ModelObject* model_object() { return this->_model_object; };
     const ModelObject& model_object() const { return *(this->_model_object); };
     
@@ -154,6 +157,13 @@ class PrintObject
     bool invalidate_step(PrintObjectStep step);
     bool invalidate_all_steps();
     
+    /// Invalidate step after a change to the config of region_id. Nothing is
+    /// invalidated if no volume of this object belongs to the region, and
+    /// posInfill only regenerates the fills of the invalidated regions on the
+    /// layers sliced within the Z range of their volumes.
+    bool invalidate_region_step(PrintObjectStep step, size_t region_id);
+    bool invalidate_region_all_steps(size_t region_id);
+    
     bool has_support_material() const;
     void detect_surfaces_type();
     void process_external_surfaces();
@@ -204,12 +214,22 @@ class PrintObject
     Print* _print;
     ModelObject* _model_object;
     Points _copies;      // Slic3r::Point objects in scaled G-code coordinates
+    
+    /// Regions whose fills the next infill() regenerates when posInfill was
+    /// invalidated for some regions only, with the [min, max] slice_z of the
+    /// layers to regenerate; empty when all regions are redone.
+    std::map<size_t, std::pair<coordf_t, coordf_t>> _infill_regions;
 
     // TODO: call model_object->get_bounding_box() instead of accepting
         // parameter
     PrintObject(Print* print, ModelObject* model_object, const BoundingBoxf3 &modobj_bbox);
     ~PrintObject();
 
+    /// Z range of the volumes of region_id, in the coordinates of slice_z.
+    std::pair<coordf_t, coordf_t> _region_z_range(size_t region_id);
+    /// Number of solid layers that the surfaces of the given type of layer i
+    /// extend into, counting layer i itself.
+    size_t _horizontal_shell_layers(const LayerRegion* layerm, const size_t& i, const SurfaceType& type) const;
     /// Outer loop of logic for horizontal shell discovery
     void _discover_external_horizontal_shells(LayerRegion* layerm, const size_t& i, const size_t& region_id);
     /// Inner loop of logic for horizontal shell discovery
@@ -233,6 +253,24 @@ class Print
     
     std::function<void(int, const std::string&)> status_cb {nullptr};
 
+    /// Make the infill toolpaths while exporting G-code, a few layers ahead of
+    /// the one being written, and release the toolpaths of each layer once it
+    /// has been written. Only the infill is held for a window of layers: the
+    /// slices, perimeters and fill surfaces of every layer are still made by
+    /// process() beforehand. The toolpaths are made again if needed later.
+    bool stream_infill {false};
+
+    /// Write the extrusions of each object copy of a layer ahead of the G-code
+    /// before them, in parallel, and join them to it at the layer changes (see
+    /// PrintGCode::Fragment). Seams then start from a corner of each object on
+    /// every layer instead of following the previous layer, and a retraction
+    /// is always made before the first extrusion of each object copy.
+    bool parallel_gcode {false};
+
+    /// When set, objects reload their slices and toolpaths from this cache
+    /// instead of computing them again, and store them there otherwise.
+    std::shared_ptr<SliceCache> slice_cache {nullptr};
+
     /// Function pointer for the UI side to call post-processing scripts.
     /// Vector is assumed to be the executable script and all arguments.
     std::function<void(std::vector<std::string>)> post_process_cb {nullptr};
@@ -278,6 +316,8 @@ class Print
     bool invalidate_step(PrintStep step);
     bool invalidate_all_steps();
     bool step_done(PrintObjectStep step) const;
+    /// Whether opt_key only affects the G-code export, and none of the steps.
+    static bool gcode_only_option(const t_config_option_key &opt_key);
     
     void add_model_object(ModelObject* model_object, int idx = -1);
     #ifndef SLIC3RXS
@@ -315,6 +355,7 @@ class Print
     std::string output_filename();
     std::string output_filepath(const std::string &path);
     private:
+    void _infill(PrintObject* object);
     void clear_regions();
     void delete_region(size_t idx);
     PrintRegionConfig _region_config_from_model_volume(const ModelVolume &volume);
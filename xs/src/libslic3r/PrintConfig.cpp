@@ -1281,6 +1281,38 @@ PrintConfigDef::PrintConfigDef()
     def->min = 0;
     def->default_value = new ConfigOptionInt(1);
     
+    def = this->add("sla_antialiasing", coInt);
+    def->label = __TRANS("Antialiasing samples");
+    def->tooltip = __TRANS("Number of scanlines sampled for each row of pixels of the exported SLA masks. Edge pixels get a gray level proportional to their covered area. Set this to 1 for black and white masks.");
+    def->cli = "sla-antialiasing=i";
+    def->min = 1;
+    def->max = 16;
+    def->default_value = new ConfigOptionInt(4);
+
+    def = this->add("sla_display_height", coInt);
+    def->label = __TRANS("Display height");
+    def->tooltip = __TRANS("Vertical resolution of the display of the SLA printer.");
+    def->sidetext = __TRANS("pixels");
+    def->cli = "sla-display-height=i";
+    def->min = 1;
+    def->default_value = new ConfigOptionInt(2160);
+
+    def = this->add("sla_display_width", coInt);
+    def->label = __TRANS("Display width");
+    def->tooltip = __TRANS("Horizontal resolution of the display of the SLA printer.");
+    def->sidetext = __TRANS("pixels");
+    def->cli = "sla-display-width=i";
+    def->min = 1;
+    def->default_value = new ConfigOptionInt(3840);
+
+    def = this->add("sla_pixel_size", coFloat);
+    def->label = __TRANS("Pixel size");
+    def->tooltip = __TRANS("Size of a pixel of the display of the SLA printer, as projected on the build plate.");
+    def->sidetext = "mm";
+    def->cli = "sla-pixel-size=f";
+    def->min = 0;
+    def->default_value = new ConfigOptionFloat(0.05);
+
     def = this->add("slowdown_below_layer_time", coInt);
     def->label = __TRANS("Slow down if layer print time is below");
     def->tooltip = __TRANS("If layer print time is estimated below this number of seconds, print moves speed will be scaled down to extend duration to this value.");
@@ -1939,6 +1971,12 @@ CLIActionsConfigDef::CLIActionsConfigDef()
     def->cli = "export-svg";
     def->default_value = new ConfigOptionBool(false);
     
+    def = this->add("export_sla", coBool);
+    def->label = __TRANS("Export SLA masks");
+    def->tooltip = __TRANS("Slice the model and export SLA printing layers as a zip of PNG images.");
+    def->cli = "export-sla";
+    def->default_value = new ConfigOptionBool(false);
+
     def = this->add("export_sla_svg", coBool);
     def->label = __TRANS("Export SVG for SLA");
     def->tooltip = __TRANS("Slice the model and export SLA printing layers as SVG.");
@@ -2117,6 +2155,26 @@ CLIMiscConfigDef::CLIMiscConfigDef()
     def->tooltip = __TRANS("The file where the output will be written (if not specified, it will be based on the input file).");
     def->cli = "output|o";
     
+    def = this->add("profile", coString);
+    def->label = __TRANS("Profile");
+    def->tooltip = __TRANS("Record the wall time, CPU time, peak memory growth and item count of each slicing step and parallel loop, and write them to the specified file as a Chrome trace (JSON).");
+    def->cli = "profile";
+    
+    def = this->add("slice_cache", coString);
+    def->label = __TRANS("Slice cache");
+    def->tooltip = __TRANS("Store the slices and toolpaths of each object in the specified directory, and reuse them when the same object is sliced again with the same settings.");
+    def->cli = "slice-cache";
+    
+    def = this->add("stream_infill", coBool);
+    def->label = __TRANS("Stream infill");
+    def->tooltip = __TRANS("Generate the infill toolpaths of each layer while the G-code is being written, and free the toolpaths of each layer once it has been exported. The slices, perimeters and fill surfaces of all layers are still made before the export.");
+    def->cli = "stream-infill";
+    
+    def = this->add("parallel_gcode", coBool);
+    def->label = __TRANS("Parallel G-code");
+    def->tooltip = __TRANS("Write the G-code of each layer in parallel, a few layers ahead, and join the layers at the layer changes. Seams are placed from a corner of each object instead of following the previous layer, and the extruder always retracts before the first extrusion of each object on a layer. The output does not depend on the number of threads.");
+    def->cli = "parallel-gcode";
+    
     #ifdef USE_WX
     def = this->add("autosave", coString);
     def->label = __TRANS("Autosave");
@@ -621,11 +621,20 @@ class SLAPrintConfig
     ConfigOptionFloatOrPercent      perimeter_extrusion_width;
     ConfigOptionInt                 raft_layers;
     ConfigOptionFloat               raft_offset;
+    ConfigOptionInt                 sla_antialiasing;
+    ConfigOptionInt                 sla_display_height;
+    ConfigOptionInt                 sla_display_width;
+    ConfigOptionFloat               sla_pixel_size;
     ConfigOptionBool                support_material;
     ConfigOptionFloatOrPercent      support_material_extrusion_width;
     ConfigOptionFloat               support_material_spacing;
     ConfigOptionInt                 threads;
     
+    SLAPrintConfig(bool initialize = true) : StaticPrintConfig() {
+        if (initialize)
+            this->set_defaults();
+    }
+    
     virtual ConfigOption* optptr(const t_config_option_key &opt_key, bool create = false) {
         OPT_PTR(fill_angle);
         OPT_PTR(fill_density);
@@ -636,6 +645,10 @@ class SLAPrintConfig
         OPT_PTR(perimeter_extrusion_width);
         OPT_PTR(raft_layers);
         OPT_PTR(raft_offset);
+        OPT_PTR(sla_antialiasing);
+        OPT_PTR(sla_display_height);
+        OPT_PTR(sla_display_width);
+        OPT_PTR(sla_pixel_size);
         OPT_PTR(support_material);
         OPT_PTR(support_material_extrusion_width);
         OPT_PTR(support_material_spacing);
@@ -1,6 +1,7 @@
 #include "PrintGCode.hpp"
 #include "PrintConfig.hpp"
 #include "Log.hpp"
+#include "Profiler.hpp"
 #include <ctime>
 #include <iostream>
 
@@ -199,6 +200,13 @@ PrintGCode::output()
         */
     }
 
+    // the fragments are written from the state of the generator before the first layer
+    if (_fragments) {
+        _fragment_template = _gcodegen;
+        _fragment_pp = *_gcodegen.placeholder_parser;
+        _fragment_extruder = _gcodegen.writer.extruder()->id;
+    }
+
     // Do all objects for each layer.
 
     if (config.complete_objects) {
@@ -232,6 +240,15 @@ PrintGCode::output()
                     layers.emplace_back(static_cast<Layer*>(l));
                 }
                 std::sort(layers.begin(), layers.end(), [] (const Layer* a, const Layer* b) { return a->print_z < b->print_z; });
+
+                // the fills of each copy are made again when streaming, as they
+                // are released after writing it
+                const bool last_copy { &copy == &object._shifted_copies.back() };
+                LayerPtrs order {};
+                std::copy_if(layers.cbegin(), layers.cend(), std::back_inserter(order), [] (const Layer* l) { return !l->is_support(); });
+                _fills_made = _fills_requested = _grouped_requested = 0;
+                size_t written {0};
+
                 for (Layer* layer : layers) {
                     // if we are printing the bottom layer of an object, and we have already finished
                     // another one, set first layer temperatures. this happens before the Z move
@@ -247,7 +264,10 @@ PrintGCode::output()
                             _print_first_layer_temperature(false);
                         }
                     }
+                    if (!layer->is_support())
+                        this->_prepare_ahead(order, written++, &copy);
                     this->process_layer(obj_idx, layer, Points({copy}));
+                    if (_streaming) this->_release_layer(layer, last_copy);
                 }
                 this->flush_filters();
                 finished_objects++;
@@ -288,11 +308,23 @@ PrintGCode::output()
 
         // pass the comparator to leave no doubt.
         std::sort(z.begin(), z.end(),  std::less<size_t>());
+
+        // object layers in the order they are written
+        LayerPtrs order {};
+        for (const auto& print_z : z)
+            for (const auto& idx : obj_idx)
+                for (auto* layer : layers[print_z][idx])
+                    if (!layer->is_support()) order.emplace_back(layer);
+        size_t written {0};
+
         //  call process_layers in the order given by obj_idx
         for (const auto& print_z : z) {
             for (const auto& idx : obj_idx) {
-                for (const auto* layer : layers[print_z][idx] ) {
+                for (auto* layer : layers[print_z][idx] ) {
+                    if (!layer->is_support())
+                        this->_prepare_ahead(order, written++);
                     this->process_layer(idx, layer, layer->object()->_shifted_copies);
+                    if (_streaming) this->_release_layer(layer, true);
                 }
             }
             _gcodegen.placeholder_parser->set("layer_z", unscale(print_z));
@@ -370,6 +402,252 @@ PrintGCode::output()
     _print_config(_print.default_region_config);
 }
 
+void
+PrintGCode::_group_extrusions(const Layer* layer, t_layer_extrusions* extrusions) const
+{
+    // We now define a strategy for building perimeters and fills. The separation
+    // between regions doesn't matter in terms of printing order, as we follow
+    // another logic instead:
+    // - we group all extrusions by extruder so that we minimize toolchanges
+    // - we start from the last used extruder
+    // - for each extruder, we group extrusions by island
+    // - for each island, we extrude perimeters first, unless user set the infill_first
+    //   option
+    // (Still, we have to keep track of regions because we need to apply their config)
+
+    // group extrusions by extruder and then by island
+    t_layer_extrusions &by_extruder { *extrusions };
+
+    // cache bounding boxes of layer slices
+    std::vector<BoundingBox> layer_slices_bb;
+    std::transform(layer->slices.cbegin(), layer->slices.cend(), std::back_inserter(layer_slices_bb), [] (const ExPolygon& s)-> BoundingBox { return s.bounding_box(); });
+    auto point_inside_surface = [&layer_slices_bb, &layer] (size_t i, Point point) -> bool {
+        const BoundingBox& bbox { layer_slices_bb.at(i) };
+        return bbox.contains(point) && layer->slices.at(i).contour.contains(point);
+    };
+    const size_t n_slices { layer->slices.size() };
+
+    for (auto region_id = 0U; region_id < _print.regions.size(); ++region_id) {
+        const LayerRegion* layerm;
+        try {
+            layerm = layer->get_region(region_id); // we promise to be good and not give this to anyone who will modify it
+        } catch (std::out_of_range &e) {
+            continue; // if no regions, bail;
+        }
+        const PrintRegion* region { _print.get_region(region_id) };
+        // process perimeters
+        {
+            auto extruder_id = region->config.perimeter_extruder-1;
+            // Casting away const just to avoid double dereferences
+            for(const auto* perimeter_coll : layerm->perimeters.flatten().entities) {
+
+                if(perimeter_coll->length() == 0) continue;  // this shouldn't happen but first_point() would fail
+
+                // perimeter_coll is an ExtrusionPath::Collection object representing a single slice
+                for(auto i = 0U; i < n_slices; i++){
+                    if (// perimeter_coll->first_point does not fit inside any slice
+                        i == n_slices - 1
+                        // perimeter_coll->first_point fits inside ith slice
+                        || point_inside_surface(i, perimeter_coll->first_point())) {
+                        std::get<0>(by_extruder[extruder_id][i])[region_id].append(*perimeter_coll);
+                        break;
+                    }
+                }
+            }
+        }
+
+        // process infill
+        // $layerm->fills is a collection of ExtrusionPath::Collection objects, each one containing
+        // the ExtrusionPath objects of a certain infill "group" (also called "surface"
+        // throughout the code). We can redefine the order of such Collections but we have to
+        // do each one completely at once.
+        for(auto* fill : layerm->fills.flatten(true).entities) {
+            if(fill->length() == 0) continue;  // this shouldn't happen but first_point() would fail
+
+            auto extruder_id = fill->is_solid_infill()
+                ? region->config.solid_infill_extruder-1
+                : region->config.infill_extruder-1;
+
+            // $fill is an ExtrusionPath::Collection object
+            for(auto i = 0U; i < n_slices; i++){
+                if (i == n_slices - 1
+                    || point_inside_surface(i, fill->first_point())) {
+                    std::get<1>(by_extruder[extruder_id][i])[region_id].append(*fill);
+                    break;
+                }
+            }
+        }
+    }
+}
+
+void
+PrintGCode::_prepare_ahead(const LayerPtrs &order, size_t next, const Point* copy)
+{
+    if (_streaming) this->_make_fills_ahead(order, next);
+    if (next < _grouped_requested) return;
+    
+    // when streaming, only the layers whose fills are made can be grouped
+    const size_t end { std::min(next + _batch_size, _streaming ? _fills_made : order.size()) };
+    std::vector< std::pair<const Layer*, t_layer_extrusions*> > batch;
+    for (size_t i = next; i < end; ++i)
+        batch.emplace_back(order[i], &_grouped[order[i]]);
+    parallelize<size_t>(
+        0,
+        batch.size() - 1,
+        [this, &batch] (size_t i) { this->_group_extrusions(batch[i].first, batch[i].second); },
+        _print.config.threads.value
+    );
+    _grouped_requested = end;
+    if (!_fragments) return;
+
+    // plan the fragments in the order they are written, each one starting with
+    // the extruder the previous one ends with to save toolchanges
+    struct Job {
+        const Layer* layer;
+        Point copy;
+        Fragment* fragment;
+    };
+    std::vector<Job> jobs;
+    for (const auto &grouped : batch) {
+        const Layer* layer { grouped.first };
+        if (!this->_fragment_layer(layer)) continue;
+        const Points copies { copy != nullptr ? Points({*copy}) : layer->object()->_shifted_copies };
+        std::vector<Fragment> &fragments { _written[layer] };
+        fragments.assign(copies.size(), Fragment());
+        for (size_t i = 0; i < copies.size(); ++i) {
+            std::vector<size_t> &extruders { fragments[i].extruders };
+            if (grouped.second->count(_fragment_extruder) > 0)
+                extruders.push_back(_fragment_extruder);
+            for (const auto &pair : *grouped.second)
+                if (pair.first != _fragment_extruder) extruders.push_back(pair.first);
+            if (!extruders.empty()) _fragment_extruder = extruders.back();
+            jobs.push_back(Job { layer, copies[i], &fragments[i] });
+        }
+    }
+    Profiler::Scope profile("PrintGCode::write_fragments", "PrintGCode", jobs.size());
+    parallelize<size_t>(
+        0,
+        jobs.size() - 1,
+        [this, &jobs] (size_t i) {
+            const Job &job { jobs[i] };
+            *job.fragment = this->_write_fragment(this->_fragment_template, true, job.layer, job.copy,
+                this->_grouped.at(job.layer), job.fragment->extruders);
+        },
+        _print.config.threads.value
+    );
+}
+
+bool
+PrintGCode::_fragment_layer(const Layer* layer) const
+{
+    return _fragments
+        && !layer->is_support()
+        && !config.spiral_vase
+        && layer->object()->config.seam_position != spRandom;
+}
+
+PrintGCode::Fragment
+PrintGCode::_write_fragment(GCode gcodegen, bool ahead, const Layer* layer, const Point &copy,
+    const t_layer_extrusions &by_extruder, const std::vector<size_t> &extruders) const
+{
+    Fragment fragment;
+    fragment.extruders = extruders;
+    if (extruders.empty()) return fragment;
+
+    const PrintObject& obj { *layer->object() };
+    PlaceholderParser pp { _fragment_pp };
+    pp.set("layer_num", layer->id());
+    pp.set("layer_z", layer->print_z);
+    gcodegen.placeholder_parser = &pp;
+    gcodegen.config.apply(obj.config, true);
+    if (ahead) {
+        // the state process_layer() is expected to leave: the other extruders
+        // were put away by a toolchange, the first one printed the layer below,
+        // moved to this one and retracted
+        for (const auto &extruder : gcodegen.writer.extruders)
+            if (extruder.first != extruders.front()) gcodegen.set_extruder(extruder.first);
+        gcodegen.set_extruder(extruders.front());
+        gcodegen.unretract();
+        const coordf_t z { layer->print_z + gcodegen.config.z_offset.value };
+        if (layer->lower_layer != nullptr) {
+            gcodegen.writer.travel_to_z(layer->lower_layer->print_z + gcodegen.config.z_offset.value);
+            if (gcodegen.config.retract_layer_change.get_at(extruders.front()) && gcodegen.writer.will_move_z(z))
+                gcodegen.retract();
+        }
+        gcodegen.writer.travel_to_z(z);
+        gcodegen.retract();
+    }
+    fragment.start = gcodegen.writer;
+
+    gcodegen.set_origin(Pointf::new_unscale(copy));
+    gcodegen.begin_fragment(*layer, obj.bounding_box().min);
+    gcodegen.enable_loop_clipping = this->_spiral_vase_layer(layer);
+    if (!this->_volumetric_speed(layer, &gcodegen.volumetric_speed))
+        gcodegen.volumetric_speed = 0;
+    for (size_t i = 0; i < extruders.size(); ++i) {
+        if (i > 0) fragment.gcode += gcodegen.set_extruder(extruders[i]);
+        for (const auto &island : by_extruder.at(extruders[i]))
+            fragment.gcode += this->_extrude_island(gcodegen, island.second);
+    }
+
+    // the placeholders were only for this fragment
+    gcodegen.placeholder_parser = nullptr;
+    fragment.end = gcodegen;
+    return fragment;
+}
+
+void
+PrintGCode::_make_fills_ahead(const LayerPtrs &order, size_t next)
+{
+    if (next < _fills_made) return;
+    
+    // wait for the batch made in the background, if any
+    if (_fills_ahead.valid()) {
+        _fills_ahead.get();
+        _fills_made = _fills_requested;
+    }
+    const int threads { _print.config.threads.value };
+    if (next >= _fills_made) {
+        _fills_requested = std::min(order.size(), next + _batch_size);
+        parallelize<Layer*>(
+            LayerPtrs(order.begin() + next, order.begin() + _fills_requested),
+            [] (Layer* layer) { layer->make_fills(); },
+            threads
+        );
+        _fills_made = _fills_requested;
+    }
+    
+    // start on the next batch while this one is written
+    if (_fills_requested < order.size()) {
+        const LayerPtrs batch(order.begin() + _fills_requested,
+            order.begin() + std::min(order.size(), _fills_requested + _batch_size));
+        _fills_requested += batch.size();
+        _fills_ahead = std::async(std::launch::async, [batch, threads] () {
+            parallelize<Layer*>(batch, [] (Layer* layer) { layer->make_fills(); }, threads);
+        });
+    }
+}
+
+void
+PrintGCode::_release_layer(Layer* layer, bool last_copy)
+{
+    if (layer->is_support()) {
+        if (!last_copy) return;
+        SupportLayer* slayer { static_cast<SupportLayer*>(layer) };
+        slayer->support_fills.clear();
+        slayer->support_interface_fills.clear();
+        return;
+    }
+    for (auto* layerm : layer->regions) {
+        layerm->fills.clear();
+        if (last_copy) {
+            layerm->perimeters.clear();
+            layerm->thin_fills.clear();
+            layerm->fill_surfaces.clear();
+        }
+    }
+}
+
 std::string
 PrintGCode::filter(const std::string& in, bool wait)
 {
@@ -385,15 +663,7 @@ PrintGCode::process_layer(size_t idx, const Layer* layer, const Points& copies)
     _gcodegen.config.apply(obj.config, true);
 
     // check for usage of spiralvase logic.
-    this->_spiral_vase.enable = (
-            layer->id() > 0
-            && (_print.config.skirts == 0 || (layer->id() >= _print.config.skirt_height && !_print.has_infinite_skirt()))
-            && std::find_if(layer->regions.cbegin(), layer->regions.cend(), [layer] (const LayerRegion* l)
-                { return    l->region()->config.bottom_solid_layers > layer->id()
-                         || l->perimeters.items_count() > 1
-                         || l->fills.items_count() > 0;
-                }) == layer->regions.cend()
-            );
+    this->_spiral_vase.enable = this->_spiral_vase_layer(layer);
     this->_gcodegen.enable_loop_clipping = this->_spiral_vase.enable;
 
 
@@ -401,64 +671,7 @@ PrintGCode::process_layer(size_t idx, const Layer* layer, const Points& copies)
     // if using spiralvase, disable loop clipping.
 
     // initialize autospeed.
-    {
-        // get the minimum cross-section used in the layer.
-        std::vector<double> mm3_per_mm;
-        for (auto region_id = 0U; region_id < _print.regions.size(); ++region_id) {
-            const PrintRegion* region = _print.get_region(region_id);
-            if( region_id >= layer->region_count() ){
-		Slic3r::Log::error("Layer processing") << "Layer #" << layer->id() 
-		    << " doesn't have region " << region_id << ". "
-		    << " The layer has " << layer->region_count() << " regions."
-		    << std::endl;
-		break;
-	    }
-            const LayerRegion* layerm = layer->get_region(region_id);
-
-            if (!(region->config.get_abs_value("perimeter_speed") > 0 &&
-                region->config.get_abs_value("small_perimeter_speed") > 0 &&
-                region->config.get_abs_value("external_perimeter_speed") > 0 &&
-                region->config.get_abs_value("bridge_speed") > 0))
-            {
-                mm3_per_mm.emplace_back(layerm->perimeters.min_mm3_per_mm());
-            }
-            if (!(region->config.get_abs_value("infill_speed") > 0 &&
-                region->config.get_abs_value("solid_infill_speed") > 0 &&
-                region->config.get_abs_value("top_solid_infill_speed") > 0 &&
-                region->config.get_abs_value("bridge_speed") > 0 &&
-                region->config.get_abs_value("gap_fill_speed") > 0)) // TODO: make this configurable?
-            {
-                mm3_per_mm.emplace_back(layerm->fills.min_mm3_per_mm());
-            }
-        }
-        if (typeid(layer) == typeid(SupportLayer*)) {
-            const SupportLayer* slayer = dynamic_cast<const SupportLayer*>(layer);
-            if (!(obj.config.get_abs_value("support_material_speed") > 0 &&
-                  obj.config.get_abs_value("support_material_interface_speed") > 0))
-            {
-                mm3_per_mm.emplace_back(slayer->support_fills.min_mm3_per_mm());
-                mm3_per_mm.emplace_back(slayer->support_interface_fills.min_mm3_per_mm());
-            }
-
-        }
-
-        // ignore too-thin segments.
-        // TODO make the definition of "too thin" based on a config somewhere
-        mm3_per_mm.erase(std::remove_if(mm3_per_mm.begin(), mm3_per_mm.end(), [] (const double& vol) { return vol <= 0.01;} ), mm3_per_mm.end());
-        if (mm3_per_mm.size() > 0) {
-            const double min_mm3_per_mm { *(std::min_element(mm3_per_mm.begin(), mm3_per_mm.end())) };
-            // In order to honor max_print_speed we need to find a target volumetric
-            // speed that we can use throughout the _print. So we define this target
-            // volumetric speed as the volumetric speed produced by printing the
-            // smallest cross-section at the maximum speed: any larger cross-section
-            // will need slower feedrates.
-            double volumetric_speed { min_mm3_per_mm * config.max_print_speed };
-            if (config.max_volumetric_speed > 0) {
-                volumetric_speed = std::min(volumetric_speed, config.max_volumetric_speed.getFloat());
-            }
-            _gcodegen.volumetric_speed = volumetric_speed;
-        }
-    }
+    this->_volumetric_speed(layer, &_gcodegen.volumetric_speed);
     // set the second layer + temp
     if (!this->_second_layer_things_done && layer->id() == 1) {
         for (const auto& extruder_ref : _gcodegen.writer.extruders) {
@@ -572,6 +785,18 @@ PrintGCode::process_layer(size_t idx, const Layer* layer, const Points& copies)
         _gcodegen.avoid_crossing_perimeters.disable_once = true;
     }
 
+    // group extrusions by extruder and then by island, if not done ahead
+    t_layer_extrusions by_extruder;
+    const auto grouped = _grouped.find(layer);
+    if (grouped != _grouped.end()) {
+        by_extruder = std::move(grouped->second);
+        _grouped.erase(grouped);
+    } else {
+        this->_group_extrusions(layer, &by_extruder);
+    }
+    // and its fragments, if written ahead
+    const auto written = _written.find(layer);
+
     auto copy_idx = 0U;
     for (const auto& copy : copies) {
         if (config.label_printed_objects) {
@@ -605,110 +830,34 @@ PrintGCode::process_layer(size_t idx, const Layer* layer, const Points& copies)
                 }
             }
         }
-        // We now define a strategy for building perimeters and fills. The separation
-        // between regions doesn't matter in terms of printing order, as we follow
-        // another logic instead:
-        // - we group all extrusions by extruder so that we minimize toolchanges
-        // - we start from the last used extruder
-        // - for each extruder, we group extrusions by island
-        // - for each island, we extrude perimeters first, unless user set the infill_first
-        //   option
-        // (Still, we have to keep track of regions because we need to apply their config)
-
-        // group extrusions by extruder and then by island
-        //       extruder        island
-        std::map<size_t,std::map<size_t,
-            //                  region
-            std::tuple<std::map<size_t,ExtrusionEntityCollection>, // perimeters
-                       std::map<size_t,ExtrusionEntityCollection>>  // infill
-        >> by_extruder;
-
-        // cache bounding boxes of layer slices
-        std::vector<BoundingBox> layer_slices_bb;
-        std::transform(layer->slices.cbegin(), layer->slices.cend(), std::back_inserter(layer_slices_bb), [] (const ExPolygon& s)-> BoundingBox { return s.bounding_box(); });
-        auto point_inside_surface = [&layer_slices_bb, &layer] (size_t i, Point point) -> bool {
-            const BoundingBox& bbox { layer_slices_bb.at(i) };
-            return bbox.contains(point) && layer->slices.at(i).contour.contains(point);
-        };
-        const size_t n_slices { layer->slices.size() };
-
-        for (auto region_id = 0U; region_id < _print.regions.size(); ++region_id) {
-            const LayerRegion* layerm;
-            try {
-                layerm = layer->get_region(region_id); // we promise to be good and not give this to anyone who will modify it
-            } catch (std::out_of_range &e) {
-                continue; // if no regions, bail;
-            }
-            const PrintRegion* region { _print.get_region(region_id) };
-            // process perimeters
-            {
-                auto extruder_id = region->config.perimeter_extruder-1;
-                // Casting away const just to avoid double dereferences
-                for(const auto* perimeter_coll : layerm->perimeters.flatten().entities) {
-
-                    if(perimeter_coll->length() == 0) continue;  // this shouldn't happen but first_point() would fail
-
-                    // perimeter_coll is an ExtrusionPath::Collection object representing a single slice
-                    for(auto i = 0U; i < n_slices; i++){
-                        if (// perimeter_coll->first_point does not fit inside any slice
-                            i == n_slices - 1
-                            // perimeter_coll->first_point fits inside ith slice
-                            || point_inside_surface(i, perimeter_coll->first_point())) {
-                            std::get<0>(by_extruder[extruder_id][i])[region_id].append(*perimeter_coll);
-                            break;
-                        }
-                    }
-                }
-            }
-
-            // process infill
-            // $layerm->fills is a collection of ExtrusionPath::Collection objects, each one containing
-            // the ExtrusionPath objects of a certain infill "group" (also called "surface"
-            // throughout the code). We can redefine the order of such Collections but we have to
-            // do each one completely at once.
-            for(auto* fill : layerm->fills.flatten(true).entities) {
-                if(fill->length() == 0) continue;  // this shouldn't happen but first_point() would fail
-
-                auto extruder_id = fill->is_solid_infill()
-                    ? region->config.solid_infill_extruder-1
-                    : region->config.infill_extruder-1;
-
-                // $fill is an ExtrusionPath::Collection object
-                for(auto i = 0U; i < n_slices; i++){
-                    if (i == n_slices - 1
-                        || point_inside_surface(i, fill->first_point())) {
-                        std::get<1>(by_extruder[extruder_id][i])[region_id].append(*fill);
-                        break;
-                    }
+        if (written != _written.end()) {
+            Fragment& fragment { written->second.at(copy_idx) };
+            if (!fragment.extruders.empty()) {
+                // bring the generator to the state the fragment starts from
+                gcode += _gcodegen.set_extruder(fragment.extruders.front());
+                gcode += _gcodegen.retract();
+                gcode += _gcodegen.travel_to_fragment(fragment.end);
+                if (!_gcodegen.writer.same_state(fragment.start)) {
+                    Profiler::Scope profile("PrintGCode::rewrite_fragment", "PrintGCode", 1);
+                    fragment = this->_write_fragment(_gcodegen, false, layer, copy, by_extruder, fragment.extruders);
+                    gcode += _gcodegen.travel_to_fragment(fragment.end);
                 }
+                gcode += fragment.gcode;
+                _gcodegen.end_fragment(fragment.end);
             }
-        }
+        } else {
+            // tweak extruder ordering to save toolchanges
 
-        // tweak extruder ordering to save toolchanges
-
-        auto last_extruder = _gcodegen.writer.extruder()->id;
-        if (by_extruder.count(last_extruder)) {
-            for(auto &island : by_extruder[last_extruder]) {
-               if (_print.config.infill_first()) {
-                    gcode += this->_extrude_infill(std::get<1>(island.second));
-                    gcode += this->_extrude_perimeters(std::get<0>(island.second));
-                } else {
-                    gcode += this->_extrude_perimeters(std::get<0>(island.second));
-                    gcode += this->_extrude_infill(std::get<1>(island.second));
-                }
+            auto last_extruder = _gcodegen.writer.extruder()->id;
+            if (by_extruder.count(last_extruder)) {
+                for(auto &island : by_extruder[last_extruder])
+                    gcode += this->_extrude_island(_gcodegen, island.second);
             }
-        }
-        for(auto &pair : by_extruder) {
-            if(pair.first == last_extruder)continue;
-            gcode += _gcodegen.set_extruder(pair.first);
-            for(auto &island : pair.second) {
-               if (_print.config.infill_first()) {
-                    gcode += this->_extrude_infill(std::get<1>(island.second));
-                    gcode += this->_extrude_perimeters(std::get<0>(island.second));
-                } else {
-                    gcode += this->_extrude_perimeters(std::get<0>(island.second));
-                    gcode += this->_extrude_infill(std::get<1>(island.second));
-                }
+            for(auto &pair : by_extruder) {
+                if(pair.first == last_extruder)continue;
+                gcode += _gcodegen.set_extruder(pair.first);
+                for(auto &island : pair.second)
+                    gcode += this->_extrude_island(_gcodegen, island.second);
             }
         }
         if (config.label_printed_objects) {
@@ -728,18 +877,109 @@ PrintGCode::process_layer(size_t idx, const Layer* layer, const Points& copies)
 
     // write the resulting gcode
     fh << this->filter(gcode);
+    if (written != _written.end()) _written.erase(written);
 }
 
 
+bool
+PrintGCode::_spiral_vase_layer(const Layer* layer) const
+{
+    return layer->id() > 0
+        && (_print.config.skirts == 0 || (layer->id() >= _print.config.skirt_height && !_print.has_infinite_skirt()))
+        && std::find_if(layer->regions.cbegin(), layer->regions.cend(), [layer] (const LayerRegion* l)
+            { return    l->region()->config.bottom_solid_layers > layer->id()
+                     || l->perimeters.items_count() > 1
+                     || l->fills.items_count() > 0;
+            }) == layer->regions.cend();
+}
+
+bool
+PrintGCode::_volumetric_speed(const Layer* layer, double* speed) const
+{
+    const PrintObject& obj { *layer->object() };
+    // get the minimum cross-section used in the layer.
+    std::vector<double> mm3_per_mm;
+    for (auto region_id = 0U; region_id < _print.regions.size(); ++region_id) {
+        const PrintRegion* region = _print.get_region(region_id);
+        if( region_id >= layer->region_count() ){
+		Slic3r::Log::error("Layer processing") << "Layer #" << layer->id() 
+		    << " doesn't have region " << region_id << ". "
+		    << " The layer has " << layer->region_count() << " regions."
+		    << std::endl;
+		break;
+	    }
+        const LayerRegion* layerm = layer->get_region(region_id);
+
+        if (!(region->config.get_abs_value("perimeter_speed") > 0 &&
+            region->config.get_abs_value("small_perimeter_speed") > 0 &&
+            region->config.get_abs_value("external_perimeter_speed") > 0 &&
+            region->config.get_abs_value("bridge_speed") > 0))
+        {
+            mm3_per_mm.emplace_back(layerm->perimeters.min_mm3_per_mm());
+        }
+        if (!(region->config.get_abs_value("infill_speed") > 0 &&
+            region->config.get_abs_value("solid_infill_speed") > 0 &&
+            region->config.get_abs_value("top_solid_infill_speed") > 0 &&
+            region->config.get_abs_value("bridge_speed") > 0 &&
+            region->config.get_abs_value("gap_fill_speed") > 0)) // TODO: make this configurable?
+        {
+            mm3_per_mm.emplace_back(layerm->fills.min_mm3_per_mm());
+        }
+    }
+    if (typeid(layer) == typeid(SupportLayer*)) {
+        const SupportLayer* slayer = dynamic_cast<const SupportLayer*>(layer);
+        if (!(obj.config.get_abs_value("support_material_speed") > 0 &&
+              obj.config.get_abs_value("support_material_interface_speed") > 0))
+        {
+            mm3_per_mm.emplace_back(slayer->support_fills.min_mm3_per_mm());
+            mm3_per_mm.emplace_back(slayer->support_interface_fills.min_mm3_per_mm());
+        }
+
+    }
+
+    // ignore too-thin segments.
+    // TODO make the definition of "too thin" based on a config somewhere
+    mm3_per_mm.erase(std::remove_if(mm3_per_mm.begin(), mm3_per_mm.end(), [] (const double& vol) { return vol <= 0.01;} ), mm3_per_mm.end());
+    if (mm3_per_mm.size() > 0) {
+        const double min_mm3_per_mm { *(std::min_element(mm3_per_mm.begin(), mm3_per_mm.end())) };
+        // In order to honor max_print_speed we need to find a target volumetric
+        // speed that we can use throughout the _print. So we define this target
+        // volumetric speed as the volumetric speed produced by printing the
+        // smallest cross-section at the maximum speed: any larger cross-section
+        // will need slower feedrates.
+        double volumetric_speed { min_mm3_per_mm * config.max_print_speed };
+        if (config.max_volumetric_speed > 0) {
+            volumetric_speed = std::min(volumetric_speed, config.max_volumetric_speed.getFloat());
+        }
+        *speed = volumetric_speed;
+        return true;
+    }
+    return false;
+}
+
+std::string
+PrintGCode::_extrude_island(GCode &gcodegen, const t_island_extrusions &island) const
+{
+    std::string gcode;
+    if (_print.config.infill_first()) {
+        gcode += this->_extrude_infill(gcodegen, std::get<1>(island));
+        gcode += this->_extrude_perimeters(gcodegen, std::get<0>(island));
+    } else {
+        gcode += this->_extrude_perimeters(gcodegen, std::get<0>(island));
+        gcode += this->_extrude_infill(gcodegen, std::get<1>(island));
+    }
+    return gcode;
+}
+
 // Extrude perimeters: Decide where to put seams (hide or align seams).
 std::string
-PrintGCode::_extrude_perimeters(std::map<size_t,ExtrusionEntityCollection> &by_region)
+PrintGCode::_extrude_perimeters(GCode &gcodegen, const std::map<size_t,ExtrusionEntityCollection> &by_region) const
 {
     std::string gcode = "";
     for(auto& pair : by_region) {
-        this->_gcodegen.config.apply(this->_print.get_region(pair.first)->config);
+        gcodegen.config.apply(this->_print.get_region(pair.first)->config);
         for(auto& ee : pair.second){
-            gcode += this->_gcodegen.extrude(*ee, "perimeter");
+            gcode += gcodegen.extrude(*ee, "perimeter");
         }
     }
     return gcode;
@@ -747,15 +987,15 @@ PrintGCode::_extrude_perimeters(std::map<size_t,ExtrusionEntityCollection> &by_r
 
 // Chain the paths hierarchically by a greedy algorithm to minimize a travel distance.
 std::string
-PrintGCode::_extrude_infill(std::map<size_t,ExtrusionEntityCollection> &by_region)
+PrintGCode::_extrude_infill(GCode &gcodegen, const std::map<size_t,ExtrusionEntityCollection> &by_region) const
 {
     std::string gcode = "";
     for(auto& pair : by_region) {
-        this->_gcodegen.config.apply(this->_print.get_region(pair.first)->config);
+        gcodegen.config.apply(this->_print.get_region(pair.first)->config);
         ExtrusionEntityCollection tmp;
-        pair.second.chained_path_from(this->_gcodegen.last_pos(),&tmp);
+        pair.second.chained_path_from(gcodegen.last_pos(),&tmp);
         for(auto& ee : tmp){
-            gcode += this->_gcodegen.extrude(*ee, "infill");
+            gcode += gcodegen.extrude(*ee, "infill");
         }
     }
     return gcode;
@@ -804,6 +1044,11 @@ PrintGCode::PrintGCode(Slic3r::Print& print, std::ostream& _fh) :
 
     if (config.spiral_vase) _spiral_vase.enable = true;
 
+    // two batches of layers are in flight: the one being written and the one being filled
+    _streaming = _print.stream_infill;
+    _fragments = _print.parallel_gcode;
+    _batch_size = 2 * std::max(1, config.threads.value);
+
     const auto extruders = _print.extruders();
     _gcodegen.set_extruders(extruders.cbegin(), extruders.cend());
 }
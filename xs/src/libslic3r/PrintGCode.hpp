@@ -9,6 +9,7 @@
 #include "ExtrusionEntity.hpp"
 #include "libslic3r.h"
 
+#include <future>
 #include <string>
 #include <iostream>
 #include <regex>
@@ -24,6 +25,12 @@ public:
     void output();
 
     /// Process an individual output for export. Writes to the ostream.
+    /// The G-code of a layer depends on the state the previous layer left
+    /// (position, extruder axis, retraction, seams, wipe path, avoid crossing
+    /// perimeters). The grouping of its extrusions is prepared in parallel ahead
+    /// of it, see _prepare_ahead(); with Print::parallel_gcode so are the
+    /// extrusions of each object copy, which are then joined here to the G-code
+    /// before them, see Fragment.
     void process_layer(size_t idx, const Layer* layer, const Points& copies);
 
     void flush_filters() { fh << this->filter(this->_cooling_buffer.flush(), true); }
@@ -55,17 +62,93 @@ private:
     std::pair<Point, bool> _last_obj_copy {std::pair<Point, bool>(Point(), false)};
     bool _autospeed {false};
 
+    /// Extrusions of an island by region.
+    //                            region
+    typedef std::tuple<std::map<size_t,ExtrusionEntityCollection>, // perimeters
+                       std::map<size_t,ExtrusionEntityCollection>  // infill
+    > t_island_extrusions;
+    /// Extrusions of a layer grouped by extruder, then by island and by region.
+    //       extruder        island
+    typedef std::map<size_t,std::map<size_t,t_island_extrusions>> t_layer_extrusions;
+
+    /// Layers grouped ahead of process_layer(), see _prepare_ahead().
+    std::map<const Layer*, t_layer_extrusions> _grouped;
+    size_t _grouped_requested {0};  ///< layers of the current sequence grouped ahead
+
+    /// The extrusions of a layer for one object copy, written ahead on a copy of
+    /// the G-code generator. The copy starts retracted, with E reset, at the Z
+    /// of the layer and with seams placed from a corner of the object rather
+    /// than from the previous layer (see GCode::begin_fragment()). process_layer()
+    /// brings the generator to that state, travels to the first extrusion and
+    /// appends the fragment; if the state differs from the one the fragment
+    /// started from (extruders used before for the first time, lift above the
+    /// layer height...) the fragment is written again from the actual state.
+    /// Either way the G-code doesn't depend on the number of threads.
+    struct Fragment {
+        std::vector<size_t> extruders;  ///< in the order they are used
+        GCodeWriter start;              ///< writer state the fragment was written from
+        GCode end;                      ///< generator state after the fragment
+        std::string gcode;
+    };
+    /// Parallel export (see Print::parallel_gcode): fragments of the layers grouped
+    /// ahead, for each copy in the order process_layer() gets them.
+    bool _fragments {false};
+    std::map<const Layer*, std::vector<Fragment>> _written;
+    GCode _fragment_template;               ///< the generator before the first layer
+    PlaceholderParser _fragment_pp;         ///< its placeholders
+    size_t _fragment_extruder {0};          ///< extruder the last planned fragment ends with
+
+    /// Streaming export (see Print::stream_infill): fills are made in batches of
+    /// layers, the next batch in the background while the current one is written.
+    bool _streaming {false};
+    size_t _batch_size {1};
+    size_t _fills_made {0};         ///< layers of the current sequence with fills
+    size_t _fills_requested {0};    ///< same, counting the batch in progress
+    std::future<void> _fills_ahead;
+
+    /// Sort the extrusions of a layer by extruder and island. This only depends on
+    /// the layer, not on the G-code written before it.
+    void _group_extrusions(const Layer* layer, t_layer_extrusions* extrusions) const;
+    /// Group the extrusions of a batch of layers from order[next] on in parallel,
+    /// making their fills first when streaming and writing their fragments after
+    /// when exporting in parallel, for copy or for all the copies of each layer;
+    /// process_layer() then only has to write them, in order.
+    void _prepare_ahead(const LayerPtrs &order, size_t next, const Point* copy = nullptr);
+    /// Make sure the fills of order[next] are ready and start on the batch after them.
+    void _make_fills_ahead(const LayerPtrs &order, size_t next);
+    /// Free the toolpaths of a written layer: only its fills when it has to be
+    /// written again for another copy, all of them otherwise.
+    void _release_layer(Layer* layer, bool last_copy);
+
     void _print_first_layer_temperature(bool wait);
     void _print_off_temperature(bool wait);
 
     /// Utility function to print config options as gcode comments
     void _print_config(const ConfigBase& config);
 
+    /// Whether the layer only has the perimeter of a vase, so that spiral vase
+    /// applies to it (and loop clipping doesn't).
+    bool _spiral_vase_layer(const Layer* layer) const;
+    /// Autospeed: the volumetric speed that honors max_print_speed for the
+    /// smallest cross-section of the layer, if any of its speeds is automatic.
+    bool _volumetric_speed(const Layer* layer, double* speed) const;
+
+    /// Whether the layer can be written as fragments (not a support layer, nor
+    /// a spiral vase or random seams, which depend on all the layers before).
+    bool _fragment_layer(const Layer* layer) const;
+    /// Write the fragment of layer for copy on gcodegen, either the template
+    /// brought to the state the fragment starts from (ahead) or a copy of the
+    /// generator of the export.
+    Fragment _write_fragment(GCode gcodegen, bool ahead, const Layer* layer, const Point &copy,
+        const t_layer_extrusions &by_extruder, const std::vector<size_t> &extruders) const;
+    /// The extrusions of an island, in the order given by infill_first.
+    std::string _extrude_island(GCode &gcodegen, const t_island_extrusions &island) const;
+
     // Extrude perimeters: Decide where to put seams (hide or align seams).
-    std::string _extrude_perimeters(std::map<size_t,ExtrusionEntityCollection> &by_region);
+    std::string _extrude_perimeters(GCode &gcodegen, const std::map<size_t,ExtrusionEntityCollection> &by_region) const;
 
     // Chain the paths hierarchically by a greedy algorithm to minimize a travel distance.
-    std::string _extrude_infill(std::map<size_t,ExtrusionEntityCollection> &by_region);
+    std::string _extrude_infill(GCode &gcodegen, const std::map<size_t,ExtrusionEntityCollection> &by_region) const;
 
     /// regular expression to match heater gcodes
     std::regex bed_temp_regex { std::regex("M(?:190|140)", std::regex_constants::icase)};
@@ -3,6 +3,8 @@
 #include "ClipperUtils.hpp"
 #include "Geometry.hpp"
 #include "Log.hpp"
+#include "Profiler.hpp"
+#include "SliceCache.hpp"
 #include "TransformationMatrix.hpp"
 #include <boost/version.hpp>
 #if BOOST_VERSION >= 107300
@@ -303,6 +305,7 @@ PrintObject::invalidate_step(PrintObjectStep step)
     } else if (step == posPrepareInfill) {
         invalidated |= this->invalidate_step(posInfill);
     } else if (step == posInfill) {
+        this->_infill_regions.clear();
         invalidated |= this->_print->invalidate_step(psSkirt);
         invalidated |= this->_print->invalidate_step(psBrim);
     } else if (step == posSlice) {
@@ -332,6 +335,56 @@ PrintObject::invalidate_all_steps()
     return invalidated;
 }
 
+bool
+PrintObject::invalidate_region_step(PrintObjectStep step, size_t region_id)
+{
+    const auto volumes = this->region_volumes.find(region_id);
+    if (volumes == this->region_volumes.end() || volumes->second.empty())
+        return false;
+    
+    // fills are made region by region, so the other regions can keep theirs
+    // unless all of them are to be made again anyway
+    if (step == posInfill && (this->state.is_done(posInfill) || !this->_infill_regions.empty())) {
+        // and only the layers that the volumes of this region reach
+        const std::pair<coordf_t, coordf_t> range = this->_region_z_range(region_id);
+        const auto inserted = this->_infill_regions.insert(std::make_pair(region_id, range));
+        bool invalidated = inserted.second;
+        if (!invalidated) {
+            std::pair<coordf_t, coordf_t> &z = inserted.first->second;
+            z = std::make_pair(std::min(z.first, range.first), std::max(z.second, range.second));
+        }
+        invalidated |= this->state.invalidate(posInfill);
+        invalidated |= this->_print->invalidate_step(psSkirt);
+        invalidated |= this->_print->invalidate_step(psBrim);
+        return invalidated;
+    }
+    return this->invalidate_step(step);
+}
+
+std::pair<coordf_t, coordf_t>
+PrintObject::_region_z_range(size_t region_id)
+{
+    ModelObject &object = *this->model_object();
+    
+    // same placement as in _slice_region(), where only Z matters here
+    TransformationMatrix trafo = object.instances[0]->get_trafo_matrix(true);
+    trafo.applyLeft(TransformationMatrix::mat_translation(0, 0, -object.bounding_box().min.z));
+    
+    BoundingBoxf3 bb;
+    for (int volume_id : this->region_volumes[region_id])
+        bb.merge(object.volumes[volume_id]->get_transformed_bounding_box(trafo));
+    return std::make_pair(bb.min.z, bb.max.z);
+}
+
+bool
+PrintObject::invalidate_region_all_steps(size_t region_id)
+{
+    const auto volumes = this->region_volumes.find(region_id);
+    if (volumes == this->region_volumes.end() || volumes->second.empty())
+        return false;
+    return this->invalidate_all_steps();
+}
+
 bool
 PrintObject::has_support_material() const
 {
@@ -347,26 +400,29 @@ void
 PrintObject::detect_surfaces_type()
 {
     if (this->state.is_done(posDetectSurfaces)) return;
+    Profiler::Scope profile("PrintObject::detect_surfaces_type", "PrintObject");
     this->state.set_started(posDetectSurfaces);
     
     // prerequisites
     this->slice();
     
     parallelize<Layer*>(
-        std::queue<Layer*>(std::deque<Layer*>(this->layers.begin(), this->layers.end())),  // cast LayerPtrs to std::queue<Layer*>
+        this->layers,
         boost::bind(&Slic3r::Layer::detect_surfaces_type, _1),
         this->_print->config.threads.value
     );
     
     this->typed_slices = true;
+    profile.items(this->layers.size());
     this->state.set_done(posDetectSurfaces);
 }
 
 void
 PrintObject::process_external_surfaces()
 {
+    Profiler::Scope profile("PrintObject::process_external_surfaces", "PrintObject", this->layers.size());
     parallelize<Layer*>(
-        std::queue<Layer*>(std::deque<Layer*>(this->layers.begin(), this->layers.end())),  // cast LayerPtrs to std::queue<Layer*>
+        this->layers,
         boost::bind(&Slic3r::Layer::process_external_surfaces, _1),
         this->_print->config.threads.value
     );
@@ -377,6 +433,7 @@ PrintObject::process_external_surfaces()
 void
 PrintObject::bridge_over_infill()
 {
+    Profiler::Scope profile("PrintObject::bridge_over_infill", "PrintObject", this->layers.size());
     FOREACH_REGION(this->_print, region) {
         const size_t region_id = region - this->_print->regions.begin();
         
@@ -869,14 +926,14 @@ void PrintObject::_slice()
     }
 
     // remove collinear points from slice polygons (artifacts from stl-triangulation)
-    std::queue<SurfaceCollection*> queue;
+    std::vector<SurfaceCollection*> slices;
     for (Layer* layer : this->layers) {
         for (LayerRegion* layerm : layer->regions) {
-            queue.push(&layerm->slices);
+            slices.push_back(&layerm->slices);
         }
     }
     parallelize<SurfaceCollection*>(
-        queue,
+        slices,
         boost::bind(&Slic3r::SurfaceCollection::remove_collinear_points, _1),
         this->_print->config.threads.value
     );
@@ -988,6 +1045,13 @@ void
 PrintObject::slice()
 {
     if (this->state.is_done(posSlice)) return;
+    Profiler::Scope profile("PrintObject::slice", "PrintObject");
+    SliceCache* cache = this->_print->slice_cache.get();
+    const std::string cache_key = cache != nullptr ? cache->key(*this, posSlice) : "";
+    if (cache != nullptr && cache->load(cache_key, this, posSlice)) {
+        profile.items(this->layers.size());
+        return;
+    }
     this->state.set_started(posSlice);
     if (_print->status_cb != nullptr) {
         _print->status_cb(10, "Processing triangulated mesh");
@@ -1072,6 +1136,8 @@ PrintObject::slice()
     }
     
     this->typed_slices = false;
+    if (cache != nullptr) cache->store(cache_key, *this, posSlice);
+    profile.items(this->layers.size());
     this->state.set_done(posSlice);
 }
 
@@ -1079,6 +1145,7 @@ void
 PrintObject::make_perimeters()
 {
     if (this->state.is_done(posPerimeters)) return;
+    Profiler::Scope profile("PrintObject::make_perimeters", "PrintObject");
     
     // Temporary workaround for detect_surfaces_type() not being idempotent (see #3764).
     // We can remove this when idempotence is restored. This make_perimeters() method
@@ -1194,7 +1261,7 @@ PrintObject::make_perimeters()
     }
     
     parallelize<Layer*>(
-        std::queue<Layer*>(std::deque<Layer*>(this->layers.begin(), this->layers.end())),  // cast LayerPtrs to std::queue<Layer*>
+        this->layers,
         boost::bind(&Slic3r::Layer::make_perimeters, _1),
         this->_print->config.threads.value
     );
@@ -1206,6 +1273,7 @@ PrintObject::make_perimeters()
     ###$self->_simplify_slices(&Slic3r::SCALED_RESOLUTION);
     */
     
+    profile.items(this->layers.size());
     this->state.set_done(posPerimeters);
 }
 
@@ -1213,21 +1281,58 @@ void
 PrintObject::infill()
 {
     if (this->state.is_done(posInfill)) return;
+    Profiler::Scope profile("PrintObject::infill", "PrintObject");
+    SliceCache* cache = this->_print->slice_cache.get();
+    const std::string cache_key = cache != nullptr ? cache->key(*this, posInfill) : "";
+    if (cache != nullptr && cache->load(cache_key, this, posInfill)) {
+        profile.items(this->layers.size());
+        return;
+    }
     this->state.set_started(posInfill);
     
     // prerequisites
     this->prepare_infill();
     
-    parallelize<Layer*>(
-        std::queue<Layer*>(std::deque<Layer*>(this->layers.begin(), this->layers.end())),  // cast LayerPtrs to std::queue<Layer*>
-        boost::bind(&Slic3r::Layer::make_fills, _1),
-        this->_print->config.threads.value
-    );
+    size_t refilled = this->layers.size();
+    if (this->_infill_regions.empty()) {
+        parallelize<Layer*>(
+            this->layers,
+            boost::bind(&Slic3r::Layer::make_fills, _1),
+            this->_print->config.threads.value
+        );
+    } else {
+        // only some regions changed since the fills were made, and only
+        // the layers that overlap their volumes need new ones
+        const auto regions = this->_infill_regions;
+        const auto in_range = [] (const Layer* layer, const std::pair<coordf_t, coordf_t> &z) {
+            return layer->slice_z + layer->height / 2 > z.first && layer->slice_z - layer->height / 2 < z.second;
+        };
+        LayerPtrs layers;
+        for (Layer* layer : this->layers)
+            for (const auto &region : regions)
+                if (in_range(layer, region.second)) {
+                    layers.push_back(layer);
+                    break;
+                }
+        parallelize<Layer*>(
+            layers,
+            [&regions, &in_range] (Layer* layer) {
+                for (const auto &region : regions)
+                    if (region.first < layer->region_count() && in_range(layer, region.second))
+                        layer->get_region(region.first)->make_fill();
+            },
+            this->_print->config.threads.value
+        );
+        refilled = layers.size();
+        this->_infill_regions.clear();
+    }
     
     /*  we could free memory now, but this would make this step not idempotent
     ### $_->fill_surfaces->clear for map @{$_->regions}, @{$object->layers};
     */
     
+    if (cache != nullptr) cache->store(cache_key, *this, posInfill);
+    profile.items(refilled);
     this->state.set_done(posInfill);
 }
 
@@ -1235,6 +1340,7 @@ void
 PrintObject::prepare_infill()
 {
     if (this->state.is_done(posPrepareInfill)) return;
+    Profiler::Scope profile("PrintObject::prepare_infill", "PrintObject");
     
     // This prepare_infill() is not really idempotent.
     // TODO: It should clear and regenerate fill_surfaces at every run 
@@ -1272,6 +1378,7 @@ PrintObject::prepare_infill()
     // combine fill surfaces to honor the "infill every N layers" option
     this->combine_infill();
 
+    profile.items(this->layers.size());
     this->state.set_done(posPrepareInfill);
 }
 
@@ -1282,6 +1389,11 @@ PrintObject::prepare_infill()
 void
 PrintObject::combine_infill()
 {
+    Profiler::Scope profile("PrintObject::combine_infill", "PrintObject", this->layers.size());
+    // Layers combined together, per region.
+    struct CombinedLayers { size_t region_id, first, last; };
+    std::vector<CombinedLayers> groups;
+
     // Work on each region separately.
     for (size_t region_id = 0; region_id < this->print()->regions.size(); ++ region_id) {
         const PrintRegion *region = this->print()->regions[region_id];
@@ -1325,16 +1437,22 @@ PrintObject::combine_infill()
         }
 
         // loop through layers to which we have assigned layers to combine
-        for (size_t layer_idx = 0; layer_idx < combine.size(); ++layer_idx) {
-            const size_t& num_layers = combine[layer_idx];
-            if (num_layers <= 1)
-                continue;
-            
+        for (size_t layer_idx = 0; layer_idx < combine.size(); ++layer_idx)
+            if (combine[layer_idx] > 1)
+                groups.push_back(CombinedLayers { region_id, layer_idx + 1 - combine[layer_idx], layer_idx });
+    }
+
+    // Each group of combined layers only touches its own layer regions.
+    parallelize<CombinedLayers>(
+        groups,
+        [this] (CombinedLayers group) {
+            const PrintRegion *region = this->print()->regions[group.region_id];
+
             // Get all the LayerRegion objects to be combined.
             std::vector<LayerRegion*> layerms;
-            layerms.reserve(num_layers);
-            for (size_t i = layer_idx + 1 - num_layers; i <= layer_idx; ++i)
-                layerms.push_back(this->layers[i]->regions[region_id]);
+            layerms.reserve(group.last + 1 - group.first);
+            for (size_t i = group.first; i <= group.last; ++i)
+                layerms.push_back(this->layers[i]->regions[group.region_id]);
             
             // We need to perform a multi-layer intersection, so let's split it in pairs.
             
@@ -1355,12 +1473,12 @@ PrintObject::combine_infill()
                 intersection.end());
             
             if (intersection.empty())
-                continue;
+                return;
             
             #ifdef SLIC3R_DEBUG
             std::cout << "  combining " << intersection.size()
-                << " internal regions from layers " << (layer_idx-(every-1))
-                << "-" << layer_idx << std::endl;
+                << " internal regions from layers " << group.first
+                << "-" << group.last << std::endl;
             #endif
             
             // intersection now contains the regions that can be combined across the full amount of layers,
@@ -1383,12 +1501,12 @@ PrintObject::combine_infill()
             for (LayerRegion *layerm : layerms) {
                 const Polygons internal = to_polygons(layerm->fill_surfaces.filter_by_type(stInternal));
                 layerm->fill_surfaces.remove_type(stInternal);
-                
+            
                 layerm->fill_surfaces.append(
                     diff_ex(internal, intersection_with_clearance),
                     stInternal
                 );
-                
+            
                 if (layerm == layerms.back()) {
                     // Apply surfaces back with adjusted depth to the uppermost layer.
                     Surface templ(stInternal, ExPolygon());
@@ -1404,8 +1522,9 @@ PrintObject::combine_infill()
                             (stInternal | stVoid));
                 }
             }
-        }
-    }
+        },
+        this->_print->config.threads.value
+    );
 }
 
 SupportMaterial *
@@ -1463,6 +1582,7 @@ PrintObject::generate_support_material()
     //prereqs 
     this->slice();
     if (this->state.is_done(posSupportMaterial)) { return; }
+    Profiler::Scope profile("PrintObject::generate_support_material", "PrintObject");
 
     this->state.set_started(posSupportMaterial); 
 
@@ -1481,6 +1601,7 @@ PrintObject::generate_support_material()
 
     this->_support_material()->generate(this);
 
+    profile.items(this->support_layers.size());
     this->state.set_done(posSupportMaterial);
 
     std::stringstream stats {""};
@@ -1494,30 +1615,107 @@ PrintObject::generate_support_material()
 void 
 PrintObject::discover_horizontal_shells()
 {
+    Profiler::Scope profile("PrintObject::discover_horizontal_shells", "PrintObject", this->layers.size());
     #ifdef SLIC3R_DEBUG
     std::cout << "==> DISCOVERING HORIZONTAL SHELLS" << std::endl;
     #endif
-    
+
+    // Layers only interact through the shells that their top and bottom surfaces
+    // project onto their neighbors, and each region only touches its own surfaces.
+    // Cut every region into runs of consecutive layers that no shell crosses: the
+    // layers of a run are processed in order, exactly like a serial pass would do,
+    // while distinct runs are independent and processed in parallel.
+    struct ShellRun { size_t region_id, first, last; };
+    std::vector<ShellRun> runs;
+    const int layer_count = int(this->layer_count());
     for (size_t region_id = 0U; region_id < _print->regions.size(); ++region_id) {
-        for (size_t i = 0; i < this->layer_count(); ++i) {
-            auto* layerm = this->get_layer(i)->get_region(region_id);
-            const auto& region_config = layerm->region()->config;
-
-            if (region_config.solid_infill_every_layers() > 0 && region_config.fill_density() > 0
-                && (i % region_config.solid_infill_every_layers()) == 0) {
-                const auto type = region_config.fill_density() == 100 ? (stInternal | stSolid) : (stInternal | stBridge);
-                for (auto* s : layerm->fill_surfaces.filter_by_type(stInternal))
-                    s->surface_type = type;
+        // range of layers touched by the shells of each layer
+        std::vector<int> lowest(layer_count), highest(layer_count);
+        for (int i = 0; i < layer_count; ++i) {
+            const LayerRegion* layerm = this->get_layer(i)->get_region(region_id);
+            lowest[i] = highest[i] = i;
+            for (auto& type : { stTop, stBottom, (stBottom | stBridge) }) {
+                // surfaces of these types are never created by neighbors, so a
+                // layer without them now never projects shells
+                if (layerm->slices.filter_by_type(type).empty() && layerm->fill_surfaces.filter_by_type(type).empty())
+                    continue;
+                const int reach = int(this->_horizontal_shell_layers(layerm, i, type)) - 1;
+                if (type == stTop)
+                    lowest[i] = std::max(0, std::min(lowest[i], i - reach));
+                else
+                    highest[i] = std::min(layer_count - 1, std::max(highest[i], i + reach));
+            }
+        }
+        // a run can end after layer i if no shell of the layers up to i reaches
+        // a layer touched by the shells of the layers above
+        std::vector<int> lowest_above(layer_count + 1, layer_count);
+        for (int i = layer_count - 1; i >= 0; --i)
+            lowest_above[i] = std::min(lowest_above[i + 1], lowest[i]);
+        int reached = -1;
+        size_t first = 0;
+        for (int i = 0; i < layer_count; ++i) {
+            reached = std::max(reached, highest[i]);
+            if (reached < lowest_above[i + 1]) {
+                runs.push_back(ShellRun { region_id, first, size_t(i) });
+                first = i + 1;
+            }
+        }
+    }
+
+    parallelize<ShellRun>(
+        runs,
+        [this] (ShellRun run) {
+            for (size_t i = run.first; i <= run.last; ++i) {
+                auto* layerm = this->get_layer(i)->get_region(run.region_id);
+                const auto& region_config = layerm->region()->config;
+
+                if (region_config.solid_infill_every_layers() > 0 && region_config.fill_density() > 0
+                    && (i % region_config.solid_infill_every_layers()) == 0) {
+                    const auto type = region_config.fill_density() == 100 ? (stInternal | stSolid) : (stInternal | stBridge);
+                    for (auto* s : layerm->fill_surfaces.filter_by_type(stInternal))
+                        s->surface_type = type;
+                }
+                this->_discover_external_horizontal_shells(layerm, i, run.region_id);
+            }
+        },
+        this->_print->config.threads.value
+    );
+}
+
+size_t
+PrintObject::_horizontal_shell_layers(const LayerRegion* layerm, const size_t& i, const SurfaceType& type) const
+{
+    const auto& region_config = layerm->region()->config;
+    size_t solid_layers = type == stTop
+        ? region_config.top_solid_layers()
+        : region_config.bottom_solid_layers();
+    solid_layers = min(solid_layers, this->layers.size());
+
+    if (region_config.min_top_bottom_shell_thickness() > 0) {
+        auto current_shell_thickness = static_cast<coordf_t>(solid_layers) * this->get_layer(i)->height;
+        const auto min_shell_thickness = region_config.min_top_bottom_shell_thickness();
+        Slic3r::Log::debug("vertical_shell_thickness") << "Initial shell thickness for layer " << i << " " 
+                                                       << current_shell_thickness << " "
+                                                       << "Minimum: " << min_shell_thickness << "\n";
+        while (std::abs(min_shell_thickness - current_shell_thickness) > Slic3r::Geometry::epsilon && current_shell_thickness < min_shell_thickness) {
+            solid_layers++;
+            current_shell_thickness = static_cast<coordf_t>(solid_layers) * this->get_layer(i)->height;
+            Slic3r::Log::debug("vertical_shell_thickness") << "Solid layer count: "
+                                                           << solid_layers << "; "
+                                                           << "current_shell_thickness: "
+                                                           << current_shell_thickness
+                                                           << "\n";
+            if (solid_layers > this->layers.size()) {
+                throw std::runtime_error("Infinite loop when determining vertical shell thickness");
             }
-            this->_discover_external_horizontal_shells(layerm, i, region_id);
         }
     }
+    return solid_layers;
 }
 
 void
 PrintObject::_discover_external_horizontal_shells(LayerRegion* layerm, const size_t& i, const size_t& region_id)
 {
-    const auto& region_config = layerm->region()->config;
     for (auto& type : { stTop, stBottom, (stBottom | stBridge) }) {
         // find slices of current type for current layer
         // use slices instead of fill_surfaces because they also include the perimeter area
@@ -1538,30 +1736,7 @@ PrintObject::_discover_external_horizontal_shells(LayerRegion* layerm, const siz
         std::cout << "Layer " << i << " has " << (type == stTop ? "top" : "bottom") << " surfaces" << std::endl;
         #endif
         
-        size_t solid_layers = type == stTop
-            ? region_config.top_solid_layers()
-            : region_config.bottom_solid_layers();
-        solid_layers = min(solid_layers, this->layers.size());
-
-        if (region_config.min_top_bottom_shell_thickness() > 0) {
-            auto current_shell_thickness = static_cast<coordf_t>(solid_layers) * this->get_layer(i)->height;
-            const auto min_shell_thickness = region_config.min_top_bottom_shell_thickness();
-            Slic3r::Log::debug("vertical_shell_thickness") << "Initial shell thickness for layer " << i << " " 
-                                                           << current_shell_thickness << " "
-                                                           << "Minimum: " << min_shell_thickness << "\n";
-            while (std::abs(min_shell_thickness - current_shell_thickness) > Slic3r::Geometry::epsilon && current_shell_thickness < min_shell_thickness) {
-                solid_layers++;
-                current_shell_thickness = static_cast<coordf_t>(solid_layers) * this->get_layer(i)->height;
-                Slic3r::Log::debug("vertical_shell_thickness") << "Solid layer count: "
-                                                               << solid_layers << "; "
-                                                               << "current_shell_thickness: "
-                                                               << current_shell_thickness
-                                                               << "\n";
-                if (solid_layers > this->layers.size()) {
-                    throw std::runtime_error("Infinite loop when determining vertical shell thickness");
-                }
-            }
-        }
+        const size_t solid_layers = this->_horizontal_shell_layers(layerm, i, type);
         _discover_neighbor_horizontal_shells(layerm, i, region_id, type, solid, solid_layers);
     }
 }
@@ -1697,6 +1872,7 @@ PrintObject::_discover_neighbor_horizontal_shells(LayerRegion* layerm, const siz
 void
 PrintObject::clip_fill_surfaces()
 {
+    Profiler::Scope profile("PrintObject::clip_fill_surfaces", "PrintObject", this->layers.size());
     if (! this->config.infill_only_where_needed.value ||
         ! std::any_of(this->print()->regions.begin(), this->print()->regions.end(), 
             [](const PrintRegion *region) { return region->config.fill_density > 0; }))
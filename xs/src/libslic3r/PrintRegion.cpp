@@ -1,4 +1,5 @@
 #include "Print.hpp"
+#include <algorithm>
 
 namespace Slic3r {
 
@@ -148,15 +149,19 @@ PrintRegion::invalidate_state_by_config(const PrintConfigBase &config)
     if (!diff.empty())
         this->config.apply(config, true);
     
+    // only the objects with volumes in this region are affected
+    const PrintRegionPtrs &regions = this->print()->regions;
+    const size_t region_id = std::find(regions.begin(), regions.end(), this) - regions.begin();
+    
     bool invalidated = false;
     if (all) {
         for (PrintObject* object : this->print()->objects)
-            if (object->invalidate_all_steps())
+            if (object->invalidate_region_all_steps(region_id))
                 invalidated = true;
     } else {
         for (const PrintObjectStep &step : steps)
             for (PrintObject* object : this->print()->objects)
-                if (object->invalidate_step(step))
+                if (object->invalidate_region_step(step, region_id))
                     invalidated = true;
     }
     
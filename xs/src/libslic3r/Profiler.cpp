@@ -0,0 +1,192 @@
+#include "Profiler.hpp"
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+#ifdef _WIN32
+    #include <windows.h>
+    #include <psapi.h>
+#else
+    #include <sys/resource.h>
+#endif
+
+namespace Slic3r {
+
+// Innermost open scope of the current thread, to name parallelize() calls
+// and to nest the events.
+static thread_local Profiler::Scope* current_scope = nullptr;
+
+Profiler&
+Profiler::instance()
+{
+    // never destroyed, like the ThreadPool whose jobs it measures
+    static Profiler* profiler = new Profiler();
+    return *profiler;
+}
+
+void
+Profiler::enable()
+{
+    boost::lock_guard<boost::mutex> lock(this->_mutex);
+    this->_events.clear();
+    this->_threads.clear();
+    this->_epoch = std::chrono::steady_clock::now();
+    this->_enabled = true;
+}
+
+std::vector<Profiler::Event>
+Profiler::events() const
+{
+    boost::lock_guard<boost::mutex> lock(this->_mutex);
+    return this->_events;
+}
+
+int64_t
+Profiler::cpu_time_us()
+{
+#ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) return 0;
+    const auto to_us = [](const FILETIME &t) {
+        return int64_t((uint64_t(t.dwHighDateTime) << 32) | t.dwLowDateTime) / 10;
+    };
+    return to_us(kernel) + to_us(user);
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+    return int64_t(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000
+        + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+#endif
+}
+
+int64_t
+Profiler::peak_rss_kb()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return int64_t(counters.PeakWorkingSetSize / 1024);
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+    #ifdef __APPLE__
+    return int64_t(usage.ru_maxrss / 1024);  // bytes
+    #else
+    return int64_t(usage.ru_maxrss);
+    #endif
+#endif
+}
+
+Profiler::Scope::Scope(const char* name, const char* category, size_t items)
+    : _enabled(Profiler::instance().enabled()), _category(category), _items(items)
+{
+    if (!this->_enabled) return;
+    this->_name = name;
+    this->_open();
+}
+
+Profiler::Scope::Scope(const Parallel&, size_t items, int threads)
+    : _enabled(Profiler::instance().enabled()), _category("parallelize"), _items(items), _threads(threads)
+{
+    if (!this->_enabled) return;
+    Scope* parent = current_scope;
+    if (parent != nullptr) {
+        this->_name = parent->_name + "/parallelize#" + std::to_string(++parent->_parallel_calls);
+    } else {
+        this->_name = "parallelize";
+    }
+    this->_open();
+}
+
+void
+Profiler::Scope::_open()
+{
+    this->_parent = current_scope;
+    current_scope = this;
+    this->_cpu_us = Profiler::cpu_time_us();
+    this->_peak_rss_kb = Profiler::peak_rss_kb();
+    this->_start = std::chrono::steady_clock::now();
+}
+
+Profiler::Scope::~Scope()
+{
+    if (!this->_enabled) return;
+    current_scope = this->_parent;
+    Profiler::instance()._record(*this);
+}
+
+void
+Profiler::_record(const Scope &scope)
+{
+    const auto end = std::chrono::steady_clock::now();
+    const int64_t cpu_us = Profiler::cpu_time_us();
+    const int64_t peak_rss_kb = Profiler::peak_rss_kb();
+
+    boost::lock_guard<boost::mutex> lock(this->_mutex);
+    // the profiler was restarted while this scope was open
+    if (scope._start < this->_epoch) return;
+
+    const boost::thread::id id = boost::this_thread::get_id();
+    size_t thread = std::find(this->_threads.begin(), this->_threads.end(), id) - this->_threads.begin();
+    if (thread == this->_threads.size()) this->_threads.push_back(id);
+
+    Event event;
+    event.name              = scope._name;
+    event.category          = scope._category;
+    event.thread            = thread;
+    event.start_us          = std::chrono::duration_cast<std::chrono::microseconds>(scope._start - this->_epoch).count();
+    event.wall_us           = std::chrono::duration_cast<std::chrono::microseconds>(end - scope._start).count();
+    event.cpu_us            = cpu_us - scope._cpu_us;
+    event.peak_rss_delta_kb = peak_rss_kb - scope._peak_rss_kb;
+    event.items             = scope._items;
+    event.threads           = scope._threads;
+    this->_events.push_back(event);
+}
+
+// Names are our own identifiers, but don't let a quote break the JSON.
+static std::string
+json_escape(const std::string &str)
+{
+    std::string retval;
+    retval.reserve(str.size());
+    for (char c : str) {
+        if (c == '"' || c == '\\') retval += '\\';
+        retval += c;
+    }
+    return retval;
+}
+
+void
+Profiler::write_trace(std::ostream &out) const
+{
+    const std::vector<Event> events = this->events();
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    for (size_t i = 0; i < events.size(); ++i) {
+        const Event &e = events[i];
+        if (i > 0) out << ",";
+        out << "\n{\"name\":\"" << json_escape(e.name) << "\""
+            << ",\"cat\":\"" << json_escape(e.category) << "\""
+            << ",\"ph\":\"X\",\"pid\":0"
+            << ",\"tid\":" << e.thread
+            << ",\"ts\":" << e.start_us
+            << ",\"dur\":" << e.wall_us
+            << ",\"args\":{\"cpu_us\":" << e.cpu_us
+            << ",\"peak_rss_delta_kb\":" << e.peak_rss_delta_kb
+            << ",\"items\":" << e.items;
+        if (e.threads > 0) out << ",\"threads\":" << e.threads;
+        out << "}}";
+    }
+    out << "\n]}\n";
+}
+
+void
+Profiler::write_trace(const std::string &file) const
+{
+    std::ofstream out(file.c_str());
+    if (!out) throw std::runtime_error("Can't open " + file + " for writing");
+    this->write_trace(out);
+    out.close();
+    if (!out) throw std::runtime_error("Error while writing " + file);
+}
+
+}
@@ -0,0 +1,112 @@
+#ifndef slic3r_Profiler_hpp_
+#define slic3r_Profiler_hpp_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <boost/thread.hpp>
+
+namespace Slic3r {
+
+/// Process-wide recorder of where time and memory go during a slice.
+/// Steps of Print and PrintObject and parallelize() calls open a Scope; when
+/// the profiler is enabled, each scope records its wall time, the CPU time
+/// used by the process (all threads) meanwhile, how much the peak resident
+/// set size grew and the number of items it handled. Disabled (the default),
+/// a Scope costs a single atomic load.
+/// The events are written as a Chrome trace (JSON) that can be loaded in
+/// chrome://tracing or Perfetto; the measurements are in the args of each event.
+class Profiler
+{
+    public:
+    /// One closed scope.
+    struct Event {
+        std::string name;
+        std::string category;
+        size_t thread;              ///< small id, in order of first appearance
+        int64_t start_us;           ///< since the profiler was enabled
+        int64_t wall_us;
+        int64_t cpu_us;
+        int64_t peak_rss_delta_kb;
+        size_t items;
+        int threads;                ///< threads requested by a parallelize() call, 0 otherwise
+    };
+
+    /// RAII measurement of a block. Nested scopes of the same thread are
+    /// nested events of the trace.
+    class Scope
+    {
+        public:
+        /// Tag of the scopes opened by parallelize().
+        struct Parallel {};
+
+        Scope(const char* name, const char* category, size_t items = 0);
+        /// Scope of a parallelize() call over items with the given number of
+        /// threads, named after the enclosing scope of the calling thread.
+        Scope(const Parallel&, size_t items, int threads);
+        ~Scope();
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        /// Number of items (layers, loops...) handled by the block.
+        void items(size_t items) { this->_items = items; };
+
+        private:
+        bool _enabled;
+        std::string _name;
+        const char* _category;
+        size_t _items;
+        int _threads {0};
+        size_t _parallel_calls {0};
+        Scope* _parent {nullptr};
+        std::chrono::steady_clock::time_point _start;
+        int64_t _cpu_us {0};
+        int64_t _peak_rss_kb {0};
+
+        void _open();
+
+        friend class Profiler;
+    };
+
+    /// The shared profiler.
+    static Profiler& instance();
+
+    /// Start recording, dropping the events recorded so far.
+    void enable();
+    void disable() { this->_enabled = false; };
+    bool enabled() const { return this->_enabled; };
+
+    /// Copy of the events recorded so far, in the order they were closed.
+    std::vector<Event> events() const;
+
+    /// Write the recorded events as a Chrome trace.
+    void write_trace(std::ostream &out) const;
+    /// Write the recorded events as a Chrome trace to file.
+    /// Throws std::runtime_error if the file can't be written.
+    void write_trace(const std::string &file) const;
+
+    /// CPU time used by the process so far, in microseconds.
+    static int64_t cpu_time_us();
+    /// Peak resident set size of the process so far, in kilobytes.
+    static int64_t peak_rss_kb();
+
+    private:
+    Profiler() : _enabled(false) {};
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+
+    std::atomic<bool> _enabled;
+    std::chrono::steady_clock::time_point _epoch;
+    mutable boost::mutex _mutex;
+    std::vector<Event> _events;
+    std::vector<boost::thread::id> _threads;
+
+    void _record(const Scope &scope);
+};
+
+}
+
+#endif
@@ -0,0 +1,140 @@
+#include "Raster.hpp"
+#include <miniz/miniz.h>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace Slic3r {
+
+namespace {
+
+/// Polygon edge in pixel coordinates, with y0 < y1.
+struct Edge {
+    double y0, y1, x0, dxdy;
+    bool operator<(const Edge &other) const { return this->y0 < other.y0; };
+};
+
+}
+
+Raster::Raster(size_t width, size_t height, double pixel_size, const Pointf &origin, unsigned int samples)
+    : _width(width), _height(height), _pixel_size(pixel_size), _origin(origin),
+      _samples(std::max(samples, 1u)), _pixels(width * height, 0)
+{}
+
+void
+Raster::draw(const Polygons &polygons)
+{
+    // collect the non-horizontal edges in pixel coordinates, rows going down
+    std::vector<Edge> edges;
+    double ymax = 0;
+    for (const Polygon &polygon : polygons) {
+        const size_t n = polygon.points.size();
+        if (n < 3) continue;
+        for (size_t i = 0; i < n; ++i) {
+            const Point &a = polygon.points[i], &b = polygon.points[(i + 1) % n];
+            double ax = (unscale(a.x) - this->_origin.x) / this->_pixel_size;
+            double ay = (this->_origin.y - unscale(a.y)) / this->_pixel_size;
+            double bx = (unscale(b.x) - this->_origin.x) / this->_pixel_size;
+            double by = (this->_origin.y - unscale(b.y)) / this->_pixel_size;
+            if (ay == by) continue;
+            if (ay > by) {
+                std::swap(ax, bx);
+                std::swap(ay, by);
+            }
+            edges.push_back(Edge { ay, by, ax, (bx - ax) / (by - ay) });
+            ymax = std::max(ymax, by);
+        }
+    }
+    if (edges.empty()) return;
+    std::sort(edges.begin(), edges.end());
+
+    const int first_row = std::max(0, int(std::floor(edges.front().y0)));
+    const int last_row = std::min(int(this->_height) - 1, int(std::ceil(ymax)));
+    const int width = int(this->_width);
+
+    // coverage of the current row: fractional coverage of the span ends, and
+    // a difference array counting the fully covered pixels; only the columns
+    // in [lo, hi) were touched and need to be accumulated and cleared
+    std::vector<float> partial(this->_width);
+    std::vector<int> full(this->_width + 1);
+    std::vector<size_t> active;
+    std::vector<double> crossings;
+    size_t next_edge = 0;
+    for (int row = first_row; row <= last_row; ++row) {
+        int lo = width, hi = 0;
+        for (unsigned int sample = 0; sample < this->_samples; ++sample) {
+            const double y = row + (sample + 0.5) / this->_samples;
+
+            // edges crossing this scanline, as half-open [y0, y1) ranges
+            while (next_edge < edges.size() && edges[next_edge].y0 <= y)
+                active.push_back(next_edge++);
+            crossings.clear();
+            size_t kept = 0;
+            for (size_t idx : active) {
+                const Edge &e = edges[idx];
+                if (e.y1 <= y) continue;
+                active[kept++] = idx;
+                crossings.push_back(e.x0 + (y - e.y0) * e.dxdy);
+            }
+            active.resize(kept);
+            std::sort(crossings.begin(), crossings.end());
+
+            // even-odd rule: pixels between pairs of crossings are inside
+            for (size_t i = 0; i + 1 < crossings.size(); i += 2) {
+                if (this->_samples == 1) {
+                    // pixels whose center is inside
+                    const int begin = std::max(0, int(std::ceil(crossings[i] - 0.5)));
+                    const int end = std::min(width, int(std::ceil(crossings[i + 1] - 0.5)));
+                    if (begin >= end) continue;
+                    lo = std::min(lo, begin);
+                    hi = std::max(hi, end);
+                    ++full[begin];
+                    --full[end];
+                    continue;
+                }
+                const double a = std::max(0., std::min(double(width), crossings[i]));
+                const double b = std::max(0., std::min(double(width), crossings[i + 1]));
+                if (b <= a) continue;
+                const int ia = int(a), ib = int(b);
+                lo = std::min(lo, ia);
+                hi = std::max(hi, std::min(width, ib + 1));
+                if (ia == ib) {
+                    partial[ia] += float(b - a);
+                } else {
+                    partial[ia] += float(ia + 1 - a);
+                    ++full[ia + 1];
+                    --full[ib];
+                    if (ib < width) partial[ib] += float(b - ib);
+                }
+            }
+        }
+
+        uint8_t* pixels = &this->_pixels[row * this->_width];
+        int covered = 0;
+        for (int x = lo; x < hi; ++x) {
+            covered += full[x];
+            const float coverage = (covered + partial[x]) / this->_samples;
+            full[x] = 0;
+            partial[x] = 0.f;
+            if (coverage <= 0) continue;
+            const int value = pixels[x] + int(std::lround(std::min(coverage, 1.f) * 255));
+            pixels[x] = uint8_t(std::min(value, 255));
+        }
+        full[hi] = 0;
+    }
+}
+
+std::string
+Raster::png(int level) const
+{
+    size_t size = 0;
+    void* data = tdefl_write_image_to_png_file_in_memory_ex(
+        this->_pixels.data(), int(this->_width), int(this->_height), 1, &size, mz_uint(level), MZ_FALSE);
+    if (data == nullptr)
+        throw std::runtime_error("PNG encoding failed");
+    const std::string retval(static_cast<const char*>(data), size);
+    mz_free(data);
+    return retval;
+}
+
+}
@@ -0,0 +1,51 @@
+#ifndef slic3r_Raster_hpp_
+#define slic3r_Raster_hpp_
+
+#include "libslic3r.h"
+#include "ExPolygon.hpp"
+#include "Point.hpp"
+#include "Polygon.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Slic3r {
+
+/// 8-bit grayscale image of a layer, as shown by the display of a masked SLA printer.
+/// Shapes are filled with an even-odd scanline fill. With antialiasing, every row
+/// of pixels is sampled by several scanlines and the exact horizontal extent of
+/// each span is accumulated, so that edge pixels get a gray level proportional
+/// to their covered area. With a single sample per row, a pixel is lit when its
+/// center is inside the shape.
+class Raster
+{
+    public:
+    /// Raster of width x height pixels of pixel_size mm, whose top left corner
+    /// is at origin (unscaled coordinates, with Y going up).
+    Raster(size_t width, size_t height, double pixel_size, const Pointf &origin, unsigned int samples = 4);
+
+    size_t width() const { return this->_width; };
+    size_t height() const { return this->_height; };
+    /// Rows of pixels, from the top one.
+    const std::vector<uint8_t>& pixels() const { return this->_pixels; };
+    uint8_t pixel(size_t x, size_t y) const { return this->_pixels[y * this->_width + x]; };
+
+    /// Fill the inside of polygons (scaled coordinates) according to the
+    /// even-odd rule. Coverage adds up with what was drawn before.
+    void draw(const Polygons &polygons);
+    void draw(const ExPolygons &expolygons) { this->draw(to_polygons(expolygons)); };
+
+    /// The raster as a PNG file, compressed with the given zlib level.
+    std::string png(int level = 1) const;
+
+    private:
+    size_t _width, _height;
+    double _pixel_size;
+    Pointf _origin;
+    unsigned int _samples;
+    std::vector<uint8_t> _pixels;
+};
+
+}
+
+#endif
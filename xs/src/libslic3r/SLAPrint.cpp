@@ -4,9 +4,12 @@
 #include "Fill/Fill.hpp"
 #include "Geometry.hpp"
 #include "Surface.hpp"
+#include "Zip/ZipArchive.hpp"
 #include <iostream>
 #include <complex>
 #include <cstdio>
+#include <sstream>
+#include <stdexcept>
 #include <boost/version.hpp>
 #if BOOST_VERSION >= 107300
 #include <boost/bind/bind.hpp>
@@ -316,6 +319,108 @@ SLAPrint::write_svg(const std::string &outputfile) const
     fclose(f);
 }
 
+void
+SLAPrint::write_png_zip(const std::string &outputfile) const
+{
+    ZipArchive zip(outputfile, 'W');
+    if (!zip.z_stats())
+        throw std::runtime_error("Can't create " + outputfile);
+
+    // Layers are rendered and encoded in parallel, a batch at a time, so
+    // that only a few images are held in memory; each batch is then written
+    // in order.
+    const size_t batch_size = std::max(1, this->config.threads.value);
+    std::vector<std::string> pngs(batch_size);
+    for (size_t first = 0; first < this->layers.size(); first += batch_size) {
+        const size_t last = std::min(first + batch_size, this->layers.size()) - 1;
+        parallelize<size_t>(
+            first,
+            last,
+            [this, first, &pngs] (size_t i) {
+                Raster raster(
+                    this->config.sla_display_width.value,
+                    this->config.sla_display_height.value,
+                    this->config.sla_pixel_size.value,
+                    this->_raster_origin(),
+                    this->config.sla_antialiasing.value
+                );
+                this->rasterize_layer(i, &raster);
+                pngs[i - first] = raster.png();
+            },
+            this->config.threads.value
+        );
+        for (size_t i = first; i <= last; ++i) {
+            char name[32];
+            sprintf(name, "layer%05zu.png", i);
+            // PNG data is already compressed
+            if (!zip.add_entry(name, pngs[i - first].data(), pngs[i - first].size(), MZ_NO_COMPRESSION))
+                throw std::runtime_error("Can't write " + outputfile);
+            std::string().swap(pngs[i - first]);
+        }
+    }
+
+    std::ostringstream ini;
+    ini << "layers = " << this->layers.size() << "\n"
+        << "layer_height = " << this->config.layer_height.value << "\n"
+        << "first_layer_height = " << (this->layers.empty() ? 0. : this->layers.front().print_z) << "\n"
+        << "display_width = " << this->config.sla_display_width.value << "\n"
+        << "display_height = " << this->config.sla_display_height.value << "\n"
+        << "pixel_size = " << this->config.sla_pixel_size.value << "\n";
+    const std::string ini_data = ini.str();
+    if (!zip.add_entry("config.ini", ini_data.data(), ini_data.size())
+        || !zip.finalize())
+        throw std::runtime_error("Can't write " + outputfile);
+}
+
+void
+SLAPrint::rasterize_layer(size_t i, Raster* raster) const
+{
+    const Layer &layer = this->layers[i];
+
+    // same shapes as write_svg()
+    if (layer.solid) {
+        raster->draw(layer.slices.expolygons);
+    } else {
+        raster->draw(layer.perimeters.expolygons);
+        raster->draw(layer.solid_infill.expolygons);
+        for (const ExtrusionEntity* entity : layer.infill.entities)
+            raster->draw(union_ex(entity->grow()));
+    }
+
+    // don't print support material in raft layers
+    if (i >= (size_t)this->config.raft_layers) {
+        const double support_material_radius = sm_pillars_radius();
+        for (const SupportPillar &pillar : this->sm_pillars) {
+            if (!(pillar.top_layer >= i && pillar.bottom_layer <= i)) continue;
+
+            // generate a conic tip
+            const double radius = scale_(std::min<double>(
+                support_material_radius,
+                (pillar.top_layer - i + 1) * this->config.layer_height.value
+            ));
+            Polygon circle;
+            const int segments = 32;
+            for (int k = 0; k < segments; ++k)
+                circle.points.push_back(Point(
+                    coord_t(pillar.x + radius * cos(2 * PI * k / segments)),
+                    coord_t(pillar.y + radius * sin(2 * PI * k / segments))
+                ));
+            raster->draw(Polygons { circle });
+        }
+    }
+}
+
+Pointf
+SLAPrint::_raster_origin() const
+{
+    // center the print on the display
+    const Pointf center = this->bb.center();
+    return Pointf(
+        center.x - this->config.sla_display_width.value * this->config.sla_pixel_size.value / 2,
+        center.y + this->config.sla_display_height.value * this->config.sla_pixel_size.value / 2
+    );
+}
+
 coordf_t
 SLAPrint::sm_pillars_radius() const
 {
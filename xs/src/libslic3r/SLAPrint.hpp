@@ -8,6 +8,7 @@
 #include "Model.hpp"
 #include "Point.hpp"
 #include "PrintConfig.hpp"
+#include "Raster.hpp"
 #include "SVG.hpp"
 
 namespace Slic3r {
@@ -41,6 +42,10 @@ class SLAPrint
     SLAPrint(const Model* _model) : model(_model) {};
     void slice();
     void write_svg(const std::string &outputfile) const;
+    /// Write a zip of one PNG mask per layer, rendered for the configured display.
+    void write_png_zip(const std::string &outputfile) const;
+    /// Render layer i on raster.
+    void rasterize_layer(size_t i, Raster* raster) const;
     
     private:
     const Model* model;
@@ -48,6 +53,8 @@ class SLAPrint
     
     void _infill_layer(size_t i, const Fill* fill);
     coordf_t sm_pillars_radius() const;
+    /// Top left corner of the rasters, centering the print on the display.
+    Pointf _raster_origin() const;
     std::string _SVG_path_d(const Polygon &polygon) const;
     std::string _SVG_path_d(const ExPolygon &expolygon) const;
 };
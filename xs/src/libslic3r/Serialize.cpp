@@ -0,0 +1,504 @@
+#include "Serialize.hpp"
+#include "Layer.hpp"
+#include "Print.hpp"
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+namespace Slic3r {
+
+namespace {
+
+const char layer_stream_magic[8] = { 'S', 'L', '3', 'L', 'A', 'Y', 'E', 'R' };
+
+/// Type tags of write_entity().
+enum EntityTag : uint8_t {
+    etPath, etLoop, etCollection,
+};
+
+/// Smallest encoded sizes, used to reject counts that can't fit in the data.
+const size_t min_points_size        = 1;
+const size_t min_expolygon_size     = 2;
+const size_t min_surface_size       = 1 + min_expolygon_size + 8 + 1 + 8 + 1;
+const size_t min_path_size          = 1 + 1 + 8 + 4 + 4;
+
+/// Length of the next record; false at the end of the stream.
+bool
+read_length(std::istream &in, uint64_t* length)
+{
+    *length = 0;
+    for (int shift = 0; ; shift += 7) {
+        const int c = in.get();
+        if (c == std::char_traits<char>::eof()) {
+            if (shift == 0) return false;
+            throw SerializationError("truncated record length");
+        }
+        if (shift > 63) throw SerializationError("invalid record length");
+        *length |= uint64_t(c & 0x7f) << shift;
+        if ((c & 0x80) == 0) return true;
+    }
+}
+
+}
+
+void
+BinaryWriter::varint(uint64_t v)
+{
+    while (v >= 0x80) {
+        this->u8(uint8_t(v) | 0x80);
+        v >>= 7;
+    }
+    this->u8(uint8_t(v));
+}
+
+void
+BinaryWriter::f32(float v)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &v, sizeof(bits));
+    for (int i = 0; i < 4; ++i) this->u8(uint8_t(bits >> (8*i)));
+}
+
+void
+BinaryWriter::f64(double v)
+{
+    uint64_t bits;
+    std::memcpy(&bits, &v, sizeof(bits));
+    for (int i = 0; i < 8; ++i) this->u8(uint8_t(bits >> (8*i)));
+}
+
+void
+BinaryWriter::string(const std::string &s)
+{
+    this->varint(s.size());
+    this->data += s;
+}
+
+void
+BinaryWriter::write(const Points &points)
+{
+    this->varint(points.size());
+    // deltas are computed with wrap-around, so any coordinates round-trip
+    uint64_t x = 0, y = 0;
+    for (const Point &p : points) {
+        this->svarint(int64_t(uint64_t(p.x) - x));
+        this->svarint(int64_t(uint64_t(p.y) - y));
+        x = uint64_t(p.x);
+        y = uint64_t(p.y);
+    }
+}
+
+void
+BinaryWriter::write(const Polygons &polygons)
+{
+    this->varint(polygons.size());
+    for (const Polygon &polygon : polygons) this->write(polygon);
+}
+
+void
+BinaryWriter::write(const Polylines &polylines)
+{
+    this->varint(polylines.size());
+    for (const Polyline &polyline : polylines) this->write(polyline);
+}
+
+void
+BinaryWriter::write(const ExPolygon &expolygon)
+{
+    this->write(expolygon.contour);
+    this->write(expolygon.holes);
+}
+
+void
+BinaryWriter::write(const ExPolygons &expolygons)
+{
+    this->varint(expolygons.size());
+    for (const ExPolygon &expolygon : expolygons) this->write(expolygon);
+}
+
+void
+BinaryWriter::write(const Surface &surface)
+{
+    this->varint(surface.surface_type);
+    this->write(surface.expolygon);
+    this->f64(surface.thickness);
+    this->varint(surface.thickness_layers);
+    this->f64(surface.bridge_angle);
+    this->varint(surface.extra_perimeters);
+}
+
+void
+BinaryWriter::write(const SurfaceCollection &surfaces)
+{
+    this->varint(surfaces.surfaces.size());
+    for (const Surface &surface : surfaces.surfaces) this->write(surface);
+}
+
+void
+BinaryWriter::write(const ExtrusionPath &path)
+{
+    this->write(path.polyline);
+    this->u8(path.role);
+    this->f64(path.mm3_per_mm);
+    this->f32(path.width);
+    this->f32(path.height);
+}
+
+void
+BinaryWriter::write(const ExtrusionLoop &loop)
+{
+    this->u8(loop.role);
+    this->varint(loop.paths.size());
+    for (const ExtrusionPath &path : loop.paths) this->write(path);
+}
+
+void
+BinaryWriter::write(const ExtrusionEntityCollection &collection)
+{
+    this->u8(collection.no_sort);
+    this->varint(collection.orig_indices.size());
+    for (size_t i : collection.orig_indices) this->varint(i);
+    this->varint(collection.entities.size());
+    for (const ExtrusionEntity* entity : collection.entities) this->write_entity(*entity);
+}
+
+void
+BinaryWriter::write_entity(const ExtrusionEntity &entity)
+{
+    if (const ExtrusionPath* path = dynamic_cast<const ExtrusionPath*>(&entity)) {
+        this->u8(etPath);
+        this->write(*path);
+    } else if (const ExtrusionLoop* loop = dynamic_cast<const ExtrusionLoop*>(&entity)) {
+        this->u8(etLoop);
+        this->write(*loop);
+    } else if (const ExtrusionEntityCollection* collection = dynamic_cast<const ExtrusionEntityCollection*>(&entity)) {
+        this->u8(etCollection);
+        this->write(*collection);
+    } else {
+        throw SerializationError("unknown extrusion entity type");
+    }
+}
+
+uint8_t
+BinaryReader::u8()
+{
+    if (this->_pos == this->_end) throw SerializationError("unexpected end of data");
+    return uint8_t(*this->_pos++);
+}
+
+uint64_t
+BinaryReader::varint()
+{
+    uint64_t v = 0;
+    for (int shift = 0; ; shift += 7) {
+        const uint8_t c = this->u8();
+        if (shift > 63) throw SerializationError("invalid varint");
+        v |= uint64_t(c & 0x7f) << shift;
+        if ((c & 0x80) == 0) return v;
+    }
+}
+
+float
+BinaryReader::f32()
+{
+    uint32_t bits = 0;
+    for (int i = 0; i < 4; ++i) bits |= uint32_t(this->u8()) << (8*i);
+    float v;
+    std::memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+double
+BinaryReader::f64()
+{
+    uint64_t bits = 0;
+    for (int i = 0; i < 8; ++i) bits |= uint64_t(this->u8()) << (8*i);
+    double v;
+    std::memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+std::string
+BinaryReader::string()
+{
+    const size_t size = this->count();
+    std::string s(this->_pos, size);
+    this->_pos += size;
+    return s;
+}
+
+size_t
+BinaryReader::count(size_t min_element_size)
+{
+    const uint64_t n = this->varint();
+    if (n > uint64_t(this->_end - this->_pos) / std::max<size_t>(min_element_size, 1))
+        throw SerializationError("unexpected end of data");
+    return size_t(n);
+}
+
+void
+BinaryReader::read(Points* points)
+{
+    points->resize(this->count(2 * min_points_size));
+    uint64_t x = 0, y = 0;
+    for (Point &p : *points) {
+        x += uint64_t(this->svarint());
+        y += uint64_t(this->svarint());
+        p.x = coord_t(int64_t(x));
+        p.y = coord_t(int64_t(y));
+    }
+}
+
+void
+BinaryReader::read(Polygons* polygons)
+{
+    polygons->resize(this->count(min_points_size));
+    for (Polygon &polygon : *polygons) this->read(&polygon);
+}
+
+void
+BinaryReader::read(Polylines* polylines)
+{
+    polylines->resize(this->count(min_points_size));
+    for (Polyline &polyline : *polylines) this->read(&polyline);
+}
+
+void
+BinaryReader::read(ExPolygon* expolygon)
+{
+    this->read(&expolygon->contour);
+    this->read(&expolygon->holes);
+}
+
+void
+BinaryReader::read(ExPolygons* expolygons)
+{
+    expolygons->resize(this->count(min_expolygon_size));
+    for (ExPolygon &expolygon : *expolygons) this->read(&expolygon);
+}
+
+void
+BinaryReader::read(Surface* surface)
+{
+    surface->surface_type       = SurfaceType(this->varint());
+    this->read(&surface->expolygon);
+    surface->thickness          = this->f64();
+    surface->thickness_layers   = (unsigned short)this->varint();
+    surface->bridge_angle       = this->f64();
+    surface->extra_perimeters   = (unsigned short)this->varint();
+}
+
+void
+BinaryReader::read(SurfaceCollection* surfaces)
+{
+    const size_t n = this->count(min_surface_size);
+    surfaces->surfaces.clear();
+    surfaces->surfaces.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        surfaces->surfaces.push_back(Surface(stInternal, ExPolygon()));
+        this->read(&surfaces->surfaces.back());
+    }
+}
+
+void
+BinaryReader::read(ExtrusionPath* path)
+{
+    this->read(&path->polyline);
+    path->role          = ExtrusionRole(this->u8());
+    path->mm3_per_mm    = this->f64();
+    path->width         = this->f32();
+    path->height        = this->f32();
+}
+
+void
+BinaryReader::read(ExtrusionLoop* loop)
+{
+    loop->role = ExtrusionLoopRole(this->u8());
+    loop->paths.assign(this->count(min_path_size), ExtrusionPath(erNone));
+    for (ExtrusionPath &path : loop->paths) this->read(&path);
+}
+
+void
+BinaryReader::read(ExtrusionEntityCollection* collection)
+{
+    collection->clear();
+    collection->no_sort = this->u8() != 0;
+    collection->orig_indices.resize(this->count());
+    for (size_t &i : collection->orig_indices) i = size_t(this->varint());
+    const size_t n = this->count();
+    collection->entities.reserve(n);
+    for (size_t i = 0; i < n; ++i)
+        collection->entities.push_back(this->read_entity());
+}
+
+ExtrusionEntity*
+BinaryReader::read_entity()
+{
+    const uint8_t tag = this->u8();
+    if (tag == etPath) {
+        std::unique_ptr<ExtrusionPath> path(new ExtrusionPath(erNone));
+        this->read(path.get());
+        return path.release();
+    } else if (tag == etLoop) {
+        std::unique_ptr<ExtrusionLoop> loop(new ExtrusionLoop());
+        this->read(loop.get());
+        return loop.release();
+    } else if (tag == etCollection) {
+        std::unique_ptr<ExtrusionEntityCollection> collection(new ExtrusionEntityCollection());
+        this->read(collection.get());
+        return collection.release();
+    }
+    throw SerializationError("unknown extrusion entity type");
+}
+
+void
+write_record(std::ostream &out, const std::string &data)
+{
+    BinaryWriter length;
+    length.varint(data.size());
+    out.write(length.data.data(), length.data.size());
+    out.write(data.data(), data.size());
+}
+
+bool
+read_record(std::istream &in, std::string* data)
+{
+    uint64_t length;
+    if (!read_length(in, &length)) return false;
+    // grow the buffer as the data comes, so that a corrupted length
+    // doesn't allocate more than the stream holds
+    data->clear();
+    while (data->size() < length) {
+        const size_t offset = data->size();
+        const size_t chunk = size_t(std::min<uint64_t>(length - offset, 1 << 20));
+        data->resize(offset + chunk);
+        if (!in.read(&(*data)[offset], chunk))
+            throw SerializationError("truncated record");
+    }
+    return true;
+}
+
+const uint32_t LayerWriter::version;
+
+LayerWriter::LayerWriter(std::ostream &out, LayerContent content)
+    : _out(out), _content(content)
+{
+    this->_out.write(layer_stream_magic, sizeof(layer_stream_magic));
+    this->_writer.varint(LayerWriter::version);
+    this->_writer.u8(content);
+    write_record(this->_out, this->_writer.data);
+}
+
+void
+LayerWriter::write(const Layer &layer)
+{
+    BinaryWriter &w = this->_writer;
+    w.data.clear();
+    w.varint(layer.id());
+    w.f64(layer.height);
+    w.f64(layer.print_z);
+    w.f64(layer.slice_z);
+    w.u8(layer.slicing_errors);
+    w.write(layer.slices.expolygons);
+
+    w.varint(layer.regions.size());
+    for (const LayerRegion* layerm : layer.regions) {
+        w.write(layerm->slices);
+        if (this->_content == lcSlices) continue;
+        w.write(layerm->fill_surfaces);
+        w.write(layerm->perimeters);
+        w.write(layerm->thin_fills);
+        w.write(layerm->fills);
+        w.write(layerm->bridged);
+        w.write(layerm->unsupported_bridge_edges.polylines);
+    }
+    write_record(this->_out, w.data);
+}
+
+void
+LayerWriter::finish()
+{
+    write_record(this->_out, std::string());
+    this->_out.flush();
+}
+
+LayerReader::LayerReader(std::istream &in)
+    : _in(in), _version(0), _content(lcSlices), _previous(nullptr)
+{
+    char magic[sizeof(layer_stream_magic)];
+    if (!this->_in.read(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), layer_stream_magic))
+        throw SerializationError("not a layer stream");
+    if (!read_record(this->_in, &this->_record))
+        throw SerializationError("truncated layer stream header");
+    BinaryReader r(this->_record);
+    const uint64_t version = r.varint();
+    if (version == 0 || version > LayerWriter::version)
+        throw SerializationError("unsupported layer stream version " + std::to_string(version));
+    this->_version = uint32_t(version);
+    const uint8_t content = r.u8();
+    if (content > lcToolpaths) throw SerializationError("unknown layer stream content");
+    this->_content = LayerContent(content);
+}
+
+Layer*
+LayerReader::read(PrintObject* object)
+{
+    if (!read_record(this->_in, &this->_record))
+        throw SerializationError("truncated layer stream");
+    if (this->_record.empty()) return nullptr;
+
+    BinaryReader r(this->_record);
+    const size_t id         = size_t(r.varint());
+    const coordf_t height   = r.f64();
+    const coordf_t print_z  = r.f64();
+    const coordf_t slice_z  = r.f64();
+    const bool slicing_errors = r.u8() != 0;
+    ExPolygons slices;
+    r.read(&slices);
+
+    const PrintRegionPtrs &regions = object->print()->regions;
+    if (r.varint() != regions.size())
+        throw SerializationError("layer stream doesn't match the print regions");
+
+    Layer* layer = object->add_layer(int(id), height, print_z, slice_z);
+    try {
+        layer->slicing_errors = slicing_errors;
+        layer->slices.expolygons = std::move(slices);
+        for (PrintRegion* region : regions) {
+            LayerRegion* layerm = layer->add_region(region);
+            r.read(&layerm->slices);
+            if (this->_content == lcSlices) continue;
+            r.read(&layerm->fill_surfaces);
+            r.read(&layerm->perimeters);
+            r.read(&layerm->thin_fills);
+            r.read(&layerm->fills);
+            r.read(&layerm->bridged);
+            r.read(&layerm->unsupported_bridge_edges.polylines);
+        }
+        if (!r.at_end()) throw SerializationError("trailing data in layer record");
+    } catch (...) {
+        object->delete_layer(int(object->layers.size()) - 1);
+        throw;
+    }
+
+    if (this->_previous != nullptr) {
+        this->_previous->upper_layer = layer;
+        layer->lower_layer = this->_previous;
+    }
+    this->_previous = layer;
+    return layer;
+}
+
+bool
+LayerReader::skip()
+{
+    uint64_t length;
+    if (!read_length(this->_in, &length))
+        throw SerializationError("truncated layer stream");
+    if (length == 0) return false;
+    if (!this->_in.ignore(length) || uint64_t(this->_in.gcount()) != length)
+        throw SerializationError("truncated layer stream");
+    return true;
+}
+
+}
@@ -0,0 +1,160 @@
+#ifndef slic3r_Serialize_hpp_
+#define slic3r_Serialize_hpp_
+
+#include "libslic3r.h"
+#include "ExPolygon.hpp"
+#include "ExtrusionEntity.hpp"
+#include "ExtrusionEntityCollection.hpp"
+#include "Polygon.hpp"
+#include "Polyline.hpp"
+#include "SurfaceCollection.hpp"
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+
+namespace Slic3r {
+
+class Layer;
+class PrintObject;
+
+/// Error raised when decoding truncated, corrupted or unsupported data.
+class SerializationError : public std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+
+/// Little-endian binary encoder of geometry and extrusion entities.
+/// Integers are written as LEB128 varints (zigzag-encoded when signed) and
+/// the points of a polygon or polyline as the first point followed by the
+/// deltas between consecutive points, so that the usual short segments take
+/// two or three bytes per coordinate. Floating point values are written as
+/// their IEEE 754 representation.
+class BinaryWriter
+{
+    public:
+    /// Encoded data.
+    std::string data;
+
+    void u8(uint8_t v) { this->data.push_back(char(v)); };
+    void varint(uint64_t v);
+    void svarint(int64_t v) { this->varint((uint64_t(v) << 1) ^ uint64_t(v >> 63)); };
+    void f32(float v);
+    void f64(double v);
+    void string(const std::string &s);
+
+    void write(const Points &points);
+    void write(const Polygon &polygon) { this->write(polygon.points); };
+    void write(const Polygons &polygons);
+    void write(const Polyline &polyline) { this->write(polyline.points); };
+    void write(const Polylines &polylines);
+    void write(const ExPolygon &expolygon);
+    void write(const ExPolygons &expolygons);
+    void write(const Surface &surface);
+    void write(const SurfaceCollection &surfaces);
+    void write(const ExtrusionPath &path);
+    void write(const ExtrusionLoop &loop);
+    void write(const ExtrusionEntityCollection &collection);
+    /// Entity of any type, preceded by its type tag.
+    void write_entity(const ExtrusionEntity &entity);
+};
+
+/// Decoder of what BinaryWriter wrote, over a memory buffer.
+/// All methods throw SerializationError if the data is truncated or invalid.
+class BinaryReader
+{
+    public:
+    BinaryReader(const char* begin, const char* end) : _pos(begin), _end(end) {};
+    explicit BinaryReader(const std::string &data) : BinaryReader(data.data(), data.data() + data.size()) {};
+    bool at_end() const { return this->_pos == this->_end; };
+
+    uint8_t u8();
+    uint64_t varint();
+    int64_t svarint() { const uint64_t v = this->varint(); return int64_t(v >> 1) ^ -int64_t(v & 1); };
+    float f32();
+    double f64();
+    std::string string();
+    /// Element count, checked against the remaining data given the minimum
+    /// encoded size of an element.
+    size_t count(size_t min_element_size = 1);
+
+    void read(Points* points);
+    void read(Polygon* polygon) { this->read(&polygon->points); };
+    void read(Polygons* polygons);
+    void read(Polyline* polyline) { this->read(&polyline->points); };
+    void read(Polylines* polylines);
+    void read(ExPolygon* expolygon);
+    void read(ExPolygons* expolygons);
+    void read(Surface* surface);
+    void read(SurfaceCollection* surfaces);
+    void read(ExtrusionPath* path);
+    void read(ExtrusionLoop* loop);
+    void read(ExtrusionEntityCollection* collection);
+    /// Entity written by write_entity(), allocated with new.
+    ExtrusionEntity* read_entity();
+
+    private:
+    const char* _pos;
+    const char* _end;
+};
+
+/// Write data to out, prefixed by its length.
+void write_record(std::ostream &out, const std::string &data);
+/// Read the next record written by write_record() into data.
+/// Returns false if the stream ends before the record starts.
+bool read_record(std::istream &in, std::string* data);
+
+/// What a layer stream holds for each layer region.
+enum LayerContent : uint8_t {
+    lcSlices,       ///< the slices only
+    lcToolpaths,    ///< also the fill surfaces, perimeters, thin fills, fills and bridges
+};
+
+/// Writes the layers of a PrintObject to a stream, one at a time.
+/// The stream starts with a magic number, the format version and the content;
+/// each layer is then written as a length-prefixed record, so readers can skip
+/// layers without decoding them, and a final empty record ends the stream.
+class LayerWriter
+{
+    public:
+    /// Current version of the format.
+    static const uint32_t version = 1;
+
+    LayerWriter(std::ostream &out, LayerContent content);
+    void write(const Layer &layer);
+    /// Terminate the stream and flush it.
+    void finish();
+
+    private:
+    std::ostream &_out;
+    LayerContent _content;
+    BinaryWriter _writer;
+};
+
+/// Reads the layers written by a LayerWriter, one at a time.
+/// Throws SerializationError on invalid data and on streams written by a
+/// newer version of the format.
+class LayerReader
+{
+    public:
+    explicit LayerReader(std::istream &in);
+    uint32_t version() const { return this->_version; };
+    LayerContent content() const { return this->_content; };
+
+    /// Append the next layer to object, with one region per region of its print,
+    /// and link it to the previously read one. Returns nullptr at the end of the stream.
+    Layer* read(PrintObject* object);
+    /// Skip the next layer. Returns false at the end of the stream.
+    bool skip();
+
+    private:
+    std::istream &_in;
+    uint32_t _version;
+    LayerContent _content;
+    Layer* _previous;
+    std::string _record;
+};
+
+}
+
+#endif
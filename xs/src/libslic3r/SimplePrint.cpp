@@ -36,6 +36,9 @@ SimplePrint::set_model(const Model &model) {
 void
 SimplePrint::export_gcode(std::string outfile) {
     this->_print.status_cb = this->status_cb;
+    this->_print.stream_infill = this->stream_infill;
+    this->_print.parallel_gcode = this->parallel_gcode;
+    this->_print.slice_cache = this->slice_cache;
     this->_print.validate();
     this->_print.export_gcode(outfile);
     
@@ -11,6 +11,9 @@ class SimplePrint {
     public:
     bool arrange{true};
     bool center{true};
+    bool stream_infill{false};
+    bool parallel_gcode{false};
+    std::shared_ptr<SliceCache> slice_cache{nullptr};
     std::function<void(int, const std::string&)> status_cb {nullptr};
     
     bool apply_config(DynamicPrintConfig config) { return this->_print.apply_config(config); }
@@ -0,0 +1,235 @@
+#include "SliceCache.hpp"
+#include "Log.hpp"
+#include "Serialize.hpp"
+#include <boost/filesystem.hpp>
+#include <boost/nowide/fstream.hpp>
+#include <boost/uuid/detail/sha1.hpp>
+#include <boost/version.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+
+namespace Slic3r {
+
+namespace {
+
+/// Bumped whenever the layout of the entries changes.
+const uint32_t entry_version = 2;
+const char entry_magic[8] = { 'S', 'L', 'C', 'A', 'C', 'H', 'E', '\0' };
+
+/// SHA-1 of the inputs of a cached step.
+class KeyHash
+{
+    public:
+    void add(const void* data, size_t size) { this->_sha1.process_bytes(data, size); };
+    void add(const std::string &s) { this->add(uint64_t(s.size())); this->add(s.data(), s.size()); };
+    void add(uint64_t v) { this->add(&v, sizeof(v)); };
+    void add(double v) { this->add(&v, sizeof(v)); };
+    void add(const TransformationMatrix &m) {
+        for (double v : m.matrix3x4f()) this->add(v);
+    };
+    void add(const ConfigBase &config) {
+        for (const t_config_option_key &opt_key : config.keys()) {
+            this->add(opt_key);
+            this->add(config.serialize(opt_key));
+        }
+    };
+
+    std::string hex() {
+        boost::uuids::detail::sha1::digest_type digest;
+        this->_sha1.get_digest(digest);
+        std::string retval;
+        char buf[9];
+        #if BOOST_VERSION >= 108600
+        for (unsigned char c : digest) {
+            std::snprintf(buf, sizeof(buf), "%02x", c);
+            retval += buf;
+        }
+        #else
+        for (unsigned int word : digest) {
+            std::snprintf(buf, sizeof(buf), "%08x", word);
+            retval += buf;
+        }
+        #endif
+        return retval;
+    };
+
+    private:
+    boost::uuids::detail::sha1 _sha1;
+};
+
+/// Steps whose results are part of an entry for step.
+std::vector<PrintObjectStep>
+steps_up_to(PrintObjectStep step)
+{
+    if (step == posSlice)
+        return { posLayers, posSlice };
+    return { posLayers, posSlice, posPerimeters, posDetectSurfaces, posPrepareInfill, posInfill };
+}
+
+}
+
+std::string
+SliceCache::key(const PrintObject &object, PrintObjectStep step) const
+{
+    if (step != posSlice && step != posInfill) return "";
+    // edited layer heights aren't part of the key
+    if (object.state.is_done(posLayers)) return "";
+
+    const Print &print = *object.print();
+    const ModelObject &model_object = object.model_object();
+    if (model_object.instances.empty()) return "";
+
+    KeyHash hash;
+    hash.add(std::string(SLIC3R_VERSION) + " " + SLIC3R_GIT_STR);
+    hash.add(uint64_t(entry_version));
+    hash.add(uint64_t(step));
+
+    // the meshes and how they are placed for slicing (see _slice_region())
+    for (const ModelVolume* volume : model_object.volumes) {
+        hash.add(uint64_t(volume->modifier));
+        hash.add(volume->trafo);
+        const stl_file &stl = volume->mesh.stl;
+        hash.add(uint64_t(stl.stats.number_of_facets));
+        for (int i = 0; i < stl.stats.number_of_facets; ++i)
+            hash.add(stl.facet_start[i].vertex, sizeof(stl.facet_start[i].vertex));
+    }
+    hash.add(model_object.instances.front()->get_trafo_matrix(true));
+    hash.add(double(object._copies_shift.x));
+    hash.add(double(object._copies_shift.y));
+    hash.add(double(object.size.x));
+    hash.add(double(object.size.y));
+    hash.add(double(object.size.z));
+    for (const auto &range : object.layer_height_ranges) {
+        hash.add(range.first.first);
+        hash.add(range.first.second);
+        hash.add(range.second);
+    }
+
+    // the configs
+    hash.add(object.config);
+    for (const auto &region_volumes : object.region_volumes) {
+        hash.add(uint64_t(region_volumes.first));
+        for (int volume_id : region_volumes.second)
+            hash.add(uint64_t(volume_id));
+    }
+    hash.add(uint64_t(print.regions.size()));
+    for (const PrintRegion* region : print.regions)
+        hash.add(region->config);
+    for (const t_config_option_key &opt_key : print.config.keys()) {
+        if (Print::gcode_only_option(opt_key)) continue;
+        hash.add(opt_key);
+        hash.add(print.config.serialize(opt_key));
+    }
+    return hash.hex();
+}
+
+bool
+SliceCache::load(const std::string &key, PrintObject* object, PrintObjectStep step)
+{
+    if (key.empty()) return false;
+    Stats &stats = this->_stats[step];
+
+    boost::nowide::ifstream file(this->_path(key), std::ios::in | std::ios::binary);
+    if (!file.good()) {
+        ++stats.misses;
+        return false;
+    }
+
+    try {
+        char magic[sizeof(entry_magic)];
+        if (!file.read(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), entry_magic))
+            throw SerializationError("not a cache entry");
+        std::string header;
+        if (!read_record(file, &header)) throw SerializationError("truncated entry");
+        BinaryReader r(header);
+        if (r.varint() != entry_version) throw SerializationError("unsupported version");
+        if (r.u8() != step || r.string() != key) throw SerializationError("key mismatch");
+        const double layer_height = r.f64();
+        std::vector<coordf_t> spline_layers(r.count(8));
+        for (coordf_t &z : spline_layers) z = r.f64();
+        const bool typed_slices = r.u8() != 0;
+
+        object->clear_layers();
+        LayerReader layers(file);
+        if (layers.content() != (step == posSlice ? lcSlices : lcToolpaths))
+            throw SerializationError("unexpected content");
+        while (layers.read(object) != nullptr) ;
+
+        // side effects of generate_object_layers()
+        object->config.layer_height.value = layer_height;
+        object->layer_height_spline.setObjectHeight(unscale(object->size.z));
+        object->layer_height_spline.setLayers(spline_layers);
+        object->model_object()->layer_height_spline = object->layer_height_spline;
+        object->typed_slices = typed_slices;
+    } catch (std::exception &e) {
+        Slic3r::Log::warn("SliceCache") << "Ignoring unreadable entry " << this->_path(key) << ": " << e.what() << std::endl;
+        object->clear_layers();
+        ++stats.misses;
+        return false;
+    }
+
+    for (PrintObjectStep s : steps_up_to(step)) {
+        object->state.set_started(s);
+        object->state.set_done(s);
+    }
+    ++stats.hits;
+    return true;
+}
+
+void
+SliceCache::store(const std::string &key, const PrintObject &object, PrintObjectStep step)
+{
+    if (key.empty()) return;
+
+    // write to a temporary file and move it in place, so that concurrent
+    // slicers never read a partial entry
+    const boost::filesystem::path path(this->_path(key));
+    const boost::filesystem::path tmp = path.string() + ".tmp" + boost::filesystem::unique_path().string();
+    try {
+        boost::filesystem::create_directories(path.parent_path());
+        {
+            boost::nowide::ofstream file(tmp.string(), std::ios::out | std::ios::binary | std::ios::trunc);
+            file.write(entry_magic, sizeof(entry_magic));
+            BinaryWriter header;
+            header.varint(entry_version);
+            header.u8(step);
+            header.string(key);
+            header.f64(object.config.layer_height.value);
+            const std::vector<coordf_t> spline_layers = object.layer_height_spline.getOriginalLayers();
+            header.varint(spline_layers.size());
+            for (coordf_t z : spline_layers) header.f64(z);
+            header.u8(object.typed_slices);
+            write_record(file, header.data);
+
+            LayerWriter layers(file, step == posSlice ? lcSlices : lcToolpaths);
+            for (const Layer* layer : object.layers)
+                layers.write(*layer);
+            layers.finish();
+            if (!file.good()) throw std::runtime_error("write failed");
+        }
+        boost::filesystem::rename(tmp, path);
+    } catch (std::exception &e) {
+        Slic3r::Log::warn("SliceCache") << "Can't write " << path.string() << ": " << e.what() << std::endl;
+        boost::system::error_code ec;
+        boost::filesystem::remove(tmp, ec);
+        return;
+    }
+    ++this->_stats[step].stores;
+}
+
+SliceCache::Stats
+SliceCache::stats(PrintObjectStep step) const
+{
+    const auto it = this->_stats.find(step);
+    return it == this->_stats.end() ? Stats() : it->second;
+}
+
+std::string
+SliceCache::_path(const std::string &key) const
+{
+    return (boost::filesystem::path(this->_directory) / (key + ".slc")).string();
+}
+
+}
@@ -0,0 +1,62 @@
+#ifndef slic3r_SliceCache_hpp_
+#define slic3r_SliceCache_hpp_
+
+#include "libslic3r.h"
+#include "Print.hpp"
+#include <map>
+#include <string>
+
+namespace Slic3r {
+
+/// On-disk cache of the layers of PrintObjects, addressed by the content they
+/// were generated from.
+/// An entry is keyed by a hash of the object meshes and their placement, of the
+/// object and region configs and of the print options that are not G-code only,
+/// so an object sliced again with the same inputs (a reprint, another plate,
+/// an export with different start G-code) reloads its layers instead of
+/// recomputing them. Two steps are cached:
+///   - posSlice: the layers and the slices of their regions;
+///   - posInfill: everything up to the fills, i.e. also the typed slices,
+///     perimeters, thin fills and fill surfaces.
+/// Objects whose layer heights were edited (posLayers already done) are not
+/// cached. Entries are never evicted; the directory can be wiped at any time.
+class SliceCache
+{
+    public:
+    /// Lookup counters of one step.
+    struct Stats {
+        size_t hits {0};
+        size_t misses {0};
+        size_t stores {0};
+    };
+
+    /// Keep the entries in directory, which is created when the first entry is stored.
+    explicit SliceCache(const std::string &directory) : _directory(directory) {};
+    const std::string& directory() const { return this->_directory; };
+
+    /// Key of the state of object after step, or an empty string if that state
+    /// can't be cached. Must be computed before the step (or its prerequisites)
+    /// starts, as generating the layers alters the object.
+    std::string key(const PrintObject &object, PrintObjectStep step) const;
+
+    /// Replace the layers of object with the entry stored under key and mark
+    /// step and its prerequisites as done. Returns false if there is no such
+    /// entry or it can't be read, leaving the state of object unchanged.
+    bool load(const std::string &key, PrintObject* object, PrintObjectStep step);
+
+    /// Store the layers of object, after step, under key.
+    void store(const std::string &key, const PrintObject &object, PrintObjectStep step);
+
+    /// Counters of the given step.
+    Stats stats(PrintObjectStep step) const;
+
+    private:
+    std::string _directory;
+    std::map<PrintObjectStep, Stats> _stats;
+
+    std::string _path(const std::string &key) const;
+};
+
+}
+
+#endif
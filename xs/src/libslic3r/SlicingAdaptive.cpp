@@ -1,4 +1,5 @@
 #include "libslic3r.h"
+#include <algorithm>
 #include <limits>
 #include "TriangleMesh.hpp"
 #include "SlicingAdaptive.hpp"
@@ -25,50 +26,23 @@ namespace Slic3r
 void SlicingAdaptive::clear()
 {
     m_meshes.clear();
-    m_faces.clear();
-    m_face_normal_z.clear();
-}
-
-std::pair<float, float> face_z_span(const stl_facet *f)
-{
-    return std::pair<float, float>(
-        std::min(std::min(f->vertex[0].z, f->vertex[1].z), f->vertex[2].z),
-        std::max(std::max(f->vertex[0].z, f->vertex[1].z), f->vertex[2].z));
+    m_indices.clear();
 }
 
 void SlicingAdaptive::prepare(coordf_t object_size)
 {
     this->object_size = object_size;
 
-    // 1) Collect faces of all meshes.
-    int nfaces_total = 0;
-    for (std::vector<const TriangleMesh*>::const_iterator it_mesh = m_meshes.begin(); it_mesh != m_meshes.end(); ++ it_mesh)
-        nfaces_total += (*it_mesh)->stl.stats.number_of_facets;
-    m_faces.reserve(nfaces_total);
+    // The facets sorted by their Z span are kept by each mesh, so they are only
+    // sorted again when a mesh changes and not on every call to prepare().
+    m_indices.clear();
     for (std::vector<const TriangleMesh*>::const_iterator it_mesh = m_meshes.begin(); it_mesh != m_meshes.end(); ++ it_mesh)
-        for (int i = 0; i < (*it_mesh)->stl.stats.number_of_facets; ++ i)
-            m_faces.push_back((*it_mesh)->stl.facet_start + i);
-
-    // 2) Sort faces lexicographically by their Z span.
-    std::sort(m_faces.begin(), m_faces.end(), [](const stl_facet *f1, const stl_facet *f2) {
-        std::pair<float, float> span1 = face_z_span(f1);
-        std::pair<float, float> span2 = face_z_span(f2);
-        return span1 < span2;
-    });
-
-    // 3) Generate Z components of the facet normals.
-    m_face_normal_z.assign(m_faces.size(), 0.f);
-    for (size_t iface = 0; iface < m_faces.size(); ++ iface)
-        m_face_normal_z[iface] = m_faces[iface]->normal.z;
-
-    // 4) Reset current facet pointer
-    this->current_facet = 0;
+        m_indices.push_back((*it_mesh)->span_index(Z));
 }
 
 float SlicingAdaptive::next_layer_height(coordf_t z, coordf_t quality_factor, coordf_t min_layer_height, coordf_t max_layer_height)
 {
     float height = max_layer_height;
-    // factor must be between 0-1, 0 is highest quality, 1 highest print speed.
 
     // factor must be between 0-1, 0 is highest quality, 1 highest print speed.
     // Invert the slider scale (100% should represent a very high quality for the user)
@@ -78,27 +52,18 @@ float SlicingAdaptive::next_layer_height(coordf_t z, coordf_t quality_factor, co
     float delta_max = SURFACE_CONST * max_layer_height + 0.5 * max_layer_height;
     float scaled_quality_factor = quality_factor * (delta_max - delta_min) + delta_min;
 
-    bool first_hit = false;
-
     // find all facets intersecting the slice-layer
-    int ordered_id = current_facet;
-    for (; ordered_id < int(m_faces.size()); ++ ordered_id) {
-        std::pair<float, float> zspan = face_z_span(m_faces[ordered_id]);
-        // facet's minimum is higher than slice_z -> end loop
-        if (zspan.first >= z)
-            break;
-        // facet's maximum is higher than slice_z -> store the first event for next layer_height call to begin at this point
-        if (zspan.second > z) {
-            // first event?
-            if (! first_hit) {
-                first_hit = true;
-                current_facet = ordered_id;
-            }
-            // skip touching facets which could otherwise cause small height values
-            if (zspan.second <= z + EPSILON)
+    for (size_t i = 0; i < m_meshes.size(); ++ i) {
+        const std::vector<int> facets = m_indices[i]->query(z, z);
+        for (int facet_idx : facets) {
+            const stl_facet &facet = m_meshes[i]->stl.facet_start[facet_idx];
+            const float min_z = std::min(std::min(facet.vertex[0].z, facet.vertex[1].z), facet.vertex[2].z);
+            const float max_z = std::max(std::max(facet.vertex[0].z, facet.vertex[1].z), facet.vertex[2].z);
+            // only facets crossing slice_z; skip touching facets which could otherwise cause small height values
+            if (min_z >= z || max_z <= z + EPSILON)
                 continue;
             // compute height for this facet and store minimum of all heights
-            height = std::min(height, this->_layer_height_from_facet(ordered_id, scaled_quality_factor));
+            height = std::min(height, this->_layer_height_from_facet(m_meshes[i], facet_idx, scaled_quality_factor));
         }
     }
 
@@ -107,39 +72,42 @@ float SlicingAdaptive::next_layer_height(coordf_t z, coordf_t quality_factor, co
 
     // check for sloped facets inside the determined layer and correct height if necessary
     if (height > min_layer_height) {
-        for (; ordered_id < int(m_faces.size()); ++ ordered_id) {
-            std::pair<float, float> zspan = face_z_span(m_faces[ordered_id]);
-            // facet's minimum is higher than slice_z + height -> end loop
-            if (zspan.first >= z + height)
-                break;
+        for (size_t i = 0; i < m_meshes.size(); ++ i) {
+            const FacetSpanIndex &index = *m_indices[i];
+            size_t ordered_id = std::lower_bound(index.min_z.begin(), index.min_z.end(), z) - index.min_z.begin();
+            for (; ordered_id < index.size(); ++ ordered_id) {
+                // facet's minimum is higher than slice_z + height -> end loop
+                if (index.min_z[ordered_id] >= z + height)
+                    break;
 
-            // skip touching facets which could otherwise cause small cusp values
-            if (zspan.second <= z + EPSILON)
-                continue;
+                // skip touching facets which could otherwise cause small cusp values
+                if (index.max_z[ordered_id] <= z + EPSILON)
+                    continue;
 
-            // Compute new height for this facet and check against height.
-            float reduced_height = this->_layer_height_from_facet(ordered_id, scaled_quality_factor);
+                // Compute new height for this facet and check against height.
+                float reduced_height = this->_layer_height_from_facet(m_meshes[i], index.facets[ordered_id], scaled_quality_factor);
 
-            float z_diff = zspan.first - z;
+                float z_diff = index.min_z[ordered_id] - z;
 
-            if (reduced_height > z_diff) {
-                if (reduced_height < height) {
+                if (reduced_height > z_diff) {
+                    if (reduced_height < height) {
 #ifdef DEBUG
-                    std::cout << "adaptive layer computation: height is reduced from " << height;
+                        std::cout << "adaptive layer computation: height is reduced from " << height;
 #endif
-                    height = reduced_height;
+                        height = reduced_height;
 #ifdef DEBUG
-                    std::cout << "to " << height << " due to higher facet" << std::endl;
+                        std::cout << "to " << height << " due to higher facet" << std::endl;
 #endif
-                }
-            } else {
+                    }
+                } else {
 #ifdef DEBUG
-                std::cout << "cusp computation, height is reduced from " << height;
+                    std::cout << "cusp computation, height is reduced from " << height;
 #endif
-                height = z_diff;
+                    height = z_diff;
 #ifdef DEBUG
-                std::cout << "to " << height << " due to z-diff" << std::endl;
+                    std::cout << "to " << height << " due to z-diff" << std::endl;
 #endif
+                }
             }
         }
         // lower height limit due to printer capabilities again
@@ -156,15 +124,23 @@ float SlicingAdaptive::next_layer_height(coordf_t z, coordf_t quality_factor, co
 // to consider horizontal object features in slice thickness
 float SlicingAdaptive::horizontal_facet_distance(coordf_t z, coordf_t max_layer_height)
 {
-    for (size_t i = 0; i < m_faces.size(); ++ i) {
-        std::pair<float, float> zspan = face_z_span(m_faces[i]);
-        // facet's minimum is higher than max forward distance -> end loop
-        if (zspan.first > z + max_layer_height)
-            break;
-        // min_z == max_z -> horizontal facet
-        if (zspan.first > z && zspan.first == zspan.second)
-            return zspan.first - z;
+    float distance = -1;
+    for (const std::shared_ptr<const FacetSpanIndex> &index : m_indices) {
+        size_t i = std::upper_bound(index->min_z.begin(), index->min_z.end(), z) - index->min_z.begin();
+        for (; i < index->size(); ++ i) {
+            // facet's minimum is higher than max forward distance -> end loop
+            if (index->min_z[i] > z + max_layer_height)
+                break;
+            // min_z == max_z -> horizontal facet
+            if (index->min_z[i] == index->max_z[i]) {
+                if (distance < 0 || index->min_z[i] - z < distance)
+                    distance = index->min_z[i] - z;
+                break;
+            }
+        }
     }
+    if (distance >= 0)
+        return distance;
 
     // objects maximum?
     return (z + max_layer_height > this->object_size) ?
@@ -173,9 +149,9 @@ float SlicingAdaptive::horizontal_facet_distance(coordf_t z, coordf_t max_layer_
 }
 
 // for a given facet, compute maximum height within the allowed surface roughness / stairstepping deviation
-float SlicingAdaptive::_layer_height_from_facet(int ordered_id, float scaled_quality_factor)
+float SlicingAdaptive::_layer_height_from_facet(const TriangleMesh *mesh, int facet_idx, float scaled_quality_factor)
 {
-    float normal_z = std::abs(m_face_normal_z[ordered_id]);
+    float normal_z = std::abs(mesh->stl.facet_start[facet_idx].normal.z);
     float height = scaled_quality_factor/(SURFACE_CONST + normal_z/2);
     return height;
 }
@@ -2,11 +2,14 @@
 #define slic3r_SlicingAdaptive_hpp_
 
 #include "admesh/stl.h"
+#include <memory>
+#include <vector>
 
 namespace Slic3r
 {
 
 class TriangleMesh;
+class FacetSpanIndex;
 
 class SlicingAdaptive
 {
@@ -20,17 +23,13 @@ public:
     float horizontal_facet_distance(coordf_t z, coordf_t max_layer_height);
 
 private:
-    float _layer_height_from_facet(int ordered_id, float scaled_quality_factor);
+    float _layer_height_from_facet(const TriangleMesh *mesh, int facet_idx, float scaled_quality_factor);
 
 protected:
-    // id of the current facet from last iteration
     coordf_t                            object_size;
-    int                                 current_facet;
     std::vector<const TriangleMesh*>	m_meshes;
-    // Collected faces of all meshes, sorted by raising Z of the bottom most face.
-    std::vector<const stl_facet*>		m_faces;
-    // Z component of face normals, normalized.
-    std::vector<float>					m_face_normal_z;
+    // Facets of each mesh sorted by their Z span, cached on the mesh itself.
+    std::vector<std::shared_ptr<const FacetSpanIndex>>	m_indices;
 };
 
 }; // namespace Slic3r
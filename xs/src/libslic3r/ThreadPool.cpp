@@ -0,0 +1,159 @@
+#include "ThreadPool.hpp"
+#include "Profiler.hpp"
+#include <algorithm>
+
+namespace Slic3r {
+
+// Set while the current thread is executing items of a job, so that a
+// parallelize() call made from inside a task doesn't wait for itself.
+static thread_local bool in_job = false;
+
+ThreadPool&
+ThreadPool::instance()
+{
+    // The pool is intentionally never destroyed: joining threads during static
+    // destruction is unsafe on some platforms (e.g. when unloading the Perl XS
+    // module on Windows) and idle workers just block on a condition variable.
+    static ThreadPool* pool = new ThreadPool();
+    return *pool;
+}
+
+void
+ThreadPool::reserve(size_t workers)
+{
+    boost::lock_guard<boost::mutex> lock(this->_mutex);
+    while (this->_workers.size() < workers) {
+        try {
+            this->_workers.push_back(new boost::thread(
+                &ThreadPool::_worker_do, this, this->_workers.size(), this->_generation
+            ));
+        } catch (boost::thread_resource_error &) {
+            // run with what we have
+            break;
+        }
+    }
+}
+
+size_t
+ThreadPool::size() const
+{
+    boost::lock_guard<boost::mutex> lock(this->_mutex);
+    return this->_workers.size();
+}
+
+void
+ThreadPool::parallel_for(size_t count, const task_t &func, int threads_count)
+{
+    if (count == 0) return;
+    if (threads_count <= 0) threads_count = 2;
+    size_t participants = std::min(count, (size_t)threads_count);
+
+    // nested calls run in place, as a part of the item of the enclosing job
+    if (in_job) {
+        for (size_t i = 0; i < count; ++i) func(i);
+        return;
+    }
+
+    Profiler::Scope profile(Profiler::Scope::Parallel(), count, threads_count);
+
+    // single items and single-threaded requests run in place
+    if (participants < 2) {
+        for (size_t i = 0; i < count; ++i) func(i);
+        return;
+    }
+
+    this->reserve(participants - 1);
+    participants = std::min(participants, this->size() + 1);
+
+    boost::lock_guard<boost::mutex> submit_lock(this->_submit_mutex);
+
+    // split the items in one contiguous range per participant
+    Job job(&func, participants);
+    const size_t share = count / participants;
+    const size_t extra = count % participants;
+    size_t begin = 0;
+    for (size_t i = 0; i < participants; ++i) {
+        job.ranges[i].next  = begin;
+        job.ranges[i].end   = begin + share + (i < extra ? 1 : 0);
+        begin = job.ranges[i].end;
+    }
+    // small enough for stealing to balance uneven items, large enough
+    // to keep the atomic counters out of the way for cheap ones
+    job.chunk = std::max((size_t)1, share / 8);
+
+    {
+        boost::lock_guard<boost::mutex> lock(this->_mutex);
+        this->_job     = &job;
+        this->_active  = participants - 1;
+        ++this->_generation;
+    }
+    this->_job_ready.notify_all();
+
+    in_job = true;
+    ThreadPool::_run(job, 0);
+    in_job = false;
+
+    {
+        boost::unique_lock<boost::mutex> lock(this->_mutex);
+        while (this->_active > 0)
+            this->_job_done.wait(lock);
+        this->_job = nullptr;
+    }
+
+    if (job.error) std::rethrow_exception(job.error);
+}
+
+void
+ThreadPool::_worker_do(size_t worker_id, size_t seen)
+{
+    in_job = true;
+
+    // seen is the last job generation this worker knows about; it is taken
+    // when the thread is created so that a job submitted before the thread
+    // gets scheduled isn't missed
+    while (true) {
+        Job* job;
+        {
+            boost::unique_lock<boost::mutex> lock(this->_mutex);
+            while (this->_generation == seen)
+                this->_job_ready.wait(lock);
+            seen = this->_generation;
+            job  = this->_job;
+
+            // participant 0 is the submitting thread
+            if (job == nullptr || worker_id + 1 >= job->ranges.size()) continue;
+        }
+
+        ThreadPool::_run(*job, worker_id + 1);
+
+        {
+            boost::lock_guard<boost::mutex> lock(this->_mutex);
+            if (--this->_active == 0) this->_job_done.notify_all();
+        }
+    }
+}
+
+void
+ThreadPool::_run(Job &job, size_t participant)
+{
+    const size_t participants = job.ranges.size();
+    try {
+        // drain our own range first, then steal from the others
+        for (size_t k = 0; k < participants && !job.cancelled; ++k) {
+            Range &range = job.ranges[(participant + k) % participants];
+            while (!job.cancelled) {
+                size_t i = range.next.fetch_add(job.chunk);
+                if (i >= range.end) break;
+                const size_t end = std::min(i + job.chunk, range.end);
+                for (; i < end; ++i) (*job.func)(i);
+                boost::this_thread::interruption_point();
+            }
+        }
+    } catch (...) {
+        boost::lock_guard<boost::mutex> lock(job.error_mutex);
+        if (!job.error) job.error = std::current_exception();
+        job.cancelled = true;
+    }
+}
+
+} // namespace Slic3r
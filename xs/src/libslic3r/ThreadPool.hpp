@@ -0,0 +1,83 @@
+#ifndef slic3r_ThreadPool_hpp_
+#define slic3r_ThreadPool_hpp_
+
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <vector>
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+
+namespace Slic3r {
+
+/// Process-wide pool of worker threads used by parallelize().
+/// Workers are started lazily the first time a job asks for them and are
+/// then kept around for the lifetime of the process, so repeated parallel
+/// steps don't pay for thread creation.
+/// A job over [0, count) is cut into one contiguous range per participating
+/// thread (the calling thread always participates). Each thread consumes its
+/// own range in chunks and, once it runs dry, steals chunks from the ranges
+/// of the other participants. Claiming a chunk is a single atomic increment,
+/// so no lock is taken while the job is running.
+class ThreadPool
+{
+    public:
+    typedef boost::function<void(size_t)> task_t;
+
+    /// The shared pool instance.
+    static ThreadPool& instance();
+
+    /// Run func(i) for every i in [0, count) using at most threads_count
+    /// threads (including the calling one) and return when all items are done.
+    /// If any invocation throws, the remaining chunks are skipped and the
+    /// first exception is rethrown in the calling thread.
+    /// Calls made from inside a running job are executed serially in place.
+    void parallel_for(size_t count, const task_t &func, int threads_count);
+
+    /// Make sure at least the given number of worker threads is running.
+    void reserve(size_t workers);
+
+    /// Number of worker threads currently running.
+    size_t size() const;
+
+    private:
+    ThreadPool() : _generation(0), _active(0), _job(nullptr) {};
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /// Range of item indices owned by one participant of a job.
+    struct Range {
+        std::atomic<size_t> next;
+        size_t end;
+        // keep each range on its own cache line
+        char _pad[64 - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+        Range() : next(0), end(0) {};
+    };
+
+    struct Job {
+        const task_t* func;
+        std::vector<Range> ranges;
+        size_t chunk;
+        std::atomic<bool> cancelled;
+        boost::mutex error_mutex;
+        std::exception_ptr error;
+        Job(const task_t* func, size_t participants)
+            : func(func), ranges(participants), chunk(1), cancelled(false) {};
+    };
+
+    void _worker_do(size_t worker_id, size_t seen);
+    static void _run(Job &job, size_t participant);
+
+    mutable boost::mutex _mutex;
+    boost::condition_variable _job_ready;
+    boost::condition_variable _job_done;
+    boost::mutex _submit_mutex;         ///< serializes jobs submitted by unrelated threads
+    std::vector<boost::thread*> _workers;
+    size_t _generation;                 ///< incremented for every submitted job
+    size_t _active;                     ///< workers still running the current job
+    Job* _job;
+};
+
+} // namespace Slic3r
+
+#endif // slic3r_ThreadPool_hpp_
@@ -2,7 +2,11 @@
 #include "ClipperUtils.hpp"
 #include "Log.hpp"
 #include "Geometry.hpp"
+#include "IO.hpp"
+#include "Profiler.hpp"
+#include <array>
 #include <cmath>
+#include <cstring>
 #include <deque>
 #include <queue>
 #include <set>
@@ -13,6 +17,7 @@
 #include <math.h>
 #include <assert.h>
 #include <stdexcept>
+#include <limits>
 #include <boost/version.hpp>
 #include <boost/config.hpp>
 #include <boost/nowide/convert.hpp>
@@ -31,6 +36,221 @@ namespace Slic3r {
 using boost::placeholders::_1;
 #endif
 
+static inline float
+axis_coord(const stl_vertex &vertex, Axis axis)
+{
+    return axis == X ? vertex.x : (axis == Y ? vertex.y : vertex.z);
+}
+
+FacetSpanIndex::FacetSpanIndex(const stl_file &stl, Axis axis)
+{
+    const size_t n = stl.stats.number_of_facets;
+    
+    std::vector< std::pair<float, int> > order;
+    order.reserve(n);
+    std::vector<float> max(n);
+    for (size_t i = 0; i < n; ++i) {
+        const stl_facet &facet = stl.facet_start[i];
+        const float a = axis_coord(facet.vertex[0], axis);
+        const float b = axis_coord(facet.vertex[1], axis);
+        const float c = axis_coord(facet.vertex[2], axis);
+        order.push_back(std::make_pair(std::min(a, std::min(b, c)), (int)i));
+        max[i] = std::max(a, std::max(b, c));
+    }
+    std::sort(order.begin(), order.end());
+    
+    this->facets.reserve(n);
+    this->min_z.reserve(n);
+    this->max_z.reserve(n);
+    for (const std::pair<float, int> &facet : order) {
+        this->facets.push_back(facet.second);
+        this->min_z.push_back(facet.first);
+        this->max_z.push_back(max[facet.second]);
+    }
+    
+    // leaves beyond the last facet never match a query
+    this->_leaves = 1;
+    while (this->_leaves < n) this->_leaves *= 2;
+    this->_tree.assign(2 * this->_leaves, -std::numeric_limits<float>::infinity());
+    std::copy(this->max_z.begin(), this->max_z.end(), this->_tree.begin() + this->_leaves);
+    for (size_t node = this->_leaves - 1; node > 0; --node)
+        this->_tree[node] = std::max(this->_tree[2*node], this->_tree[2*node + 1]);
+    
+    this->_facet_start = stl.facet_start;
+    this->_lowest      = axis_coord(stl.stats.min, axis);
+    this->_highest     = axis_coord(stl.stats.max, axis);
+}
+
+std::vector<int>
+FacetSpanIndex::query(float min, float max) const
+{
+    std::vector<int> result;
+    if (this->empty() || min > max) return result;
+    
+    // only the facets starting at or below max are candidates; among them,
+    // skip the subtrees ending below min
+    const size_t end = this->upper_bound(max);
+    struct Node { size_t id, first, width; };
+    std::vector<Node> stack;
+    stack.push_back(Node { 1, 0, this->_leaves });
+    while (!stack.empty()) {
+        const Node node = stack.back();
+        stack.pop_back();
+        if (node.first >= end || this->_tree[node.id] < min) continue;
+        if (node.width == 1) {
+            result.push_back(this->facets[node.first]);
+        } else {
+            const size_t half = node.width / 2;
+            stack.push_back(Node { 2*node.id + 1, node.first + half, half });
+            stack.push_back(Node { 2*node.id,     node.first,        half });
+        }
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+size_t
+FacetSpanIndex::lower_bound(float z) const
+{
+    return std::lower_bound(this->min_z.begin(), this->min_z.end(), z) - this->min_z.begin();
+}
+
+size_t
+FacetSpanIndex::upper_bound(float z) const
+{
+    return std::upper_bound(this->min_z.begin(), this->min_z.end(), z) - this->min_z.begin();
+}
+
+FacetEdgeIndex::FacetEdgeIndex(const stl_file &stl)
+    : _v_indices(stl.v_indices), _v_shared(stl.v_shared)
+{
+    const size_t facets_count = std::max(stl.stats.number_of_facets, 0);
+    const size_t vertices_count = std::max(stl.stats.shared_vertices, 0);
+    this->facets_edges.resize(facets_count);
+    this->scaled_vertices.assign(stl.v_shared, stl.v_shared + vertices_count);
+    if (facets_count == 0) return;
+    
+    const size_t threads = std::max(1u, boost::thread::hardware_concurrency());
+    const size_t chunks_count = std::min(facets_count, threads * 4);
+    const size_t chunk_size = (facets_count + chunks_count - 1) / chunks_count;
+    const size_t buckets_count = std::min(facets_count * 3 / 65536 + 1, chunks_count * 2);
+    
+    parallelize<size_t>(
+        0,
+        vertices_count / 65536,
+        [this, vertices_count](size_t run) {
+            for (size_t i = run * 65536; i < std::min(vertices_count, (run + 1) * 65536); ++i) {
+                this->scaled_vertices[i].x /= SCALING_FACTOR;
+                this->scaled_vertices[i].y /= SCALING_FACTOR;
+                this->scaled_vertices[i].z /= SCALING_FACTOR;
+            }
+        }
+    );
+    
+    /*  An edge is identified by its two shared vertices regardless of their
+        order, and gets the next id when it is first seen walking the facets in
+        order. Edges are scattered into buckets by a hash of their vertices,
+        keeping facet order inside each bucket, and every bucket finds the first
+        occurrence of each of its edges on its own. The first occurrences are
+        then numbered in facet order and the other ones copy their id. */
+    const v_indices_struct* v_indices = stl.v_indices;
+    auto edge_key = [v_indices](size_t edge) {
+        const int* vertex = v_indices[edge / 3].vertex;
+        const uint32_t a = vertex[edge % 3], b = vertex[(edge + 1) % 3];
+        return a < b ? ((uint64_t)a << 32 | b) : ((uint64_t)b << 32 | a);
+    };
+    auto edge_hash = [](uint64_t key) {
+        key ^= key >> 33; key *= 0xff51afd7ed558ccdULL;
+        key ^= key >> 33; key *= 0xc4ceb9fe1a85ec53ULL;
+        return (uint32_t)(key ^ (key >> 33));
+    };
+    
+    std::vector< std::vector<uint32_t> > offsets(chunks_count, std::vector<uint32_t>(buckets_count, 0));
+    parallelize<size_t>(
+        0,
+        chunks_count-1,
+        [&](size_t chunk) {
+            for (size_t edge = chunk * chunk_size * 3; edge < std::min(facets_count, (chunk + 1) * chunk_size) * 3; ++edge)
+                ++offsets[chunk][edge_hash(edge_key(edge)) % buckets_count];
+        }
+    );
+    std::vector<uint32_t> bucket_start(buckets_count + 1, 0);
+    for (size_t bucket = 0, offset = 0; bucket < buckets_count; ++bucket) {
+        bucket_start[bucket] = offset;
+        for (std::vector<uint32_t> &counts : offsets) {
+            const uint32_t count = counts[bucket];
+            counts[bucket] = offset;
+            offset += count;
+        }
+    }
+    bucket_start[buckets_count] = facets_count * 3;
+    
+    std::vector<uint32_t> bucket_edges(facets_count * 3);
+    parallelize<size_t>(
+        0,
+        chunks_count-1,
+        [&](size_t chunk) {
+            for (size_t edge = chunk * chunk_size * 3; edge < std::min(facets_count, (chunk + 1) * chunk_size) * 3; ++edge)
+                bucket_edges[ offsets[chunk][edge_hash(edge_key(edge)) % buckets_count]++ ] = edge;
+        }
+    );
+    
+    // position of the first occurrence of each edge
+    std::vector<uint32_t> first(facets_count * 3);
+    parallelize<size_t>(
+        0,
+        buckets_count-1,
+        [&](size_t bucket) {
+            const uint32_t count = bucket_start[bucket+1] - bucket_start[bucket];
+            uint32_t mask = 15;
+            while (mask < count * 2) mask = mask * 2 + 1;
+            std::vector< std::pair<uint64_t, uint32_t> > slots(mask + 1,
+                std::make_pair(0, std::numeric_limits<uint32_t>::max()));
+            for (uint32_t i = bucket_start[bucket]; i < bucket_start[bucket+1]; ++i) {
+                const uint32_t edge = bucket_edges[i];
+                const uint64_t key = edge_key(edge);
+                uint32_t slot = (edge_hash(key) / buckets_count) & mask;
+                while (slots[slot].second != std::numeric_limits<uint32_t>::max() && slots[slot].first != key)
+                    slot = (slot + 1) & mask;
+                if (slots[slot].second == std::numeric_limits<uint32_t>::max())
+                    slots[slot] = std::make_pair(key, edge);
+                first[edge] = slots[slot].second;
+            }
+        }
+    );
+    std::vector<uint32_t>().swap(bucket_edges);
+    
+    std::vector<int> chunk_ids(chunks_count + 1, 0);
+    parallelize<size_t>(
+        0,
+        chunks_count-1,
+        [&](size_t chunk) {
+            for (size_t edge = chunk * chunk_size * 3; edge < std::min(facets_count, (chunk + 1) * chunk_size) * 3; ++edge)
+                chunk_ids[chunk+1] += first[edge] == edge;
+        }
+    );
+    for (size_t chunk = 1; chunk <= chunks_count; ++chunk)
+        chunk_ids[chunk] += chunk_ids[chunk-1];
+    this->edges_count = chunk_ids.back();
+    parallelize<size_t>(
+        0,
+        chunks_count-1,
+        [&](size_t chunk) {
+            int id = chunk_ids[chunk];
+            for (size_t edge = chunk * chunk_size * 3; edge < std::min(facets_count, (chunk + 1) * chunk_size) * 3; ++edge)
+                if (first[edge] == edge) this->facets_edges[edge / 3][edge % 3] = id++;
+        }
+    );
+    parallelize<size_t>(
+        0,
+        chunks_count-1,
+        [&](size_t chunk) {
+            for (size_t edge = chunk * chunk_size * 3; edge < std::min(facets_count, (chunk + 1) * chunk_size) * 3; ++edge)
+                if (first[edge] != edge) this->facets_edges[edge / 3][edge % 3] = this->facets_edges[first[edge] / 3][first[edge] % 3];
+        }
+    );
+}
+
 TriangleMesh::TriangleMesh()
     : repaired(false)
 {
@@ -90,6 +310,7 @@ TriangleMesh& TriangleMesh::operator= (const TriangleMesh& other)
     this->stl = other.stl;
     this->repaired = other.repaired;
     this->clone(other);
+    this->invalidate_indices();
 
     return *this;
 }
@@ -121,6 +342,9 @@ TriangleMesh::TriangleMesh(TriangleMesh&& other) {
     this->repaired = std::move(other.repaired);
     this->stl = std::move(other.stl);
     stl_initialize(&other.stl);
+    for (int axis = X; axis <= Z; ++axis)
+        this->_span_index[axis] = std::move(other._span_index[axis]);
+    this->_edge_index = std::move(other._edge_index);
 }
 
 TriangleMesh& TriangleMesh::operator= (TriangleMesh&& other)
@@ -128,6 +352,9 @@ TriangleMesh& TriangleMesh::operator= (TriangleMesh&& other)
     this->repaired = std::move(other.repaired);
     this->stl = std::move(other.stl);
     stl_initialize(&other.stl);
+    for (int axis = X; axis <= Z; ++axis)
+        this->_span_index[axis] = std::move(other._span_index[axis]);
+    this->_edge_index = std::move(other._edge_index);
 
     return *this;
 }
@@ -137,6 +364,9 @@ TriangleMesh::swap(TriangleMesh &other)
 {
     std::swap(this->stl,      other.stl);
     std::swap(this->repaired, other.repaired);
+    for (int axis = X; axis <= Z; ++axis)
+        std::swap(this->_span_index[axis], other._span_index[axis]);
+    std::swap(this->_edge_index, other._edge_index);
 }
 
 TriangleMesh::~TriangleMesh() {
@@ -145,11 +375,14 @@ TriangleMesh::~TriangleMesh() {
 
 void
 TriangleMesh::ReadSTLFile(const std::string &input_file) {
-    #ifdef BOOST_WINDOWS
-    stl_open(&stl, boost::nowide::widen(input_file).c_str());
-    #else
-    stl_open(&stl, input_file.c_str());
-    #endif
+    if (!IO::STL::read_mapped(input_file, &this->stl)) {
+        #ifdef BOOST_WINDOWS
+        stl_open(&stl, boost::nowide::widen(input_file).c_str());
+        #else
+        stl_open(&stl, input_file.c_str());
+        #endif
+    }
+    this->invalidate_indices();
     if (this->stl.error != 0) throw std::runtime_error("Failed to read STL file");
 }
 
@@ -182,22 +415,18 @@ TriangleMesh::repair() {
     
     this->check_topology();
 
-    /// Call the stl_repair from admesh rather than reimplementing it ourselves.
-    stl_repair(&(this->stl),  // operate on this STL
-               true,  // flag: try to fix everything
-               true,  // flag: check for perfectly aligned edges
-               false, // flag: don't use tolerance
-               0.0,    // null tolerance value
-               false, // flag: don't increment tolerance
-               0.0,   // amount to increment tolerance on each iteration
-               true,  // find and try to connect nearby bad facets
-               10,    // Perform 10 iterations
-               true,  // remove unconnected
-               true,  // fill holes
-               true,  // fix normal directions
-               true,  // fix normal values
-               false, // reverse direction of all facets and normals
-               0);  // Verbosity
+    /*  This is what admesh's stl_repair() does when asked to fix everything
+        (exact check, 10 nearby iterations, remove unconnected facets, fill
+        holes, fix normals), spelled out so that the exact connectivity pass
+        goes through stl_check_facets_exact_parallel(). */
+    this->check_topology(10);
+    if (this->stl.stats.connected_facets_3_edge < this->stl.stats.number_of_facets)
+        stl_remove_unconnected_facets(&this->stl);
+    if (this->stl.stats.connected_facets_3_edge < this->stl.stats.number_of_facets)
+        stl_fill_holes(&this->stl);
+    stl_fix_normal_directions(&this->stl);
+    stl_fix_normal_values(&this->stl);
+    stl_calculate_volume(&this->stl);
     
     // always calculate the volume and reverse all normals if volume is negative
     (void)this->volume();
@@ -205,6 +434,7 @@ TriangleMesh::repair() {
     // neighbors
     stl_verify_neighbors(&stl);
     
+    this->invalidate_indices();
     this->repaired = true;
 }
 
@@ -216,10 +446,10 @@ TriangleMesh::volume()
 }
 
 void
-TriangleMesh::check_topology()
+TriangleMesh::check_topology(int iterations)
 {
     // checking exact
-    stl_check_facets_exact(&stl);
+    stl_check_facets_exact_parallel(&stl);
     stl.stats.facets_w_1_bad_edge = (stl.stats.connected_facets_2_edge - stl.stats.connected_facets_3_edge);
     stl.stats.facets_w_2_bad_edge = (stl.stats.connected_facets_1_edge - stl.stats.connected_facets_2_edge);
     stl.stats.facets_w_3_bad_edge = (stl.stats.number_of_facets - stl.stats.connected_facets_1_edge);
@@ -228,12 +458,13 @@ TriangleMesh::check_topology()
     //int last_edges_fixed = 0;
     float tolerance = stl.stats.shortest_edge;
     float increment = stl.stats.bounding_diameter / 10000.0;
-    int iterations = 2;
     if (stl.stats.connected_facets_3_edge < stl.stats.number_of_facets) {
         for (int i = 0; i < iterations; i++) {
             if (stl.stats.connected_facets_3_edge < stl.stats.number_of_facets) {
                 //printf("Checking nearby. Tolerance= %f Iteration=%d of %d...", tolerance, i + 1, iterations);
                 stl_check_facets_nearby(&stl, tolerance);
+                // vertices may have moved
+                this->invalidate_indices();
                 //printf("  Fixed %d edges.\n", stl.stats.edges_fixed - last_edges_fixed);
                 //last_edges_fixed = stl.stats.edges_fixed;
                 tolerance += increment;
@@ -244,6 +475,286 @@ TriangleMesh::check_topology()
     }
 }
 
+namespace {
+
+/// One edge of the exact connectivity table, keyed like admesh's stl_hash_edge.
+struct ExactEdge {
+    uint32_t    key[6];
+    int         facet_number;
+    int         which_edge;
+    
+    ExactEdge() {};
+    /// Same as stl_load_edge_exact() on an edge of a facet with unified zeros.
+    ExactEdge(const stl_vertex (&vertex)[3], int facet_number, int which_edge)
+        : facet_number(facet_number), which_edge(which_edge)
+    {
+        const stl_vertex &a = vertex[which_edge];
+        const stl_vertex &b = vertex[(which_edge + 1) % 3];
+        if ((a.x != b.x) ? (a.x < b.x) : ((a.y != b.y) ? (a.y < b.y) : (a.z < b.z))) {
+            memcpy(&this->key[0], &a, sizeof(stl_vertex));
+            memcpy(&this->key[3], &b, sizeof(stl_vertex));
+        } else {
+            memcpy(&this->key[0], &b, sizeof(stl_vertex));
+            memcpy(&this->key[3], &a, sizeof(stl_vertex));
+            this->which_edge += 3;  // this edge is loaded backwards
+        }
+    }
+    bool same_key(const ExactEdge &other) const {
+        return memcmp(this->key, other.key, sizeof(this->key)) == 0;
+    }
+    uint32_t hash() const {
+        uint32_t h = 2166136261u;
+        for (int i = 0; i < 6; ++i) h = (h ^ this->key[i]) * 16777619u;
+        h ^= h >> 16; h *= 0x85ebca6bu;
+        h ^= h >> 13; h *= 0xc2b2ae35u;
+        return h ^ (h >> 16);
+    }
+};
+
+/// Open addressed table of the edges of a bucket still waiting for their
+/// pair, at most one per key. Matched edges leave the table again, so it
+/// stays small when neighboring facets are stored close to each other.
+class PendingExactEdges {
+public:
+    enum : uint32_t { NONE = 0xFFFFFFFF };
+    
+    /// edges are indexed by the table, hashes are divided by divisor so that
+    /// the bits already used to pick the bucket are skipped.
+    PendingExactEdges(const ExactEdge* edges, uint32_t divisor)
+        : _edges(edges), _divisor(divisor), _mask(255), _size(0), _slots(256, NONE) {};
+    
+    /// Remove and return the pending edge with the same key as edge i, or
+    /// add edge i and return NONE if there is none.
+    uint32_t match(uint32_t i) {
+        uint32_t slot = this->_home(i);
+        for (; this->_slots[slot] != NONE; slot = (slot + 1) & this->_mask) {
+            const uint32_t other = this->_slots[slot];
+            if (this->_edges[other].same_key(this->_edges[i])) {
+                this->_erase(slot);
+                return other;
+            }
+        }
+        this->_slots[slot] = i;
+        if (++this->_size * 2 > this->_mask) this->_grow();
+        return NONE;
+    };
+    
+private:
+    const ExactEdge*        _edges;
+    uint32_t                _divisor;
+    uint32_t                _mask;
+    uint32_t                _size;
+    std::vector<uint32_t>   _slots;
+    
+    uint32_t _home(uint32_t i) const { return (this->_edges[i].hash() / this->_divisor) & this->_mask; };
+    
+    /// Backward shift deletion, which keeps probe sequences without holes.
+    void _erase(uint32_t slot) {
+        for (uint32_t next = (slot + 1) & this->_mask; this->_slots[next] != NONE; next = (next + 1) & this->_mask) {
+            if (((next - this->_home(this->_slots[next])) & this->_mask) >= ((next - slot) & this->_mask)) {
+                this->_slots[slot] = this->_slots[next];
+                slot = next;
+            }
+        }
+        this->_slots[slot] = NONE;
+        --this->_size;
+    };
+    
+    void _grow() {
+        std::vector<uint32_t> slots(this->_slots.size() * 2, NONE);
+        slots.swap(this->_slots);
+        this->_mask = this->_mask * 2 + 1;
+        for (uint32_t i : slots) {
+            if (i == NONE) continue;
+            uint32_t slot = this->_home(i);
+            while (this->_slots[slot] != NONE) slot = (slot + 1) & this->_mask;
+            this->_slots[slot] = i;
+        }
+    };
+};
+
+}
+
+/// Copy of a facet's vertices with -0 turned into +0, so that vertices
+/// equal for the FPU are also equal for memcmp.
+static inline void
+unified_vertices(const stl_facet &facet, stl_vertex (&vertex)[3])
+{
+    memcpy(vertex, facet.vertex, sizeof(vertex));
+    uint32_t* f = reinterpret_cast<uint32_t*>(vertex);
+    for (int i = 0; i < 9; ++i)
+        if (f[i] == 0x80000000) f[i] = 0;
+}
+
+/// Same as stl_record_neighbors(), minus the statistics which are
+/// computed once all edges are matched.
+static inline void
+record_exact_neighbors(stl_file* stl, const ExactEdge &edge_a, const ExactEdge &edge_b)
+{
+    stl_neighbors &a = stl->neighbors_start[edge_a.facet_number];
+    stl_neighbors &b = stl->neighbors_start[edge_b.facet_number];
+    a.neighbor[edge_a.which_edge % 3] = edge_b.facet_number;
+    a.which_vertex_not[edge_a.which_edge % 3] = (edge_b.which_edge + 2) % 3;
+    b.neighbor[edge_b.which_edge % 3] = edge_a.facet_number;
+    b.which_vertex_not[edge_b.which_edge % 3] = (edge_a.which_edge + 2) % 3;
+    if ((edge_a.which_edge < 3) == (edge_b.which_edge < 3)) {
+        // these facets are oriented in opposite directions
+        a.which_vertex_not[edge_a.which_edge % 3] += 3;
+        b.which_vertex_not[edge_b.which_edge % 3] += 3;
+    }
+}
+
+void
+stl_check_facets_exact_parallel(stl_file *stl)
+{
+    if (stl->error) return;
+    
+    stl->stats.connected_edges = 0;
+    stl->stats.connected_facets_1_edge = 0;
+    stl->stats.connected_facets_2_edge = 0;
+    stl->stats.connected_facets_3_edge = 0;
+    stl->stats.malloced = 0;
+    stl->stats.freed = 0;
+    stl->stats.collisions = 0;
+    
+    for (int i = 0; i < stl->stats.number_of_facets; ++i)
+        stl->neighbors_start[i].neighbor[0] = stl->neighbors_start[i].neighbor[1] = stl->neighbors_start[i].neighbor[2] = -1;
+    
+    /*  admesh removes a degenerate facet by moving the last facet in its place
+        and checking that one next. None of the moved facets is connected yet,
+        so doing all the removals upfront leaves the facets in the same order. */
+    for (int i = 0; i < stl->stats.number_of_facets; ) {
+        stl_vertex vertex[3];
+        unified_vertices(stl->facet_start[i], vertex);
+        if (memcmp(&vertex[0], &vertex[1], sizeof(stl_vertex)) != 0
+            && memcmp(&vertex[1], &vertex[2], sizeof(stl_vertex)) != 0
+            && memcmp(&vertex[0], &vertex[2], sizeof(stl_vertex)) != 0) {
+            ++i;
+            continue;
+        }
+        const int last = stl->stats.number_of_facets - 1;
+        stl->stats.degenerate_facets += 1;
+        stl->stats.facets_removed += 1;
+        stl->facet_start[i] = stl->facet_start[last];
+        stl->neighbors_start[i] = stl->neighbors_start[last];
+        stl->stats.number_of_facets -= 1;
+    }
+    
+    const size_t facets_count = stl->stats.number_of_facets;
+    if (facets_count == 0) return;
+    
+    /*  The edges are scattered into buckets by a hash of their key, keeping the
+        facet order inside each bucket, so that every bucket can be matched on
+        its own. In admesh a new edge is matched with the oldest unmatched edge
+        of equal key, which means that equal edges pair up as first with second,
+        third with fourth and so on in facet order; walking each bucket in facet
+        order pairs them up the same way. */
+    const size_t chunks_count = std::min(facets_count,
+        (size_t)std::max(1u, boost::thread::hardware_concurrency()) * 4);
+    const size_t chunk_size = (facets_count + chunks_count - 1) / chunks_count;
+    const size_t buckets_count = std::min(facets_count * 3 / 65536 + 1, chunks_count * 2);
+    
+    // count the edges of each run going to each bucket, and find the shortest one
+    std::vector< std::vector<uint32_t> > offsets(chunks_count, std::vector<uint32_t>(buckets_count, 0));
+    std::vector<float> shortest_edge(chunks_count, std::numeric_limits<float>::infinity());
+    parallelize<size_t>(
+        0,
+        chunks_count-1,
+        [stl, chunk_size, facets_count, buckets_count, &offsets, &shortest_edge](size_t chunk) {
+            std::vector<uint32_t> &counts = offsets[chunk];
+            float shortest = shortest_edge[chunk];
+            for (size_t i = chunk * chunk_size; i < std::min(facets_count, (chunk + 1) * chunk_size); ++i) {
+                stl_vertex vertex[3];
+                unified_vertices(stl->facet_start[i], vertex);
+                for (int j = 0; j < 3; ++j) {
+                    const stl_vertex &a = vertex[j];
+                    const stl_vertex &b = vertex[(j + 1) % 3];
+                    float diff_x = ABS(a.x - b.x);
+                    float diff_y = ABS(a.y - b.y);
+                    float diff_z = ABS(a.z - b.z);
+                    float max_diff = STL_MAX(diff_x, diff_y);
+                    max_diff = STL_MAX(diff_z, max_diff);
+                    shortest = STL_MIN(max_diff, shortest);
+                    ++counts[ExactEdge(vertex, (int)i, j).hash() % buckets_count];
+                }
+            }
+            shortest_edge[chunk] = shortest;
+        }
+    );
+    for (float length : shortest_edge)
+        stl->stats.shortest_edge = STL_MIN(length, stl->stats.shortest_edge);
+    
+    std::vector<uint32_t> bucket_start(buckets_count + 1, 0);
+    for (size_t bucket = 0, offset = 0; bucket < buckets_count; ++bucket) {
+        bucket_start[bucket] = offset;
+        for (std::vector<uint32_t> &counts : offsets) {
+            const uint32_t count = counts[bucket];
+            counts[bucket] = offset;
+            offset += count;
+        }
+    }
+    bucket_start[buckets_count] = facets_count * 3;
+    
+    std::vector<ExactEdge> edges(facets_count * 3);
+    parallelize<size_t>(
+        0,
+        chunks_count-1,
+        [stl, chunk_size, facets_count, buckets_count, &offsets, &edges](size_t chunk) {
+            std::vector<uint32_t> &next = offsets[chunk];
+            for (size_t i = chunk * chunk_size; i < std::min(facets_count, (chunk + 1) * chunk_size); ++i) {
+                stl_vertex vertex[3];
+                unified_vertices(stl->facet_start[i], vertex);
+                for (int j = 0; j < 3; ++j) {
+                    const ExactEdge edge(vertex, (int)i, j);
+                    edges[ next[edge.hash() % buckets_count]++ ] = edge;
+                }
+            }
+        }
+    );
+    
+    std::vector<int> connected_edges(buckets_count, 0);
+    parallelize<size_t>(
+        0,
+        buckets_count-1,
+        [stl, buckets_count, &edges, &bucket_start, &connected_edges](size_t bucket) {
+            const ExactEdge* bucket_edges = edges.data() + bucket_start[bucket];
+            PendingExactEdges pending(bucket_edges, buckets_count);
+            for (uint32_t i = 0; i < bucket_start[bucket+1] - bucket_start[bucket]; ++i) {
+                const uint32_t other = pending.match(i);
+                if (other != PendingExactEdges::NONE) {
+                    record_exact_neighbors(stl, bucket_edges[i], bucket_edges[other]);
+                    connected_edges[bucket] += 2;
+                }
+            }
+        }
+    );
+    std::vector<ExactEdge>().swap(edges);
+    for (int count : connected_edges)
+        stl->stats.connected_edges += count;
+    
+    /*  admesh counts a facet in connected_facets_N_edge when its Nth edge gets
+        connected, so once all edges are matched these are the numbers of
+        facets with at least N connected edges. */
+    std::vector< std::array<int, 3> > connected_facets(chunks_count, std::array<int, 3>{{ 0, 0, 0 }});
+    parallelize<size_t>(
+        0,
+        chunks_count-1,
+        [stl, chunk_size, facets_count, &connected_facets](size_t chunk) {
+            for (size_t i = chunk * chunk_size; i < std::min(facets_count, (chunk + 1) * chunk_size); ++i) {
+                const stl_neighbors &neighbors = stl->neighbors_start[i];
+                const int connected = (neighbors.neighbor[0] != -1) + (neighbors.neighbor[1] != -1) + (neighbors.neighbor[2] != -1);
+                for (int n = 0; n < connected; ++n)
+                    ++connected_facets[chunk][n];
+            }
+        }
+    );
+    for (const std::array<int, 3> &counts : connected_facets) {
+        stl->stats.connected_facets_1_edge += counts[0];
+        stl->stats.connected_facets_2_edge += counts[1];
+        stl->stats.connected_facets_3_edge += counts[2];
+    }
+}
+
 bool
 TriangleMesh::is_manifold() const
 {
@@ -293,6 +804,7 @@ void TriangleMesh::scale(float factor)
 {
     stl_scale(&(this->stl), factor);
     stl_invalidate_shared_vertices(&this->stl);
+    this->invalidate_indices();
 }
 
 void TriangleMesh::scale(const Pointf3 &versor)
@@ -303,12 +815,14 @@ void TriangleMesh::scale(const Pointf3 &versor)
     fversor[2] = versor.z;
     stl_scale_versor(&this->stl, fversor);
     stl_invalidate_shared_vertices(&this->stl);
+    this->invalidate_indices();
 }
 
 void TriangleMesh::translate(float x, float y, float z)
 {
     stl_translate_relative(&(this->stl), x, y, z);
     stl_invalidate_shared_vertices(&this->stl);
+    this->invalidate_indices();
 }
 
 void TriangleMesh::translate(Pointf3 vec) {
@@ -332,6 +846,7 @@ void TriangleMesh::rotate(float angle, const Axis &axis)
         stl_rotate_z(&(this->stl), angle);
     }
     stl_invalidate_shared_vertices(&this->stl);
+    this->invalidate_indices();
 }
 
 void TriangleMesh::rotate_x(float angle)
@@ -359,6 +874,7 @@ void TriangleMesh::mirror(const Axis &axis)
         stl_mirror_xy(&this->stl);
     }
     stl_invalidate_shared_vertices(&this->stl);
+    this->invalidate_indices();
 }
 
 void TriangleMesh::mirror_x()
@@ -410,6 +926,7 @@ void TriangleMesh::align_to_bed()
 {
     stl_translate_relative(&(this->stl), 0.0f, 0.0f, -this->stl.stats.min.z);
     stl_invalidate_shared_vertices(&this->stl);
+    this->invalidate_indices();
 }
 
 TriangleMesh TriangleMesh::get_transformed_mesh(TransformationMatrix const & trafo) const
@@ -426,6 +943,7 @@ void TriangleMesh::transform(TransformationMatrix const & trafo)
     std::vector<double> trafo_arr = trafo.matrix3x4f();
     stl_transform(&(this->stl), trafo_arr.data());
     stl_invalidate_shared_vertices(&(this->stl));
+    this->invalidate_indices();
 }
 
 Pointf3s TriangleMesh::vertices()
@@ -523,6 +1041,57 @@ BoundingBoxf3 TriangleMesh::bb3() const {
 }
 
 
+std::shared_ptr<const FacetSpanIndex>
+TriangleMesh::span_index(Axis axis) const
+{
+    const auto fresh = [this, axis](const std::shared_ptr<const FacetSpanIndex> &index) {
+        return index != nullptr
+            && index->_facet_start == this->stl.facet_start
+            && index->size() == (size_t)std::max(this->stl.stats.number_of_facets, 0)
+            && index->_lowest  == axis_coord(this->stl.stats.min, axis)
+            && index->_highest == axis_coord(this->stl.stats.max, axis);
+    };
+    std::shared_ptr<const FacetSpanIndex> index = std::atomic_load(&this->_span_index[axis]);
+    if (!fresh(index)) {
+        // slicing threads may ask for the index concurrently: the first one
+        // stored is kept and the others use it, or their own copy if it is stale
+        std::shared_ptr<const FacetSpanIndex> built = std::make_shared<const FacetSpanIndex>(this->stl, axis);
+        if (std::atomic_compare_exchange_strong(&this->_span_index[axis], &index, built) || !fresh(index))
+            index = built;
+    }
+    return index;
+}
+
+std::shared_ptr<const FacetEdgeIndex>
+TriangleMesh::edge_index()
+{
+    this->require_shared_vertices();
+    const auto fresh = [this](const std::shared_ptr<const FacetEdgeIndex> &index) {
+        return index != nullptr
+            && index->_v_indices == this->stl.v_indices
+            && index->_v_shared  == this->stl.v_shared
+            && index->facets_edges.size()    == (size_t)this->stl.stats.number_of_facets
+            && index->scaled_vertices.size() == (size_t)this->stl.stats.shared_vertices;
+    };
+    std::shared_ptr<const FacetEdgeIndex> index = std::atomic_load(&this->_edge_index);
+    if (!fresh(index)) {
+        // same as span_index()
+        Profiler::Scope profile("TriangleMesh::edge_index", "TriangleMesh", this->stl.stats.number_of_facets);
+        std::shared_ptr<const FacetEdgeIndex> built = std::make_shared<const FacetEdgeIndex>(this->stl);
+        if (std::atomic_compare_exchange_strong(&this->_edge_index, &index, built) || !fresh(index))
+            index = built;
+    }
+    return index;
+}
+
+void
+TriangleMesh::invalidate_indices()
+{
+    for (int axis = X; axis <= Z; ++axis)
+        std::atomic_store(&this->_span_index[axis], std::shared_ptr<const FacetSpanIndex>());
+    std::atomic_store(&this->_edge_index, std::shared_ptr<const FacetEdgeIndex>());
+}
+
 void TriangleMesh::cut(Axis axis, double z, TriangleMesh* upper, TriangleMesh* lower) 
 {
     switch(axis) {
@@ -640,6 +1209,7 @@ TriangleMesh::merge(const TriangleMesh &mesh)
     // reset stats and metadata
     int number_of_facets = this->stl.stats.number_of_facets;
     stl_invalidate_shared_vertices(&this->stl);
+    this->invalidate_indices();
     this->repaired = false;
     
     // update facet count and allocate more memory
@@ -726,7 +1296,10 @@ void
 TriangleMesh::require_shared_vertices()
 {
     if (!this->repaired) this->repair();
-    if (this->stl.v_shared == NULL) stl_generate_shared_vertices(&(this->stl));
+    if (this->stl.v_shared == NULL) {
+        Profiler::Scope profile("TriangleMesh::require_shared_vertices", "TriangleMesh", this->stl.stats.number_of_facets);
+        stl_generate_shared_vertices(&(this->stl));
+    }
 }
 
 void
@@ -781,6 +1354,7 @@ TriangleMesh::extrude_tin(float offset)
         }
     }
     stl_get_size(&this->stl);
+    this->invalidate_indices();
     
     this->repair();
 }
@@ -967,15 +1541,8 @@ TriangleMeshSlicer<A>::slice(const std::vector<float> &z, std::vector<Polygons>*
         type is float.
     */
     
-    std::vector<IntersectionLines> lines(z.size());
-    {
-        boost::mutex lines_mutex;
-        parallelize<int>(
-            0,
-            this->mesh->stl.stats.number_of_facets-1,
-            boost::bind(&TriangleMeshSlicer<A>::_slice_do, this, _1, &lines, &lines_mutex, z)
-        );
-    }
+    std::vector<IntersectionLines> lines;
+    this->slice_lines(z, &lines);
     
     // v_scaled_shared could be freed here
     
@@ -990,34 +1557,116 @@ TriangleMeshSlicer<A>::slice(const std::vector<float> &z, std::vector<Polygons>*
 
 template <Axis A>
 void
-TriangleMeshSlicer<A>::_slice_do(size_t facet_idx, std::vector<IntersectionLines>* lines, boost::mutex* lines_mutex, 
-    const std::vector<float> &z) const
+TriangleMeshSlicer<A>::slice_lines(const std::vector<float> &z, std::vector<IntersectionLines>* lines) const
 {
-    const stl_facet &facet = this->mesh->stl.facet_start[facet_idx];
+    lines->clear();
+    lines->resize(z.size());
+    if (this->mesh->stl.stats.number_of_facets == 0 || z.empty()) return;
     
-    // find facet extents
-    const float min_z = fminf(_z(facet.vertex[0]), fminf(_z(facet.vertex[1]), _z(facet.vertex[2])));
-    const float max_z = fmaxf(_z(facet.vertex[0]), fmaxf(_z(facet.vertex[1]), _z(facet.vertex[2])));
+    /*  When only a band of the mesh is sliced (single planes, cuts, re-slicing of
+        a layer range) the facets crossing it are looked up in the span index
+        instead of visiting all of them. The index is returned in facet order, so
+        the lines are the same either way. */
+    std::vector<int> selected;
+    const auto z_range = std::minmax_element(z.begin(), z.end());
+    const bool use_index = (*z_range.second - *z_range.first)
+        < (axis_coord(this->mesh->stl.stats.max, A) - axis_coord(this->mesh->stl.stats.min, A)) / 2;
+    if (use_index) selected = this->mesh->span_index(A)->query(*z_range.first, *z_range.second);
+    const size_t facets_count = use_index ? selected.size() : (size_t)this->mesh->stl.stats.number_of_facets;
+    if (facets_count == 0) return;
     
-    #ifdef SLIC3R_DEBUG
-    printf("\n==> FACET %zu (%f,%f,%f - %f,%f,%f - %f,%f,%f):\n", facet_idx,
-        _x(facet.vertex[0]), _y(facet.vertex[0]), _z(facet.vertex[0]),
-        _x(facet.vertex[1]), _y(facet.vertex[1]), _z(facet.vertex[1]),
-        _x(facet.vertex[2]), _y(facet.vertex[2]), _z(facet.vertex[2]));
-    printf("z: min = %.2f, max = %.2f\n", min_z, max_z);
-    #endif
+    /*  Facets are split in runs of consecutive facets and each run collects its
+        intersection lines in a buffer of its own, together with the number of
+        lines found on each layer. Once all runs are done we know where each run
+        has to write its lines in the per-layer vectors, so that they can be moved
+        there without any locking and in the same order a serial pass over the
+        facets would produce. */
+    const size_t chunks_count = std::min(facets_count,
+        (size_t)std::max(1u, boost::thread::hardware_concurrency()) * 4);
+    const size_t chunk_size = (facets_count + chunks_count - 1) / chunks_count;
     
-    // find layer extents
-    std::vector<float>::const_iterator min_layer, max_layer;
-    min_layer = std::lower_bound(z.begin(), z.end(), min_z); // first layer whose slice_z is >= min_z
-    max_layer = std::upper_bound(z.begin() + (min_layer - z.begin()), z.end(), max_z) - 1; // last layer whose slice_z is <= max_z
-    #ifdef SLIC3R_DEBUG
-    printf("layers: min = %d, max = %d\n", (int)(min_layer - z.begin()), (int)(max_layer - z.begin()));
-    #endif
+    std::vector<t_layer_lines> chunk_lines(chunks_count);
+    std::vector< std::vector<size_t> > chunk_counts(chunks_count, std::vector<size_t>(z.size(), 0));
+    parallelize<size_t>(
+        0,
+        chunks_count-1,
+        boost::bind(&TriangleMeshSlicer<A>::_slice_chunk_do, this, _1, chunk_size,
+            (use_index ? &selected : nullptr), &z, &chunk_lines, &chunk_counts)
+    );
+    
+    // turn the per-run counts into offsets in the layer vectors
+    parallelize<size_t>(
+        0,
+        z.size()-1,
+        [lines, &chunk_counts](size_t layer_idx) {
+            size_t offset = 0;
+            for (std::vector<size_t> &counts : chunk_counts) {
+                const size_t count = counts[layer_idx];
+                counts[layer_idx] = offset;
+                offset += count;
+            }
+            (*lines)[layer_idx].resize(offset);
+        }
+    );
     
-    for (std::vector<float>::const_iterator it = min_layer; it != max_layer + 1; ++it) {
-        std::vector<float>::size_type layer_idx = it - z.begin();
-        this->slice_facet(*it / SCALING_FACTOR, facet, facet_idx, min_z, max_z, &(*lines)[layer_idx], lines_mutex);
+    // move the lines in place
+    parallelize<size_t>(
+        0,
+        chunks_count-1,
+        [lines, &chunk_lines, &chunk_counts](size_t chunk) {
+            std::vector<size_t> &offsets = chunk_counts[chunk];
+            for (const std::pair<size_t, IntersectionLine> &line : chunk_lines[chunk])
+                (*lines)[line.first][ offsets[line.first]++ ] = line.second;
+            t_layer_lines().swap(chunk_lines[chunk]);
+        }
+    );
+}
+
+template <Axis A>
+void
+TriangleMeshSlicer<A>::_slice_chunk_do(size_t chunk, size_t chunk_size, const std::vector<int>* selected,
+    const std::vector<float>* z, std::vector<t_layer_lines>* chunk_lines,
+    std::vector< std::vector<size_t> >* chunk_counts) const
+{
+    const size_t first = chunk * chunk_size;
+    const size_t last  = std::min(first + chunk_size,
+        selected != nullptr ? selected->size() : (size_t)this->mesh->stl.stats.number_of_facets);
+    t_layer_lines &layer_lines = (*chunk_lines)[chunk];
+    std::vector<size_t> &counts = (*chunk_counts)[chunk];
+    IntersectionLines facet_lines;
+    
+    for (size_t pos = first; pos < last; ++pos) {
+        const size_t facet_idx = selected != nullptr ? (*selected)[pos] : pos;
+        const stl_facet &facet = this->mesh->stl.facet_start[facet_idx];
+        
+        // find facet extents
+        const float min_z = fminf(_z(facet.vertex[0]), fminf(_z(facet.vertex[1]), _z(facet.vertex[2])));
+        const float max_z = fmaxf(_z(facet.vertex[0]), fmaxf(_z(facet.vertex[1]), _z(facet.vertex[2])));
+        
+        #ifdef SLIC3R_DEBUG
+        printf("\n==> FACET %zu (%f,%f,%f - %f,%f,%f - %f,%f,%f):\n", facet_idx,
+            _x(facet.vertex[0]), _y(facet.vertex[0]), _z(facet.vertex[0]),
+            _x(facet.vertex[1]), _y(facet.vertex[1]), _z(facet.vertex[1]),
+            _x(facet.vertex[2]), _y(facet.vertex[2]), _z(facet.vertex[2]));
+        printf("z: min = %.2f, max = %.2f\n", min_z, max_z);
+        #endif
+        
+        // find layer extents
+        std::vector<float>::const_iterator min_layer, max_layer;
+        min_layer = std::lower_bound(z->begin(), z->end(), min_z); // first layer whose slice_z is >= min_z
+        max_layer = std::upper_bound(min_layer, z->end(), max_z);  // first layer whose slice_z is > max_z
+        #ifdef SLIC3R_DEBUG
+        printf("layers: min = %d, max = %d\n", (int)(min_layer - z->begin()), (int)(max_layer - z->begin()) - 1);
+        #endif
+        
+        for (std::vector<float>::const_iterator it = min_layer; it != max_layer; ++it) {
+            const size_t layer_idx = it - z->begin();
+            facet_lines.clear();
+            this->slice_facet(*it / SCALING_FACTOR, facet, facet_idx, min_z, max_z, &facet_lines);
+            for (const IntersectionLine &line : facet_lines)
+                layer_lines.push_back(std::make_pair(layer_idx, line));
+            counts[layer_idx] += facet_lines.size();
+        }
     }
 }
 
@@ -1072,18 +1721,18 @@ TriangleMeshSlicer<A>::slice_facet(float slice_z, const stl_facet &facet, const
         i = 2;
     }
     for (int j = i; (j-i) < 3; j++) {  // loop through facet edges
-        int edge_id = this->facets_edges[facet_idx][j % 3];
+        int edge_id = this->edge_index->facets_edges[facet_idx][j % 3];
         int a_id = this->mesh->stl.v_indices[facet_idx].vertex[j % 3];
         int b_id = this->mesh->stl.v_indices[facet_idx].vertex[(j+1) % 3];
-        stl_vertex* a = &this->v_scaled_shared[a_id];
-        stl_vertex* b = &this->v_scaled_shared[b_id];
+        const stl_vertex* a = &this->v_scaled_shared[a_id];
+        const stl_vertex* b = &this->v_scaled_shared[b_id];
         
         if (_z(*a) == _z(*b) && _z(*a) == slice_z) {
             // edge is horizontal and belongs to the current layer
             
-            stl_vertex &v0 = this->v_scaled_shared[ this->mesh->stl.v_indices[facet_idx].vertex[0] ];
-            stl_vertex &v1 = this->v_scaled_shared[ this->mesh->stl.v_indices[facet_idx].vertex[1] ];
-            stl_vertex &v2 = this->v_scaled_shared[ this->mesh->stl.v_indices[facet_idx].vertex[2] ];
+            const stl_vertex &v0 = this->v_scaled_shared[ this->mesh->stl.v_indices[facet_idx].vertex[0] ];
+            const stl_vertex &v1 = this->v_scaled_shared[ this->mesh->stl.v_indices[facet_idx].vertex[1] ];
+            const stl_vertex &v2 = this->v_scaled_shared[ this->mesh->stl.v_indices[facet_idx].vertex[2] ];
             IntersectionLine line;
             if (min_z == max_z) {
                 line.edge_type = feHorizontal;
@@ -1446,14 +2095,15 @@ TriangleMeshSlicer<A>::cut(float z, TriangleMesh* upper, TriangleMesh* lower) co
     IntersectionLines upper_lines, lower_lines;
     
     const float scaled_z = scale_(z);
-    for (int facet_idx = 0; facet_idx < this->mesh->stl.stats.number_of_facets; facet_idx++) {
-        stl_facet* facet = &this->mesh->stl.facet_start[facet_idx];
-        
-        // find facet extents
+    
+    // intersect the facets crossing the cutting plane with it (the margin
+    // covers the rounding of the scaled coordinates)
+    const std::vector<int> crossing = this->mesh->span_index(A)->query(z - EPSILON, z + EPSILON);
+    for (int facet_idx : crossing) {
+        const stl_facet* facet = &this->mesh->stl.facet_start[facet_idx];
         float min_z = fminf(_z(facet->vertex[0]), fminf(_z(facet->vertex[1]), _z(facet->vertex[2])));
         float max_z = fmaxf(_z(facet->vertex[0]), fmaxf(_z(facet->vertex[1]), _z(facet->vertex[2])));
         
-        // intersect facet with cutting plane
         IntersectionLines lines;
         this->slice_facet(scaled_z, *facet, facet_idx, min_z, max_z, &lines);
         
@@ -1468,6 +2118,28 @@ TriangleMeshSlicer<A>::cut(float z, TriangleMesh* upper, TriangleMesh* lower) co
                 upper_lines.push_back(*it);
             }
         }
+    }
+    
+    // every facet goes to one side or the other, but only the ones the index
+    // found near the plane need their extent checked or get split
+    std::vector<int>::const_iterator candidate = crossing.begin();
+    for (int facet_idx = 0; facet_idx < this->mesh->stl.stats.number_of_facets; facet_idx++) {
+        stl_facet* facet = &this->mesh->stl.facet_start[facet_idx];
+        
+        if (candidate == crossing.end() || *candidate != facet_idx) {
+            // the whole facet is more than EPSILON above or below the plane
+            if (_z(facet->vertex[0]) > z) {
+                if (upper != NULL) stl_add_facet(&upper->stl, facet);
+            } else {
+                if (lower != NULL) stl_add_facet(&lower->stl, facet);
+            }
+            continue;
+        }
+        ++candidate;
+        
+        // find facet extents
+        float min_z = fminf(_z(facet->vertex[0]), fminf(_z(facet->vertex[1]), _z(facet->vertex[2])));
+        float max_z = fmaxf(_z(facet->vertex[0]), fmaxf(_z(facet->vertex[1]), _z(facet->vertex[2])));
         
         if (min_z > z || (min_z == z && max_z > min_z)) {
             // facet is above the cut plane and does not belong to it
@@ -1597,70 +2269,9 @@ TriangleMeshSlicer<A>::cut(float z, TriangleMesh* upper, TriangleMesh* lower) co
 
 
 template <Axis A>
-TriangleMeshSlicer<A>::TriangleMeshSlicer(TriangleMesh* _mesh) : mesh(_mesh), v_scaled_shared(NULL)
-{
-    // build a table to map a facet_idx to its three edge indices
-    this->mesh->require_shared_vertices();
-    typedef std::pair<int,int>              t_edge;
-    typedef std::vector<t_edge>             t_edges;  // edge_idx => a_id,b_id
-    typedef std::map<t_edge,int>            t_edges_map;  // a_id,b_id => edge_idx
-    
-    this->facets_edges.resize(this->mesh->stl.stats.number_of_facets);
-    
-    {
-        t_edges edges;
-        // reserve() instead of resize() because otherwise we couldn't read .size() below to assign edge_idx
-        edges.reserve(this->mesh->stl.stats.number_of_facets * 3);  // number of edges = number of facets * 3
-        t_edges_map edges_map;
-        for (int facet_idx = 0; facet_idx < this->mesh->stl.stats.number_of_facets; facet_idx++) {
-            this->facets_edges[facet_idx].resize(3);
-            for (int i = 0; i <= 2; i++) {
-                int a_id = this->mesh->stl.v_indices[facet_idx].vertex[i];
-                int b_id = this->mesh->stl.v_indices[facet_idx].vertex[(i+1) % 3];
-                
-                int edge_idx;
-                t_edges_map::const_iterator my_edge = edges_map.find(std::make_pair(b_id,a_id));
-                if (my_edge != edges_map.end()) {
-                    edge_idx = my_edge->second;
-                } else {
-                    /* admesh can assign the same edge ID to more than two facets (which is 
-                       still topologically correct), so we have to search for a duplicate of 
-                       this edge too in case it was already seen in this orientation */
-                    my_edge = edges_map.find(std::make_pair(a_id,b_id));
-                    
-                    if (my_edge != edges_map.end()) {
-                        edge_idx = my_edge->second;
-                    } else {
-                        // edge isn't listed in table, so we insert it
-                        edge_idx = edges.size();
-                        edges.push_back(std::make_pair(a_id,b_id));
-                        edges_map[ edges[edge_idx] ] = edge_idx;
-                    }
-                }
-                this->facets_edges[facet_idx][i] = edge_idx;
-                
-                #ifdef SLIC3R_DEBUG
-                printf("  [facet %d, edge %d] a_id = %d, b_id = %d   --> edge %d\n", facet_idx, i, a_id, b_id, edge_idx);
-                #endif
-            }
-        }
-    }
-    
-    // clone shared vertices coordinates and scale them
-    this->v_scaled_shared = (stl_vertex*)calloc(this->mesh->stl.stats.shared_vertices, sizeof(stl_vertex));
-    std::copy(this->mesh->stl.v_shared, this->mesh->stl.v_shared + this->mesh->stl.stats.shared_vertices, this->v_scaled_shared);
-    for (int i = 0; i < this->mesh->stl.stats.shared_vertices; i++) {
-        this->v_scaled_shared[i].x /= SCALING_FACTOR;
-        this->v_scaled_shared[i].y /= SCALING_FACTOR;
-        this->v_scaled_shared[i].z /= SCALING_FACTOR;
-    }
-}
-
-template <Axis A>
-TriangleMeshSlicer<A>::~TriangleMeshSlicer()
-{
-    free(this->v_scaled_shared);
-}
+TriangleMeshSlicer<A>::TriangleMeshSlicer(TriangleMesh* _mesh)
+    : mesh(_mesh), edge_index(_mesh->edge_index()), v_scaled_shared(edge_index->scaled_vertices.data())
+{}
 
 template class TriangleMeshSlicer<X>;
 template class TriangleMeshSlicer<Y>;
@@ -3,6 +3,8 @@
 
 #include "libslic3r.h"
 #include <admesh/stl.h>
+#include <array>
+#include <memory>
 #include <vector>
 #include <boost/thread.hpp>
 #include "BoundingBox.hpp"
@@ -18,6 +20,65 @@ class TriangleMesh;
 template <Axis A> class TriangleMeshSlicer;
 typedef std::vector<TriangleMesh*> TriangleMeshPtrs;
 
+/// Facets of a mesh sorted by the lower end of their extent along one axis,
+/// with a tree of the upper ends on top of them, to find the facets spanning
+/// a range of heights without visiting the whole mesh.
+class FacetSpanIndex
+{
+    public:
+    FacetSpanIndex() {};
+    FacetSpanIndex(const stl_file &stl, Axis axis);
+
+    /// Indices of the facets whose extent overlaps [min, max], sorted by facet index.
+    std::vector<int> query(float min, float max) const;
+
+    /// Position of the first facet (in min_z order) whose lower end is not below z.
+    size_t lower_bound(float z) const;
+
+    /// Position of the first facet (in min_z order) whose lower end is above z.
+    size_t upper_bound(float z) const;
+
+    size_t size() const { return this->facets.size(); };
+    bool empty() const { return this->facets.empty(); };
+
+    std::vector<int>    facets;     ///< facet indices, sorted by the lower end of their extent
+    std::vector<float>  min_z;      ///< lower end of each facet, in the order of facets
+    std::vector<float>  max_z;      ///< upper end of each facet, in the order of facets
+
+    private:
+    /// Maximum of max_z over each node of a complete binary tree whose
+    /// leaves are the sorted facets (node 1 is the root).
+    std::vector<float>  _tree;
+    size_t              _leaves {0};
+
+    friend class TriangleMesh;
+    /// Identifies the facet data the index was built from.
+    const stl_facet*    _facet_start {nullptr};
+    float               _lowest {0};
+    float               _highest {0};
+};
+
+/// Edges between the shared vertices of a mesh, numbered in the order they
+/// first appear in the facets, and the shared vertices scaled to integer
+/// coordinates. This is what TriangleMeshSlicer works on.
+class FacetEdgeIndex
+{
+    public:
+    FacetEdgeIndex() {};
+    explicit FacetEdgeIndex(const stl_file &stl);
+
+    /// Ids of the three edges of each facet, edge i going from vertex i to vertex i+1.
+    std::vector< std::array<int, 3> >   facets_edges;
+    size_t                              edges_count {0};
+    /// stl.v_shared divided by SCALING_FACTOR.
+    std::vector<stl_vertex>             scaled_vertices;
+
+    private:
+    friend class TriangleMesh;
+    /// Identifies the shared vertex data the index was built from.
+    const v_indices_struct* _v_indices {nullptr};
+    const stl_vertex*       _v_shared {nullptr};
+};
 
 /// Interface to available statistics from the underlying mesh. 
 struct mesh_stats {
@@ -58,7 +119,11 @@ class TriangleMesh
     void write_ascii(const std::string &output_file) const;
     void write_binary(const std::string &output_file) const;
     void repair();
-    void check_topology();
+
+    /// Build the facet neighbors list, then try to connect the remaining open
+    /// edges to nearby ones with a growing tolerance for the given number of
+    /// iterations.
+    void check_topology(int iterations = 2);
     float volume();
     bool is_manifold() const;
     void WriteOBJFile(const std::string &output_file) const;
@@ -138,6 +203,20 @@ class TriangleMesh
 
     /// Perform a cut of the mesh and put the output in upper and lower
     void cut(Axis axis, double z, TriangleMesh* upper, TriangleMesh* lower);
+
+    /// Index of the facet extents along the given axis. It is built on first
+    /// use and kept until the mesh is modified through one of its methods.
+    /// Code writing to stl directly has to call invalidate_indices().
+    /// Callers share the ownership of the index, so it stays valid while they
+    /// use it even if another thread rebuilds it.
+    std::shared_ptr<const FacetSpanIndex> span_index(Axis axis) const;
+
+    /// Edge numbering shared by all slicers of this mesh, built along with the
+    /// shared vertices on first use and kept like the span indices.
+    std::shared_ptr<const FacetEdgeIndex> edge_index();
+
+    /// Drop the cached span and edge indices.
+    void invalidate_indices();
 	
 	/// Generate a mesh representing a cube with dimensions (x, y, z), with one corner at (0,0,0).
     static TriangleMesh make_cube(double x, double y, double z);
@@ -168,11 +247,23 @@ class TriangleMesh
     /// Perform the mechanics of a stl copy
     void clone(const TriangleMesh& other);
 
+    /// Cached span indices, one per axis.
+    mutable std::shared_ptr<const FacetSpanIndex> _span_index[3];
+    std::shared_ptr<const FacetEdgeIndex> _edge_index;
+
     friend class TriangleMeshSlicer<X>;
     friend class TriangleMeshSlicer<Y>;
     friend class TriangleMeshSlicer<Z>;
 };
 
+/// Drop-in replacement for admesh's stl_check_facets_exact(). Degenerate
+/// facets are removed the same way, then all edges are bucketed by a hash of
+/// their vertices and each bucket is matched through a flat open addressed
+/// table on the ThreadPool.
+/// The neighbors list and the connection statistics are identical to the
+/// ones of the chained hash table in admesh.
+void stl_check_facets_exact_parallel(stl_file *stl);
+
 enum FacetEdgeType { feNone, feTop, feBottom, feHorizontal };
 
 class IntersectionPoint : public Point
@@ -205,10 +296,14 @@ class TriangleMeshSlicer
     public:
     TriangleMesh* mesh;
     TriangleMeshSlicer(TriangleMesh* _mesh);
-    ~TriangleMeshSlicer();
     void slice(const std::vector<float> &z, std::vector<Polygons>* layers) const;
     void slice(const std::vector<float> &z, std::vector<ExPolygons>* layers) const;
     void slice(float z, ExPolygons* slices) const;
+
+    /// Intersect every facet with the given (unscaled) planes and return the lines
+    /// found on each of them. Lines are listed in facet order, which makes the
+    /// result independent of the number of threads used to compute it.
+    void slice_lines(const std::vector<float> &z, std::vector<IntersectionLines>* lines) const;
     void slice_facet(float slice_z, const stl_facet &facet, const int &facet_idx,
         const float &min_z, const float &max_z, std::vector<IntersectionLine>* lines,
         boost::mutex* lines_mutex = NULL) const;
@@ -220,10 +315,13 @@ class TriangleMeshSlicer
     void cut(float z, TriangleMesh* upper, TriangleMesh* lower) const;
     
     private:
-    typedef std::vector< std::vector<int> > t_facets_edges;
-    t_facets_edges facets_edges;
-    stl_vertex* v_scaled_shared;
-    void _slice_do(size_t facet_idx, std::vector<IntersectionLines>* lines, boost::mutex* lines_mutex, const std::vector<float> &z) const;
+    std::shared_ptr<const FacetEdgeIndex> edge_index;
+    const stl_vertex* v_scaled_shared;
+    /// Intersection lines found by a run of facets, tagged with their layer index.
+    typedef std::vector< std::pair<size_t, IntersectionLine> > t_layer_lines;
+    void _slice_chunk_do(size_t chunk, size_t chunk_size, const std::vector<int>* selected,
+        const std::vector<float>* z, std::vector<t_layer_lines>* chunk_lines,
+        std::vector< std::vector<size_t> >* chunk_counts) const;
     void _make_loops_do(size_t i, std::vector<IntersectionLines>* lines, std::vector<Polygons>* layers) const;
     void make_loops(std::vector<IntersectionLine> &lines, Polygons* loops) const;
     void make_expolygons(const Polygons &loops, ExPolygons* slices) const;
@@ -16,6 +16,7 @@
 #include <vector>
 #include <boost/thread.hpp>
 #include <cstdint>
+#include "ThreadPool.hpp"
 
 #ifdef _MSC_VER
 #include <limits>
@@ -103,43 +104,42 @@ inline void append_to(std::vector<T> &dst, const std::vector<T> &src)
     dst.insert(dst.end(), src.begin(), src.end());
 }
 
+/// Run func on every item of the vector, spreading the work over the shared
+/// ThreadPool with at most threads_count threads.
 template <class T> void
-_parallelize_do(std::queue<T>* queue, boost::mutex* queue_mutex, boost::function<void(T)> func)
+parallelize(const std::vector<T> &items, boost::function<void(T)> func,
+    int threads_count = boost::thread::hardware_concurrency())
 {
-    //std::cout << "THREAD STARTED: " << boost::this_thread::get_id() << std::endl;
-    while (true) {
-        T i;
-        {
-            boost::lock_guard<boost::mutex> l(*queue_mutex);
-            if (queue->empty()) return;
-            i = queue->front();
-            queue->pop();
-        }
-        //std::cout << "  Thread " << boost::this_thread::get_id() << " processing item " << i << std::endl;
-        func(i);
-        boost::this_thread::interruption_point();
-    }
+    ThreadPool::instance().parallel_for(
+        items.size(),
+        [&items, &func](size_t i) { func(items[i]); },
+        threads_count
+    );
 }
 
 template <class T> void
 parallelize(std::queue<T> queue, boost::function<void(T)> func,
     int threads_count = boost::thread::hardware_concurrency())
 {
-    if (threads_count == 0) threads_count = 2;
-    boost::mutex queue_mutex;
-    boost::thread_group workers;
-    for (int i = 0; i < std::min(threads_count, (int)queue.size()); i++)
-        workers.add_thread(new boost::thread(&_parallelize_do<T>, &queue, &queue_mutex, func));
-    workers.join_all();
+    std::vector<T> items;
+    items.reserve(queue.size());
+    for (; !queue.empty(); queue.pop()) items.push_back(queue.front());
+    parallelize(items, func, threads_count);
 }
 
+/// Run func on every value of the closed range [start, end].
+/// An empty range (end == start - 1, as passed by callers doing size()-1 on
+/// an empty container) is a no-op.
 template <class T> void
 parallelize(T start, T end, boost::function<void(T)> func,
     int threads_count = boost::thread::hardware_concurrency())
 {
-    std::queue<T> queue;
-    for (T i = start; i <= end; ++i) queue.push(i);
-    parallelize(queue, func, threads_count);
+    if (end + 1 == start || end < start) return;
+    ThreadPool::instance().parallel_for(
+        static_cast<size_t>(end - start) + 1,
+        [start, &func](size_t i) { func(start + static_cast<T>(i)); },
+        threads_count
+    );
 }
 
 } // namespace Slic3r